@@ -0,0 +1,885 @@
+// Copyright 2024 Vlad Krupinskii <mrvladus@yandex.ru>
+// SPDX-License-Identifier: MIT
+
+// SWCL benchmark client.
+// Run it with './build.py -b' which starts headless weston (if installed) and
+// forces software EGL, or run it directly inside any Wayland session:
+//   ./benchmarks/benchmark [--software] [results.json]
+// With '--software' the same scenes are drawn by software renderer.
+//   ./benchmarks/benchmark --scaling [results.json]
+// measures software renderer scaling from 1 to 32 threads on a 4K scene. It
+// renders offscreen and doesn't need compositor.
+//   ./benchmarks/benchmark --upload [results.json]
+// measures 4K texture upload throughput with and without persistently mapped
+// pixel buffers. It uses headless mode and doesn't need compositor either.
+//   ./benchmarks/benchmark --resize [results.json]
+// replays interactive resize storm of configure events into headless window,
+// first one configure per frame, then several configures between frames, and
+// counts how many configures each frame coalesced.
+//   ./benchmarks/benchmark --soak [results.json]
+// opens and closes 100000 headless windows and checks that memory and number
+// of live objects don't grow. Compositor run closes 1000 windows as well.
+//   ./benchmarks/benchmark --text font.ttf [results.json]
+// scrolls headless log view of 10000 lines recorded once into command list.
+// It needs benchmark compiled with SWCL_ENABLE_TEXT.
+// Compositor run also measures time from opening popup to its first frame,
+// for the first popup that creates its surfaces and for popups that reuse
+// surfaces of closed ones, CPU time of window drawn on demand while
+// nothing changes, and cost of pointer motion over built-in decorations with
+// number of their redraws.
+// Results are written as JSON so they can be compared between commits.
+
+// Live objects are counted for soak test, it only touches object creation
+#define SWCL_ENABLE_LEAK_CHECK
+#define SWCL_IMPLEMENTATION
+#include "../swcl.h"
+#include <poll.h>
+#include <sys/resource.h>
+
+#define FRAMES 300
+#define INPUT_EVENTS 1000000
+#define MEMORY_WINDOWS 16
+#define SCALING_WIDTH 3840
+#define SCALING_HEIGHT 2160
+#define SCALING_FRAMES 10
+#define UPLOAD_WIDTH 3840
+#define UPLOAD_HEIGHT 2160
+#define UPLOAD_FRAMES 120
+#define RESIZE_STEPS 500
+#define RESIZE_BURST 4
+#define SOAK_WINDOWS 100000
+#define SOAK_WAYLAND_WINDOWS 1000
+#define POPUP_OPENS 100
+#define IDLE_MS 2000
+#define CSD_FRAMES 300
+#define TEXT_LINES 10000
+#define TEXT_FRAMES 300
+#define TEXT_LINE_HEIGHT 14
+
+// Current time in milliseconds
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// CPU time used by the process in milliseconds
+static double cpu_ms() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 +
+         (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+// Resident set size of the process in kilobytes
+static long rss_kb() {
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+    resident = 0;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static struct {
+  double start;
+  double app_new;
+  double window_new;
+  double first_frame;
+  double frame_times[FRAMES];
+  uint32_t frames;
+  double last_frame;
+  uint64_t input_events;
+  SWCLRenderStats stats;
+} bench;
+
+// Scene with a mix of opaque and translucent primitives
+static void draw_scene(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){240, 240, 240, 255});
+  for (uint32_t i = 0; i < 50; i++) {
+    uint32_t x = (i * 37 + bench.frames * 3) % (win->width - 60);
+    uint32_t y = (i * 53) % (win->height - 60);
+    swcl_draw_rect((SWCLColor){i * 5, 100, 200, i % 2 ? 255 : 128},
+                   (SWCLRect){x, y, 60, 40});
+    swcl_draw_circle((SWCLColor){200, i * 5, 100, 255},
+                     (SWCLCircle){x + 30, y + 30, 20});
+  }
+  swcl_draw_rounded_rect((SWCLColor){230, 230, 230, 255},
+                         (SWCLRect){0, 0, win->width, 30}, 10);
+}
+
+static void draw(SWCLWindow *win) {
+  double t = now_ms();
+  if (bench.frames == 0)
+    bench.first_frame = t - bench.start;
+  else if (bench.frames <= FRAMES)
+    bench.frame_times[bench.frames - 1] = t - bench.last_frame;
+  bench.last_frame = t;
+  draw_scene(win);
+  swcl_window_swap_buffers(win);
+  bench.stats = swcl_application_render_stats(win->app);
+  if (++bench.frames > FRAMES)
+    swcl_application_quit(win->app);
+}
+
+static void pointer_motion(SWCLWindow *win, SWCLSeat *seat, int x, int y) {
+  bench.input_events++;
+}
+
+// Seat input listeners are called with. Headless compositor may have no
+// seats, then a seat without devices is used.
+static SWCLSeat *bench_seat(SWCLApplication *app) {
+  static SWCLSeat seat;
+  if (app->seats.length)
+    return (SWCLSeat *)app->seats.items[0];
+  seat.app = app;
+  return &seat;
+}
+
+// Large scene for 4K software rendering
+static void draw_scaling_scene() {
+  swcl_clear_background((SWCLColor){240, 240, 240, 255});
+  for (uint32_t i = 0; i < 2000; i++) {
+    uint32_t x = (i * 97) % (SCALING_WIDTH - 140);
+    uint32_t y = (i * 61) % (SCALING_HEIGHT - 140);
+    swcl_draw_rect((SWCLColor){i * 5, 100, 200, i % 2 ? 255 : 128},
+                   (SWCLRect){x, y, 120, 80});
+    swcl_draw_circle((SWCLColor){200, i * 3, 100, 200},
+                     (SWCLCircle){x + 60, y + 60, 50});
+    swcl_draw_rounded_rect((SWCLColor){20, i, 90, 230},
+                           (SWCLRect){x, y + 30, 140, 60}, 12);
+  }
+}
+
+static struct {
+  SWCLTexture *texture;
+  uint8_t *pixels;
+  uint32_t frames;
+  bool persistent_supported;
+  double start;
+  double update_ms;
+  // Results with persistent buffers ring and with direct uploads
+  double mb_per_sec[2];
+  double update_call_ms[2];
+} upload;
+
+// Upload and draw new 4K frame. First half of frames is uploaded through
+// persistent buffers ring, second half directly.
+static void draw_upload(SWCLWindow *win) {
+  uint32_t half = upload.frames / UPLOAD_FRAMES;
+  if (upload.frames % UPLOAD_FRAMES == 0) {
+    glFinish();
+    upload.start = now_ms();
+    upload.update_ms = 0;
+  }
+  upload.pixels[upload.frames * 4099 % (UPLOAD_WIDTH * UPLOAD_HEIGHT * 4)]++;
+  double t = now_ms();
+  swcl_texture_update(upload.texture, 0, 0, UPLOAD_WIDTH, UPLOAD_HEIGHT,
+                      upload.pixels, 0);
+  upload.update_ms += now_ms() - t;
+  swcl_draw_texture(upload.texture, (SWCLRect){0, 0, win->width, win->height});
+  swcl_window_swap_buffers(win);
+  if (++upload.frames % UPLOAD_FRAMES != 0)
+    return;
+  glFinish();
+  double seconds = (now_ms() - upload.start) / 1000.0;
+  upload.mb_per_sec[half] = (double)UPLOAD_WIDTH * UPLOAD_HEIGHT * 4 *
+                            UPLOAD_FRAMES / 1000000.0 / seconds;
+  upload.update_call_ms[half] = upload.update_ms / UPLOAD_FRAMES;
+  win->app->gl_persistent_upload = false;
+  if (half == 1)
+    swcl_application_quit(win->app);
+}
+
+// Stream 4K RGBA frames into texture, first through persistently mapped
+// buffers ring, then with plain glTexSubImage2D
+static void bench_upload(const char *path) {
+  SWCLConfig cfg = {.app_id = "io.github.mrvladus.Benchmark",
+                    .headless = true};
+  SWCLApplication *app = swcl_application_new(&cfg);
+  SWCLWindow *win =
+      swcl_window_new(app, "Benchmark", 640, 360, 0, 0, false, false,
+                      draw_upload);
+  upload.pixels = (uint8_t *)malloc(UPLOAD_WIDTH * UPLOAD_HEIGHT * 4);
+  for (uint32_t i = 0; i < UPLOAD_WIDTH * UPLOAD_HEIGHT * 4; i++)
+    upload.pixels[i] = i * 7;
+  upload.texture =
+      swcl_texture_create(app, UPLOAD_WIDTH, UPLOAD_HEIGHT, upload.pixels);
+  // Create texture and upload buffers before measuring
+  __swcl_window_make_current(win);
+  upload.persistent_supported = app->gl_persistent_upload;
+  for (uint32_t i = 0; i < SWCL_UPLOAD_BUFFERS; i++)
+    swcl_texture_update(upload.texture, 0, 0, UPLOAD_WIDTH, UPLOAD_HEIGHT,
+                        upload.pixels, 0);
+  swcl_application_run(app);
+  swcl_texture_free(upload.texture);
+  swcl_application_destroy(app);
+  FILE *f = path ? fopen(path, "w") : stdout;
+  if (!f)
+    SWCL_PANIC("Failed to open %s", path);
+  fprintf(f, "{\n  \"width\": %d, \"height\": %d, \"frames\": %d,\n",
+          UPLOAD_WIDTH, UPLOAD_HEIGHT, UPLOAD_FRAMES);
+  fprintf(f, "  \"persistent_supported\": %s,\n",
+          upload.persistent_supported ? "true" : "false");
+  fprintf(f,
+          "  \"pbo_ring\": {\"mb_per_sec\": %.1f, \"update_call_ms\": %.3f},\n",
+          upload.mb_per_sec[0], upload.update_call_ms[0]);
+  fprintf(f,
+          "  \"direct\": {\"mb_per_sec\": %.1f, \"update_call_ms\": %.3f}\n",
+          upload.mb_per_sec[1], upload.update_call_ms[1]);
+  fprintf(f, "}\n");
+  if (path)
+    fclose(f);
+  free(upload.pixels);
+}
+
+#ifdef SWCL_ENABLE_TEXT
+static struct {
+  SWCLFont *font;
+  SWCLCommandList *list;
+  uint32_t frames;
+  double first_frame_ms;
+  double frame_times[TEXT_FRAMES];
+  uint32_t draw_calls;
+  // Glyphs rasterized after the first frame
+  uint32_t rasterized;
+} text;
+
+// Scroll log view recorded once. List is replayed with one draw call and its
+// glyphs stay in atlas, so only the first frame rasterizes them.
+static void draw_text(SWCLWindow *win) {
+  double t = now_ms();
+  swcl_clear_background((SWCLColor){255, 255, 255, 255});
+  if (text.list->dirty) {
+    swcl_command_list_begin(text.list);
+    for (uint32_t i = 0; i < TEXT_LINES; i++) {
+      char line[64];
+      snprintf(line, sizeof(line), "[%05u] worker %u: request handled in %u ms",
+               i, i % 16, i * 37 % 1000);
+      swcl_draw_text((SWCLColor){40, 40, 40, 255}, text.font, 12, 4,
+                     i * TEXT_LINE_HEIGHT, line);
+    }
+    swcl_command_list_end(text.list);
+  }
+  uint32_t scroll = TEXT_LINES * TEXT_LINE_HEIGHT - win->height;
+  swcl_command_list_draw(text.list, 0, -(int32_t)(text.frames * 97 % scroll));
+  swcl_window_swap_buffers(win);
+  glFinish();
+  t = now_ms() - t;
+  if (text.frames == 0) {
+    text.first_frame_ms = t;
+    text.rasterized = __swcl_glyph_atlas.rasterized;
+  } else
+    text.frame_times[text.frames - 1] = t;
+  text.draw_calls = swcl_application_render_stats(win->app).draw_calls;
+  if (++text.frames <= TEXT_FRAMES)
+    return;
+  text.rasterized = __swcl_glyph_atlas.rasterized - text.rasterized;
+  swcl_application_quit(win->app);
+}
+
+// Log view of 10000 lines in headless window
+static void bench_text(const char *font, const char *path) {
+  SWCLConfig cfg = {.app_id = "io.github.mrvladus.Benchmark",
+                    .headless = true};
+  SWCLApplication *app = swcl_application_new(&cfg);
+  text.font = swcl_font_new(font);
+  if (!text.font)
+    SWCL_PANIC("Failed to load font %s", font);
+  text.list = swcl_command_list_new();
+  swcl_window_new(app, "Benchmark", 800, 600, 0, 0, false, false, draw_text);
+  swcl_application_run(app);
+  swcl_command_list_free(text.list);
+  swcl_application_destroy(app);
+  swcl_font_free(text.font);
+  qsort(text.frame_times, TEXT_FRAMES, sizeof(double), cmp_double);
+  FILE *f = path ? fopen(path, "w") : stdout;
+  if (!f)
+    SWCL_PANIC("Failed to open %s", path);
+  fprintf(f, "{\n  \"lines\": %d, \"frames\": %d,\n", TEXT_LINES,
+          TEXT_FRAMES);
+  fprintf(f, "  \"first_frame_ms\": %.3f,\n", text.first_frame_ms);
+  fprintf(f,
+          "  \"frame\": {\"p50_ms\": %.3f, \"p99_ms\": %.3f, "
+          "\"draw_calls\": %u},\n",
+          text.frame_times[TEXT_FRAMES / 2],
+          text.frame_times[TEXT_FRAMES * 99 / 100], text.draw_calls);
+  fprintf(f, "  \"glyphs_rasterized_after_first_frame\": %u\n}\n",
+          text.rasterized);
+  if (path)
+    fclose(f);
+}
+#endif
+
+static struct {
+  // Pass 0 sends one configure per frame, pass 1 sends bursts
+  uint32_t pass;
+  uint32_t step;
+  uint32_t frames;
+  // Serial of the last configure sent and the one applied by last frame
+  uint32_t serial;
+  uint32_t applied_serial;
+  double start;
+  double last_frame;
+  double frame_times[RESIZE_STEPS];
+  // Results of each pass
+  uint32_t frames_rendered[2];
+  uint32_t applied_frames[2];
+  uint32_t max_coalesced[2];
+  double storm_ms[2];
+  double avg_ms[2];
+  double p99_ms[2];
+} resize;
+
+// Size of window at step of resize storm, like dragging window corner
+static void resize_step_size(uint32_t step, uint32_t *width,
+                             uint32_t *height) {
+  *width = 400 + step * 13 % 1200;
+  *height = 300 + step * 7 % 700;
+}
+
+// Draw frame and send configures of the next steps the way compositor does,
+// directly into listeners. Configures received since the last frame are
+// coalesced into one, so frame applies only serial of the latest one.
+static void draw_resize(SWCLWindow *win) {
+  double t = now_ms();
+  if (resize.frames == 0)
+    resize.start = t;
+  else
+    resize.frame_times[resize.frames - 1] = t - resize.last_frame;
+  resize.last_frame = t;
+  uint32_t coalesced = win->configure_serial - resize.applied_serial;
+  if (coalesced) {
+    resize.applied_frames[resize.pass]++;
+    if (coalesced > resize.max_coalesced[resize.pass])
+      resize.max_coalesced[resize.pass] = coalesced;
+    resize.applied_serial = win->configure_serial;
+  }
+  draw_scene(win);
+  swcl_window_swap_buffers(win);
+  resize.frames++;
+  if (resize.step == RESIZE_STEPS) {
+    glFinish();
+    uint32_t frames = resize.frames - 1;
+    double sum = 0;
+    for (uint32_t i = 0; i < frames; i++)
+      sum += resize.frame_times[i];
+    qsort(resize.frame_times, frames, sizeof(double), cmp_double);
+    resize.frames_rendered[resize.pass] = resize.frames;
+    resize.storm_ms[resize.pass] = now_ms() - resize.start;
+    resize.avg_ms[resize.pass] = sum / frames;
+    resize.p99_ms[resize.pass] = resize.frame_times[frames * 99 / 100];
+    resize.frames = 0;
+    resize.step = 0;
+    if (++resize.pass == 2)
+      swcl_application_quit(win->app);
+    return;
+  }
+  uint32_t burst = resize.pass ? RESIZE_BURST : 1;
+  struct wl_array states = {0};
+  for (uint32_t i = 0; i < burst && resize.step < RESIZE_STEPS; i++) {
+    uint32_t width, height;
+    resize_step_size(resize.step++, &width, &height);
+    xdg_toplevel_listener.configure(win, NULL, width, height, &states);
+    xdg_surface_listener.configure(win, NULL, ++resize.serial);
+  }
+}
+
+// Resize storm in headless mode. Compositor can't be asked to send
+// configures, so they are replayed into listeners of headless window.
+static void bench_resize(const char *path) {
+  SWCLConfig cfg = {.app_id = "io.github.mrvladus.Benchmark",
+                    .headless = true};
+  SWCLApplication *app = swcl_application_new(&cfg);
+  swcl_window_new(app, "Benchmark", 800, 600, 0, 0, false, false,
+                  draw_resize);
+  swcl_application_run(app);
+  swcl_application_destroy(app);
+  FILE *f = path ? fopen(path, "w") : stdout;
+  if (!f)
+    SWCL_PANIC("Failed to open %s", path);
+  fprintf(f, "{\n  \"configures\": %d, \"burst_size\": %d,\n", RESIZE_STEPS,
+          RESIZE_BURST);
+  const char *names[2] = {"every_configure", "burst"};
+  for (uint32_t i = 0; i < 2; i++)
+    fprintf(f,
+            "  \"%s\": {\"frames\": %d, \"applied_frames\": %d, "
+            "\"avg_coalesced\": %.2f, \"max_coalesced\": %d, "
+            "\"storm_ms\": %.3f, \"avg_ms\": %.3f, \"p99_ms\": %.3f}%s\n",
+            names[i], resize.frames_rendered[i], resize.applied_frames[i],
+            (double)RESIZE_STEPS / resize.applied_frames[i],
+            resize.max_coalesced[i], resize.storm_ms[i], resize.avg_ms[i],
+            resize.p99_ms[i], i ? "" : ",");
+  fprintf(f, "}\n");
+  if (path)
+    fclose(f);
+}
+
+static struct {
+  uint32_t windows;
+  double ms;
+  // Memory after tenth of windows, when allocator and driver caches are warm
+  long rss_warm_kb;
+  long rss_end_kb;
+  // Objects left after all windows were closed
+  int32_t live_objects;
+} soak;
+
+static void draw_soak(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){240, 240, 240, 255});
+  swcl_draw_rounded_rect((SWCLColor){50, 100, 200, 255},
+                         (SWCLRect){20, 20, 160, 160}, 10);
+  swcl_window_swap_buffers(win);
+}
+
+// Sum of live object counts
+static int32_t live_objects() {
+  SWCLLiveObjects live = swcl_live_objects();
+  const int32_t *counts = (const int32_t *)&live;
+  int32_t sum = 0;
+  for (uint32_t i = 0; i < sizeof(live) / sizeof(int32_t); i++)
+    sum += counts[i];
+  return sum;
+}
+
+// Open, draw and close windows one by one
+static void soak_windows(SWCLApplication *app, uint32_t count) {
+  int32_t live = live_objects();
+  double t = now_ms();
+  for (uint32_t i = 0; i < count; i++) {
+    if (i == count / 10)
+      soak.rss_warm_kb = rss_kb();
+    SWCLWindow *win = swcl_window_new(app, "Soak", 200, 200, 0, 0, false,
+                                      false, draw_soak);
+    swcl_window_show(win);
+    swcl_window_destroy(win);
+  }
+  soak.ms = now_ms() - t;
+  soak.rss_end_kb = rss_kb();
+  soak.windows = count;
+  soak.live_objects = live_objects() - live;
+}
+
+static void write_soak(FILE *f) {
+  fprintf(f,
+          "  \"soak\": {\"windows\": %d, \"windows_per_sec\": %.0f, "
+          "\"rss_warm_kb\": %ld, \"rss_growth_kb\": %ld, "
+          "\"live_objects\": %d}\n",
+          soak.windows, soak.windows / (soak.ms / 1000.0), soak.rss_warm_kb,
+          soak.rss_end_kb - soak.rss_warm_kb, soak.live_objects);
+}
+
+static struct {
+  double cold_ms;
+  double warm_ms[POPUP_OPENS];
+  bool drawn;
+} popup;
+
+static void draw_popup(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){255, 255, 255, 255});
+  swcl_draw_rounded_rect((SWCLColor){230, 230, 230, 255},
+                         (SWCLRect){4, 4, win->width - 8, 30}, 4);
+  swcl_window_swap_buffers(win);
+  popup.drawn = true;
+}
+
+// Open popup and wait until its first frame is committed
+static double popup_open_ms(SWCLWindow *win, SWCLPositioner *pos,
+                            uint32_t i) {
+  popup.drawn = false;
+  double t = now_ms();
+  SWCLWindow *p = swcl_popup_open(
+      win, pos, (SWCLRect){(i * 37) % 600, (i * 53) % 400, 1, 1}, 200, 150,
+      false, draw_popup);
+  while (!popup.drawn)
+    wl_display_dispatch(win->app->wl_display);
+  t = now_ms() - t;
+  swcl_popup_close(p);
+  return t;
+}
+
+// Popup open to first frame latency. The first popup creates its surfaces,
+// next ones take them from pool.
+static void bench_popups(SWCLWindow *win) {
+  SWCLPositioner *pos = swcl_positioner_new(
+      win->app, SWCL_POPUP_EDGE_BOTTOM_RIGHT, SWCL_POPUP_EDGE_BOTTOM_RIGHT,
+      SWCL_POPUP_ADJUST_FLIP_X | SWCL_POPUP_ADJUST_FLIP_Y, 0, 0);
+  popup.cold_ms = popup_open_ms(win, pos, 0);
+  for (uint32_t i = 0; i < POPUP_OPENS; i++)
+    popup.warm_ms[i] = popup_open_ms(win, pos, i + 1);
+  swcl_positioner_free(pos);
+  qsort(popup.warm_ms, POPUP_OPENS, sizeof(double), cmp_double);
+}
+
+static struct {
+  uint32_t frames;
+  double cpu_ms;
+} idle;
+
+// Dispatch events for 'ms' milliseconds
+static void dispatch_for(SWCLApplication *app, double ms) {
+  double end = now_ms() + ms;
+  for (double t = now_ms(); t < end; t = now_ms()) {
+    wl_display_flush(app->wl_display);
+    struct pollfd pfd = {wl_display_get_fd(app->wl_display), POLLIN, 0};
+    if (poll(&pfd, 1, (int)(end - t) + 1) > 0)
+      wl_display_dispatch(app->wl_display);
+  }
+}
+
+// Window drawn on demand must not draw or use CPU while nothing changes
+static void bench_idle(SWCLWindow *win) {
+  swcl_window_set_redraw_on_demand(win, true);
+  // Frame callback requested before is still delivered
+  dispatch_for(win->app, 100);
+  uint32_t frames = bench.frames;
+  double cpu = cpu_ms();
+  dispatch_for(win->app, IDLE_MS);
+  idle.frames = bench.frames - frames;
+  idle.cpu_ms = cpu_ms() - cpu;
+  swcl_window_set_redraw_on_demand(win, false);
+}
+
+static struct {
+  uint32_t frames;
+  uint32_t gestures;
+  double ms;
+} touch;
+
+static void touch_frame(SWCLWindow *win, SWCLSeat *seat,
+                        const SWCLTouchPoint *points, uint32_t length) {
+  touch.frames++;
+}
+
+static void touch_gesture(SWCLWindow *win, SWCLSeat *seat,
+                          const SWCLGesture *gesture) {
+  touch.gestures++;
+}
+
+// Touch dispatch with gesture recognizer. All points move in every touch
+// frame, as on a 10-point panel, so cost per event is compared with pointer.
+static void bench_touch(SWCLWindow *win) {
+  SWCLSeat *seat = bench_seat(win->app);
+  for (int32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++)
+    wl_touch_listener.down(seat, seat->wl_touch, i, 0, win->wl_surface, i,
+                           wl_fixed_from_int(i * 50), wl_fixed_from_int(300));
+  wl_touch_listener.frame(seat, seat->wl_touch);
+  double t = now_ms();
+  for (uint32_t i = 0; i < INPUT_EVENTS; i++) {
+    int32_t id = i % SWCL_MAX_TOUCH_POINTS;
+    wl_touch_listener.motion(seat, seat->wl_touch, i, id,
+                             wl_fixed_from_int(id * 50 + i % 100),
+                             wl_fixed_from_int(300 + i % 200));
+    if (id == SWCL_MAX_TOUCH_POINTS - 1)
+      wl_touch_listener.frame(seat, seat->wl_touch);
+  }
+  touch.ms = now_ms() - t;
+  for (int32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++)
+    wl_touch_listener.up(seat, seat->wl_touch, i, 0, i);
+  wl_touch_listener.frame(seat, seat->wl_touch);
+}
+
+static struct {
+  uint32_t frames;
+  uint32_t chrome_frames;
+  double motion_ms;
+  bool hits_match;
+  void (*draw_chrome)(SWCLWindow *chrome);
+} csd;
+
+// Compare hit-testing grid with per-pixel classifier on every pixel of
+// decorations of different sizes, including maximized ones without shadow
+// and ones so narrow that borders between their parts collide
+static bool check_csd_hits(SWCLWindow *win) {
+  const uint32_t sizes[][2] = {{800, 600}, {120, 80}, {60, 30},
+                               {25, 10},   {7, 3},    {1, 1}};
+  uint32_t width = win->width, height = win->height;
+  bool maximized = win->maximized, matches = true;
+  for (uint32_t m = 0; m < 2; m++)
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      win->maximized = m;
+      win->width = sizes[i][0];
+      win->height = sizes[i][1];
+      __swcl_csd_layout(win);
+      for (int32_t y = 0; y < (int32_t)win->csd->height; y++)
+        for (int32_t x = 0; x < (int32_t)win->csd->width; x++)
+          matches &= __swcl_csd_hit(win, x, y) ==
+                     __swcl_csd_classify(win, x, y);
+    }
+  win->maximized = maximized;
+  win->width = width;
+  win->height = height;
+  __swcl_csd_layout(win);
+  return matches;
+}
+
+// Count frames of decorations
+static void draw_csd_chrome(SWCLWindow *chrome) {
+  csd.chrome_frames++;
+  csd.draw_chrome(chrome);
+}
+
+// Pointer moves along title bar every frame, decorations must be redrawn
+// only when it crosses buttons
+static void draw_csd(SWCLWindow *win) {
+  draw_scene(win);
+  swcl_window_swap_buffers(win);
+  SWCLSeat *seat = bench_seat(win->app);
+  seat->current_window = win->csd;
+  wl_pointer_listener.motion(
+      seat, seat->wl_pointer, 0,
+      wl_fixed_from_int(csd.frames * 5 % win->csd->width),
+      wl_fixed_from_int(win->csd_shadow + win->csd_top / 2));
+  csd.frames++;
+}
+
+// Pointer motion over built-in decorations and their redraws while window is
+// redrawn every frame
+static void bench_csd(SWCLApplication *app) {
+  SWCLWindow *win = swcl_window_new(app, "CSD", 800, 600, 100, 100, false,
+                                    false, draw_csd);
+  swcl_window_enable_csd(win);
+  csd.draw_chrome = win->csd->on_draw_cb;
+  win->csd->on_draw_cb = draw_csd_chrome;
+  csd.hits_match = check_csd_hits(win);
+  // Listener is called directly, so only hit-testing and dispatch is measured
+  SWCLSeat *seat = bench_seat(app);
+  seat->current_window = win->csd;
+  double t = now_ms();
+  for (uint32_t i = 0; i < INPUT_EVENTS; i++)
+    wl_pointer_listener.motion(seat, seat->wl_pointer, i,
+                               wl_fixed_from_int(i % win->csd->width),
+                               wl_fixed_from_int(i % win->csd->height));
+  csd.motion_ms = now_ms() - t;
+  swcl_window_show(win);
+  while (csd.frames < CSD_FRAMES)
+    wl_display_dispatch(app->wl_display);
+  swcl_window_destroy(win);
+}
+
+// Soak test in headless mode, without compositor
+static void bench_soak(const char *path) {
+  SWCLConfig cfg = {.app_id = "io.github.mrvladus.Benchmark",
+                    .headless = true};
+  SWCLApplication *app = swcl_application_new(&cfg);
+  soak_windows(app, SOAK_WINDOWS);
+  swcl_application_destroy(app);
+  FILE *f = path ? fopen(path, "w") : stdout;
+  if (!f)
+    SWCL_PANIC("Failed to open %s", path);
+  fprintf(f, "{\n");
+  write_soak(f);
+  fprintf(f, "}\n");
+  if (path)
+    fclose(f);
+}
+
+// Render 4K scene with software renderer internals directly, without
+// compositor, using 1 to 32 threads. Also checks that output is identical.
+static void bench_scaling(const char *path) {
+  uint32_t *pixels =
+      (uint32_t *)malloc(SCALING_WIDTH * SCALING_HEIGHT * sizeof(uint32_t));
+  FILE *f = path ? fopen(path, "w") : stdout;
+  if (!f)
+    SWCL_PANIC("Failed to open %s", path);
+  fprintf(f, "{\n  \"width\": %d, \"height\": %d,\n  \"threads\": [",
+          SCALING_WIDTH, SCALING_HEIGHT);
+  uint64_t first_hash = 0;
+  bool identical = true;
+  for (uint32_t threads = 1; threads <= 32; threads *= 2) {
+    SWCLApplication app = {.renderer = SWCL_RENDERER_SOFTWARE,
+                           .software_threads = threads};
+    SWCLWindow win = {.app = &app};
+    __swcl_sw_window = &win;
+    double best = 1e9;
+    for (uint32_t i = 0; i < SCALING_FRAMES; i++) {
+      draw_scaling_scene();
+      double t = now_ms();
+      __swcl_sw_render(&win, pixels, SCALING_WIDTH, SCALING_HEIGHT);
+      t = now_ms() - t;
+      if (t < best)
+        best = t;
+    }
+    uint64_t hash = 0;
+    for (uint32_t i = 0; i < SCALING_WIDTH * SCALING_HEIGHT; i++)
+      hash = hash * 31 + pixels[i];
+    if (threads == 1)
+      first_hash = hash;
+    identical &= hash == first_hash;
+    fprintf(f, "%s\n    {\"threads\": %d, \"frame_ms\": %.3f}",
+            threads == 1 ? "" : ",", threads, best);
+    if (app.render_pool)
+      __swcl_render_pool_destroy(app.render_pool);
+    free(win.commands);
+    free(win.tile_offsets);
+    free(win.tile_commands);
+  }
+  fprintf(f, "\n  ],\n  \"identical_output\": %s\n}\n",
+          identical ? "true" : "false");
+  if (path)
+    fclose(f);
+  free(pixels);
+}
+
+static void write_results(const char *path, SWCLRenderer renderer,
+                          double input_ms, long mem_kb) {
+  qsort(bench.frame_times, FRAMES, sizeof(double), cmp_double);
+  double sum = 0;
+  for (uint32_t i = 0; i < FRAMES; i++)
+    sum += bench.frame_times[i];
+  FILE *f = path ? fopen(path, "w") : stdout;
+  if (!f)
+    SWCL_PANIC("Failed to open %s", path);
+  fprintf(f, "{\n");
+  fprintf(f, "  \"renderer\": \"%s\",\n",
+          renderer == SWCL_RENDERER_SOFTWARE ? "software" : "opengl");
+  fprintf(f,
+          "  \"startup\": {\"app_new_ms\": %.3f, \"window_new_ms\": %.3f, "
+          "\"first_frame_ms\": %.3f},\n",
+          bench.app_new, bench.window_new, bench.first_frame);
+  fprintf(f,
+          "  \"frame\": {\"frames\": %d, \"avg_ms\": %.3f, \"p50_ms\": %.3f, "
+          "\"p99_ms\": %.3f},\n",
+          FRAMES, sum / FRAMES, bench.frame_times[FRAMES / 2],
+          bench.frame_times[FRAMES * 99 / 100]);
+  fprintf(f,
+          "  \"gl_state\": {\"state_changes\": %u, "
+          "\"state_changes_skipped\": %u, \"draw_calls\": %u, "
+          "\"draws_merged\": %u},\n",
+          bench.stats.state_changes, bench.stats.state_changes_skipped,
+          bench.stats.draw_calls, bench.stats.draws_merged);
+  fprintf(f,
+          "  \"input\": {\"events\": %d, \"events_per_sec\": %.0f},\n",
+          INPUT_EVENTS, INPUT_EVENTS / (input_ms / 1000.0));
+  fprintf(f, "  \"memory\": {\"windows\": %d, \"kb_per_window\": %ld},\n",
+          MEMORY_WINDOWS, mem_kb / MEMORY_WINDOWS);
+  fprintf(f,
+          "  \"popup\": {\"opens\": %d, \"cold_ms\": %.3f, "
+          "\"p50_ms\": %.3f, \"p99_ms\": %.3f},\n",
+          POPUP_OPENS, popup.cold_ms, popup.warm_ms[POPUP_OPENS / 2],
+          popup.warm_ms[POPUP_OPENS * 99 / 100]);
+  fprintf(f,
+          "  \"idle\": {\"ms\": %d, \"frames\": %d, \"cpu_ms\": %.3f},\n",
+          IDLE_MS, idle.frames, idle.cpu_ms);
+  fprintf(f,
+          "  \"csd\": {\"frames\": %d, \"chrome_frames\": %d, "
+          "\"motion_events_per_sec\": %.0f, "
+          "\"hits_match_classifier\": %s},\n",
+          csd.frames, csd.chrome_frames,
+          INPUT_EVENTS / (csd.motion_ms / 1000.0),
+          csd.hits_match ? "true" : "false");
+  fprintf(f,
+          "  \"touch\": {\"points\": %d, \"frames\": %d, "
+          "\"gestures\": %d, \"events_per_sec\": %.0f},\n",
+          SWCL_MAX_TOUCH_POINTS, touch.frames, touch.gestures,
+          INPUT_EVENTS / (touch.ms / 1000.0));
+  write_soak(f);
+  fprintf(f, "}\n");
+  if (path)
+    fclose(f);
+}
+
+int main(int argc, char **argv) {
+  const char *output = NULL;
+  SWCLRenderer renderer = SWCL_RENDERER_OPENGL;
+  const char *font = NULL;
+  bool scaling = false, upload_mode = false, resize_mode = false,
+       soak_mode = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--software"))
+      renderer = SWCL_RENDERER_SOFTWARE;
+    else if (!strcmp(argv[i], "--scaling"))
+      scaling = true;
+    else if (!strcmp(argv[i], "--upload"))
+      upload_mode = true;
+    else if (!strcmp(argv[i], "--resize"))
+      resize_mode = true;
+    else if (!strcmp(argv[i], "--soak"))
+      soak_mode = true;
+    else if (!strcmp(argv[i], "--text") && i + 1 < argc)
+      font = argv[++i];
+    else
+      output = argv[i];
+  }
+  if (scaling) {
+    bench_scaling(output);
+    return 0;
+  }
+  if (upload_mode) {
+    bench_upload(output);
+    return 0;
+  }
+  if (resize_mode) {
+    bench_resize(output);
+    return 0;
+  }
+  if (soak_mode) {
+    bench_soak(output);
+    return 0;
+  }
+  if (font) {
+#ifdef SWCL_ENABLE_TEXT
+    bench_text(font, output);
+    return 0;
+#else
+    SWCL_LOG("Benchmark is compiled without SWCL_ENABLE_TEXT");
+    return 1;
+#endif
+  }
+  SWCLConfig cfg = {
+      .app_id = "io.github.mrvladus.Benchmark",
+      .renderer = renderer,
+      .on_pointer_motion_cb = pointer_motion,
+      .on_touch_cb = touch_frame,
+      .on_gesture_cb = touch_gesture,
+  };
+
+  // Startup latency
+  bench.start = now_ms();
+  SWCLApplication *app = swcl_application_new(&cfg);
+  bench.app_new = now_ms() - bench.start;
+  SWCLWindow *win = swcl_window_new(app, "Benchmark", 800, 600, 100, 100,
+                                    false, false, draw);
+  bench.window_new = now_ms() - bench.start - bench.app_new;
+
+  // Memory per window. Extra windows are never shown.
+  long rss = rss_kb();
+  for (uint32_t i = 0; i < MEMORY_WINDOWS; i++)
+    swcl_window_new(app, "Benchmark", 200, 200, 0, 0, false, false, draw);
+  long mem_kb = rss_kb() - rss;
+
+  // Input dispatch throughput. Calls the listener directly so only SWCL
+  // dispatch cost is measured.
+  SWCLSeat *seat = bench_seat(app);
+  seat->current_window = win;
+  double t = now_ms();
+  for (uint32_t i = 0; i < INPUT_EVENTS; i++)
+    wl_pointer_listener.motion(seat, seat->wl_pointer, i,
+                               wl_fixed_from_int(i % 800),
+                               wl_fixed_from_int(i % 600));
+  double input_ms = now_ms() - t;
+  bench_touch(win);
+
+  // Frame time
+  swcl_window_show(win);
+  swcl_application_run(app);
+
+  // Popups are opened after frames are measured, so they don't disturb them
+  bench_popups(win);
+  bench_idle(win);
+  bench_csd(app);
+
+  // Closing windows doesn't leak memory or objects
+  soak_windows(app, SOAK_WAYLAND_WINDOWS);
+  swcl_application_destroy(app);
+
+  write_results(output, renderer, input_ms, mem_kb);
+  return 0;
+}
@@ -3,16 +3,21 @@
 import argparse
 import os
 import re
+import shutil
+import subprocess
+import tempfile
+import time
 import urllib.request
 
 CC = "gcc"
-CLIBS = "-lwayland-client -lwayland-egl -lwayland-cursor -lGL -lEGL -lm"
+CLIBS = "-lwayland-client -lwayland-egl -lwayland-cursor -lGL -lEGL -lm -lpthread"
 CFLAGS = f"{CC} -O3"
 
 def parse_args():
     parser = argparse.ArgumentParser(description='Build script for SWCL')
     parser.add_argument("-r", "--regenerate-protocols", action="store_true", help="Regenerate Wayland protocols files")
     parser.add_argument("-e", "--build-examples", action="store_true", help="Build examples in 'examples' directory")
+    parser.add_argument("-b", "--benchmark", action="store_true", help="Build and run benchmarks in 'benchmarks' directory")
     parser.add_argument("-c", "--clean", action="store_true", help="Cleanup build files")
     return parser.parse_args()
 
@@ -35,15 +40,13 @@ def build_header():
     # Load files
     with open(os.path.join("src", "swcl.h"), "r") as f:
         swcl_h:str = f.read()
-    with open(os.path.join("src", "xdg-shell-protocol.h"), "r") as f:
-        xdg_shell_protocol_h = cleanup_header(f.read())
-    with open(os.path.join("src", "xdg-shell-protocol.c"), "r") as f:
-        xdg_shell_protocol_c = cleanup_header(f.read())
     # Remove dev defines
     swcl_h = swcl_h.replace("\n#define SWCL_IMPLEMENTATION // DEV\n", "")
-    # Insert headers and source files
-    swcl_h = swcl_h.replace('#include "xdg-shell-protocol.h"', xdg_shell_protocol_h)
-    swcl_h = swcl_h.replace('#include "xdg-shell-protocol.c"', xdg_shell_protocol_c)
+    # Insert generated protocol headers and source files
+    def insert_protocol(match):
+        with open(os.path.join("src", match.group(1)), "r") as f:
+            return cleanup_header(f.read())
+    swcl_h = re.sub(r'#include "([\w-]+-protocol\.[ch])"', insert_protocol, swcl_h)
     # Save to file
     with open("swcl.h", "w") as f:
         f.write(swcl_h)
@@ -51,25 +54,95 @@ def build_header():
 
 def build_examples():
     print("Building examples")
-    examples = ["basic-window", "csd", "events"]
+    examples = ["basic-window", "csd", "dmabuf", "events", "layer-shell", "popup", "subsurface", "touch", "video"]
     for example in examples:
         print(f"Building {example}")
         os.system(f"{CFLAGS} examples/{example}.c -o examples/{example} {CLIBS} -DSWCL_ENABLE_DEBUG_LOGS")
     print("Done")
 
+def run_benchmarks():
+    print("Building benchmarks")
+    # Text benchmark needs FreeType and a font
+    text_flags = ""
+    font = None
+    if os.system("pkg-config --exists freetype2") == 0:
+        text_flags = "-DSWCL_ENABLE_TEXT $(pkg-config --cflags --libs freetype2)"
+        if shutil.which("fc-match"):
+            font = subprocess.run(["fc-match", "-f", "%{file}", "monospace"], capture_output=True, text=True).stdout
+    if os.system(f"{CFLAGS} benchmarks/benchmark.c -o benchmarks/benchmark {CLIBS} {text_flags}") != 0:
+        return
+    print("Running software renderer scaling benchmark")
+    subprocess.run(["benchmarks/benchmark", "--scaling", "benchmarks/results-scaling.json"])
+    # Uploads depend on the GPU driver, so they are measured with the real one
+    print("Running texture upload benchmark")
+    subprocess.run(["benchmarks/benchmark", "--upload", "benchmarks/results-upload.json"])
+    print("Running resize storm benchmark")
+    subprocess.run(["benchmarks/benchmark", "--resize", "benchmarks/results-resize.json"])
+    print("Running soak benchmark")
+    subprocess.run(["benchmarks/benchmark", "--soak", "benchmarks/results-soak.json"])
+    if font:
+        print("Running text benchmark")
+        subprocess.run(["benchmarks/benchmark", "--text", font, "benchmarks/results-text.json"])
+    env = os.environ.copy()
+    # Render with llvmpipe so results don't depend on the GPU
+    env["LIBGL_ALWAYS_SOFTWARE"] = "1"
+    compositor = None
+    if shutil.which("weston"):
+        print("Starting headless weston")
+        runtime_dir = env.setdefault("XDG_RUNTIME_DIR", tempfile.mkdtemp())
+        socket = "swcl-benchmark"
+        # Newer weston takes backend name, older one the module file
+        for backend in ["headless", "headless-backend.so"]:
+            compositor = subprocess.Popen(["weston", f"--backend={backend}", "--renderer=gl", f"--socket={socket}", "--idle-time=0"], env=env)
+            for _ in range(50):
+                if compositor.poll() is not None or os.path.exists(os.path.join(runtime_dir, socket)):
+                    break
+                time.sleep(0.1)
+            if compositor.poll() is None and os.path.exists(os.path.join(runtime_dir, socket)):
+                break
+            compositor.terminate()
+            compositor.wait()
+            compositor = None
+        if not compositor:
+            print("Failed to start headless weston, see its output above")
+            return
+        env["WAYLAND_DISPLAY"] = socket
+    elif "WAYLAND_DISPLAY" not in env:
+        print("Weston is not installed and WAYLAND_DISPLAY is not set")
+        return
+    # Same scenes with OpenGL (llvmpipe) and software renderers
+    for renderer in ["opengl", "software"]:
+        print(f"Running benchmarks with {renderer} renderer")
+        args = ["benchmarks/benchmark", f"benchmarks/results-{renderer}.json"]
+        if renderer == "software":
+            args.append("--software")
+        subprocess.run(args, env=env)
+    if compositor:
+        compositor.terminate()
+        compositor.wait()
+    print("Results saved to 'benchmarks' directory")
+
 def regenerate_protocols():
     print("Generating protocols")
     os.system("wayland-scanner client-header < /usr/share/wayland-protocols/stable/xdg-shell/xdg-shell.xml > src/xdg-shell-protocol.h")
     os.system("wayland-scanner private-code < /usr/share/wayland-protocols/stable/xdg-shell/xdg-shell.xml > src/xdg-shell-protocol.c")
+    os.system("wayland-scanner client-header < /usr/share/wayland-protocols/unstable/linux-dmabuf/linux-dmabuf-unstable-v1.xml > src/linux-dmabuf-protocol.h")
+    os.system("wayland-scanner private-code < /usr/share/wayland-protocols/unstable/linux-dmabuf/linux-dmabuf-unstable-v1.xml > src/linux-dmabuf-protocol.c")
+    os.system("wayland-scanner client-header < /usr/share/wayland-protocols/stable/viewporter/viewporter.xml > src/viewporter-protocol.h")
+    os.system("wayland-scanner private-code < /usr/share/wayland-protocols/stable/viewporter/viewporter.xml > src/viewporter-protocol.c")
+    os.system("wayland-scanner client-header < /usr/share/wayland-protocols/staging/fractional-scale/fractional-scale-v1.xml > src/fractional-scale-protocol.h")
+    os.system("wayland-scanner private-code < /usr/share/wayland-protocols/staging/fractional-scale/fractional-scale-v1.xml > src/fractional-scale-protocol.c")
     urllib.request.urlretrieve("https://gitlab.freedesktop.org/wlroots/wlr-protocols/-/raw/master/unstable/wlr-layer-shell-unstable-v1.xml", "wlr-layer-shell-unstable-v1.xml")
     os.system("wayland-scanner client-header < wlr-layer-shell-unstable-v1.xml > src/wlr-layer-shell-protocol.h")
     os.system("wayland-scanner private-code < wlr-layer-shell-unstable-v1.xml > src/wlr-layer-shell-protocol.c")
     os.remove("wlr-layer-shell-unstable-v1.xml")
+    os.system("wayland-scanner client-header < /usr/share/wayland-protocols/unstable/xdg-decoration/xdg-decoration-unstable-v1.xml > src/xdg-decoration-protocol.h")
+    os.system("wayland-scanner private-code < /usr/share/wayland-protocols/unstable/xdg-decoration/xdg-decoration-unstable-v1.xml > src/xdg-decoration-protocol.c")
     print("Done")
 
 def clean():
     print("Running cleanup")
-    clean_files = ["examples/basic-window", "examples/csd", "examples/events"]
+    clean_files = ["examples/basic-window", "examples/csd", "examples/dmabuf", "examples/events", "examples/layer-shell", "examples/popup", "examples/subsurface", "examples/touch", "examples/video", "benchmarks/benchmark", "benchmarks/results-opengl.json", "benchmarks/results-software.json", "benchmarks/results-scaling.json", "benchmarks/results-upload.json", "benchmarks/results-resize.json", "benchmarks/results-soak.json", "benchmarks/results-text.json"]
     for file in clean_files:
         try:
             os.remove(file)
@@ -82,6 +155,8 @@ if __name__ == "__main__":
     args = parse_args()
     if args.build_examples:
         build_examples()
+    elif args.benchmark:
+        run_benchmarks()
     elif args.clean:
         clean()
     elif args.regenerate_protocols:
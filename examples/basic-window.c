@@ -25,5 +25,6 @@ int main() {
   swcl_window_show(win);
   // Run application
   swcl_application_run(app);
+  swcl_application_destroy(app);
   return 0;
 }
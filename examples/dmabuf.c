@@ -0,0 +1,82 @@
+// Copyright 2024 Vlad Krupinskii <mrvladus@yandex.ru>
+// SPDX-License-Identifier: MIT
+
+// Draws frames that are written into dmabuf without copying them into
+// OpenGL. Buffer is created from memfd with udmabuf, so it works without GPU
+// that can export dmabufs (e. g. with llvmpipe). Needs access to
+// '/dev/udmabuf' and OpenGL renderer.
+
+#define _GNU_SOURCE
+#define SWCL_IMPLEMENTATION
+#include "../swcl.h"
+#include <fcntl.h>
+#include <linux/udmabuf.h>
+#include <sys/ioctl.h>
+
+#define WIDTH 256
+#define HEIGHT 256
+
+static uint32_t *pixels;
+static SWCLTexture *texture;
+static uint32_t frame;
+
+void draw(SWCLWindow *win) {
+  // Producer writes next frame right into the buffer GPU samples from
+  for (uint32_t y = 0; y < HEIGHT; y++)
+    for (uint32_t x = 0; x < WIDTH; x++)
+      pixels[y * WIDTH + x] =
+          0xff000000 | ((x + frame) & 255) << 16 | ((y + frame) & 255) << 8;
+  frame++;
+  swcl_clear_background((SWCLColor){255, 255, 255, 255});
+  swcl_draw_texture(texture, (SWCLRect){0, 0, win->width, win->height});
+  swcl_window_swap_buffers(win);
+}
+
+// Create dmabuf backed by memfd and map it
+static int create_dmabuf(size_t size) {
+  int memfd = memfd_create("swcl-dmabuf", MFD_ALLOW_SEALING);
+  if (memfd < 0 || ftruncate(memfd, size) < 0 ||
+      fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) < 0)
+    SWCL_PANIC("Failed to create memfd");
+  pixels = (uint32_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            memfd, 0);
+  if (pixels == MAP_FAILED)
+    SWCL_PANIC("Failed to map memfd");
+  int dev = open("/dev/udmabuf", O_RDWR);
+  if (dev < 0)
+    SWCL_PANIC("Failed to open /dev/udmabuf");
+  struct udmabuf_create create = {
+      .memfd = memfd, .flags = UDMABUF_FLAGS_CLOEXEC, .size = size};
+  int fd = ioctl(dev, UDMABUF_CREATE, &create);
+  if (fd < 0)
+    SWCL_PANIC("Failed to create udmabuf");
+  close(dev);
+  close(memfd);
+  return fd;
+}
+
+int main() {
+  SWCLConfig cfg = {.app_id = "io.github.mrvladus.Test",
+                    .renderer = SWCL_RENDERER_OPENGL};
+  SWCLApplication *app = swcl_application_new(&cfg);
+  SWCLWindow *win = swcl_window_new(app, "Dmabuf", WIDTH * 2, HEIGHT * 2, 100,
+                                    100, false, false, draw);
+  SWCLDmabuf dmabuf = {
+      .width = WIDTH,
+      .height = HEIGHT,
+      .format = SWCL_FOURCC('X', 'R', '2', '4'),
+      .modifier = SWCL_DMABUF_MOD_INVALID,
+      .planes_length = 1,
+      .planes = {{.fd = create_dmabuf(WIDTH * HEIGHT * 4),
+                  .stride = WIDTH * 4}},
+  };
+  texture = swcl_texture_import_dmabuf(app, &dmabuf);
+  if (!texture)
+    SWCL_PANIC("Failed to import dmabuf");
+  close(dmabuf.planes[0].fd);
+  swcl_window_show(win);
+  swcl_application_run(app);
+  swcl_texture_free(texture);
+  swcl_application_destroy(app);
+  return 0;
+}
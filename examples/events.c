@@ -1,6 +1,9 @@
 // Copyright 2024 Vlad Krupinskii <mrvladus@yandex.ru>
 // SPDX-License-Identifier: MIT
 
+// Logs input events with the seat they came from. Compositors with several
+// seats, e. g. one per user of a shared table, report each of them.
+
 #define SWCL_IMPLEMENTATION
 #include "../swcl.h"
 #include <GL/gl.h>
@@ -11,42 +14,54 @@ void draw(SWCLWindow *win) {
   swcl_window_swap_buffers(win);
 }
 
-void pointer_enter(SWCLWindow *win, int x, int y) {
-  SWCL_LOG("Pointer entered: id=%d, x=%d, y=%d", win->id, x, y);
+// Name is sent by compositors that support wl_seat version 2
+static const char *seat_name(SWCLSeat *seat) {
+  return seat->name ? seat->name : "unnamed";
+}
+
+void pointer_enter(SWCLWindow *win, SWCLSeat *seat, int x, int y) {
+  SWCL_LOG("Pointer entered: seat=%s, id=%d, x=%d, y=%d", seat_name(seat),
+           win->id, x, y);
 }
 
-void pointer_leave(SWCLWindow *win) {
-  SWCL_LOG("Pointer leave: id: %d", win->id);
+void pointer_leave(SWCLWindow *win, SWCLSeat *seat) {
+  SWCL_LOG("Pointer leave: seat=%s, id: %d", seat_name(seat), win->id);
 }
 
-void pointer_motion(SWCLWindow *win, int x, int y) {
-  SWCL_LOG("Pointer motion: id=%d, x=%d, y=%d", win->id, x, y);
+void pointer_motion(SWCLWindow *win, SWCLSeat *seat, int x, int y) {
+  SWCL_LOG("Pointer motion: seat=%s, id=%d, x=%d, y=%d", seat_name(seat),
+           win->id, x, y);
 }
 
-void scroll(SWCLWindow *win, SWCLScrollDirection dir) {
+void scroll(SWCLWindow *win, SWCLSeat *seat, SWCLScrollDirection dir) {
   if (dir == SWCL_SCROLL_UP)
-    SWCL_LOG("Scroll UP");
+    SWCL_LOG("Scroll UP: seat=%s", seat_name(seat));
   else
-    SWCL_LOG("Scroll DOWN");
+    SWCL_LOG("Scroll DOWN: seat=%s", seat_name(seat));
 }
 
-void mouse_button_pressed(SWCLWindow *win, SWCLMouseButton button,
-                          SWCLButtonState state) {
-  SWCL_LOG("Button pressed: id=%d, key=%d, state=%d, "
+void mouse_button_pressed(SWCLWindow *win, SWCLSeat *seat,
+                          SWCLMouseButton button, SWCLButtonState state) {
+  SWCL_LOG("Button pressed: seat=%s, id=%d, key=%d, state=%d, "
            "x=%d, y=%d",
-           win->id, button, state, win->app->cursor_pos.x,
-           win->app->cursor_pos.y);
+           seat_name(seat), win->id, button, state, seat->cursor_pos.x,
+           seat->cursor_pos.y);
 }
 
-void kb_key(SWCLWindow *win, uint32_t key, SWCLButtonState state) {
-  SWCL_LOG("Key: keycode=%d, state=%d", key, state);
+void kb_key(SWCLWindow *win, SWCLSeat *seat, uint32_t key,
+            SWCLButtonState state) {
+  SWCL_LOG("Key: seat=%s, keycode=%d, state=%d", seat_name(seat), key, state);
 }
 
-void kb_mod_key(SWCLWindow *win, uint32_t mods_depressed, uint32_t mods_latched,
-                uint32_t mods_locked, uint32_t group) {
-  SWCL_LOG("Key: mods_depressed=%d, mods_latched=%d, "
+void kb_mod_key(SWCLWindow *win, SWCLSeat *seat, uint32_t mods_depressed,
+                uint32_t mods_latched, uint32_t mods_locked, uint32_t group) {
+  SWCL_LOG("Key: seat=%s, mods_depressed=%d, mods_latched=%d, "
            "mods_locked=%d, group=%d",
-           mods_depressed, mods_latched, mods_locked, group);
+           seat_name(seat), mods_depressed, mods_latched, mods_locked, group);
+}
+
+void seat_removed(SWCLSeat *seat) {
+  SWCL_LOG("Seat removed: seat=%s", seat_name(seat));
 }
 
 int main() {
@@ -59,11 +74,13 @@ int main() {
       .on_mouse_scroll_cb = scroll,
       .on_keyboard_key_cb = kb_key,
       .on_keyboard_mod_key_cb = kb_mod_key,
+      .on_seat_removed_cb = seat_removed,
   };
   SWCLApplication *app = swcl_application_new(&cfg);
   SWCLWindow *win = swcl_window_new(app, "Window Events", 800, 600, 100, 100,
                                     false, false, draw);
   swcl_window_show(win);
   swcl_application_run(app);
+  swcl_application_destroy(app);
   return 0;
 }
@@ -0,0 +1,71 @@
+// Copyright 2024 Vlad Krupinskii <mrvladus@yandex.ru>
+// SPDX-License-Identifier: MIT
+
+// Bar at the top of the screen that reserves space for itself, so windows
+// are not placed under it. It's redrawn only when hovered button changes, so
+// it doesn't use CPU while pointer is not moving over it. Needs compositor
+// with wlr_layer_shell support, e. g. sway, hyprland or kwin.
+
+#define SWCL_IMPLEMENTATION
+#include "../swcl.h"
+
+#define BAR_HEIGHT 32
+#define BUTTONS 5
+#define BUTTON_WIDTH 60
+
+static int32_t hovered = -1;
+
+void draw(SWCLWindow *bar) {
+  swcl_clear_background((SWCLColor){30, 30, 30, 255});
+  for (int32_t i = 0; i < BUTTONS; i++) {
+    SWCLColor color = i == hovered ? (SWCLColor){80, 120, 200, 255}
+                                   : (SWCLColor){60, 60, 60, 255};
+    swcl_draw_rounded_rect(
+        color, (SWCLRect){4 + i * (BUTTON_WIDTH + 4), 4, BUTTON_WIDTH,
+                          BAR_HEIGHT - 8},
+        6);
+  }
+  swcl_window_swap_buffers(bar);
+}
+
+static void set_hovered(SWCLWindow *bar, int32_t button) {
+  if (button == hovered)
+    return;
+  hovered = button;
+  swcl_window_queue_redraw(bar);
+}
+
+void pointer_motion(SWCLWindow *bar, SWCLSeat *seat, int x, int y) {
+  if (!bar)
+    return;
+  int32_t button = (x - 4) / (BUTTON_WIDTH + 4);
+  set_hovered(bar, x >= 4 && button < BUTTONS ? button : -1);
+}
+
+void pointer_leave(SWCLWindow *bar, SWCLSeat *seat) {
+  if (bar)
+    set_hovered(bar, -1);
+}
+
+// Bar is the only surface, so application ends when compositor closes it
+void bar_closed(SWCLWindow *bar) { swcl_application_quit(bar->app); }
+
+int main() {
+  SWCLConfig cfg = {
+      .app_id = "io.github.mrvladus.Test",
+      .on_pointer_motion_cb = pointer_motion,
+      .on_pointer_leave_cb = pointer_leave,
+      .on_layer_surface_closed_cb = bar_closed,
+  };
+  SWCLApplication *app = swcl_application_new(&cfg);
+  // Width 0 stretches bar between left and right edges
+  SWCLWindow *bar = swcl_layer_surface_new(
+      app, SWCL_LAYER_TOP, SWCL_ANCOR_TOP | SWCL_ANCOR_LEFT | SWCL_ANCOR_RIGHT,
+      0, BAR_HEIGHT, draw);
+  if (!bar)
+    SWCL_PANIC("Layer surfaces are not supported");
+  swcl_layer_surface_set_exclusive_zone(bar, BAR_HEIGHT);
+  swcl_application_run(app);
+  swcl_application_destroy(app);
+  return 0;
+}
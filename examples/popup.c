@@ -0,0 +1,126 @@
+// Copyright 2024 Vlad Krupinskii <mrvladus@yandex.ru>
+// SPDX-License-Identifier: MIT
+
+// Right click opens context menu at the pointer, hovering the button shows
+// tooltip below it. Both are popups placed by reusable positioners, their
+// surfaces are created in advance and reused every time popup opens.
+
+#define SWCL_IMPLEMENTATION
+#include "../swcl.h"
+
+#define MENU_ITEMS 4
+#define ITEM_HEIGHT 30
+
+static SWCLRect button_rect = {20, 20, 120, 40};
+static SWCLPositioner *menu_pos;
+static SWCLPositioner *tooltip_pos;
+static SWCLWindow *menu;
+static SWCLWindow *tooltip;
+static int32_t hovered_item = -1;
+
+void draw(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){240, 240, 240, 255});
+  swcl_draw_rounded_rect((SWCLColor){50, 100, 200, 255}, button_rect, 8);
+  swcl_window_swap_buffers(win);
+}
+
+void draw_menu(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){255, 255, 255, 255});
+  for (int32_t i = 0; i < MENU_ITEMS; i++) {
+    SWCLColor color = i == hovered_item ? (SWCLColor){200, 220, 250, 255}
+                                        : (SWCLColor){230, 230, 230, 255};
+    swcl_draw_rect(color, (SWCLRect){4, 4 + i * ITEM_HEIGHT, win->width - 8,
+                                     ITEM_HEIGHT - 4});
+  }
+  swcl_window_swap_buffers(win);
+}
+
+void draw_tooltip(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){50, 50, 50, 230});
+  swcl_window_swap_buffers(win);
+}
+
+static bool in_rect(SWCLRect r, int x, int y) {
+  return x >= (int)r.x && y >= (int)r.y && x < (int)(r.x + r.w) &&
+         y < (int)(r.y + r.h);
+}
+
+void pointer_motion(SWCLWindow *win, SWCLSeat *seat, int x, int y) {
+  if (!win)
+    return;
+  if (win == menu) {
+    hovered_item = y / ITEM_HEIGHT;
+    return;
+  }
+  if (win->parent)
+    return;
+  // Tooltip is shown while pointer is over the button
+  bool over = in_rect(button_rect, x, y);
+  if (over && !tooltip && !menu)
+    tooltip = swcl_popup_open(win, tooltip_pos, button_rect, 120, 24, false,
+                              draw_tooltip);
+  else if (!over && tooltip) {
+    swcl_popup_close(tooltip);
+    tooltip = NULL;
+  }
+}
+
+void mouse_button(SWCLWindow *win, SWCLSeat *seat, SWCLMouseButton button,
+                  SWCLButtonState state) {
+  if (!win || state != SWCL_BUTTON_PRESSED)
+    return;
+  if (win == menu) {
+    SWCL_LOG("Menu item %d activated", hovered_item);
+    swcl_popup_close(menu);
+    menu = NULL;
+    return;
+  }
+  if (button != SWCL_MOUSE_2 || menu)
+    return;
+  if (tooltip) {
+    swcl_popup_close(tooltip);
+    tooltip = NULL;
+  }
+  // Menu grabs input of the seat that clicked, so it's closed by compositor
+  // when user clicks elsewhere
+  SWCLPoint pos = seat->cursor_pos;
+  hovered_item = -1;
+  menu = swcl_popup_open(win, menu_pos, (SWCLRect){pos.x, pos.y, 1, 1}, 160,
+                         MENU_ITEMS * ITEM_HEIGHT + 4, true, draw_menu);
+}
+
+void popup_done(SWCLWindow *popup) {
+  if (popup == menu)
+    menu = NULL;
+  if (popup == tooltip)
+    tooltip = NULL;
+}
+
+int main() {
+  SWCLConfig cfg = {
+      .app_id = "io.github.mrvladus.Test",
+      .popup_pool = 2,
+      .on_popup_done_cb = popup_done,
+      .on_pointer_motion_cb = pointer_motion,
+      .on_mouse_button_cb = mouse_button,
+  };
+  SWCLApplication *app = swcl_application_new(&cfg);
+  // Menu opens to the bottom right of the pointer and is flipped or moved if
+  // it doesn't fit on screen. Tooltip is centered below the button.
+  menu_pos = swcl_positioner_new(
+      app, SWCL_POPUP_EDGE_BOTTOM_RIGHT, SWCL_POPUP_EDGE_BOTTOM_RIGHT,
+      SWCL_POPUP_ADJUST_FLIP_X | SWCL_POPUP_ADJUST_FLIP_Y |
+          SWCL_POPUP_ADJUST_SLIDE_X | SWCL_POPUP_ADJUST_SLIDE_Y,
+      0, 0);
+  tooltip_pos = swcl_positioner_new(app, SWCL_POPUP_EDGE_BOTTOM,
+                                    SWCL_POPUP_EDGE_BOTTOM,
+                                    SWCL_POPUP_ADJUST_SLIDE_X, 0, 4);
+  SWCLWindow *win = swcl_window_new(app, "Popups", 400, 300, 200, 150, false,
+                                    false, draw);
+  swcl_window_show(win);
+  swcl_application_run(app);
+  swcl_positioner_free(menu_pos);
+  swcl_positioner_free(tooltip_pos);
+  swcl_application_destroy(app);
+  return 0;
+}
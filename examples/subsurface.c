@@ -0,0 +1,49 @@
+// Copyright 2024 Vlad Krupinskii <mrvladus@yandex.ru>
+// SPDX-License-Identifier: MIT
+
+// Window content is drawn on demand, e. g. when it's resized, while spinner
+// in subsurface is redrawn every frame. Compositor puts them together.
+
+#define SWCL_IMPLEMENTATION
+#include "../swcl.h"
+
+static uint32_t frame;
+
+void draw(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){240, 240, 240, 255});
+  swcl_draw_rounded_rect((SWCLColor){50, 100, 200, 255},
+                         (SWCLRect){20, 20, win->width - 40, 60}, 10);
+  swcl_draw_rect((SWCLColor){200, 200, 200, 255},
+                 (SWCLRect){20, 100, win->width - 40, win->height - 120});
+  swcl_window_swap_buffers(win);
+}
+
+void draw_spinner(SWCLWindow *sub) {
+  frame++;
+  swcl_clear_background((SWCLColor){0, 0, 0, 0});
+  for (uint32_t i = 0; i < 8; i++) {
+    float angle = (i + frame / 4) * M_PI / 4;
+    uint8_t alpha = 255 - i * 30;
+    swcl_draw_circle((SWCLColor){50, 100, 200, alpha},
+                     (SWCLCircle){32 + cosf(angle) * 22,
+                                  32 + sinf(angle) * 22, 6});
+  }
+  swcl_window_swap_buffers(sub);
+}
+
+int main() {
+  SWCLConfig cfg = {.app_id = "io.github.mrvladus.Test"};
+  SWCLApplication *app = swcl_application_new(&cfg);
+  SWCLWindow *win = swcl_window_new(app, "Subsurface", 400, 300, 400, 300,
+                                    false, false, draw);
+  // Content of the window is static, so it's drawn only when configure or
+  // scale change needs new frame
+  swcl_window_set_redraw_on_demand(win, true);
+  SWCLWindow *spinner = swcl_subsurface_new(win, 168, 168, 64, 64,
+                                            draw_spinner);
+  swcl_window_show(win);
+  swcl_window_show(spinner);
+  swcl_application_run(app);
+  swcl_application_destroy(app);
+  return 0;
+}
@@ -0,0 +1,73 @@
+// Copyright 2024 Vlad Krupinskii <mrvladus@yandex.ru>
+// SPDX-License-Identifier: MIT
+
+// Every finger on the touchscreen is shown as a circle. Dragging with one
+// finger moves the card and pinching with two scales it, tap resets it.
+// Window is redrawn only when touch points change.
+
+#define SWCL_IMPLEMENTATION
+#include "../swcl.h"
+
+#define CARD_SIZE 200
+
+static SWCLTouchPoint points[SWCL_MAX_TOUCH_POINTS];
+static float card_x = 100, card_y = 100, card_scale = 1;
+// Card position and scale when gesture began
+static float start_x, start_y, start_scale;
+
+void draw(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){255, 255, 255, 255});
+  uint32_t size = CARD_SIZE * card_scale;
+  swcl_draw_rounded_rect((SWCLColor){50, 100, 200, 255},
+                         (SWCLRect){card_x, card_y, size, size}, 12);
+  for (uint32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++)
+    if (points[i].state != SWCL_TOUCH_NONE)
+      swcl_draw_circle((SWCLColor){200, 80, 80, 160},
+                       (SWCLCircle){points[i].x, points[i].y, 30});
+  swcl_window_swap_buffers(win);
+}
+
+// Points that went up in this frame are still in their slots
+void touch(SWCLWindow *win, SWCLSeat *seat,
+           const SWCLTouchPoint *touch_points, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    points[i] = touch_points[i];
+    if (points[i].state == SWCL_TOUCH_UP ||
+        points[i].state == SWCL_TOUCH_CANCEL)
+      points[i].state = SWCL_TOUCH_NONE;
+  }
+  swcl_window_queue_redraw(win);
+}
+
+void gesture(SWCLWindow *win, SWCLSeat *seat, const SWCLGesture *gesture) {
+  if (gesture->type == SWCL_GESTURE_TAP) {
+    card_x = card_y = 100;
+    card_scale = 1;
+  } else if (gesture->phase == SWCL_GESTURE_BEGIN) {
+    start_x = card_x;
+    start_y = card_y;
+    start_scale = card_scale;
+  } else {
+    card_x = start_x + gesture->dx;
+    card_y = start_y + gesture->dy;
+    if (gesture->type == SWCL_GESTURE_PINCH)
+      card_scale = start_scale * gesture->scale;
+  }
+  swcl_window_queue_redraw(win);
+}
+
+int main() {
+  SWCLConfig cfg = {
+      .app_id = "io.github.mrvladus.Test",
+      .on_touch_cb = touch,
+      .on_gesture_cb = gesture,
+  };
+  SWCLApplication *app = swcl_application_new(&cfg);
+  SWCLWindow *win = swcl_window_new(app, "Touch", 800, 600, 100, 100, false,
+                                    false, draw);
+  swcl_window_set_redraw_on_demand(win, true);
+  swcl_window_show(win);
+  swcl_application_run(app);
+  swcl_application_destroy(app);
+  return 0;
+}
@@ -0,0 +1,118 @@
+// Copyright 2024 Vlad Krupinskii <mrvladus@yandex.ru>
+// SPDX-License-Identifier: MIT
+
+// Frames are written into dmabufs that are given to compositor as they are,
+// so they are never copied or drawn with OpenGL. Compositor scales them to
+// the size of the video subsurface. Buffers are created from memfd with
+// udmabuf, so it needs access to '/dev/udmabuf'.
+
+#define _GNU_SOURCE
+#define SWCL_IMPLEMENTATION
+#include "../swcl.h"
+#include <fcntl.h>
+#include <linux/udmabuf.h>
+#include <sys/ioctl.h>
+
+#define WIDTH 320
+#define HEIGHT 180
+#define BUFFERS 3
+
+typedef struct {
+  SWCLVideoBuffer *buffer;
+  uint32_t *pixels;
+} Frame;
+
+static Frame frames[BUFFERS];
+static Frame *last;
+static uint32_t frame;
+
+void draw(SWCLWindow *win) {
+  swcl_clear_background((SWCLColor){20, 20, 20, 255});
+  swcl_window_swap_buffers(win);
+}
+
+void draw_video(SWCLWindow *video) {
+  // Write next frame into buffer that compositor doesn't read from
+  Frame *f = NULL;
+  for (uint32_t i = 0; i < BUFFERS && !f; i++)
+    if (!frames[i].buffer->busy)
+      f = &frames[i];
+  // All buffers are busy - show the last frame again to get next frame
+  // callback
+  if (!f) {
+    swcl_video_surface_present(video, last->buffer);
+    return;
+  }
+  for (uint32_t y = 0; y < HEIGHT; y++)
+    for (uint32_t x = 0; x < WIDTH; x++)
+      f->pixels[y * WIDTH + x] =
+          0xff000000 | ((x + frame) & 255) << 16 | ((y + frame) & 255) << 8;
+  frame++;
+  last = f;
+  swcl_video_surface_present(video, f->buffer);
+}
+
+// Create dmabuf backed by memfd and map it
+static int create_dmabuf(size_t size, uint32_t **pixels) {
+  int memfd = memfd_create("swcl-video", MFD_ALLOW_SEALING);
+  if (memfd < 0 || ftruncate(memfd, size) < 0 ||
+      fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) < 0)
+    SWCL_PANIC("Failed to create memfd");
+  *pixels = (uint32_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                             memfd, 0);
+  if (*pixels == MAP_FAILED)
+    SWCL_PANIC("Failed to map memfd");
+  int dev = open("/dev/udmabuf", O_RDWR);
+  if (dev < 0)
+    SWCL_PANIC("Failed to open /dev/udmabuf");
+  struct udmabuf_create create = {
+      .memfd = memfd, .flags = UDMABUF_FLAGS_CLOEXEC, .size = size};
+  int fd = ioctl(dev, UDMABUF_CREATE, &create);
+  if (fd < 0)
+    SWCL_PANIC("Failed to create udmabuf");
+  close(dev);
+  close(memfd);
+  return fd;
+}
+
+int main() {
+  SWCLConfig cfg = {.app_id = "io.github.mrvladus.Test"};
+  SWCLApplication *app = swcl_application_new(&cfg);
+  SWCLWindow *win = swcl_window_new(app, "Video", WIDTH * 2 + 40,
+                                    HEIGHT * 2 + 40, 100, 100, false, false,
+                                    draw);
+  SWCLWindow *video =
+      swcl_subsurface_new(win, 20, 20, WIDTH * 2, HEIGHT * 2, draw_video);
+  if (!swcl_video_surface_init(video))
+    SWCL_PANIC("Video surfaces are not supported");
+  // Linear buffers are the only ones CPU can write, prefer explicit modifier
+  uint64_t modifier = SWCL_DMABUF_MOD_INVALID;
+  uint32_t length;
+  const SWCLDmabufFormat *formats = swcl_video_surface_formats(video, &length);
+  for (uint32_t i = 0; i < length; i++)
+    if (formats[i].format == SWCL_FOURCC('X', 'R', '2', '4') &&
+        formats[i].modifier == 0)
+      modifier = 0;
+  for (uint32_t i = 0; i < BUFFERS; i++) {
+    SWCLDmabuf dmabuf = {
+        .width = WIDTH,
+        .height = HEIGHT,
+        .format = SWCL_FOURCC('X', 'R', '2', '4'),
+        .modifier = modifier,
+        .planes_length = 1,
+        .planes = {{.fd = create_dmabuf(WIDTH * HEIGHT * 4, &frames[i].pixels),
+                    .stride = WIDTH * 4}},
+    };
+    frames[i].buffer = swcl_video_buffer_new(app, &dmabuf);
+    if (!frames[i].buffer)
+      SWCL_PANIC("Failed to create video buffer");
+    close(dmabuf.planes[0].fd);
+  }
+  swcl_window_show(win);
+  swcl_window_show(video);
+  swcl_application_run(app);
+  for (uint32_t i = 0; i < BUFFERS; i++)
+    swcl_video_buffer_free(frames[i].buffer);
+  swcl_application_destroy(app);
+  return 0;
+}
@@ -8,22 +8,50 @@
 // (CSD).
 
 // Compile flags: -lwayland-client -lwayland-egl -lwayland-cursor -lGL -lEGL -lm
+//                -lpthread
+// With SWCL_ENABLE_TEXT: $(pkg-config --cflags --libs freetype2)
 
 #ifndef SWCL_H
 #define SWCL_H
 
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GL/gl.h>
 #include <wayland-client-protocol.h>
 #include <wayland-client.h>
 #include <wayland-cursor.h>
 #include <wayland-egl-core.h>
 
+#include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// SIMD span fillers of software renderer are selected at compile time
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Text rendering uses FreeType for loading fonts and rasterizing glyphs
+#ifdef SWCL_ENABLE_TEXT
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_ADVANCES_H
+#include FT_OUTLINE_H
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -54,7 +82,35 @@ extern "C" {
     exit(1);                                                                   \
   } while (0)
 
-#define SWCL_ALLOC(T) (T *)malloc(sizeof(T))
+#define SWCL_ALLOC(T) (T *)calloc(1, sizeof(T))
+
+// Tracing macros. Compile with SWCL_ENABLE_TRACING to record events into
+// per-thread ring buffers, then call 'swcl_trace_dump' to write them as Chrome
+// trace JSON (open in chrome://tracing or ui.perfetto.dev). Without the flag
+// they compile to nothing. 'name' must be a string literal.
+#ifdef SWCL_ENABLE_TRACING
+#define SWCL_TRACE_BEGIN(name) swcl_trace_record(name, 'B')
+#define SWCL_TRACE_END(name) swcl_trace_record(name, 'E')
+#define SWCL_TRACE_INSTANT(name) swcl_trace_record(name, 'i')
+#else
+#define SWCL_TRACE_BEGIN(name) ((void)0)
+#define SWCL_TRACE_END(name) ((void)0)
+#define SWCL_TRACE_INSTANT(name) ((void)0)
+#endif
+
+// Leak accounting macros. Compile with SWCL_ENABLE_LEAK_CHECK to count live
+// Wayland and EGL objects created by SWCL (see 'swcl_live_objects'). Objects
+// left when application is destroyed are logged. 'kind' is field of
+// SWCLLiveObjects.
+#ifdef SWCL_ENABLE_LEAK_CHECK
+#define SWCL_LIVE_INC(kind)                                                    \
+  __atomic_add_fetch(&__swcl_live_objects.kind, 1, __ATOMIC_RELAXED)
+#define SWCL_LIVE_DEC(kind)                                                    \
+  __atomic_sub_fetch(&__swcl_live_objects.kind, 1, __ATOMIC_RELAXED)
+#else
+#define SWCL_LIVE_INC(kind) ((void)0)
+#define SWCL_LIVE_DEC(kind) ((void)0)
+#endif
 
 // ---------- UTILS ---------- //
 
@@ -66,7 +122,7 @@ static inline int swcl_generate_id() {
 
 // --- Dynamic Array --- //
 
-// Simple dynamic array structure that can only be grown in size
+// Simple dynamic array structure
 typedef struct {
   uint32_t length;
   uint32_t capacity;
@@ -93,13 +149,211 @@ static inline void swcl_array_append(SWCLArray *array, void *item) {
   array->items[array->length++] = item;
 }
 
-// Destroy array
+// Remove item from the array. Last item takes its place.
+static inline void swcl_array_remove(SWCLArray *array, void *item) {
+  for (uint32_t i = 0; i < array->length; i++) {
+    if (array->items[i] == item) {
+      array->items[i] = array->items[--array->length];
+      return;
+    }
+  }
+}
+
+// Destroy array and free its items
 static inline void swcl_array_free(SWCLArray array) {
   for (uint32_t i = 0; i < array.length; i++) {
     free(array.items[i]);
   }
+  free(array.items);
+}
+
+// --- Tracing --- //
+
+#ifdef SWCL_ENABLE_TRACING
+
+// Number of events kept per thread. Must be a power of two.
+#ifndef SWCL_TRACE_BUFFER_SIZE
+#define SWCL_TRACE_BUFFER_SIZE 16384
+#endif
+
+// Maximum number of threads that can record events
+#ifndef SWCL_TRACE_MAX_THREADS
+#define SWCL_TRACE_MAX_THREADS 16
+#endif
+
+// Fixed-size trace record
+typedef struct {
+  const char *name;
+  uint64_t ts_ns;
+  char phase;
+} SWCLTraceEvent;
+
+// Ring buffer of trace records owned by one thread
+typedef struct {
+  uint32_t tid;
+  uint64_t head;
+  SWCLTraceEvent events[SWCL_TRACE_BUFFER_SIZE];
+} SWCLTraceBuffer;
+
+static SWCLTraceBuffer *__swcl_trace_buffers[SWCL_TRACE_MAX_THREADS];
+static uint32_t __swcl_trace_buffers_count = 0;
+static __thread SWCLTraceBuffer *__swcl_trace_buffer = NULL;
+// Set for threads started after all buffers were taken, they don't record
+static __thread bool __swcl_trace_disabled = false;
+
+static inline uint64_t __swcl_trace_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Record event with phase 'B' (begin), 'E' (end) or 'i' (instant) into the
+// ring buffer of the calling thread. Oldest events are overwritten.
+static inline void swcl_trace_record(const char *name, char phase) {
+  SWCLTraceBuffer *buf = __swcl_trace_buffer;
+  if (!buf) {
+    if (__swcl_trace_disabled)
+      return;
+    uint32_t idx = __atomic_fetch_add(&__swcl_trace_buffers_count, 1,
+                                      __ATOMIC_RELAXED);
+    if (idx >= SWCL_TRACE_MAX_THREADS) {
+      __swcl_trace_disabled = true;
+      if (idx == SWCL_TRACE_MAX_THREADS)
+        SWCL_LOG("Tracing: more than %d threads, events of the next ones are "
+                 "not recorded",
+                 SWCL_TRACE_MAX_THREADS);
+      return;
+    }
+    buf = (SWCLTraceBuffer *)calloc(1, sizeof(SWCLTraceBuffer));
+    buf->tid = idx + 1;
+    __atomic_store_n(&__swcl_trace_buffers[idx], buf, __ATOMIC_RELEASE);
+    __swcl_trace_buffer = buf;
+  }
+  SWCLTraceEvent *e = &buf->events[buf->head & (SWCL_TRACE_BUFFER_SIZE - 1)];
+  e->name = name;
+  e->ts_ns = __swcl_trace_now();
+  e->phase = phase;
+  __atomic_store_n(&buf->head, buf->head + 1, __ATOMIC_RELEASE);
+}
+
+// Write recorded events of all threads to file at 'path' in Chrome trace
+// JSON format. Should be called when other threads are not recording.
+// Returns false if file can't be opened.
+static inline bool swcl_trace_dump(const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return false;
+  int pid = getpid();
+  bool first = true;
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  uint32_t count = __atomic_load_n(&__swcl_trace_buffers_count, __ATOMIC_ACQUIRE);
+  if (count > SWCL_TRACE_MAX_THREADS)
+    count = SWCL_TRACE_MAX_THREADS;
+  for (uint32_t i = 0; i < count; i++) {
+    SWCLTraceBuffer *buf =
+        __atomic_load_n(&__swcl_trace_buffers[i], __ATOMIC_ACQUIRE);
+    if (!buf)
+      continue;
+    fprintf(f,
+            "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"tid\":%u,\"args\":{\"name\":\"SWCL thread %u\"}}",
+            first ? "" : ",", pid, buf->tid, buf->tid);
+    first = false;
+    uint64_t head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+    uint64_t start =
+        head > SWCL_TRACE_BUFFER_SIZE ? head - SWCL_TRACE_BUFFER_SIZE : 0;
+    // Begin events of spans may be overwritten by the ring, their ends are
+    // skipped so every end has a matching begin
+    uint32_t depth = 0;
+    for (uint64_t j = start; j < head; j++) {
+      SWCLTraceEvent *e = &buf->events[j & (SWCL_TRACE_BUFFER_SIZE - 1)];
+      if (e->phase == 'B')
+        depth++;
+      else if (e->phase == 'E' && depth == 0)
+        continue;
+      else if (e->phase == 'E')
+        depth--;
+      fprintf(f,
+              ",\n{\"name\":\"%s\",\"cat\":\"swcl\",\"ph\":\"%c\","
+              "\"ts\":%.3f,\"pid\":%d,\"tid\":%u%s}",
+              e->name, e->phase, e->ts_ns / 1000.0, pid, buf->tid,
+              e->phase == 'i' ? ",\"s\":\"t\"" : "");
+    }
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  return true;
+}
+
+#else
+
+static inline bool swcl_trace_dump(const char *path) { return false; }
+
+#endif // SWCL_ENABLE_TRACING
+
+// --- Leak accounting --- //
+
+// Number of live objects of each kind created by SWCL
+typedef struct {
+  int32_t windows;
+  int32_t textures;
+  int32_t wl_surfaces;
+  int32_t wl_subsurfaces;
+  int32_t xdg_surfaces;
+  int32_t xdg_toplevels;
+  int32_t xdg_decorations;
+  int32_t xdg_popups;
+  int32_t xdg_positioners;
+  int32_t layer_surfaces;
+  int32_t wl_callbacks;
+  int32_t wl_buffers;
+  int32_t wp_viewports;
+  int32_t wp_fractional_scales;
+  int32_t dmabuf_feedbacks;
+  int32_t wl_egl_windows;
+  int32_t egl_surfaces;
+  int32_t egl_contexts;
+} SWCLLiveObjects;
+
+#ifdef SWCL_ENABLE_LEAK_CHECK
+
+static SWCLLiveObjects __swcl_live_objects;
+
+// Get number of live objects. Counts of all applications are summed.
+static inline SWCLLiveObjects swcl_live_objects() {
+  return __swcl_live_objects;
+}
+
+// Log objects that are still alive
+static inline void __swcl_live_objects_report() {
+  SWCLLiveObjects live = swcl_live_objects();
+  // In order of SWCLLiveObjects fields
+  const char *names[] = {
+      "windows",        "textures",      "wl_surfaces",
+      "wl_subsurfaces", "xdg_surfaces",  "xdg_toplevels",
+      "xdg_decorations",                 "xdg_popups",
+      "xdg_positioners",                 "layer_surfaces",
+      "wl_callbacks",   "wl_buffers",    "wp_viewports",
+      "wp_fractional_scales",            "dmabuf_feedbacks",
+      "wl_egl_windows", "egl_surfaces",  "egl_contexts",
+  };
+  const int32_t *counts = (const int32_t *)&live;
+  for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    if (counts[i])
+      SWCL_LOG("Leak check: %d %s alive", counts[i], names[i]);
+}
+
+#else
+
+static inline SWCLLiveObjects swcl_live_objects() {
+  SWCLLiveObjects live = {0};
+  return live;
 }
 
+static inline void __swcl_live_objects_report() {}
+
+#endif // SWCL_ENABLE_LEAK_CHECK
+
 // ---------- ENUMS ---------- //
 
 // Direction of the mouse scroll wheel
@@ -136,20 +390,456 @@ typedef enum {
   SWCL_WINDOW_EDGE_BOTTOM_RIGHT = 10,
 } SWCLWindowEdge;
 
-// Ancor position of the window.
+// Renderer used for drawing windows content.
+// SWCL_RENDERER_AUTO uses OpenGL and falls back to software if EGL fails.
+typedef enum {
+  SWCL_RENDERER_AUTO = 0,
+  SWCL_RENDERER_OPENGL = 1,
+  SWCL_RENDERER_SOFTWARE = 2,
+} SWCLRenderer;
+
+// Edges of output layer surface is ancored to. Can be combined, e. g.
+// SWCL_ANCOR_TOP | SWCL_ANCOR_LEFT | SWCL_ANCOR_RIGHT for top bar. Surface
+// ancored to opposite edges is stretched between them, surface without
+// ancors is centered.
 typedef enum {
   SWCL_ANCOR_NONE = 0,
+  SWCL_ANCOR_CENTER = 0,
   SWCL_ANCOR_TOP = 1,
   SWCL_ANCOR_BOTTOM = 2,
-  SWCL_ANCOR_LEFT = 3,
-  SWCL_ANCOR_RIGHT = 4,
-  SWCL_ANCOR_CENTER = 5,
+  SWCL_ANCOR_LEFT = 4,
+  SWCL_ANCOR_RIGHT = 8,
 } SWCLAncor;
 
+// Shell layer of layer surface, from bottom to top. Bars usually use top
+// layer, wallpapers background and lock screens or notifications overlay.
+typedef enum {
+  SWCL_LAYER_BACKGROUND = 0,
+  SWCL_LAYER_BOTTOM = 1,
+  SWCL_LAYER_TOP = 2,
+  SWCL_LAYER_OVERLAY = 3,
+} SWCLLayer;
+
+// Keyboard focus of layer surface. With exclusive interactivity surface takes
+// all keyboard input, with on demand it's focused like normal windows.
+typedef enum {
+  SWCL_KEYBOARD_INTERACTIVITY_NONE = 0,
+  SWCL_KEYBOARD_INTERACTIVITY_EXCLUSIVE = 1,
+  SWCL_KEYBOARD_INTERACTIVITY_ON_DEMAND = 2,
+} SWCLKeyboardInteractivity;
+
+// Side or corner of popup anchor rectangle. Used both as point of rectangle
+// popup is attached to and as direction popup extends in from that point.
+typedef enum {
+  SWCL_POPUP_EDGE_NONE = 0,
+  SWCL_POPUP_EDGE_TOP = 1,
+  SWCL_POPUP_EDGE_BOTTOM = 2,
+  SWCL_POPUP_EDGE_LEFT = 3,
+  SWCL_POPUP_EDGE_RIGHT = 4,
+  SWCL_POPUP_EDGE_TOP_LEFT = 5,
+  SWCL_POPUP_EDGE_BOTTOM_LEFT = 6,
+  SWCL_POPUP_EDGE_TOP_RIGHT = 7,
+  SWCL_POPUP_EDGE_BOTTOM_RIGHT = 8,
+} SWCLPopupEdge;
+
+// Flags that tell compositor how popup can be moved or resized if it doesn't
+// fit on output. Applied in order: slide, flip, resize.
+typedef enum {
+  SWCL_POPUP_ADJUST_NONE = 0,
+  SWCL_POPUP_ADJUST_SLIDE_X = 1,
+  SWCL_POPUP_ADJUST_SLIDE_Y = 2,
+  SWCL_POPUP_ADJUST_FLIP_X = 4,
+  SWCL_POPUP_ADJUST_FLIP_Y = 8,
+  SWCL_POPUP_ADJUST_RESIZE_X = 16,
+  SWCL_POPUP_ADJUST_RESIZE_Y = 32,
+} SWCLPopupAdjust;
+
+// Who draws title bar and borders of the window
+typedef enum {
+  SWCL_DECORATION_CLIENT_SIDE = 1,
+  SWCL_DECORATION_SERVER_SIDE = 2,
+} SWCLDecorationMode;
+
+// Part of client-side decorations drawn by SWCL. Resize borders have values
+// of SWCLWindowEdge.
+typedef enum {
+  SWCL_CSD_REGION_NONE = 0,
+  SWCL_CSD_REGION_TITLE_BAR = 16,
+  SWCL_CSD_REGION_CLOSE = 17,
+  SWCL_CSD_REGION_MAXIMIZE = 18,
+  SWCL_CSD_REGION_MINIMIZE = 19,
+} SWCLCSDRegion;
+
+// State of touch point in the current touch frame
+typedef enum {
+  SWCL_TOUCH_NONE = 0,       // Slot is free
+  SWCL_TOUCH_DOWN = 1,       // Went down in this frame
+  SWCL_TOUCH_MOTION = 2,     // Moved in this frame
+  SWCL_TOUCH_STATIONARY = 3, // Didn't change in this frame
+  SWCL_TOUCH_UP = 4,         // Went up in this frame
+  SWCL_TOUCH_CANCEL = 5,     // Taken by compositor, e. g. for its gesture
+} SWCLTouchState;
+
+// Gestures recognized from touch points
+typedef enum {
+  SWCL_GESTURE_TAP = 0,
+  SWCL_GESTURE_PAN = 1,
+  SWCL_GESTURE_PINCH = 2,
+} SWCLGestureType;
+
+// Phase of gesture. Tap is reported once with SWCL_GESTURE_END phase.
+typedef enum {
+  SWCL_GESTURE_BEGIN = 0,
+  SWCL_GESTURE_UPDATE = 1,
+  SWCL_GESTURE_END = 2,
+} SWCLGesturePhase;
+
+// ---------- DRAWING-RELATED STRUCTS ---------- //
+
+// RGBA color. Values can be from 0 to 255. Alpha is not premultiplied, SWCL
+// premultiplies colors itself when drawing.
+typedef struct {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t a;
+} SWCLColor;
+
+// Rectangle with top left corner position at 'x' and 'y',
+// width 'w' and height 'h'
+typedef struct {
+  uint32_t x;
+  uint32_t y;
+  uint32_t w;
+  uint32_t h;
+} SWCLRect;
+
+// Circle where 'cx' and 'cy' are coordinates of the center of the circle and
+// 'r' is the radius
+typedef struct {
+  uint32_t cx;
+  uint32_t cy;
+  uint32_t r;
+} SWCLCircle;
+
+// Type of recorded drawing command
+typedef enum {
+  SWCL_DRAW_CLEAR = 0,
+  SWCL_DRAW_RECT = 1,
+  SWCL_DRAW_ROUNDED_RECT = 2,
+  SWCL_DRAW_CIRCLE = 3,
+  SWCL_DRAW_GLYPH = 4,
+  SWCL_DRAW_TEXTURE = 5,
+} SWCLDrawCommandType;
+
+// Font loaded with 'swcl_font_new'
+typedef struct SWCLFont SWCLFont;
+
+// Image created with 'swcl_texture_create'
+typedef struct SWCLTexture SWCLTexture;
+
+// Glyph of the font rasterized with given pixel size and horizontal subpixel
+// offset bucket, and its position in glyph atlas at the time it was drawn
+typedef struct {
+  SWCLFont *font;
+  uint32_t index;
+  uint16_t size;
+  uint8_t bucket;
+  uint16_t atlas_x;
+  uint16_t atlas_y;
+} SWCLGlyphRef;
+
+// Recorded call of one of the swcl_draw_* functions. Text is recorded as
+// glyph commands. 'rect' coordinates of glyphs and textures can be negative.
+typedef struct {
+  SWCLDrawCommandType type;
+  SWCLColor color;
+  union {
+    SWCLRect rect;
+    SWCLCircle circle;
+  };
+  union {
+    int radius;
+    SWCLGlyphRef glyph;
+    SWCLTexture *texture;
+  };
+} SWCLDrawCommand;
+
+// Vertex of tessellated drawing commands. Texture coordinates point into
+// glyph atlas, shapes use its white texel at 0, 0.
+typedef struct {
+  float x;
+  float y;
+  float u;
+  float v;
+  SWCLColor color;
+} SWCLVertex;
+
+// Range of vertices of compiled command list, optionally preceded by clear.
+// Vertices are drawn with 'texture', or with glyph atlas if it's NULL.
+typedef struct {
+  uint32_t first;
+  uint32_t count;
+  bool clear;
+  SWCLColor clear_color;
+  SWCLTexture *texture;
+} SWCLCommandBatch;
+
+// Maximum number of rectangles in opaque region
+#ifndef SWCL_OPAQUE_RECTS
+#define SWCL_OPAQUE_RECTS 16
+#endif
+
+// Opaque rectangles smaller than this area are not worth sending
+#define SWCL_OPAQUE_MIN_AREA 1024
+
+// Parts of surface that are known to be fully opaque. Built from drawing
+// commands and sent to compositor with wl_surface_set_opaque_region, so it
+// can skip blending and drawing what is beneath.
+typedef struct {
+  // Surface was cleared, so everything drawn before doesn't matter
+  bool cleared;
+  // Whole surface is opaque
+  bool full;
+  uint32_t length;
+  SWCLRect rects[SWCL_OPAQUE_RECTS];
+} SWCLOpaqueRegion;
+
+// Growable array of vertices
+typedef struct {
+  SWCLVertex *items;
+  uint32_t length;
+  uint32_t capacity;
+} SWCLVertexArray;
+
+// Number of commands in one block of command list arena
+#ifndef SWCL_COMMAND_BLOCK_SIZE
+#define SWCL_COMMAND_BLOCK_SIZE 256
+#endif
+
+// Fixed-size block of recorded commands
+typedef struct SWCLCommandBlock {
+  struct SWCLCommandBlock *next;
+  uint32_t length;
+  SWCLDrawCommand commands[SWCL_COMMAND_BLOCK_SIZE];
+} SWCLCommandBlock;
+
+// Recorded list of drawing commands. Record it once between
+// 'swcl_command_list_begin' and 'swcl_command_list_end' and replay it every
+// frame with 'swcl_command_list_draw'. With OpenGL renderer commands are
+// compiled into vertex buffer, so replaying unchanged list is a single draw
+// call.
+// Recording is done on the calling thread and lists can be recorded from
+// several threads at once, each thread using its own list (see
+// 'swcl_command_lists_submit'). Commands are stored in blocks that are kept
+// when list is recorded again, so recording doesn't allocate once the list
+// has grown to its working size.
+typedef struct {
+  SWCLCommandBlock *first;
+  SWCLCommandBlock *current;
+  uint32_t length;
+  // True after creation and 'swcl_command_list_invalidate', false after
+  // recording. Check it to know if list needs to be recorded again.
+  bool dirty;
+  // Tessellated commands. Built when recording ends.
+  SWCLVertexArray vertices;
+  SWCLCommandBatch *batches;
+  uint32_t batches_length;
+  uint32_t batches_capacity;
+  bool translucent;
+  SWCLOpaqueRegion opaque;
+  // Glyph atlas generation the glyphs were placed with. Glyphs are looked up
+  // again if atlas evicted some glyphs since then.
+  bool has_glyphs;
+  uint32_t glyph_generation;
+  // Distinct atlas glyphs of the list, marked as used every time it's drawn
+  uint32_t *glyphs;
+  uint32_t glyphs_length;
+  uint32_t glyphs_capacity;
+  // OpenGL vertex buffer with uploaded vertices and application whose context
+  // it was created in
+  bool uploaded;
+  GLuint gl_buffer;
+  struct SWCLApplication *gl_app;
+} SWCLCommandList;
+
+// CPU render target of software renderer. Pixels are premultiplied ARGB8888.
+// Drawing is limited to [clip_x0, clip_x1) x [clip_y0, clip_y1).
+typedef struct {
+  uint32_t *pixels;
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride;
+  int32_t clip_x0;
+  int32_t clip_y0;
+  int32_t clip_x1;
+  int32_t clip_y1;
+} SWCLCanvas;
+
 // ---------- STRUCTS ---------- //
 
 typedef struct SWCLApplication SWCLApplication;
 typedef struct SWCLWindow SWCLWindow;
+typedef struct SWCLSeat SWCLSeat;
+
+// Number of pixel buffers used for asynchronous readback in headless mode
+#ifndef SWCL_READBACK_BUFFERS
+#define SWCL_READBACK_BUFFERS 3
+#endif
+
+// Number of GPU timer queries of each window in flight. Results are read a
+// few frames later, so reading them doesn't stall the pipeline.
+#ifndef SWCL_GPU_TIMERS
+#define SWCL_GPU_TIMERS 4
+#endif
+
+// Lowest render scale of dynamic resolution
+#ifndef SWCL_MIN_RENDER_SCALE
+#define SWCL_MIN_RENDER_SCALE 0.5f
+#endif
+
+// Callback that receives pixels read back from headless window.
+// Pixels are RGBA, 4 bytes per pixel, rows from bottom to top.
+// Pointer is valid only during the callback.
+typedef void (*SWCLPixelsCallback)(SWCLWindow *win, const uint8_t *pixels,
+                                   uint32_t width, uint32_t height,
+                                   void *user_data);
+
+// Number of wl_shm buffers per window used by software renderer.
+// 2 - double buffering, 3 - triple buffering.
+#ifndef SWCL_SHM_BUFFERS
+#define SWCL_SHM_BUFFERS 2
+#endif
+
+// Shared memory buffer of software renderer
+typedef struct {
+  struct wl_buffer *wl_buffer;
+  uint32_t *data;
+  uint32_t width;
+  uint32_t height;
+  size_t size;
+  bool busy;
+} SWCLShmBuffer;
+
+// Size of the square tiles software renderer splits window into
+#ifndef SWCL_TILE_SIZE
+#define SWCL_TILE_SIZE 64
+#endif
+
+// Maximum number of software renderer threads
+#ifndef SWCL_MAX_RENDER_THREADS
+#define SWCL_MAX_RENDER_THREADS 64
+#endif
+
+// Threads that rasterize tiles of software rendered frames. The thread that
+// submits a frame rasterizes tiles too.
+typedef struct {
+  pthread_t threads[SWCL_MAX_RENDER_THREADS];
+  uint32_t threads_count;
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  uint64_t generation;
+  uint32_t active;
+  bool quit;
+  // Current frame
+  SWCLWindow *win;
+  SWCLCanvas canvas;
+  uint32_t tiles_count;
+  // Generation of the frame in high 32 bits and its next tile in low ones,
+  // so worker that woke up late can't take tiles of the next frame
+  uint64_t next_tile;
+} SWCLRenderPool;
+
+// Pending asynchronous readback
+typedef struct {
+  GLuint pbo;
+  GLsync fence;
+  uint32_t width;
+  uint32_t height;
+  SWCLPixelsCallback cb;
+  void *user_data;
+} SWCLReadback;
+
+// Output (monitor) and its integer scale
+typedef struct {
+  SWCLApplication *app;
+  struct wl_output *wl_output;
+  uint32_t id;
+  int32_t scale;
+} SWCLOutput;
+
+// Dmabuf format and modifier that compositor accepts
+typedef struct {
+  uint32_t format;
+  uint64_t modifier;
+  // Buffers of this format can be shown directly by display hardware
+  // (scanout), without composition
+  bool scanout;
+} SWCLDmabufFormat;
+
+// Formats received with zwp_linux_dmabuf_feedback_v1, most preferred first.
+// Tranches are collected into 'pending' and replace 'formats' on 'done'
+// event.
+typedef struct {
+  SWCLDmabufFormat *formats;
+  uint32_t formats_length;
+  uint32_t formats_capacity;
+  SWCLDmabufFormat *pending;
+  uint32_t pending_length;
+  uint32_t pending_capacity;
+  // First format and flags of the tranche being received
+  uint32_t tranche_start;
+  uint32_t tranche_flags;
+  // Mapped format table that tranches index
+  uint8_t *table;
+  uint32_t table_size;
+  // Formats changed since 'swcl_video_surface_formats_changed' was called
+  bool changed;
+} SWCLDmabufFeedback;
+
+// Template of popup placement created with 'swcl_positioner_new'. Its
+// xdg_positioner is kept and reused by every popup opened with it, only size
+// and anchor rectangle that differ from the last popup are sent again.
+typedef struct {
+  SWCLPopupEdge anchor;
+  SWCLPopupEdge gravity;
+  uint32_t adjust;
+  int32_t offset_x;
+  int32_t offset_y;
+  // Size and anchor rectangle last set on xdg_positioner
+  uint32_t width;
+  uint32_t height;
+  SWCLRect anchor_rect;
+  struct xdg_positioner *xdg_positioner;
+  SWCLApplication *app;
+} SWCLPositioner;
+
+// Height of title bar and width of shadow drawn by built-in client-side
+// decorations. Window is resized by dragging its shadow.
+#ifndef SWCL_CSD_TITLE_BAR_HEIGHT
+#define SWCL_CSD_TITLE_BAR_HEIGHT 32
+#endif
+#ifndef SWCL_CSD_SHADOW
+#define SWCL_CSD_SHADOW 12
+#endif
+#ifndef SWCL_CSD_CURSOR_SIZE
+#define SWCL_CSD_CURSOR_SIZE 24
+#endif
+
+// Maximum number of cells of decorations map on each axis
+#define SWCL_CSD_CUTS 8
+
+// Parts of decorations looked up by position. Decorations surface is cut
+// into cells at every border between parts, cell 'i' on x axis spans from
+// 'xs[i]' to 'xs[i + 1]'. Part of each cell is found when layout changes.
+typedef struct {
+  int32_t xs[SWCL_CSD_CUTS];
+  int32_t ys[SWCL_CSD_CUTS];
+  uint8_t xs_length;
+  uint8_t ys_length;
+  uint8_t cells[SWCL_CSD_CUTS][SWCL_CSD_CUTS];
+} SWCLCSDMap;
 
 // Toplevel window object
 typedef struct SWCLWindow {
@@ -162,40 +852,253 @@ typedef struct SWCLWindow {
   uint32_t min_height;
   bool maximized;
   bool fullscreen;
+  // Window has keyboard focus
+  bool activated;
+  // Decorations mode compositor configured, its preferred one until window
+  // requests another. Window draws its own decorations unless it's server
+  // side (see 'swcl_window_request_ssr').
+  SWCLDecorationMode decoration_mode;
+  // Scale of the output window is shown on. 'width' and 'height' are in
+  // logical pixels, frames are rendered into buffers of 'buffer_width' x
+  // 'buffer_height' device pixels. Software renderer and video surfaces
+  // always have scale 1 and compositor scales them.
+  float scale;
+  uint32_t buffer_width;
+  uint32_t buffer_height;
+  // Fraction of buffer size that is rendered with dynamic resolution. Less
+  // than 1 when GPU can't render frames in budget.
+  float render_scale;
 
   // Draw function
   void (*on_draw_cb)(SWCLWindow *win);
+  // Window is mapped when its first frame is drawn. Windows drawn on demand
+  // are redrawn only after 'swcl_window_queue_redraw', others on every frame
+  // callback.
+  bool mapped;
+  bool redraw_on_demand;
+  bool redraw_queued;
 
   // Wayland elements
   struct wl_surface *wl_surface;
   struct wl_callback *wl_callback;
   struct xdg_surface *xdg_surface;
   struct xdg_toplevel *xdg_toplevel;
+  struct zxdg_toplevel_decoration_v1 *xdg_decoration;
+
+  // Latest configure received from compositor. Configures are coalesced and
+  // the last one is applied and acked right before the frame that renders
+  // it, so sizes that would be replaced before drawing are never rendered.
+  uint32_t configure_width;
+  uint32_t configure_height;
+  uint32_t configure_serial;
+  bool configure_pending;
+
+  // Scaling elements. Scale is taken from wp_fractional_scale_v1, then from
+  // wl_surface preferred scale, then from outputs surface entered.
+  struct wp_fractional_scale_v1 *wp_fractional_scale;
+  uint32_t fractional_scale;
+  int32_t preferred_scale;
+  SWCLArray outputs;
+  // Surface size is set with viewport destination, scale is committed with
+  // wl_surface.set_buffer_scale if there is no viewporter
+  struct wp_viewport *wp_viewport;
+  uint32_t viewport_width;
+  uint32_t viewport_height;
+  int32_t buffer_scale;
+
+  // Subsurface elements. Set only for windows created with
+  // 'swcl_subsurface_new' or 'swcl_popup_open', 'x' and 'y' are position
+  // relative to parent.
+  SWCLWindow *parent;
+  struct wl_subsurface *wl_subsurface;
+  int32_t x;
+  int32_t y;
+  bool sync;
+
+  // Popup elements. Set only for windows opened with 'swcl_popup_open'.
+  bool popup;
+  struct xdg_popup *xdg_popup;
+
+  // Client-side decorations elements. Set only for windows with
+  // 'swcl_window_enable_csd'. Decorations are drawn into 'csd' subsurface
+  // below the window, 'csd_top' and 'csd_shadow' are their size around
+  // window content, both are 0 while decorations are hidden.
+  SWCLWindow *csd;
+  uint32_t csd_top;
+  uint32_t csd_shadow;
+  SWCLCSDMap csd_map;
+  uint8_t csd_hovered;
+  uint8_t csd_pressed;
+
+  // Layer surface elements. Set only for windows created with
+  // 'swcl_layer_surface_new'.
+  struct zwlr_layer_surface_v1 *layer_surface;
+
+  // Video surface elements. Set only for windows turned into video surface
+  // with 'swcl_video_surface_init'.
+  bool video;
+  struct zwp_linux_dmabuf_feedback_v1 *dmabuf_feedback;
+  SWCLDmabufFeedback feedback;
+  SWCLRect video_source;
 
   // EGL
   struct wl_egl_window *egl_window;
   EGLSurface egl_surface;
 
+  // Ring of GPU timer queries of finished frames and smoothed GPU time of
+  // frame in milliseconds. Render scale is kept for 'render_scale_hold'
+  // frames after change, until queries measure frames of the new size.
+  GLuint gl_timers[SWCL_GPU_TIMERS];
+  uint32_t gl_timer_head;
+  uint32_t gl_timer_count;
+  float gpu_time;
+  uint32_t render_scale_hold;
+
+  // Column-major orthographic projection with top left corner as 0.
+  // Updated when window size changes.
+  float projection[16];
+
+  // Headless framebuffer and readback ring
+  GLuint gl_framebuffer;
+  GLuint gl_renderbuffer;
+  SWCLReadback readbacks[SWCL_READBACK_BUFFERS];
+  uint32_t readback_head;
+  uint32_t readback_count;
+
+  // Software renderer buffers
+  SWCLShmBuffer shm_buffers[SWCL_SHM_BUFFERS];
+  SWCLShmBuffer *shm_current;
+
+  // Opaque region of the current frame and the one sent to compositor
+  SWCLOpaqueRegion opaque;
+  SWCLOpaqueRegion opaque_committed;
+  uint32_t opaque_committed_width;
+  uint32_t opaque_committed_height;
+
+  // Software renderer commands of the current frame and their tiles.
+  // Commands of tile 'i' are 'tile_commands[tile_offsets[i]..tile_offsets[i+1]]'
+  SWCLDrawCommand *commands;
+  uint32_t commands_length;
+  uint32_t commands_capacity;
+  uint32_t *tile_offsets;
+  uint32_t tile_offsets_capacity;
+  uint32_t *tile_commands;
+  uint32_t tile_commands_capacity;
+  // Textures updated after they were drawn in the current frame keep their
+  // old pixels here until it's rendered (see 'swcl_texture_update')
+  SWCLArray texture_snapshots;
+
   SWCLApplication *app;
 } SWCLWindow;
 
+// Maximum number of touch points tracked at once. Points that go down while
+// all slots are taken are ignored.
+#ifndef SWCL_MAX_TOUCH_POINTS
+#define SWCL_MAX_TOUCH_POINTS 10
+#endif
+// Distance in pixels touch point can move and still be a tap
+#ifndef SWCL_TOUCH_SLOP
+#define SWCL_TOUCH_SLOP 10
+#endif
+// Longest time in milliseconds between touch down and up of a tap
+#ifndef SWCL_TAP_TIMEOUT
+#define SWCL_TAP_TIMEOUT 300
+#endif
+
+// Touch point. Coordinates are in surface of the window it went down on and
+// stay there until it goes up, even if it moves outside of the window.
+typedef struct {
+  SWCLTouchState state;
+  // Id given by compositor, unique while point is down
+  int32_t id;
+  SWCLWindow *window;
+  float x;
+  float y;
+  // Where point went down
+  float start_x;
+  float start_y;
+} SWCLTouchPoint;
+
+// Gesture recognized from touch points. 'x' and 'y' are center of the
+// points, 'dx' and 'dy' its movement since gesture began and 'scale' is
+// distance between first two points divided by their distance when pinch
+// began.
+typedef struct {
+  SWCLGestureType type;
+  SWCLGesturePhase phase;
+  float x;
+  float y;
+  float dx;
+  float dy;
+  float scale;
+} SWCLGesture;
+
 // SWCL application configuration.
 // Create before initializing.
 // app_id must be in format e. g. "com.mydomain.AppName"
+// If headless is true, no Wayland connection is made and windows are rendered
+// into offscreen framebuffers (see swcl_window_read_pixels_async). Headless
+// mode always uses OpenGL renderer.
+// software_threads is number of threads used by software renderer, 0 means
+// number of CPUs.
+// If gl_core_profile is true, OpenGL 3.3 core profile context is created
+// instead of compatibility one.
+// If dynamic_resolution is true, OpenGL windows are rendered at lower
+// resolution when GPU time of frame exceeds gpu_frame_budget milliseconds
+// (0 means 12) and compositor scales them to window size. Needs
+// wp_viewporter.
+// popup_pool is number of popup surfaces created in advance, so that first
+// popups open as fast as the next ones, which reuse surfaces of closed
+// popups.
+// on_popup_done_cb is called when compositor closes popup, e. g. user clicked
+// outside of popup with grab. Popup is closed after it returns.
+// on_decoration_mode_cb is called when compositor sets decorations mode of
+// the window, before its next frame is drawn.
+// on_layer_surface_closed_cb is called when compositor closes layer surface,
+// e. g. its output was unplugged. Surface is destroyed after it returns.
+// on_seat_removed_cb is called when seat goes away, e. g. its devices are
+// unplugged, right before it's freed. Application must not keep pointer to
+// the seat after it returns.
+// Input callbacks get the seat event came from. Pointer and keyboard events
+// get window under the pointer or with keyboard focus of the seat, which is
+// NULL if it's not a window of the application.
+// on_touch_cb is called once per touch frame with all SWCL_MAX_TOUCH_POINTS
+// slots, free ones have SWCL_TOUCH_NONE state. Slot of point doesn't change
+// while it's down. Window is the one first point of the touch went down on.
+// on_gesture_cb turns on gesture recognizer for points on that window. Pan
+// and pinch are reported when they begin, every touch frame while they go on
+// and when number of points changes or they go up.
 // Callbacks can be NULL.
 typedef struct {
   const char *app_id;
-  void (*on_pointer_enter_cb)(SWCLWindow *win, int x, int y);
-  void (*on_pointer_leave_cb)(SWCLWindow *win);
-  void (*on_pointer_motion_cb)(SWCLWindow *win, int x, int y);
-  void (*on_mouse_button_cb)(SWCLWindow *win, SWCLMouseButton button,
-                             SWCLButtonState state);
-  void (*on_mouse_scroll_cb)(SWCLWindow *win, SWCLScrollDirection dir);
-  void (*on_keyboard_key_cb)(SWCLWindow *win, uint32_t key,
+  bool headless;
+  SWCLRenderer renderer;
+  uint32_t software_threads;
+  bool gl_core_profile;
+  bool dynamic_resolution;
+  float gpu_frame_budget;
+  uint32_t popup_pool;
+  void (*on_popup_done_cb)(SWCLWindow *popup);
+  void (*on_decoration_mode_cb)(SWCLWindow *win, SWCLDecorationMode mode);
+  void (*on_layer_surface_closed_cb)(SWCLWindow *win);
+  void (*on_seat_removed_cb)(SWCLSeat *seat);
+  void (*on_pointer_enter_cb)(SWCLWindow *win, SWCLSeat *seat, int x, int y);
+  void (*on_pointer_leave_cb)(SWCLWindow *win, SWCLSeat *seat);
+  void (*on_pointer_motion_cb)(SWCLWindow *win, SWCLSeat *seat, int x, int y);
+  void (*on_mouse_button_cb)(SWCLWindow *win, SWCLSeat *seat,
+                             SWCLMouseButton button, SWCLButtonState state);
+  void (*on_mouse_scroll_cb)(SWCLWindow *win, SWCLSeat *seat,
+                             SWCLScrollDirection dir);
+  void (*on_keyboard_key_cb)(SWCLWindow *win, SWCLSeat *seat, uint32_t key,
                              SWCLButtonState state);
-  void (*on_keyboard_mod_key_cb)(SWCLWindow *win, uint32_t mods_depressed,
+  void (*on_keyboard_mod_key_cb)(SWCLWindow *win, SWCLSeat *seat,
+                                 uint32_t mods_depressed,
                                  uint32_t mods_latched, uint32_t mods_locked,
                                  uint32_t group);
+  void (*on_touch_cb)(SWCLWindow *win, SWCLSeat *seat,
+                      const SWCLTouchPoint *points, uint32_t length);
+  void (*on_gesture_cb)(SWCLWindow *win, SWCLSeat *seat,
+                        const SWCLGesture *gesture);
 } SWCLConfig;
 
 // Position with x and y coordinates
@@ -204,81 +1107,404 @@ typedef struct {
   uint32_t y;
 } SWCLPoint;
 
-struct SWCLApplication {
-  // Properties
-  const char *app_id;
-  bool running;
-  SWCLArray windows;
+#ifdef SWCL_ENABLE_TEXT
+
+// Size of square glyph atlas texture
+#ifndef SWCL_GLYPH_ATLAS_SIZE
+#define SWCL_GLYPH_ATLAS_SIZE 1024
+#endif
+
+// Maximum number of glyphs in atlas. Must be power of two.
+#ifndef SWCL_GLYPH_CACHE_SIZE
+#define SWCL_GLYPH_CACHE_SIZE 4096
+#endif
+
+// Maximum number of shaped strings kept in cache. Must be power of two.
+#ifndef SWCL_TEXT_RUN_CACHE_SIZE
+#define SWCL_TEXT_RUN_CACHE_SIZE 4096
+#endif
+
+// Number of horizontal subpixel positions each glyph is rasterized for
+#define SWCL_SUBPIXEL_BUCKETS 4
+
+// Glyphs are placed into square slots of size multiple of this
+#define SWCL_GLYPH_SLOT_STEP 8
+#define SWCL_GLYPH_SLOT_CLASSES 32
+
+struct SWCLFont {
+  FT_Face face;
+  // Pixel size face is currently set to
+  uint32_t size;
+};
+
+// Links of intrusive LRU list. Items are referenced by index + 1, 0 is none.
+typedef struct {
+  uint32_t prev;
+  uint32_t next;
+} SWCLLruLink;
+
+typedef struct {
+  // Most recently used item
+  uint32_t head;
+  // Least recently used item
+  uint32_t tail;
+} SWCLLru;
+
+// Glyph placed into atlas
+typedef struct {
+  SWCLGlyphRef ref;
+  uint16_t w;
+  uint16_t h;
+  int16_t left;
+  int16_t top;
+  // Slot size class, its size is (class + 1) * SWCL_GLYPH_SLOT_STEP
+  uint8_t slot_class;
+  uint32_t last_used;
+  uint32_t hash_next;
+} SWCLGlyph;
+
+// Row of atlas with slots of one size
+typedef struct {
+  uint16_t y;
+  uint8_t slot_class;
+  uint16_t next_x;
+} SWCLAtlasShelf;
+
+typedef struct {
+  uint16_t x;
+  uint16_t y;
+} SWCLAtlasSlot;
+
+// Glyph of shaped string and its pen position in 26.6 fixed point
+typedef struct {
+  uint32_t index;
+  int32_t x;
+} SWCLShapedGlyph;
+
+// Shaped string of the font with given size
+typedef struct {
+  char *text;
+  uint64_t hash;
+  SWCLFont *font;
+  uint32_t size;
+  SWCLShapedGlyph *glyphs;
+  uint32_t length;
+  // Width and ascender in 26.6 fixed point
+  int32_t advance;
+  int32_t ascender;
+  uint32_t hash_next;
+} SWCLTextRun;
+
+// Glyph cache shared by all windows. Glyphs are rasterized into CPU copy of
+// atlas (used directly by software renderer) and uploaded to OpenGL texture
+// before drawing. Glyphs used in current frame are never evicted.
+typedef struct {
+  pthread_mutex_t mutex;
+  FT_Library ft;
+  uint8_t *pixels;
+  uint32_t frame;
+  // Incremented every time glyph leaves atlas
+  uint32_t generation;
+  // Number of glyphs rasterized so far
+  uint32_t rasterized;
+  // Atlas is full with glyphs of current frame, it's cleared on next frame
+  bool reset;
+  // Rows changed since last upload
+  uint32_t dirty_y0;
+  uint32_t dirty_y1;
+  SWCLAtlasShelf shelves[SWCL_GLYPH_ATLAS_SIZE / SWCL_GLYPH_SLOT_STEP];
+  uint32_t shelves_length;
+  uint32_t shelves_y;
+  SWCLAtlasSlot *free_slots[SWCL_GLYPH_SLOT_CLASSES];
+  uint32_t free_slots_length[SWCL_GLYPH_SLOT_CLASSES];
+  uint32_t free_slots_capacity[SWCL_GLYPH_SLOT_CLASSES];
+  SWCLGlyph glyphs[SWCL_GLYPH_CACHE_SIZE];
+  SWCLLruLink glyphs_links[SWCL_GLYPH_CACHE_SIZE];
+  uint32_t glyphs_table[SWCL_GLYPH_CACHE_SIZE];
+  uint32_t glyphs_free[SWCL_GLYPH_CACHE_SIZE];
+  uint32_t glyphs_free_length;
+  uint32_t glyphs_length;
+  SWCLLru glyphs_lru;
+  SWCLTextRun runs[SWCL_TEXT_RUN_CACHE_SIZE];
+  SWCLLruLink runs_links[SWCL_TEXT_RUN_CACHE_SIZE];
+  uint32_t runs_table[SWCL_TEXT_RUN_CACHE_SIZE];
+  uint32_t runs_free[SWCL_TEXT_RUN_CACHE_SIZE];
+  uint32_t runs_free_length;
+  uint32_t runs_length;
+  SWCLLru runs_lru;
+} SWCLGlyphAtlas;
+
+#endif // SWCL_ENABLE_TEXT
+
+// Rendering counters of one frame
+typedef struct {
+  // OpenGL state changes that reached the driver
+  uint32_t state_changes;
+  // State changes skipped because state was already set
+  uint32_t state_changes_skipped;
+  uint32_t draw_calls;
+  // Draws that were merged into previous batch instead of own draw call
+  uint32_t draws_merged;
+} SWCLRenderStats;
+
+// Shadow copy of OpenGL context state. SWCL changes state only through it,
+// so calls are made only when state really changes.
+typedef struct {
+  bool blend;
+  GLint viewport[4];
+  GLuint program;
+  GLuint vertex_array;
+  GLuint array_buffer;
+  GLuint texture;
+  GLuint framebuffer;
+  // Bound texture is an image, not glyph atlas
+  bool image;
+} SWCLGLState;
+
+// Number of pixel unpack buffers texture uploads cycle through
+#ifndef SWCL_UPLOAD_BUFFERS
+#define SWCL_UPLOAD_BUFFERS 3
+#endif
+
+// Persistently mapped pixel unpack buffer. Pixels are copied into it and
+// texture is updated from it by GPU, so upload doesn't wait for the driver.
+// Fence is signaled when GPU has finished reading the buffer.
+typedef struct {
+  GLuint pbo;
+  uint8_t *data;
+  size_t size;
+  GLsync fence;
+} SWCLUploadBuffer;
+
+// Gesture recognizer state. Touch sequence lasts from the first point down
+// to the last point up.
+typedef struct {
+  // Pan or pinch in progress
+  SWCLGesture gesture;
+  bool active;
+  uint32_t points;
+  float start_x;
+  float start_y;
+  float start_distance;
+  // Most points down at once in the sequence and whether any of them moved
+  // further than SWCL_TOUCH_SLOP
+  uint32_t max_points;
+  bool moved;
+  uint32_t start_time;
+} SWCLGestureRecognizer;
+
+// Input devices of one user, e. g. at a table shared by several users. Each
+// seat has its own pointer with cursor, keyboard focus and touch points.
+struct SWCLSeat {
+  // Read-Only properties
+  uint32_t id;
+  char *name;
+  SWCLApplication *app;
+  // Pointer position in surface of 'current_window', window under the
+  // pointer and window with keyboard focus
   SWCLPoint cursor_pos;
   SWCLWindow *current_window;
+  SWCLWindow *keyboard_window;
+
+  // Events of touch frame are collected in slots and reported when it ends.
+  // 'touch_window' is the window first point of the sequence went down on.
+  SWCLTouchPoint touch_points[SWCL_MAX_TOUCH_POINTS];
+  uint32_t touch_count;
+  bool touch_changed;
+  uint32_t touch_time;
+  SWCLWindow *touch_window;
+  SWCLGestureRecognizer gesture;
 
   // Serials of events
   uint32_t wl_pointer_serial;
+  uint32_t wl_pointer_enter_serial;
   uint32_t wl_keyboard_serial;
+  uint32_t wl_touch_serial;
 
   // Wayland
-  struct wl_display *wl_display;
-  struct wl_registry *wl_registry;
-  struct wl_compositor *wl_compositor;
   struct wl_seat *wl_seat;
   struct wl_pointer *wl_pointer;
   struct wl_keyboard *wl_keyboard;
+  struct wl_touch *wl_touch;
+
+  // Cursor. Image is taken from theme of the application and is valid while
+  // theme of 'wl_cursor_theme_generation' is loaded.
+  struct wl_surface *wl_cursor_surface;
+  struct wl_cursor_image *wl_cursor_image;
+  const char *current_cursor_name;
+  uint32_t wl_cursor_theme_generation;
+  // Serial of pointer enter the cursor was set for
+  uint32_t wl_cursor_serial;
+};
+
+struct SWCLApplication {
+  // Properties
+  const char *app_id;
+  bool running;
+  bool headless;
+  SWCLRenderer renderer;
+  uint32_t software_threads;
+  SWCLRenderPool *render_pool;
+  SWCLArray windows;
+  // Hidden surfaces of closed popups, reused by next popups
+  SWCLArray popup_pool;
+  // Seats in order compositor announced them. Windows are moved, resized
+  // and popups grab input with seat of the last input event.
+  SWCLArray seats;
+  SWCLSeat *current_seat;
+
+  // Wayland
+  struct wl_display *wl_display;
+  struct wl_registry *wl_registry;
+  struct wl_compositor *wl_compositor;
+  struct wl_subcompositor *wl_subcompositor;
   struct xdg_wm_base *xdg_wm_base;
   struct zwlr_layer_shell_v1 *wlr_layer_shell;
+  struct zxdg_decoration_manager_v1 *xdg_decoration_manager;
+  struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf;
+  struct wp_viewporter *wp_viewporter;
+  struct wp_fractional_scale_manager_v1 *wp_fractional_scale_manager;
+  SWCLArray outputs;
+  // Dmabuf formats compositor accepts for any surface
+  struct zwp_linux_dmabuf_feedback_v1 *dmabuf_feedback;
+  SWCLDmabufFeedback dmabuf_formats;
 
   EGLConfig egl_config;
   EGLDisplay egl_display;
   EGLContext egl_context;
-
-  // Cursor
-  struct wl_buffer *wl_cursor_buffer;
-  struct wl_cursor *wl_cursor;
+  EGLSurface egl_pbuffer;
+  // EGL_EXT_image_dma_buf_import entry points. Loaded on first import.
+  PFNEGLCREATEIMAGEKHRPROC egl_create_image;
+  PFNEGLDESTROYIMAGEKHRPROC egl_destroy_image;
+  PFNGLEGLIMAGETARGETTEXTURE2DOESPROC gl_image_target_texture;
+  bool egl_dmabuf_modifiers;
+
+  // OpenGL objects shared by all windows. Created when context is made
+  // current for the first time.
+  bool gl_core_profile;
+  GLuint gl_program;
+  GLint gl_projection_location;
+  GLint gl_offset_location;
+  GLint gl_image_location;
+  GLuint gl_vertex_array;
+  GLuint gl_stream_buffer;
+  // Glyph atlas texture. Holds only white texel if text is not used.
+  GLuint gl_atlas_texture;
+  uint32_t gl_atlas_size;
+  SWCLGLState gl_state;
+
+  // Texture uploads go through ring of persistently mapped buffers if
+  // context supports ARB_buffer_storage, otherwise directly
+  bool gl_persistent_upload;
+  SWCLUploadBuffer gl_uploads[SWCL_UPLOAD_BUFFERS];
+  uint32_t gl_upload_index;
+
+  // Immediate draws waiting to be drawn as one batch
+  SWCLVertexArray gl_pending;
+  bool gl_pending_translucent;
+  SWCLTexture *gl_pending_texture;
+
+  // Counters of current and last finished frame
+  SWCLRenderStats stats;
+  SWCLRenderStats last_stats;
+
+  // Dynamic resolution. Frame of 'gl_timer_window' is being timed, only one
+  // timer query can be active at a time.
+  bool dynamic_resolution;
+  float gpu_frame_budget;
+  bool gl_timer_queries;
+  SWCLWindow *gl_timer_window;
+
+  // Cursor theme shared by all seats. Generation is incremented every time
+  // theme is loaded, which frees images of the previous one.
   struct wl_cursor_theme *wl_cursor_theme;
-  struct wl_cursor_image *wl_cursor_image;
-  struct wl_shm *wl_cursor_shm;
-  struct wl_surface *wl_cursor_surface;
-  char *current_cursor_name;
+  uint8_t wl_cursor_size;
+  uint32_t wl_cursor_theme_generation;
+  struct wl_shm *wl_shm;
 
   // Callbacks
-  void (*on_pointer_enter_cb)(SWCLWindow *win, int x, int y);
-  void (*on_pointer_leave_cb)(SWCLWindow *win);
-  void (*on_pointer_motion_cb)(SWCLWindow *win, int x, int y);
-  void (*on_mouse_button_cb)(SWCLWindow *win, SWCLMouseButton button,
+  void (*on_popup_done_cb)(SWCLWindow *popup);
+  void (*on_decoration_mode_cb)(SWCLWindow *win, SWCLDecorationMode mode);
+  void (*on_layer_surface_closed_cb)(SWCLWindow *win);
+  void (*on_seat_removed_cb)(SWCLSeat *seat);
+  void (*on_pointer_enter_cb)(SWCLWindow *win, SWCLSeat *seat, int x, int y);
+  void (*on_pointer_leave_cb)(SWCLWindow *win, SWCLSeat *seat);
+  void (*on_pointer_motion_cb)(SWCLWindow *win, SWCLSeat *seat, int x, int y);
+  void (*on_mouse_button_cb)(SWCLWindow *win, SWCLSeat *seat,
+                             SWCLMouseButton button, SWCLButtonState state);
+  void (*on_mouse_scroll_cb)(SWCLWindow *win, SWCLSeat *seat,
+                             SWCLScrollDirection dir);
+  void (*on_keyboard_key_cb)(SWCLWindow *win, SWCLSeat *seat, uint32_t key,
                              SWCLButtonState state);
-  void (*on_mouse_scroll_cb)(SWCLWindow *win, SWCLScrollDirection dir);
-  void (*on_keyboard_key_cb)(SWCLWindow *win, uint32_t key,
-                             SWCLButtonState state);
-  void (*on_keyboard_mod_key_cb)(SWCLWindow *win, uint32_t mods_depressed,
+  void (*on_keyboard_mod_key_cb)(SWCLWindow *win, SWCLSeat *seat,
+                                 uint32_t mods_depressed,
                                  uint32_t mods_latched, uint32_t mods_locked,
                                  uint32_t group);
+  void (*on_touch_cb)(SWCLWindow *win, SWCLSeat *seat,
+                      const SWCLTouchPoint *points, uint32_t length);
+  void (*on_gesture_cb)(SWCLWindow *win, SWCLSeat *seat,
+                        const SWCLGesture *gesture);
 };
 
-// ---------- DRAWING-RELATED STRUCTS ---------- //
+// Image that can be drawn with 'swcl_draw_texture'
+struct SWCLTexture {
+  SWCLApplication *app;
+  uint32_t width;
+  uint32_t height;
+  // Premultiplied ARGB8888 pixels used by software renderer
+  uint32_t *pixels;
+  // OpenGL texture. Created on first draw if context was not current when
+  // texture was created, until then pixels are kept in 'staging'.
+  GLuint gl_texture;
+  uint8_t *staging;
+  // Imported dmabuf that texture samples directly
+  EGLImageKHR egl_image;
+};
 
-// RGBA color. Values can be from 0 to 255.
-typedef struct {
-  uint8_t r;
-  uint8_t g;
-  uint8_t b;
-  uint8_t a;
-} SWCLColor;
+// Make DRM fourcc format code, e. g. SWCL_FOURCC('X', 'R', '2', '4') for
+// DRM_FORMAT_XRGB8888
+#define SWCL_FOURCC(a, b, c, d)                                                \
+  ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 |                  \
+   (uint32_t)(d) << 24)
 
-// Rectangle with top left corner position at 'x' and 'y',
-// width 'w' and height 'h'
+// Modifier of dmabuf with implicit, driver-defined layout
+// (DRM_FORMAT_MOD_INVALID)
+#define SWCL_DMABUF_MOD_INVALID 0x00ffffffffffffffULL
+
+// Maximum number of planes of dmabuf image
+#define SWCL_DMABUF_MAX_PLANES 4
+
+// Plane of dmabuf image
 typedef struct {
-  uint32_t x;
-  uint32_t y;
-  uint32_t w;
-  uint32_t h;
-} SWCLRect;
+  int fd;
+  uint32_t offset;
+  uint32_t stride;
+} SWCLDmabufPlane;
+
+// Image shared through dmabuf file descriptors, e. g. decoded video frame or
+// buffer from another process. 'format' is DRM fourcc code and 'modifier' is
+// DRM format modifier of all planes.
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t format;
+  uint64_t modifier;
+  uint32_t planes_length;
+  SWCLDmabufPlane planes[SWCL_DMABUF_MAX_PLANES];
+} SWCLDmabuf;
 
-// Circle where 'cx' and 'cy' are coordinates of the center of the circle and
-// 'r' is the radius
+// Dmabuf buffer that is shown on video surface without copies
 typedef struct {
-  uint32_t cx;
-  uint32_t cy;
-  uint32_t r;
-} SWCLCircle;
+  SWCLApplication *app;
+  struct wl_buffer *wl_buffer;
+  uint32_t width;
+  uint32_t height;
+  // Format has no alpha channel, so surface is sent as opaque
+  bool opaque;
+  // Compositor reads from the buffer. It must not be changed until compositor
+  // releases it.
+  bool busy;
+} SWCLVideoBuffer;
 
 // ---------- APPLICATION ---------- //
 
@@ -287,10 +1513,17 @@ typedef struct {
 // and touch devices. Also it will initialize EGL and create OpenGL context.
 static SWCLApplication *swcl_application_new(SWCLConfig *cfg);
 
-// Start the application loop
+// Start the application loop. Returns after 'swcl_application_quit' is
+// called. Headless application also returns when no window has anything to
+// draw.
 static void swcl_application_run(SWCLApplication *app);
 
-// Set cursor image with given name and size.
+// Destroy all windows of the application, release its Wayland and EGL objects
+// and disconnect from Wayland display. Textures and video buffers must be
+// freed before.
+static void swcl_application_destroy(SWCLApplication *app);
+
+// Set cursor image of the seat pointer with given name and size.
 // Name can be one of those:
 // "left_ptr" - default cursor
 // "top_side" - resize top side
@@ -301,12 +1534,22 @@ static void swcl_application_run(SWCLApplication *app);
 // "top_right_corner" - resize top right corner
 // "bottom_left_corner" - resize bottom left corner
 // "bottom_right_corner" - resize bottom right corner
+// Cursor is sent to compositor only when it changes or pointer enters a
+// surface, so it can be set on every motion event.
+static void swcl_seat_set_cursor(SWCLSeat *seat, const char *name,
+                                 uint8_t size);
+
+// Set cursor image of all seats
 static void swcl_application_set_cursor(SWCLApplication *app, const char *name,
                                         uint8_t size);
 
 // Shutdown SWCL application
 static void swcl_application_quit(SWCLApplication *app);
 
+// Get rendering counters of the last frame, e. g. number of OpenGL state
+// changes and draw calls
+static SWCLRenderStats swcl_application_render_stats(SWCLApplication *app);
+
 // ---------- WINDOW ---------- //
 
 // Create new window.
@@ -322,19 +1565,38 @@ static SWCLWindow *swcl_window_new(SWCLApplication *app, char *title,
 // Start window rendering.
 static void swcl_window_show(SWCLWindow *win);
 
-// Set window ancor. Useful for bars, docks or run menus types of apps.
-// Can be used only with compositors that support
-// wlr_layer_shell protocol, e. g. hyprland, kwin, sway.
-// If compositor is not supported - does nothing.
-static void swcl_window_ancor(SWCLAncor ancor);
-
-// Request server-side decorations (SSR) for the window.
-// Compositor must support xdg_decoration protocol.
-// Supported compositors: kwin, sway, hyprland.
-static void swcl_window_request_ssr(SWCLWindow *win);
+// Close window and release all its objects. Subsurfaces of the window are
+// destroyed too. Can be called from draw function of the window.
+static void swcl_window_destroy(SWCLWindow *win);
+
+// Draw window only when 'swcl_window_queue_redraw' is called instead of on
+// every frame callback. Idle window doesn't use CPU or GPU at all. Windows
+// are redrawn continuously by default, layer surfaces on demand.
+static void swcl_window_set_redraw_on_demand(SWCLWindow *win, bool on_demand);
+
+// Redraw window drawn on demand with the next frame callback. Several calls
+// before the frame result in one redraw.
+static void swcl_window_queue_redraw(SWCLWindow *win);
+
+// Request server-side decorations (SSR) for the window, so it doesn't need
+// to draw title bar and borders. Mode compositor chooses is reported with
+// 'on_decoration_mode_cb' and kept in 'decoration_mode'. Returns false if
+// compositor doesn't support xdg_decoration protocol, then window stays
+// client-side decorated. Supported compositors: kwin, sway, hyprland.
+static bool swcl_window_request_ssr(SWCLWindow *win);
+
+// Draw title bar with close, maximize and minimize buttons and shadow around
+// the window, and move or resize window when they are dragged. Decorations
+// are drawn into subsurface below the window and redrawn only when window is
+// resized, focused or hovered button changes, so draw function of the window
+// draws only its content. Pointer events of decorations are not passed to
+// callbacks. Decorations are hidden in fullscreen and while compositor draws
+// its own (see 'swcl_window_request_ssr'). Call before showing the window.
+static void swcl_window_enable_csd(SWCLWindow *win);
 
 // Show compositor window menu. This function is
 // useful for implementing Client-Side Decorations (CSD).
+// This and next two functions use seat of the last input event.
 static void swcl_window_show_menu(SWCLWindow *win);
 
 // Tells compositor to begin native drag operation. With this, window can be
@@ -350,6 +1612,159 @@ static void swcl_window_resize(SWCLWindow *win, SWCLWindowEdge edge);
 // Swap OpenGL buffer for rendered frame
 static void swcl_window_swap_buffers(SWCLWindow *win);
 
+// Start asynchronous read of the rendered frame in headless mode. Call it
+// after drawing and before 'swcl_window_swap_buffers'. 'cb' is called once
+// the pixels are ready, from one of the next 'swcl_window_swap_buffers' calls
+// or from 'swcl_window_flush_pixels'.
+static void swcl_window_read_pixels_async(SWCLWindow *win,
+                                          SWCLPixelsCallback cb,
+                                          void *user_data);
+
+// Wait for all pending readbacks of the window and deliver them
+static void swcl_window_flush_pixels(SWCLWindow *win);
+
+// ---------- SUBSURFACES ---------- //
+
+// Create subsurface of 'parent' window (or of another subsurface) at position
+// 'x', 'y' relative to it. Subsurface is a window without decorations that
+// compositor draws on top of its parent. It has its own buffers and frame
+// callbacks, so content that changes often, e. g. video or spinner, can be
+// redrawn in 'draw_func' without redrawing the parent. Draw it with the same
+// functions as windows and call 'swcl_window_show' to render first frame.
+// Subsurfaces don't receive input, events are delivered to the toplevel
+// window. Subsurface starts in desynchronized mode.
+static SWCLWindow *swcl_subsurface_new(SWCLWindow *parent, int32_t x,
+                                       int32_t y, uint16_t width,
+                                       uint16_t height,
+                                       void (*draw_func)(SWCLWindow *win));
+
+// Move subsurface. Like z-order changes, it's applied when parent surface is
+// committed.
+static void swcl_subsurface_set_position(SWCLWindow *sub, int32_t x,
+                                         int32_t y);
+
+// Place subsurface right above or below 'sibling', which is another
+// subsurface of the same parent or the parent itself
+static void swcl_subsurface_place_above(SWCLWindow *sub, SWCLWindow *sibling);
+static void swcl_subsurface_place_below(SWCLWindow *sub, SWCLWindow *sibling);
+
+// In synchronized mode frames of subsurface are shown together with the next
+// frame of its parent, e. g. to resize them at once. In desynchronized mode
+// they are shown as soon as they are drawn.
+static void swcl_subsurface_set_sync(SWCLWindow *sub, bool sync);
+
+// ---------- LAYER SURFACES ---------- //
+
+// Create layer surface, e. g. bar, dock, wallpaper or notification. It's
+// placed by compositor on shell 'layer' of the output and ancored to its
+// edges with SWCLAncor flags in 'ancor'. Width or height can be 0 if surface
+// is ancored to both opposite edges, then it's stretched between them.
+// First frame is drawn with 'draw_func' when compositor configures surface.
+// Layer surfaces are redrawn on demand (see 'swcl_window_queue_redraw').
+// Can be used only with compositors that support wlr_layer_shell protocol,
+// e. g. hyprland, kwin, sway. Returns NULL if compositor is not supported.
+static SWCLWindow *swcl_layer_surface_new(SWCLApplication *app,
+                                          SWCLLayer layer, uint32_t ancor,
+                                          uint16_t width, uint16_t height,
+                                          void (*draw_func)(SWCLWindow *win));
+
+// Change ancor of layer surface. Like other layer surface properties, it's
+// applied with the next frame.
+static void swcl_window_ancor(SWCLWindow *win, uint32_t ancor);
+
+// Reserve area of the output, e. g. for bar, so other windows are not placed
+// under it. 'zone' is distance from ancored edge, 0 means surface is moved
+// to not overlap reserved areas of other surfaces and -1 means it's not moved
+// at all.
+static void swcl_layer_surface_set_exclusive_zone(SWCLWindow *win,
+                                                  int32_t zone);
+
+// Set distance between layer surface and ancored edges of output
+static void swcl_layer_surface_set_margin(SWCLWindow *win, int32_t top,
+                                          int32_t right, int32_t bottom,
+                                          int32_t left);
+
+// Set how layer surface receives keyboard focus
+static void swcl_layer_surface_set_keyboard_interactivity(
+    SWCLWindow *win, SWCLKeyboardInteractivity interactivity);
+
+// Move layer surface to another layer
+static void swcl_layer_surface_set_layer(SWCLWindow *win, SWCLLayer layer);
+
+// ---------- POPUPS ---------- //
+
+// Create template of popup placement. Popup is attached to 'anchor' point of
+// anchor rectangle given when it's opened, e. g. clicked point or menu
+// button, and extends from it in 'gravity' direction, moved by 'offset_x',
+// 'offset_y'. 'adjust' are SWCLPopupAdjust flags. Create it once and reuse it
+// for all popups of the same kind, e. g. context menus.
+static SWCLPositioner *swcl_positioner_new(SWCLApplication *app,
+                                           SWCLPopupEdge anchor,
+                                           SWCLPopupEdge gravity,
+                                           uint32_t adjust, int32_t offset_x,
+                                           int32_t offset_y);
+
+// Destroy positioner. Popups opened with it are not affected.
+static void swcl_positioner_free(SWCLPositioner *pos);
+
+// Open popup, e. g. menu or tooltip, of 'parent' window or popup. It's placed
+// by 'pos' relative to 'anchor' rectangle in parent coordinates. Surface and
+// EGL surface are taken from pool of closed popups, so nothing is allocated
+// when popup opens. First frame is drawn with 'draw_func' as soon as
+// compositor configures popup, there is no need to call 'swcl_window_show'.
+// Popup position chosen by compositor is in 'x' and 'y' fields.
+// If 'grab' is true, popup gets keyboard focus and compositor closes it when
+// user clicks outside of it (see 'on_popup_done_cb'). Grab must be requested
+// in response to mouse button press.
+static SWCLWindow *swcl_popup_open(SWCLWindow *parent, SWCLPositioner *pos,
+                                   SWCLRect anchor, uint16_t width,
+                                   uint16_t height, bool grab,
+                                   void (*draw_func)(SWCLWindow *win));
+
+// Close popup and put its surfaces back to pool. Popups opened from it are
+// closed and its subsurfaces are destroyed. Popup must not be used after this
+// call.
+static void swcl_popup_close(SWCLWindow *popup);
+
+// ---------- VIDEO SURFACES ---------- //
+
+// Turn window or subsurface into video surface. Its frames are not drawn, but
+// dmabuf buffers, e. g. from hardware video decoder, are passed to compositor
+// as is with 'swcl_video_surface_present'. Compositor scales them to the
+// window size and can put them directly on screen (scanout) when window is
+// fullscreen or covers the whole output. 'draw_func' of the window is still
+// called on frame callbacks and should present the next frame instead of
+// drawing. Returns false if compositor doesn't support zwp_linux_dmabuf_v1.
+static bool swcl_video_surface_init(SWCLWindow *win);
+
+// Get dmabuf formats and modifiers that compositor accepts for the video
+// surface, most preferred first. Allocate buffers with formats marked as
+// 'scanout' when possible.
+static const SWCLDmabufFormat *swcl_video_surface_formats(SWCLWindow *win,
+                                                          uint32_t *length);
+
+// Returns true once after compositor changed formats of the video surface,
+// e. g. when it became fullscreen and can be scanned out. Buffers should be
+// reallocated with formats from 'swcl_video_surface_formats'.
+static bool swcl_video_surface_formats_changed(SWCLWindow *win);
+
+// Show only 'src' part of the buffers, e. g. to cut padding of decoded
+// frames. Zero width or height shows the whole buffer.
+static void swcl_video_surface_set_source(SWCLWindow *win, SWCLRect src);
+
+// Show buffer on video surface. Buffer stays busy until compositor releases
+// it.
+static void swcl_video_surface_present(SWCLWindow *win, SWCLVideoBuffer *buf);
+
+// Create buffer for video surfaces from dmabuf. Format and modifier must be
+// accepted by compositor. Dmabuf file descriptors can be closed after this
+// call. Returns NULL if compositor failed to import dmabuf.
+static SWCLVideoBuffer *swcl_video_buffer_new(SWCLApplication *app,
+                                              const SWCLDmabuf *dmabuf);
+
+// Destroy video buffer
+static void swcl_video_buffer_free(SWCLVideoBuffer *buf);
+
 // Set window properties
 
 // Set window title
@@ -385,9 +1800,104 @@ static void swcl_draw_rounded_rect(SWCLColor color, SWCLRect rect, int radius);
 // Draw circle
 static void swcl_draw_circle(SWCLColor color, SWCLCircle circle);
 
+// ---------- TEXTURES ---------- //
+
+// Create texture of given size. 'pixels' are RGBA, 4 bytes per pixel, not
+// premultiplied, rows from top to bottom. Can be NULL, then texture is
+// transparent.
+static inline SWCLTexture *swcl_texture_create(SWCLApplication *app,
+                                               uint32_t width, uint32_t height,
+                                               const uint8_t *pixels);
+
+// Replace rectangle of the texture with 'pixels' in the same format.
+// 'stride' is number of bytes between rows, 0 means 'width * 4'.
+// With OpenGL renderer pixels are copied into persistently mapped pixel
+// buffer and GPU updates texture asynchronously, so 'pixels' can be reused
+// right after the call and drawing doesn't wait for upload.
+// Draws made before the update show old pixels with both renderers.
+static inline void swcl_texture_update(SWCLTexture *texture, uint32_t x,
+                                       uint32_t y, uint32_t width,
+                                       uint32_t height, const uint8_t *pixels,
+                                       uint32_t stride);
+
+// Import dmabuf as texture without copying its pixels. Texture samples the
+// buffer directly, so drawing it shows what producer has written into the
+// buffer last. Import every buffer of producer's pool once and draw the one
+// with the latest frame. Formats must be sampleable as RGBA, alpha is treated
+// as not premultiplied. File descriptors are not taken and can be closed
+// after the call. Requires OpenGL renderer and EGL_EXT_image_dma_buf_import,
+// returns NULL if dmabuf can't be imported.
+static inline SWCLTexture *swcl_texture_import_dmabuf(SWCLApplication *app,
+                                                      const SWCLDmabuf *dmabuf);
+
+// Free texture. Command lists that draw it must not be drawn anymore.
+static inline void swcl_texture_free(SWCLTexture *texture);
+
+// Draw texture stretched to rectangle. Consecutive draws of the same texture
+// are batched.
+static inline void swcl_draw_texture(SWCLTexture *texture, SWCLRect rect);
+
+// ---------- TEXT ---------- //
+
+#ifdef SWCL_ENABLE_TEXT
+
+// Load font from file, e. g. TTF or OTF. Returns NULL on failure.
+static SWCLFont *swcl_font_new(const char *path);
+
+// Free font and its cached glyphs
+static void swcl_font_free(SWCLFont *font);
+
+// Draw UTF-8 text with font of 'size' pixels. 'x' and 'y' are top left corner
+// of the line, 'x' can be fractional.
+// Glyphs are rasterized once into glyph atlas and drawn as quads batched with
+// other shapes. Shaped strings are cached, so drawing the same strings every
+// frame doesn't shape or rasterize anything.
+static void swcl_draw_text(SWCLColor color, SWCLFont *font, uint32_t size,
+                           float x, float y, const char *text);
+
+// Get width of the text in pixels
+static float swcl_text_width(SWCLFont *font, uint32_t size, const char *text);
+
+#endif // SWCL_ENABLE_TEXT
+
+// ---------- COMMAND LISTS ---------- //
+
+// Create new empty command list
+static SWCLCommandList *swcl_command_list_new();
+
+// Start recording on the calling thread. Previous content is discarded. Until
+// 'swcl_command_list_end' all swcl_draw_* and swcl_clear_background calls
+// made on this thread are recorded into the list instead of being drawn.
+static void swcl_command_list_begin(SWCLCommandList *list);
+
+// Stop recording and tessellate recorded commands. Doesn't use OpenGL, so it
+// can be called on worker threads.
+static void swcl_command_list_end(SWCLCommandList *list);
+
+// Draw recorded commands translated by 'x' and 'y'
+static void swcl_command_list_draw(SWCLCommandList *list, int32_t x,
+                                   int32_t y);
+
+// Mark list as dirty, e. g. when window was resized and its content must be
+// recorded again
+static void swcl_command_list_invalidate(SWCLCommandList *list);
+
+// Draw several lists in array order, e. g. lists recorded concurrently by
+// worker threads. Must be called on the thread with the current window, after
+// recording threads have finished and before 'swcl_window_swap_buffers'.
+// With OpenGL renderer lists are merged into one vertex stream and drawn with
+// a single draw call.
+static void swcl_command_lists_submit(SWCLCommandList **lists,
+                                      uint32_t count);
+
+// Free command list. With OpenGL renderer, context that was current when list
+// was drawn must be current, so list must be freed before its application.
+// List that was never drawn with OpenGL can be freed at any time.
+static void swcl_command_list_free(SWCLCommandList *list);
+
 // ------------------------------------------------------------------------- //
 //                                                                           //
-//                       XDG_SHELL_PROTOCOL DEFENITION                       //
+//                        WAYLAND PROTOCOLS DEFENITION                       //
 //                        INSERTED DURING BUILD STEP                         //
 //                                                                           //
 // ------------------------------------------------------------------------- //
@@ -999,840 +2509,6767 @@ xdg_popup_reposition(struct xdg_popup *xdg_popup, struct xdg_positioner *positio
 }
 #endif
 
-
-#ifdef SWCL_IMPLEMENTATION
-
-// ------------------------------------------------------------------------- //
-//                                                                           //
-//                     XDG_SHELL_PROTOCOL IMPLEMENTATION                     //
-//                        INSERTED DURING BUILD STEP                         //
-//                                                                           //
-// ------------------------------------------------------------------------- //
-
-#include <stdlib.h>
+#ifndef LINUX_DMABUF_UNSTABLE_V1_CLIENT_PROTOCOL_H
+#define LINUX_DMABUF_UNSTABLE_V1_CLIENT_PROTOCOL_H
 #include <stdint.h>
-#include "wayland-util.h"
-#ifndef __has_attribute
-# define __has_attribute(x) 0  
+#include <stddef.h>
+#include "wayland-client.h"
+struct wl_buffer;
+struct wl_surface;
+struct zwp_linux_buffer_params_v1;
+struct zwp_linux_dmabuf_feedback_v1;
+struct zwp_linux_dmabuf_v1;
+#ifndef ZWP_LINUX_DMABUF_V1_INTERFACE
+#define ZWP_LINUX_DMABUF_V1_INTERFACE
+extern const struct wl_interface zwp_linux_dmabuf_v1_interface;
 #endif
-#if (__has_attribute(visibility) || defined(__GNUC__) && __GNUC__ >= 4)
-#define WL_PRIVATE __attribute__ ((visibility("hidden")))
-#else
-#define WL_PRIVATE
+#ifndef ZWP_LINUX_BUFFER_PARAMS_V1_INTERFACE
+#define ZWP_LINUX_BUFFER_PARAMS_V1_INTERFACE
+extern const struct wl_interface zwp_linux_buffer_params_v1_interface;
 #endif
-extern const struct wl_interface wl_output_interface;
-extern const struct wl_interface wl_seat_interface;
-extern const struct wl_interface wl_surface_interface;
-extern const struct wl_interface xdg_popup_interface;
-extern const struct wl_interface xdg_positioner_interface;
-extern const struct wl_interface xdg_surface_interface;
-extern const struct wl_interface xdg_toplevel_interface;
-static const struct wl_interface *xdg_shell_types[] = {
-	NULL,
-	NULL,
-	NULL,
-	NULL,
-	&xdg_positioner_interface,
-	&xdg_surface_interface,
-	&wl_surface_interface,
-	&xdg_toplevel_interface,
-	&xdg_popup_interface,
-	&xdg_surface_interface,
-	&xdg_positioner_interface,
-	&xdg_toplevel_interface,
-	&wl_seat_interface,
-	NULL,
-	NULL,
-	NULL,
-	&wl_seat_interface,
-	NULL,
-	&wl_seat_interface,
-	NULL,
-	NULL,
-	&wl_output_interface,
-	&wl_seat_interface,
-	NULL,
-	&xdg_positioner_interface,
-	NULL,
-};
-static const struct wl_message xdg_wm_base_requests[] = {
-	{ "destroy", "", xdg_shell_types + 0 },
-	{ "create_positioner", "n", xdg_shell_types + 4 },
-	{ "get_xdg_surface", "no", xdg_shell_types + 5 },
-	{ "pong", "u", xdg_shell_types + 0 },
-};
-static const struct wl_message xdg_wm_base_events[] = {
-	{ "ping", "u", xdg_shell_types + 0 },
-};
-WL_PRIVATE const struct wl_interface xdg_wm_base_interface = {
-	"xdg_wm_base", 6,
-	4, xdg_wm_base_requests,
-	1, xdg_wm_base_events,
-};
-static const struct wl_message xdg_positioner_requests[] = {
-	{ "destroy", "", xdg_shell_types + 0 },
-	{ "set_size", "ii", xdg_shell_types + 0 },
-	{ "set_anchor_rect", "iiii", xdg_shell_types + 0 },
-	{ "set_anchor", "u", xdg_shell_types + 0 },
-	{ "set_gravity", "u", xdg_shell_types + 0 },
-	{ "set_constraint_adjustment", "u", xdg_shell_types + 0 },
-	{ "set_offset", "ii", xdg_shell_types + 0 },
-	{ "set_reactive", "3", xdg_shell_types + 0 },
-	{ "set_parent_size", "3ii", xdg_shell_types + 0 },
-	{ "set_parent_configure", "3u", xdg_shell_types + 0 },
-};
-WL_PRIVATE const struct wl_interface xdg_positioner_interface = {
-	"xdg_positioner", 6,
-	10, xdg_positioner_requests,
-	0, NULL,
-};
-static const struct wl_message xdg_surface_requests[] = {
-	{ "destroy", "", xdg_shell_types + 0 },
-	{ "get_toplevel", "n", xdg_shell_types + 7 },
-	{ "get_popup", "n?oo", xdg_shell_types + 8 },
-	{ "set_window_geometry", "iiii", xdg_shell_types + 0 },
-	{ "ack_configure", "u", xdg_shell_types + 0 },
-};
-static const struct wl_message xdg_surface_events[] = {
-	{ "configure", "u", xdg_shell_types + 0 },
-};
-WL_PRIVATE const struct wl_interface xdg_surface_interface = {
-	"xdg_surface", 6,
-	5, xdg_surface_requests,
-	1, xdg_surface_events,
-};
-static const struct wl_message xdg_toplevel_requests[] = {
-	{ "destroy", "", xdg_shell_types + 0 },
-	{ "set_parent", "?o", xdg_shell_types + 11 },
-	{ "set_title", "s", xdg_shell_types + 0 },
-	{ "set_app_id", "s", xdg_shell_types + 0 },
-	{ "show_window_menu", "ouii", xdg_shell_types + 12 },
-	{ "move", "ou", xdg_shell_types + 16 },
-	{ "resize", "ouu", xdg_shell_types + 18 },
-	{ "set_max_size", "ii", xdg_shell_types + 0 },
-	{ "set_min_size", "ii", xdg_shell_types + 0 },
-	{ "set_maximized", "", xdg_shell_types + 0 },
-	{ "unset_maximized", "", xdg_shell_types + 0 },
-	{ "set_fullscreen", "?o", xdg_shell_types + 21 },
-	{ "unset_fullscreen", "", xdg_shell_types + 0 },
-	{ "set_minimized", "", xdg_shell_types + 0 },
+#ifndef ZWP_LINUX_DMABUF_FEEDBACK_V1_INTERFACE
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_INTERFACE
+extern const struct wl_interface zwp_linux_dmabuf_feedback_v1_interface;
+#endif
+struct zwp_linux_dmabuf_v1_listener {
+	void (*format)(void *data,
+		       struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1,
+		       uint32_t format);
+	void (*modifier)(void *data,
+			 struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1,
+			 uint32_t format,
+			 uint32_t modifier_hi,
+			 uint32_t modifier_lo);
 };
-static const struct wl_message xdg_toplevel_events[] = {
-	{ "configure", "iia", xdg_shell_types + 0 },
-	{ "close", "", xdg_shell_types + 0 },
-	{ "configure_bounds", "4ii", xdg_shell_types + 0 },
-	{ "wm_capabilities", "5a", xdg_shell_types + 0 },
+static inline int
+zwp_linux_dmabuf_v1_add_listener(struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1,
+				 const struct zwp_linux_dmabuf_v1_listener *listener, void *data)
+{
+	return wl_proxy_add_listener((struct wl_proxy *) zwp_linux_dmabuf_v1,
+				     (void (**)(void)) listener, data);
+}
+#define ZWP_LINUX_DMABUF_V1_DESTROY 0
+#define ZWP_LINUX_DMABUF_V1_CREATE_PARAMS 1
+#define ZWP_LINUX_DMABUF_V1_GET_DEFAULT_FEEDBACK 2
+#define ZWP_LINUX_DMABUF_V1_GET_SURFACE_FEEDBACK 3
+#define ZWP_LINUX_DMABUF_V1_FORMAT_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION 3
+#define ZWP_LINUX_DMABUF_V1_DESTROY_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_V1_CREATE_PARAMS_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_V1_GET_DEFAULT_FEEDBACK_SINCE_VERSION 4
+#define ZWP_LINUX_DMABUF_V1_GET_SURFACE_FEEDBACK_SINCE_VERSION 4
+static inline void
+zwp_linux_dmabuf_v1_set_user_data(struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) zwp_linux_dmabuf_v1, user_data);
+}
+static inline void *
+zwp_linux_dmabuf_v1_get_user_data(struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) zwp_linux_dmabuf_v1);
+}
+static inline uint32_t
+zwp_linux_dmabuf_v1_get_version(struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) zwp_linux_dmabuf_v1);
+}
+static inline void
+zwp_linux_dmabuf_v1_destroy(struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_dmabuf_v1,
+			 ZWP_LINUX_DMABUF_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) zwp_linux_dmabuf_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+static inline struct zwp_linux_buffer_params_v1 *
+zwp_linux_dmabuf_v1_create_params(struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1)
+{
+	struct wl_proxy *params_id;
+	params_id = wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_dmabuf_v1,
+			 ZWP_LINUX_DMABUF_V1_CREATE_PARAMS, &zwp_linux_buffer_params_v1_interface, wl_proxy_get_version((struct wl_proxy *) zwp_linux_dmabuf_v1), 0, NULL);
+	return (struct zwp_linux_buffer_params_v1 *) params_id;
+}
+static inline struct zwp_linux_dmabuf_feedback_v1 *
+zwp_linux_dmabuf_v1_get_default_feedback(struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1)
+{
+	struct wl_proxy *id;
+	id = wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_dmabuf_v1,
+			 ZWP_LINUX_DMABUF_V1_GET_DEFAULT_FEEDBACK, &zwp_linux_dmabuf_feedback_v1_interface, wl_proxy_get_version((struct wl_proxy *) zwp_linux_dmabuf_v1), 0, NULL);
+	return (struct zwp_linux_dmabuf_feedback_v1 *) id;
+}
+static inline struct zwp_linux_dmabuf_feedback_v1 *
+zwp_linux_dmabuf_v1_get_surface_feedback(struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1, struct wl_surface *surface)
+{
+	struct wl_proxy *id;
+	id = wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_dmabuf_v1,
+			 ZWP_LINUX_DMABUF_V1_GET_SURFACE_FEEDBACK, &zwp_linux_dmabuf_feedback_v1_interface, wl_proxy_get_version((struct wl_proxy *) zwp_linux_dmabuf_v1), 0, NULL, surface);
+	return (struct zwp_linux_dmabuf_feedback_v1 *) id;
+}
+#ifndef ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ENUM
+#define ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ENUM
+enum zwp_linux_buffer_params_v1_error {
+	ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED = 0,
+	ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_IDX = 1,
+	ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_SET = 2,
+	ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE = 3,
+	ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_FORMAT = 4,
+	ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_DIMENSIONS = 5,
+	ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS = 6,
+	ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_WL_BUFFER = 7,
 };
-WL_PRIVATE const struct wl_interface xdg_toplevel_interface = {
-	"xdg_toplevel", 6,
-	14, xdg_toplevel_requests,
-	4, xdg_toplevel_events,
+#endif 
+#ifndef ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_ENUM
+#define ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_ENUM
+enum zwp_linux_buffer_params_v1_flags {
+	ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_Y_INVERT = 1,
+	ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_INTERLACED = 2,
+	ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_BOTTOM_FIRST = 4,
 };
-static const struct wl_message xdg_popup_requests[] = {
-	{ "destroy", "", xdg_shell_types + 0 },
-	{ "grab", "ou", xdg_shell_types + 22 },
-	{ "reposition", "3ou", xdg_shell_types + 24 },
+#endif 
+struct zwp_linux_buffer_params_v1_listener {
+	void (*created)(void *data,
+			struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1,
+			struct wl_buffer *buffer);
+	void (*failed)(void *data,
+		       struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1);
 };
-static const struct wl_message xdg_popup_events[] = {
-	{ "configure", "iiii", xdg_shell_types + 0 },
-	{ "popup_done", "", xdg_shell_types + 0 },
-	{ "repositioned", "3u", xdg_shell_types + 0 },
+static inline int
+zwp_linux_buffer_params_v1_add_listener(struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1,
+					const struct zwp_linux_buffer_params_v1_listener *listener, void *data)
+{
+	return wl_proxy_add_listener((struct wl_proxy *) zwp_linux_buffer_params_v1,
+				     (void (**)(void)) listener, data);
+}
+#define ZWP_LINUX_BUFFER_PARAMS_V1_DESTROY 0
+#define ZWP_LINUX_BUFFER_PARAMS_V1_ADD 1
+#define ZWP_LINUX_BUFFER_PARAMS_V1_CREATE 2
+#define ZWP_LINUX_BUFFER_PARAMS_V1_CREATE_IMMED 3
+#define ZWP_LINUX_BUFFER_PARAMS_V1_CREATED_SINCE_VERSION 1
+#define ZWP_LINUX_BUFFER_PARAMS_V1_FAILED_SINCE_VERSION 1
+#define ZWP_LINUX_BUFFER_PARAMS_V1_DESTROY_SINCE_VERSION 1
+#define ZWP_LINUX_BUFFER_PARAMS_V1_ADD_SINCE_VERSION 1
+#define ZWP_LINUX_BUFFER_PARAMS_V1_CREATE_SINCE_VERSION 1
+#define ZWP_LINUX_BUFFER_PARAMS_V1_CREATE_IMMED_SINCE_VERSION 2
+static inline void
+zwp_linux_buffer_params_v1_set_user_data(struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) zwp_linux_buffer_params_v1, user_data);
+}
+static inline void *
+zwp_linux_buffer_params_v1_get_user_data(struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) zwp_linux_buffer_params_v1);
+}
+static inline uint32_t
+zwp_linux_buffer_params_v1_get_version(struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) zwp_linux_buffer_params_v1);
+}
+static inline void
+zwp_linux_buffer_params_v1_destroy(struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_buffer_params_v1,
+			 ZWP_LINUX_BUFFER_PARAMS_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) zwp_linux_buffer_params_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+static inline void
+zwp_linux_buffer_params_v1_add(struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1, int32_t fd, uint32_t plane_idx, uint32_t offset, uint32_t stride, uint32_t modifier_hi, uint32_t modifier_lo)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_buffer_params_v1,
+			 ZWP_LINUX_BUFFER_PARAMS_V1_ADD, NULL, wl_proxy_get_version((struct wl_proxy *) zwp_linux_buffer_params_v1), 0, fd, plane_idx, offset, stride, modifier_hi, modifier_lo);
+}
+static inline void
+zwp_linux_buffer_params_v1_create(struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1, int32_t width, int32_t height, uint32_t format, uint32_t flags)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_buffer_params_v1,
+			 ZWP_LINUX_BUFFER_PARAMS_V1_CREATE, NULL, wl_proxy_get_version((struct wl_proxy *) zwp_linux_buffer_params_v1), 0, width, height, format, flags);
+}
+static inline struct wl_buffer *
+zwp_linux_buffer_params_v1_create_immed(struct zwp_linux_buffer_params_v1 *zwp_linux_buffer_params_v1, int32_t width, int32_t height, uint32_t format, uint32_t flags)
+{
+	struct wl_proxy *buffer_id;
+	buffer_id = wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_buffer_params_v1,
+			 ZWP_LINUX_BUFFER_PARAMS_V1_CREATE_IMMED, &wl_buffer_interface, wl_proxy_get_version((struct wl_proxy *) zwp_linux_buffer_params_v1), 0, NULL, width, height, format, flags);
+	return (struct wl_buffer *) buffer_id;
+}
+#ifndef ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_ENUM
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_ENUM
+enum zwp_linux_dmabuf_feedback_v1_tranche_flags {
+	ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_SCANOUT = 1,
 };
-WL_PRIVATE const struct wl_interface xdg_popup_interface = {
-	"xdg_popup", 6,
-	3, xdg_popup_requests,
-	3, xdg_popup_events,
+#endif 
+struct zwp_linux_dmabuf_feedback_v1_listener {
+	void (*done)(void *data,
+		     struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1);
+	void (*format_table)(void *data,
+			     struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1,
+			     int32_t fd,
+			     uint32_t size);
+	void (*main_device)(void *data,
+			    struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1,
+			    struct wl_array *device);
+	void (*tranche_done)(void *data,
+			     struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1);
+	void (*tranche_target_device)(void *data,
+				      struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1,
+				      struct wl_array *device);
+	void (*tranche_formats)(void *data,
+				struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1,
+				struct wl_array *indices);
+	void (*tranche_flags)(void *data,
+			      struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1,
+			      uint32_t flags);
 };
-
-
-// ------------------------------------------------------------------------- //
-//                                                                           //
-//                         APPLICATION IMPLEMENTATION                        //
-//                                                                           //
-// ------------------------------------------------------------------------- //
-
-// -------- xdg_wm_base events callbacks -------- //
-
-static inline void on_xdg_wm_base_ping(void *data, struct xdg_wm_base *wm_base,
-                                       uint32_t serial) {
-  xdg_wm_base_pong(wm_base, serial);
+static inline int
+zwp_linux_dmabuf_feedback_v1_add_listener(struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1,
+					  const struct zwp_linux_dmabuf_feedback_v1_listener *listener, void *data)
+{
+	return wl_proxy_add_listener((struct wl_proxy *) zwp_linux_dmabuf_feedback_v1,
+				     (void (**)(void)) listener, data);
 }
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_DESTROY 0
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_DONE_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_FORMAT_TABLE_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_MAIN_DEVICE_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_DONE_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_TARGET_DEVICE_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FORMATS_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_SINCE_VERSION 1
+#define ZWP_LINUX_DMABUF_FEEDBACK_V1_DESTROY_SINCE_VERSION 1
+static inline void
+zwp_linux_dmabuf_feedback_v1_set_user_data(struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) zwp_linux_dmabuf_feedback_v1, user_data);
+}
+static inline void *
+zwp_linux_dmabuf_feedback_v1_get_user_data(struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) zwp_linux_dmabuf_feedback_v1);
+}
+static inline uint32_t
+zwp_linux_dmabuf_feedback_v1_get_version(struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) zwp_linux_dmabuf_feedback_v1);
+}
+static inline void
+zwp_linux_dmabuf_feedback_v1_destroy(struct zwp_linux_dmabuf_feedback_v1 *zwp_linux_dmabuf_feedback_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwp_linux_dmabuf_feedback_v1,
+			 ZWP_LINUX_DMABUF_FEEDBACK_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) zwp_linux_dmabuf_feedback_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+#endif
 
-static inline void on_wl_seat_name(void *data, struct wl_seat *seat,
-                                   const char *name) {}
-
-static const struct xdg_wm_base_listener xdg_wm_base_listener = {
-    .ping = on_xdg_wm_base_ping,
+#ifndef VIEWPORTER_CLIENT_PROTOCOL_H
+#define VIEWPORTER_CLIENT_PROTOCOL_H
+#include <stdint.h>
+#include <stddef.h>
+#include "wayland-client.h"
+struct wl_surface;
+struct wp_viewport;
+struct wp_viewporter;
+#ifndef WP_VIEWPORTER_INTERFACE
+#define WP_VIEWPORTER_INTERFACE
+extern const struct wl_interface wp_viewporter_interface;
+#endif
+#ifndef WP_VIEWPORT_INTERFACE
+#define WP_VIEWPORT_INTERFACE
+extern const struct wl_interface wp_viewport_interface;
+#endif
+#ifndef WP_VIEWPORTER_ERROR_ENUM
+#define WP_VIEWPORTER_ERROR_ENUM
+enum wp_viewporter_error {
+	WP_VIEWPORTER_ERROR_VIEWPORT_EXISTS = 0,
 };
-
-// -------- wl_pointer events callbacks -------- //
-
-static inline void on_wl_pointer_button(void *data, struct wl_pointer *pointer,
-                                        uint32_t serial, uint32_t time,
-                                        uint32_t button, uint32_t state) {
-  SWCLApplication *app = (SWCLApplication *)data;
-  app->wl_pointer_serial = serial;
-  if (app->on_mouse_button_cb)
-    app->on_mouse_button_cb(app->current_window, (SWCLMouseButton)button,
-                            (SWCLButtonState)state);
+#endif 
+#define WP_VIEWPORTER_DESTROY 0
+#define WP_VIEWPORTER_GET_VIEWPORT 1
+#define WP_VIEWPORTER_DESTROY_SINCE_VERSION 1
+#define WP_VIEWPORTER_GET_VIEWPORT_SINCE_VERSION 1
+static inline void
+wp_viewporter_set_user_data(struct wp_viewporter *wp_viewporter, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) wp_viewporter, user_data);
 }
-
-static inline void on_wl_pointer_enter(void *data, struct wl_pointer *pointer,
-                                       uint32_t serial,
-                                       struct wl_surface *surface, wl_fixed_t x,
+static inline void *
+wp_viewporter_get_user_data(struct wp_viewporter *wp_viewporter)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) wp_viewporter);
+}
+static inline uint32_t
+wp_viewporter_get_version(struct wp_viewporter *wp_viewporter)
+{
+	return wl_proxy_get_version((struct wl_proxy *) wp_viewporter);
+}
+static inline void
+wp_viewporter_destroy(struct wp_viewporter *wp_viewporter)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) wp_viewporter,
+			 WP_VIEWPORTER_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) wp_viewporter), WL_MARSHAL_FLAG_DESTROY);
+}
+static inline struct wp_viewport *
+wp_viewporter_get_viewport(struct wp_viewporter *wp_viewporter, struct wl_surface *surface)
+{
+	struct wl_proxy *id;
+	id = wl_proxy_marshal_flags((struct wl_proxy *) wp_viewporter,
+			 WP_VIEWPORTER_GET_VIEWPORT, &wp_viewport_interface, wl_proxy_get_version((struct wl_proxy *) wp_viewporter), 0, NULL, surface);
+	return (struct wp_viewport *) id;
+}
+#ifndef WP_VIEWPORT_ERROR_ENUM
+#define WP_VIEWPORT_ERROR_ENUM
+enum wp_viewport_error {
+	WP_VIEWPORT_ERROR_BAD_VALUE = 0,
+	WP_VIEWPORT_ERROR_BAD_SIZE = 1,
+	WP_VIEWPORT_ERROR_OUT_OF_BUFFER = 2,
+	WP_VIEWPORT_ERROR_NO_SURFACE = 3,
+};
+#endif 
+#define WP_VIEWPORT_DESTROY 0
+#define WP_VIEWPORT_SET_SOURCE 1
+#define WP_VIEWPORT_SET_DESTINATION 2
+#define WP_VIEWPORT_DESTROY_SINCE_VERSION 1
+#define WP_VIEWPORT_SET_SOURCE_SINCE_VERSION 1
+#define WP_VIEWPORT_SET_DESTINATION_SINCE_VERSION 1
+static inline void
+wp_viewport_set_user_data(struct wp_viewport *wp_viewport, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) wp_viewport, user_data);
+}
+static inline void *
+wp_viewport_get_user_data(struct wp_viewport *wp_viewport)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) wp_viewport);
+}
+static inline uint32_t
+wp_viewport_get_version(struct wp_viewport *wp_viewport)
+{
+	return wl_proxy_get_version((struct wl_proxy *) wp_viewport);
+}
+static inline void
+wp_viewport_destroy(struct wp_viewport *wp_viewport)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) wp_viewport,
+			 WP_VIEWPORT_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) wp_viewport), WL_MARSHAL_FLAG_DESTROY);
+}
+static inline void
+wp_viewport_set_source(struct wp_viewport *wp_viewport, wl_fixed_t x, wl_fixed_t y, wl_fixed_t width, wl_fixed_t height)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) wp_viewport,
+			 WP_VIEWPORT_SET_SOURCE, NULL, wl_proxy_get_version((struct wl_proxy *) wp_viewport), 0, x, y, width, height);
+}
+static inline void
+wp_viewport_set_destination(struct wp_viewport *wp_viewport, int32_t width, int32_t height)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) wp_viewport,
+			 WP_VIEWPORT_SET_DESTINATION, NULL, wl_proxy_get_version((struct wl_proxy *) wp_viewport), 0, width, height);
+}
+#endif
+
+#ifndef FRACTIONAL_SCALE_V1_CLIENT_PROTOCOL_H
+#define FRACTIONAL_SCALE_V1_CLIENT_PROTOCOL_H
+#include <stdint.h>
+#include <stddef.h>
+#include "wayland-client.h"
+struct wl_surface;
+struct wp_fractional_scale_manager_v1;
+struct wp_fractional_scale_v1;
+#ifndef WP_FRACTIONAL_SCALE_MANAGER_V1_INTERFACE
+#define WP_FRACTIONAL_SCALE_MANAGER_V1_INTERFACE
+extern const struct wl_interface wp_fractional_scale_manager_v1_interface;
+#endif
+#ifndef WP_FRACTIONAL_SCALE_V1_INTERFACE
+#define WP_FRACTIONAL_SCALE_V1_INTERFACE
+extern const struct wl_interface wp_fractional_scale_v1_interface;
+#endif
+#ifndef WP_FRACTIONAL_SCALE_MANAGER_V1_ERROR_ENUM
+#define WP_FRACTIONAL_SCALE_MANAGER_V1_ERROR_ENUM
+enum wp_fractional_scale_manager_v1_error {
+	WP_FRACTIONAL_SCALE_MANAGER_V1_ERROR_FRACTIONAL_SCALE_EXISTS = 0,
+};
+#endif 
+#define WP_FRACTIONAL_SCALE_MANAGER_V1_DESTROY 0
+#define WP_FRACTIONAL_SCALE_MANAGER_V1_GET_FRACTIONAL_SCALE 1
+#define WP_FRACTIONAL_SCALE_MANAGER_V1_DESTROY_SINCE_VERSION 1
+#define WP_FRACTIONAL_SCALE_MANAGER_V1_GET_FRACTIONAL_SCALE_SINCE_VERSION 1
+static inline void
+wp_fractional_scale_manager_v1_set_user_data(struct wp_fractional_scale_manager_v1 *wp_fractional_scale_manager_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) wp_fractional_scale_manager_v1, user_data);
+}
+static inline void *
+wp_fractional_scale_manager_v1_get_user_data(struct wp_fractional_scale_manager_v1 *wp_fractional_scale_manager_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) wp_fractional_scale_manager_v1);
+}
+static inline uint32_t
+wp_fractional_scale_manager_v1_get_version(struct wp_fractional_scale_manager_v1 *wp_fractional_scale_manager_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) wp_fractional_scale_manager_v1);
+}
+static inline void
+wp_fractional_scale_manager_v1_destroy(struct wp_fractional_scale_manager_v1 *wp_fractional_scale_manager_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) wp_fractional_scale_manager_v1,
+			 WP_FRACTIONAL_SCALE_MANAGER_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) wp_fractional_scale_manager_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+static inline struct wp_fractional_scale_v1 *
+wp_fractional_scale_manager_v1_get_fractional_scale(struct wp_fractional_scale_manager_v1 *wp_fractional_scale_manager_v1, struct wl_surface *surface)
+{
+	struct wl_proxy *id;
+	id = wl_proxy_marshal_flags((struct wl_proxy *) wp_fractional_scale_manager_v1,
+			 WP_FRACTIONAL_SCALE_MANAGER_V1_GET_FRACTIONAL_SCALE, &wp_fractional_scale_v1_interface, wl_proxy_get_version((struct wl_proxy *) wp_fractional_scale_manager_v1), 0, NULL, surface);
+	return (struct wp_fractional_scale_v1 *) id;
+}
+struct wp_fractional_scale_v1_listener {
+	void (*preferred_scale)(void *data,
+				struct wp_fractional_scale_v1 *wp_fractional_scale_v1,
+				uint32_t scale);
+};
+static inline int
+wp_fractional_scale_v1_add_listener(struct wp_fractional_scale_v1 *wp_fractional_scale_v1,
+				    const struct wp_fractional_scale_v1_listener *listener, void *data)
+{
+	return wl_proxy_add_listener((struct wl_proxy *) wp_fractional_scale_v1,
+				     (void (**)(void)) listener, data);
+}
+#define WP_FRACTIONAL_SCALE_V1_DESTROY 0
+#define WP_FRACTIONAL_SCALE_V1_PREFERRED_SCALE_SINCE_VERSION 1
+#define WP_FRACTIONAL_SCALE_V1_DESTROY_SINCE_VERSION 1
+static inline void
+wp_fractional_scale_v1_set_user_data(struct wp_fractional_scale_v1 *wp_fractional_scale_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) wp_fractional_scale_v1, user_data);
+}
+static inline void *
+wp_fractional_scale_v1_get_user_data(struct wp_fractional_scale_v1 *wp_fractional_scale_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) wp_fractional_scale_v1);
+}
+static inline uint32_t
+wp_fractional_scale_v1_get_version(struct wp_fractional_scale_v1 *wp_fractional_scale_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) wp_fractional_scale_v1);
+}
+static inline void
+wp_fractional_scale_v1_destroy(struct wp_fractional_scale_v1 *wp_fractional_scale_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) wp_fractional_scale_v1,
+			 WP_FRACTIONAL_SCALE_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) wp_fractional_scale_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+#endif
+
+#ifndef WLR_LAYER_SHELL_UNSTABLE_V1_CLIENT_PROTOCOL_H
+#define WLR_LAYER_SHELL_UNSTABLE_V1_CLIENT_PROTOCOL_H
+#include <stdint.h>
+#include <stddef.h>
+#include "wayland-client.h"
+struct wl_output;
+struct wl_surface;
+struct xdg_popup;
+struct zwlr_layer_shell_v1;
+struct zwlr_layer_surface_v1;
+#ifndef ZWLR_LAYER_SHELL_V1_INTERFACE
+#define ZWLR_LAYER_SHELL_V1_INTERFACE
+extern const struct wl_interface zwlr_layer_shell_v1_interface;
+#endif
+#ifndef ZWLR_LAYER_SURFACE_V1_INTERFACE
+#define ZWLR_LAYER_SURFACE_V1_INTERFACE
+extern const struct wl_interface zwlr_layer_surface_v1_interface;
+#endif
+#ifndef ZWLR_LAYER_SHELL_V1_ERROR_ENUM
+#define ZWLR_LAYER_SHELL_V1_ERROR_ENUM
+enum zwlr_layer_shell_v1_error {
+	ZWLR_LAYER_SHELL_V1_ERROR_ROLE = 0,
+	ZWLR_LAYER_SHELL_V1_ERROR_INVALID_LAYER = 1,
+	ZWLR_LAYER_SHELL_V1_ERROR_ALREADY_CONSTRUCTED = 2,
+};
+#endif 
+#ifndef ZWLR_LAYER_SHELL_V1_LAYER_ENUM
+#define ZWLR_LAYER_SHELL_V1_LAYER_ENUM
+enum zwlr_layer_shell_v1_layer {
+	ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND = 0,
+	ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM = 1,
+	ZWLR_LAYER_SHELL_V1_LAYER_TOP = 2,
+	ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY = 3,
+};
+#endif 
+#define ZWLR_LAYER_SHELL_V1_GET_LAYER_SURFACE 0
+#define ZWLR_LAYER_SHELL_V1_DESTROY 1
+#define ZWLR_LAYER_SHELL_V1_GET_LAYER_SURFACE_SINCE_VERSION 1
+#define ZWLR_LAYER_SHELL_V1_DESTROY_SINCE_VERSION 3
+static inline void
+zwlr_layer_shell_v1_set_user_data(struct zwlr_layer_shell_v1 *zwlr_layer_shell_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) zwlr_layer_shell_v1, user_data);
+}
+static inline void *
+zwlr_layer_shell_v1_get_user_data(struct zwlr_layer_shell_v1 *zwlr_layer_shell_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) zwlr_layer_shell_v1);
+}
+static inline uint32_t
+zwlr_layer_shell_v1_get_version(struct zwlr_layer_shell_v1 *zwlr_layer_shell_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) zwlr_layer_shell_v1);
+}
+static inline struct zwlr_layer_surface_v1 *
+zwlr_layer_shell_v1_get_layer_surface(struct zwlr_layer_shell_v1 *zwlr_layer_shell_v1, struct wl_surface *surface, struct wl_output *output, uint32_t layer, const char *namespace)
+{
+	struct wl_proxy *id;
+	id = wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_shell_v1,
+			 ZWLR_LAYER_SHELL_V1_GET_LAYER_SURFACE, &zwlr_layer_surface_v1_interface, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_shell_v1), 0, NULL, surface, output, layer, namespace);
+	return (struct zwlr_layer_surface_v1 *) id;
+}
+static inline void
+zwlr_layer_shell_v1_destroy(struct zwlr_layer_shell_v1 *zwlr_layer_shell_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_shell_v1,
+			 ZWLR_LAYER_SHELL_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_shell_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+#ifndef ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_ENUM
+#define ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_ENUM
+enum zwlr_layer_surface_v1_keyboard_interactivity {
+	ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_NONE = 0,
+	ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_EXCLUSIVE = 1,
+	ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_ON_DEMAND = 2,
+};
+#define ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_ON_DEMAND_SINCE_VERSION 4
+#endif 
+#ifndef ZWLR_LAYER_SURFACE_V1_ERROR_ENUM
+#define ZWLR_LAYER_SURFACE_V1_ERROR_ENUM
+enum zwlr_layer_surface_v1_error {
+	ZWLR_LAYER_SURFACE_V1_ERROR_INVALID_SURFACE_STATE = 0,
+	ZWLR_LAYER_SURFACE_V1_ERROR_INVALID_SIZE = 1,
+	ZWLR_LAYER_SURFACE_V1_ERROR_INVALID_ANCHOR = 2,
+	ZWLR_LAYER_SURFACE_V1_ERROR_INVALID_KEYBOARD_INTERACTIVITY = 3,
+	ZWLR_LAYER_SURFACE_V1_ERROR_INVALID_EXCLUSIVE_EDGE = 4,
+};
+#endif 
+#ifndef ZWLR_LAYER_SURFACE_V1_ANCHOR_ENUM
+#define ZWLR_LAYER_SURFACE_V1_ANCHOR_ENUM
+enum zwlr_layer_surface_v1_anchor {
+	ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP = 1,
+	ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM = 2,
+	ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT = 4,
+	ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT = 8,
+};
+#endif 
+struct zwlr_layer_surface_v1_listener {
+	void (*configure)(void *data,
+			  struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1,
+			  uint32_t serial,
+			  uint32_t width,
+			  uint32_t height);
+	void (*closed)(void *data,
+		       struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1);
+};
+static inline int
+zwlr_layer_surface_v1_add_listener(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1,
+				   const struct zwlr_layer_surface_v1_listener *listener, void *data)
+{
+	return wl_proxy_add_listener((struct wl_proxy *) zwlr_layer_surface_v1,
+				     (void (**)(void)) listener, data);
+}
+#define ZWLR_LAYER_SURFACE_V1_SET_SIZE 0
+#define ZWLR_LAYER_SURFACE_V1_SET_ANCHOR 1
+#define ZWLR_LAYER_SURFACE_V1_SET_EXCLUSIVE_ZONE 2
+#define ZWLR_LAYER_SURFACE_V1_SET_MARGIN 3
+#define ZWLR_LAYER_SURFACE_V1_SET_KEYBOARD_INTERACTIVITY 4
+#define ZWLR_LAYER_SURFACE_V1_GET_POPUP 5
+#define ZWLR_LAYER_SURFACE_V1_ACK_CONFIGURE 6
+#define ZWLR_LAYER_SURFACE_V1_DESTROY 7
+#define ZWLR_LAYER_SURFACE_V1_SET_LAYER 8
+#define ZWLR_LAYER_SURFACE_V1_SET_EXCLUSIVE_EDGE 9
+#define ZWLR_LAYER_SURFACE_V1_CONFIGURE_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_CLOSED_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_SET_SIZE_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_SET_ANCHOR_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_SET_EXCLUSIVE_ZONE_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_SET_MARGIN_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_SET_KEYBOARD_INTERACTIVITY_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_GET_POPUP_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_ACK_CONFIGURE_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_DESTROY_SINCE_VERSION 1
+#define ZWLR_LAYER_SURFACE_V1_SET_LAYER_SINCE_VERSION 2
+#define ZWLR_LAYER_SURFACE_V1_SET_EXCLUSIVE_EDGE_SINCE_VERSION 5
+static inline void
+zwlr_layer_surface_v1_set_user_data(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) zwlr_layer_surface_v1, user_data);
+}
+static inline void *
+zwlr_layer_surface_v1_get_user_data(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) zwlr_layer_surface_v1);
+}
+static inline uint32_t
+zwlr_layer_surface_v1_get_version(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1);
+}
+static inline void
+zwlr_layer_surface_v1_set_size(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, uint32_t width, uint32_t height)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_SET_SIZE, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, width, height);
+}
+static inline void
+zwlr_layer_surface_v1_set_anchor(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, uint32_t anchor)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_SET_ANCHOR, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, anchor);
+}
+static inline void
+zwlr_layer_surface_v1_set_exclusive_zone(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, int32_t zone)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_SET_EXCLUSIVE_ZONE, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, zone);
+}
+static inline void
+zwlr_layer_surface_v1_set_margin(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, int32_t top, int32_t right, int32_t bottom, int32_t left)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_SET_MARGIN, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, top, right, bottom, left);
+}
+static inline void
+zwlr_layer_surface_v1_set_keyboard_interactivity(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, uint32_t keyboard_interactivity)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_SET_KEYBOARD_INTERACTIVITY, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, keyboard_interactivity);
+}
+static inline void
+zwlr_layer_surface_v1_get_popup(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, struct xdg_popup *popup)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_GET_POPUP, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, popup);
+}
+static inline void
+zwlr_layer_surface_v1_ack_configure(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, uint32_t serial)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_ACK_CONFIGURE, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, serial);
+}
+static inline void
+zwlr_layer_surface_v1_destroy(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+static inline void
+zwlr_layer_surface_v1_set_layer(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, uint32_t layer)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_SET_LAYER, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, layer);
+}
+static inline void
+zwlr_layer_surface_v1_set_exclusive_edge(struct zwlr_layer_surface_v1 *zwlr_layer_surface_v1, uint32_t edge)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zwlr_layer_surface_v1,
+			 ZWLR_LAYER_SURFACE_V1_SET_EXCLUSIVE_EDGE, NULL, wl_proxy_get_version((struct wl_proxy *) zwlr_layer_surface_v1), 0, edge);
+}
+#endif
+
+#ifndef XDG_DECORATION_UNSTABLE_V1_CLIENT_PROTOCOL_H
+#define XDG_DECORATION_UNSTABLE_V1_CLIENT_PROTOCOL_H
+#include <stdint.h>
+#include <stddef.h>
+#include "wayland-client.h"
+struct xdg_toplevel;
+struct zxdg_decoration_manager_v1;
+struct zxdg_toplevel_decoration_v1;
+#ifndef ZXDG_DECORATION_MANAGER_V1_INTERFACE
+#define ZXDG_DECORATION_MANAGER_V1_INTERFACE
+extern const struct wl_interface zxdg_decoration_manager_v1_interface;
+#endif
+#ifndef ZXDG_TOPLEVEL_DECORATION_V1_INTERFACE
+#define ZXDG_TOPLEVEL_DECORATION_V1_INTERFACE
+extern const struct wl_interface zxdg_toplevel_decoration_v1_interface;
+#endif
+#define ZXDG_DECORATION_MANAGER_V1_DESTROY 0
+#define ZXDG_DECORATION_MANAGER_V1_GET_TOPLEVEL_DECORATION 1
+#define ZXDG_DECORATION_MANAGER_V1_DESTROY_SINCE_VERSION 1
+#define ZXDG_DECORATION_MANAGER_V1_GET_TOPLEVEL_DECORATION_SINCE_VERSION 1
+static inline void
+zxdg_decoration_manager_v1_set_user_data(struct zxdg_decoration_manager_v1 *zxdg_decoration_manager_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) zxdg_decoration_manager_v1, user_data);
+}
+static inline void *
+zxdg_decoration_manager_v1_get_user_data(struct zxdg_decoration_manager_v1 *zxdg_decoration_manager_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) zxdg_decoration_manager_v1);
+}
+static inline uint32_t
+zxdg_decoration_manager_v1_get_version(struct zxdg_decoration_manager_v1 *zxdg_decoration_manager_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) zxdg_decoration_manager_v1);
+}
+static inline void
+zxdg_decoration_manager_v1_destroy(struct zxdg_decoration_manager_v1 *zxdg_decoration_manager_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zxdg_decoration_manager_v1,
+			 ZXDG_DECORATION_MANAGER_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) zxdg_decoration_manager_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+static inline struct zxdg_toplevel_decoration_v1 *
+zxdg_decoration_manager_v1_get_toplevel_decoration(struct zxdg_decoration_manager_v1 *zxdg_decoration_manager_v1, struct xdg_toplevel *toplevel)
+{
+	struct wl_proxy *id;
+	id = wl_proxy_marshal_flags((struct wl_proxy *) zxdg_decoration_manager_v1,
+			 ZXDG_DECORATION_MANAGER_V1_GET_TOPLEVEL_DECORATION, &zxdg_toplevel_decoration_v1_interface, wl_proxy_get_version((struct wl_proxy *) zxdg_decoration_manager_v1), 0, NULL, toplevel);
+	return (struct zxdg_toplevel_decoration_v1 *) id;
+}
+#ifndef ZXDG_TOPLEVEL_DECORATION_V1_ERROR_ENUM
+#define ZXDG_TOPLEVEL_DECORATION_V1_ERROR_ENUM
+enum zxdg_toplevel_decoration_v1_error {
+	ZXDG_TOPLEVEL_DECORATION_V1_ERROR_UNCONFIGURED_BUFFER = 0,
+	ZXDG_TOPLEVEL_DECORATION_V1_ERROR_ALREADY_CONSTRUCTED = 1,
+	ZXDG_TOPLEVEL_DECORATION_V1_ERROR_ORPHANED = 2,
+	ZXDG_TOPLEVEL_DECORATION_V1_ERROR_INVALID_MODE = 3,
+};
+#endif 
+#ifndef ZXDG_TOPLEVEL_DECORATION_V1_MODE_ENUM
+#define ZXDG_TOPLEVEL_DECORATION_V1_MODE_ENUM
+enum zxdg_toplevel_decoration_v1_mode {
+	ZXDG_TOPLEVEL_DECORATION_V1_MODE_CLIENT_SIDE = 1,
+	ZXDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE = 2,
+};
+#endif 
+struct zxdg_toplevel_decoration_v1_listener {
+	void (*configure)(void *data,
+			  struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1,
+			  uint32_t mode);
+};
+static inline int
+zxdg_toplevel_decoration_v1_add_listener(struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1,
+					 const struct zxdg_toplevel_decoration_v1_listener *listener, void *data)
+{
+	return wl_proxy_add_listener((struct wl_proxy *) zxdg_toplevel_decoration_v1,
+				     (void (**)(void)) listener, data);
+}
+#define ZXDG_TOPLEVEL_DECORATION_V1_DESTROY 0
+#define ZXDG_TOPLEVEL_DECORATION_V1_SET_MODE 1
+#define ZXDG_TOPLEVEL_DECORATION_V1_UNSET_MODE 2
+#define ZXDG_TOPLEVEL_DECORATION_V1_CONFIGURE_SINCE_VERSION 1
+#define ZXDG_TOPLEVEL_DECORATION_V1_DESTROY_SINCE_VERSION 1
+#define ZXDG_TOPLEVEL_DECORATION_V1_SET_MODE_SINCE_VERSION 1
+#define ZXDG_TOPLEVEL_DECORATION_V1_UNSET_MODE_SINCE_VERSION 1
+static inline void
+zxdg_toplevel_decoration_v1_set_user_data(struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) zxdg_toplevel_decoration_v1, user_data);
+}
+static inline void *
+zxdg_toplevel_decoration_v1_get_user_data(struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) zxdg_toplevel_decoration_v1);
+}
+static inline uint32_t
+zxdg_toplevel_decoration_v1_get_version(struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1)
+{
+	return wl_proxy_get_version((struct wl_proxy *) zxdg_toplevel_decoration_v1);
+}
+static inline void
+zxdg_toplevel_decoration_v1_destroy(struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zxdg_toplevel_decoration_v1,
+			 ZXDG_TOPLEVEL_DECORATION_V1_DESTROY, NULL, wl_proxy_get_version((struct wl_proxy *) zxdg_toplevel_decoration_v1), WL_MARSHAL_FLAG_DESTROY);
+}
+static inline void
+zxdg_toplevel_decoration_v1_set_mode(struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1, uint32_t mode)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zxdg_toplevel_decoration_v1,
+			 ZXDG_TOPLEVEL_DECORATION_V1_SET_MODE, NULL, wl_proxy_get_version((struct wl_proxy *) zxdg_toplevel_decoration_v1), 0, mode);
+}
+static inline void
+zxdg_toplevel_decoration_v1_unset_mode(struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1)
+{
+	wl_proxy_marshal_flags((struct wl_proxy *) zxdg_toplevel_decoration_v1,
+			 ZXDG_TOPLEVEL_DECORATION_V1_UNSET_MODE, NULL, wl_proxy_get_version((struct wl_proxy *) zxdg_toplevel_decoration_v1), 0);
+}
+#endif
+
+
+#ifdef SWCL_IMPLEMENTATION
+
+// ------------------------------------------------------------------------- //
+//                                                                           //
+//                      WAYLAND PROTOCOLS IMPLEMENTATION                     //
+//                        INSERTED DURING BUILD STEP                         //
+//                                                                           //
+// ------------------------------------------------------------------------- //
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "wayland-util.h"
+#ifndef __has_attribute
+# define __has_attribute(x) 0  
+#endif
+#if (__has_attribute(visibility) || defined(__GNUC__) && __GNUC__ >= 4)
+#define WL_PRIVATE __attribute__ ((visibility("hidden")))
+#else
+#define WL_PRIVATE
+#endif
+extern const struct wl_interface wl_output_interface;
+extern const struct wl_interface wl_seat_interface;
+extern const struct wl_interface wl_surface_interface;
+extern const struct wl_interface xdg_popup_interface;
+extern const struct wl_interface xdg_positioner_interface;
+extern const struct wl_interface xdg_surface_interface;
+extern const struct wl_interface xdg_toplevel_interface;
+static const struct wl_interface *xdg_shell_types[] = {
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	&xdg_positioner_interface,
+	&xdg_surface_interface,
+	&wl_surface_interface,
+	&xdg_toplevel_interface,
+	&xdg_popup_interface,
+	&xdg_surface_interface,
+	&xdg_positioner_interface,
+	&xdg_toplevel_interface,
+	&wl_seat_interface,
+	NULL,
+	NULL,
+	NULL,
+	&wl_seat_interface,
+	NULL,
+	&wl_seat_interface,
+	NULL,
+	NULL,
+	&wl_output_interface,
+	&wl_seat_interface,
+	NULL,
+	&xdg_positioner_interface,
+	NULL,
+};
+static const struct wl_message xdg_wm_base_requests[] = {
+	{ "destroy", "", xdg_shell_types + 0 },
+	{ "create_positioner", "n", xdg_shell_types + 4 },
+	{ "get_xdg_surface", "no", xdg_shell_types + 5 },
+	{ "pong", "u", xdg_shell_types + 0 },
+};
+static const struct wl_message xdg_wm_base_events[] = {
+	{ "ping", "u", xdg_shell_types + 0 },
+};
+WL_PRIVATE const struct wl_interface xdg_wm_base_interface = {
+	"xdg_wm_base", 6,
+	4, xdg_wm_base_requests,
+	1, xdg_wm_base_events,
+};
+static const struct wl_message xdg_positioner_requests[] = {
+	{ "destroy", "", xdg_shell_types + 0 },
+	{ "set_size", "ii", xdg_shell_types + 0 },
+	{ "set_anchor_rect", "iiii", xdg_shell_types + 0 },
+	{ "set_anchor", "u", xdg_shell_types + 0 },
+	{ "set_gravity", "u", xdg_shell_types + 0 },
+	{ "set_constraint_adjustment", "u", xdg_shell_types + 0 },
+	{ "set_offset", "ii", xdg_shell_types + 0 },
+	{ "set_reactive", "3", xdg_shell_types + 0 },
+	{ "set_parent_size", "3ii", xdg_shell_types + 0 },
+	{ "set_parent_configure", "3u", xdg_shell_types + 0 },
+};
+WL_PRIVATE const struct wl_interface xdg_positioner_interface = {
+	"xdg_positioner", 6,
+	10, xdg_positioner_requests,
+	0, NULL,
+};
+static const struct wl_message xdg_surface_requests[] = {
+	{ "destroy", "", xdg_shell_types + 0 },
+	{ "get_toplevel", "n", xdg_shell_types + 7 },
+	{ "get_popup", "n?oo", xdg_shell_types + 8 },
+	{ "set_window_geometry", "iiii", xdg_shell_types + 0 },
+	{ "ack_configure", "u", xdg_shell_types + 0 },
+};
+static const struct wl_message xdg_surface_events[] = {
+	{ "configure", "u", xdg_shell_types + 0 },
+};
+WL_PRIVATE const struct wl_interface xdg_surface_interface = {
+	"xdg_surface", 6,
+	5, xdg_surface_requests,
+	1, xdg_surface_events,
+};
+static const struct wl_message xdg_toplevel_requests[] = {
+	{ "destroy", "", xdg_shell_types + 0 },
+	{ "set_parent", "?o", xdg_shell_types + 11 },
+	{ "set_title", "s", xdg_shell_types + 0 },
+	{ "set_app_id", "s", xdg_shell_types + 0 },
+	{ "show_window_menu", "ouii", xdg_shell_types + 12 },
+	{ "move", "ou", xdg_shell_types + 16 },
+	{ "resize", "ouu", xdg_shell_types + 18 },
+	{ "set_max_size", "ii", xdg_shell_types + 0 },
+	{ "set_min_size", "ii", xdg_shell_types + 0 },
+	{ "set_maximized", "", xdg_shell_types + 0 },
+	{ "unset_maximized", "", xdg_shell_types + 0 },
+	{ "set_fullscreen", "?o", xdg_shell_types + 21 },
+	{ "unset_fullscreen", "", xdg_shell_types + 0 },
+	{ "set_minimized", "", xdg_shell_types + 0 },
+};
+static const struct wl_message xdg_toplevel_events[] = {
+	{ "configure", "iia", xdg_shell_types + 0 },
+	{ "close", "", xdg_shell_types + 0 },
+	{ "configure_bounds", "4ii", xdg_shell_types + 0 },
+	{ "wm_capabilities", "5a", xdg_shell_types + 0 },
+};
+WL_PRIVATE const struct wl_interface xdg_toplevel_interface = {
+	"xdg_toplevel", 6,
+	14, xdg_toplevel_requests,
+	4, xdg_toplevel_events,
+};
+static const struct wl_message xdg_popup_requests[] = {
+	{ "destroy", "", xdg_shell_types + 0 },
+	{ "grab", "ou", xdg_shell_types + 22 },
+	{ "reposition", "3ou", xdg_shell_types + 24 },
+};
+static const struct wl_message xdg_popup_events[] = {
+	{ "configure", "iiii", xdg_shell_types + 0 },
+	{ "popup_done", "", xdg_shell_types + 0 },
+	{ "repositioned", "3u", xdg_shell_types + 0 },
+};
+WL_PRIVATE const struct wl_interface xdg_popup_interface = {
+	"xdg_popup", 6,
+	3, xdg_popup_requests,
+	3, xdg_popup_events,
+};
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "wayland-util.h"
+#ifndef __has_attribute
+# define __has_attribute(x) 0  
+#endif
+#if (__has_attribute(visibility) || defined(__GNUC__) && __GNUC__ >= 4)
+#define WL_PRIVATE __attribute__ ((visibility("hidden")))
+#else
+#define WL_PRIVATE
+#endif
+extern const struct wl_interface wl_buffer_interface;
+extern const struct wl_interface wl_surface_interface;
+extern const struct wl_interface zwp_linux_buffer_params_v1_interface;
+extern const struct wl_interface zwp_linux_dmabuf_feedback_v1_interface;
+static const struct wl_interface *linux_dmabuf_unstable_v1_types[] = {
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	&zwp_linux_buffer_params_v1_interface,
+	&zwp_linux_dmabuf_feedback_v1_interface,
+	&zwp_linux_dmabuf_feedback_v1_interface,
+	&wl_surface_interface,
+	&wl_buffer_interface,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	&wl_buffer_interface,
+};
+static const struct wl_message zwp_linux_dmabuf_v1_requests[] = {
+	{ "destroy", "", linux_dmabuf_unstable_v1_types + 0 },
+	{ "create_params", "n", linux_dmabuf_unstable_v1_types + 6 },
+	{ "get_default_feedback", "4n", linux_dmabuf_unstable_v1_types + 7 },
+	{ "get_surface_feedback", "4no", linux_dmabuf_unstable_v1_types + 8 },
+};
+static const struct wl_message zwp_linux_dmabuf_v1_events[] = {
+	{ "format", "u", linux_dmabuf_unstable_v1_types + 0 },
+	{ "modifier", "3uuu", linux_dmabuf_unstable_v1_types + 0 },
+};
+WL_PRIVATE const struct wl_interface zwp_linux_dmabuf_v1_interface = {
+	"zwp_linux_dmabuf_v1", 5,
+	4, zwp_linux_dmabuf_v1_requests,
+	2, zwp_linux_dmabuf_v1_events,
+};
+static const struct wl_message zwp_linux_buffer_params_v1_requests[] = {
+	{ "destroy", "", linux_dmabuf_unstable_v1_types + 0 },
+	{ "add", "huuuuu", linux_dmabuf_unstable_v1_types + 0 },
+	{ "create", "iiuu", linux_dmabuf_unstable_v1_types + 0 },
+	{ "create_immed", "2niiuu", linux_dmabuf_unstable_v1_types + 10 },
+};
+static const struct wl_message zwp_linux_buffer_params_v1_events[] = {
+	{ "created", "n", linux_dmabuf_unstable_v1_types + 15 },
+	{ "failed", "", linux_dmabuf_unstable_v1_types + 0 },
+};
+WL_PRIVATE const struct wl_interface zwp_linux_buffer_params_v1_interface = {
+	"zwp_linux_buffer_params_v1", 5,
+	4, zwp_linux_buffer_params_v1_requests,
+	2, zwp_linux_buffer_params_v1_events,
+};
+static const struct wl_message zwp_linux_dmabuf_feedback_v1_requests[] = {
+	{ "destroy", "", linux_dmabuf_unstable_v1_types + 0 },
+};
+static const struct wl_message zwp_linux_dmabuf_feedback_v1_events[] = {
+	{ "done", "", linux_dmabuf_unstable_v1_types + 0 },
+	{ "format_table", "hu", linux_dmabuf_unstable_v1_types + 0 },
+	{ "main_device", "a", linux_dmabuf_unstable_v1_types + 0 },
+	{ "tranche_done", "", linux_dmabuf_unstable_v1_types + 0 },
+	{ "tranche_target_device", "a", linux_dmabuf_unstable_v1_types + 0 },
+	{ "tranche_formats", "a", linux_dmabuf_unstable_v1_types + 0 },
+	{ "tranche_flags", "u", linux_dmabuf_unstable_v1_types + 0 },
+};
+WL_PRIVATE const struct wl_interface zwp_linux_dmabuf_feedback_v1_interface = {
+	"zwp_linux_dmabuf_feedback_v1", 5,
+	1, zwp_linux_dmabuf_feedback_v1_requests,
+	7, zwp_linux_dmabuf_feedback_v1_events,
+};
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "wayland-util.h"
+#ifndef __has_attribute
+# define __has_attribute(x) 0  
+#endif
+#if (__has_attribute(visibility) || defined(__GNUC__) && __GNUC__ >= 4)
+#define WL_PRIVATE __attribute__ ((visibility("hidden")))
+#else
+#define WL_PRIVATE
+#endif
+extern const struct wl_interface wl_surface_interface;
+extern const struct wl_interface wp_viewport_interface;
+static const struct wl_interface *viewporter_types[] = {
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	&wp_viewport_interface,
+	&wl_surface_interface,
+};
+static const struct wl_message wp_viewporter_requests[] = {
+	{ "destroy", "", viewporter_types + 0 },
+	{ "get_viewport", "no", viewporter_types + 4 },
+};
+WL_PRIVATE const struct wl_interface wp_viewporter_interface = {
+	"wp_viewporter", 1,
+	2, wp_viewporter_requests,
+	0, NULL,
+};
+static const struct wl_message wp_viewport_requests[] = {
+	{ "destroy", "", viewporter_types + 0 },
+	{ "set_source", "ffff", viewporter_types + 0 },
+	{ "set_destination", "ii", viewporter_types + 0 },
+};
+WL_PRIVATE const struct wl_interface wp_viewport_interface = {
+	"wp_viewport", 1,
+	3, wp_viewport_requests,
+	0, NULL,
+};
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "wayland-util.h"
+#ifndef __has_attribute
+# define __has_attribute(x) 0  
+#endif
+#if (__has_attribute(visibility) || defined(__GNUC__) && __GNUC__ >= 4)
+#define WL_PRIVATE __attribute__ ((visibility("hidden")))
+#else
+#define WL_PRIVATE
+#endif
+extern const struct wl_interface wl_surface_interface;
+extern const struct wl_interface wp_fractional_scale_v1_interface;
+static const struct wl_interface *fractional_scale_v1_types[] = {
+	NULL,
+	&wp_fractional_scale_v1_interface,
+	&wl_surface_interface,
+};
+static const struct wl_message wp_fractional_scale_manager_v1_requests[] = {
+	{ "destroy", "", fractional_scale_v1_types + 0 },
+	{ "get_fractional_scale", "no", fractional_scale_v1_types + 1 },
+};
+WL_PRIVATE const struct wl_interface wp_fractional_scale_manager_v1_interface = {
+	"wp_fractional_scale_manager_v1", 1,
+	2, wp_fractional_scale_manager_v1_requests,
+	0, NULL,
+};
+static const struct wl_message wp_fractional_scale_v1_requests[] = {
+	{ "destroy", "", fractional_scale_v1_types + 0 },
+};
+static const struct wl_message wp_fractional_scale_v1_events[] = {
+	{ "preferred_scale", "u", fractional_scale_v1_types + 0 },
+};
+WL_PRIVATE const struct wl_interface wp_fractional_scale_v1_interface = {
+	"wp_fractional_scale_v1", 1,
+	1, wp_fractional_scale_v1_requests,
+	1, wp_fractional_scale_v1_events,
+};
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "wayland-util.h"
+#ifndef __has_attribute
+# define __has_attribute(x) 0  
+#endif
+#if (__has_attribute(visibility) || defined(__GNUC__) && __GNUC__ >= 4)
+#define WL_PRIVATE __attribute__ ((visibility("hidden")))
+#else
+#define WL_PRIVATE
+#endif
+extern const struct wl_interface wl_output_interface;
+extern const struct wl_interface wl_surface_interface;
+extern const struct wl_interface xdg_popup_interface;
+extern const struct wl_interface zwlr_layer_surface_v1_interface;
+static const struct wl_interface *wlr_layer_shell_unstable_v1_types[] = {
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	&zwlr_layer_surface_v1_interface,
+	&wl_surface_interface,
+	&wl_output_interface,
+	NULL,
+	NULL,
+	&xdg_popup_interface,
+};
+static const struct wl_message zwlr_layer_shell_v1_requests[] = {
+	{ "get_layer_surface", "no?ous", wlr_layer_shell_unstable_v1_types + 4 },
+	{ "destroy", "3", wlr_layer_shell_unstable_v1_types + 0 },
+};
+WL_PRIVATE const struct wl_interface zwlr_layer_shell_v1_interface = {
+	"zwlr_layer_shell_v1", 5,
+	2, zwlr_layer_shell_v1_requests,
+	0, NULL,
+};
+static const struct wl_message zwlr_layer_surface_v1_requests[] = {
+	{ "set_size", "uu", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "set_anchor", "u", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "set_exclusive_zone", "i", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "set_margin", "iiii", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "set_keyboard_interactivity", "u", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "get_popup", "o", wlr_layer_shell_unstable_v1_types + 9 },
+	{ "ack_configure", "u", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "destroy", "", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "set_layer", "2u", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "set_exclusive_edge", "5u", wlr_layer_shell_unstable_v1_types + 0 },
+};
+static const struct wl_message zwlr_layer_surface_v1_events[] = {
+	{ "configure", "uuu", wlr_layer_shell_unstable_v1_types + 0 },
+	{ "closed", "", wlr_layer_shell_unstable_v1_types + 0 },
+};
+WL_PRIVATE const struct wl_interface zwlr_layer_surface_v1_interface = {
+	"zwlr_layer_surface_v1", 5,
+	10, zwlr_layer_surface_v1_requests,
+	2, zwlr_layer_surface_v1_events,
+};
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "wayland-util.h"
+#ifndef __has_attribute
+# define __has_attribute(x) 0  
+#endif
+#if (__has_attribute(visibility) || defined(__GNUC__) && __GNUC__ >= 4)
+#define WL_PRIVATE __attribute__ ((visibility("hidden")))
+#else
+#define WL_PRIVATE
+#endif
+extern const struct wl_interface xdg_toplevel_interface;
+extern const struct wl_interface zxdg_toplevel_decoration_v1_interface;
+static const struct wl_interface *xdg_decoration_unstable_v1_types[] = {
+	NULL,
+	&zxdg_toplevel_decoration_v1_interface,
+	&xdg_toplevel_interface,
+};
+static const struct wl_message zxdg_decoration_manager_v1_requests[] = {
+	{ "destroy", "", xdg_decoration_unstable_v1_types + 0 },
+	{ "get_toplevel_decoration", "no", xdg_decoration_unstable_v1_types + 1 },
+};
+WL_PRIVATE const struct wl_interface zxdg_decoration_manager_v1_interface = {
+	"zxdg_decoration_manager_v1", 1,
+	2, zxdg_decoration_manager_v1_requests,
+	0, NULL,
+};
+static const struct wl_message zxdg_toplevel_decoration_v1_requests[] = {
+	{ "destroy", "", xdg_decoration_unstable_v1_types + 0 },
+	{ "set_mode", "u", xdg_decoration_unstable_v1_types + 0 },
+	{ "unset_mode", "", xdg_decoration_unstable_v1_types + 0 },
+};
+static const struct wl_message zxdg_toplevel_decoration_v1_events[] = {
+	{ "configure", "u", xdg_decoration_unstable_v1_types + 0 },
+};
+WL_PRIVATE const struct wl_interface zxdg_toplevel_decoration_v1_interface = {
+	"zxdg_toplevel_decoration_v1", 1,
+	3, zxdg_toplevel_decoration_v1_requests,
+	1, zxdg_toplevel_decoration_v1_events,
+};
+
+
+// ------------------------------------------------------------------------- //
+//                                                                           //
+//                         APPLICATION IMPLEMENTATION                        //
+//                                                                           //
+// ------------------------------------------------------------------------- //
+
+static void __swcl_window_make_current(SWCLWindow *win);
+static void __swcl_window_update_scale(SWCLWindow *win);
+static void __swcl_gl_flush(SWCLApplication *app);
+static void __swcl_render_pool_destroy(SWCLRenderPool *pool);
+static void __swcl_popup_pool_fill(SWCLApplication *app, uint32_t count);
+static void __swcl_window_map(SWCLWindow *win);
+static void swcl_window_queue_redraw(SWCLWindow *win);
+static uint32_t __swcl_csd_top(SWCLWindow *win);
+static void __swcl_csd_layout(SWCLWindow *win);
+static void __swcl_csd_update(SWCLWindow *win);
+static void __swcl_csd_update_done(SWCLWindow *win);
+static bool __swcl_csd_pointer_motion(SWCLSeat *seat);
+static bool __swcl_csd_pointer_leave(SWCLSeat *seat);
+static bool __swcl_csd_pointer_button(SWCLSeat *seat, uint32_t button,
+                                      uint32_t state);
+static bool __swcl_csd_touch_down(SWCLSeat *seat, SWCLWindow *chrome,
+                                  int32_t x, int32_t y, uint32_t serial);
+static void __swcl_gl_use_texture(SWCLApplication *app, SWCLTexture *texture);
+#ifdef SWCL_ENABLE_TEXT
+static void __swcl_glyph_atlas_upload(SWCLApplication *app);
+static void __swcl_glyph_atlas_next_frame();
+#endif
+
+// -------- xdg_wm_base events callbacks -------- //
+
+static inline void on_xdg_wm_base_ping(void *data, struct xdg_wm_base *wm_base,
+                                       uint32_t serial) {
+  xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener xdg_wm_base_listener = {
+    .ping = on_xdg_wm_base_ping,
+};
+
+// Find window of the surface input event is for
+static inline SWCLWindow *__swcl_window_of_surface(SWCLApplication *app,
+                                                   struct wl_surface *surface) {
+  for (uint32_t i = 0; i < app->windows.length; i++)
+    if (((SWCLWindow *)app->windows.items[i])->wl_surface == surface)
+      return (SWCLWindow *)app->windows.items[i];
+  return NULL;
+}
+
+// -------- wl_pointer events callbacks -------- //
+
+static inline void on_wl_pointer_button(void *data, struct wl_pointer *pointer,
+                                        uint32_t serial, uint32_t time,
+                                        uint32_t button, uint32_t state) {
+  SWCL_TRACE_BEGIN("on_wl_pointer_button");
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+  app->current_seat = seat;
+  seat->wl_pointer_serial = serial;
+  if (!__swcl_csd_pointer_button(seat, button, state) &&
+      app->on_mouse_button_cb)
+    app->on_mouse_button_cb(seat->current_window, seat,
+                            (SWCLMouseButton)button, (SWCLButtonState)state);
+  SWCL_TRACE_END("on_wl_pointer_button");
+}
+
+static inline void on_wl_pointer_enter(void *data, struct wl_pointer *pointer,
+                                       uint32_t serial,
+                                       struct wl_surface *surface, wl_fixed_t x,
                                        wl_fixed_t y) {
+  SWCL_TRACE_BEGIN("on_wl_pointer_enter");
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+  app->current_seat = seat;
+  seat->wl_pointer_serial = serial;
+  seat->wl_pointer_enter_serial = serial;
+  seat->cursor_pos.x = wl_fixed_to_int(x);
+  seat->cursor_pos.y = wl_fixed_to_int(y);
+  SWCLWindow *win = __swcl_window_of_surface(app, surface);
+  if (win) {
+    seat->current_window = win;
+    if (!__swcl_csd_pointer_motion(seat)) {
+      // Pointer may come from resize border of decorations
+      if (win->csd)
+        swcl_seat_set_cursor(seat, "left_ptr", SWCL_CSD_CURSOR_SIZE);
+      if (app->on_pointer_enter_cb)
+        app->on_pointer_enter_cb(win, seat, seat->cursor_pos.x,
+                                 seat->cursor_pos.y);
+    }
+  }
+  SWCL_TRACE_END("on_wl_pointer_enter");
+};
+
+static inline void on_wl_pointer_leave(void *data, struct wl_pointer *pointer,
+                                       uint32_t serial,
+                                       struct wl_surface *surface) {
+  SWCL_TRACE_BEGIN("on_wl_pointer_leave");
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+  app->current_seat = seat;
+  if (!__swcl_csd_pointer_leave(seat) && app->on_pointer_leave_cb)
+    app->on_pointer_leave_cb(seat->current_window, seat);
+  seat->wl_pointer_serial = serial;
+  SWCL_TRACE_END("on_wl_pointer_leave");
+};
+
+static inline void on_wl_pointer_motion(void *data, struct wl_pointer *pointer,
+                                        uint32_t time, wl_fixed_t x,
+                                        wl_fixed_t y) {
+  SWCL_TRACE_BEGIN("on_wl_pointer_motion");
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+  app->current_seat = seat;
+  seat->cursor_pos.x = wl_fixed_to_int(x);
+  seat->cursor_pos.y = wl_fixed_to_int(y);
+  if (!__swcl_csd_pointer_motion(seat) && app->on_pointer_motion_cb)
+    app->on_pointer_motion_cb(seat->current_window, seat, seat->cursor_pos.x,
+                              seat->cursor_pos.y);
+  SWCL_TRACE_END("on_wl_pointer_motion");
+};
+
+static inline void on_wl_pointer_axis(void *data, struct wl_pointer *wl_pointer,
+                                      uint32_t time, uint32_t axis,
+                                      wl_fixed_t value) {
+  SWCL_TRACE_BEGIN("on_wl_pointer_axis");
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+  app->current_seat = seat;
+  if (app->on_mouse_scroll_cb)
+    app->on_mouse_scroll_cb(seat->current_window, seat,
+                            (SWCLScrollDirection)(1 ? value > 0 : 0));
+  SWCL_TRACE_END("on_wl_pointer_axis");
+};
+
+static const struct wl_pointer_listener wl_pointer_listener = {
+    .enter = on_wl_pointer_enter,
+    .leave = on_wl_pointer_leave,
+    .motion = on_wl_pointer_motion,
+    .button = on_wl_pointer_button,
+    .axis = on_wl_pointer_axis,
+};
+
+// -------- wl_keyboard events callbacks -------- //
+
+// Keymap is not used, but its file descriptor must be closed
+static inline void on_wl_kb_keymap(void *data, struct wl_keyboard *wl_keyboard,
+                                   uint32_t format, int32_t fd, uint32_t size) {
+  close(fd);
+}
+
+static inline void on_wl_kb_focus_enter_surface(void *data,
+                                                struct wl_keyboard *wl_keyboard,
+                                                uint32_t serial,
+                                                struct wl_surface *surface,
+                                                struct wl_array *key) {
+  SWCLSeat *seat = (SWCLSeat *)data;
+  seat->wl_keyboard_serial = serial;
+  seat->keyboard_window = __swcl_window_of_surface(seat->app, surface);
+}
+
+static inline void on_wl_kb_focus_leave_surface(void *data,
+                                                struct wl_keyboard *wl_keyboard,
+                                                uint32_t serial,
+                                                struct wl_surface *surface) {
+  SWCLSeat *seat = (SWCLSeat *)data;
+  seat->wl_keyboard_serial = serial;
+  seat->keyboard_window = NULL;
+}
+
+static inline void on_wl_kb_key(void *data, struct wl_keyboard *wl_keyboard,
+                                uint32_t serial, uint32_t time, uint32_t key,
+                                uint32_t state) {
+  SWCL_TRACE_BEGIN("on_wl_kb_key");
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+  app->current_seat = seat;
+  seat->wl_keyboard_serial = serial;
+  if (app->on_keyboard_key_cb)
+    app->on_keyboard_key_cb(seat->keyboard_window, seat, key,
+                            (SWCLButtonState)state);
+  SWCL_TRACE_END("on_wl_kb_key");
+}
+
+static inline void on_wl_kb_mod(void *data, struct wl_keyboard *wl_keyboard,
+                                uint32_t serial, uint32_t mods_depressed,
+                                uint32_t mods_latched, uint32_t mods_locked,
+                                uint32_t group) {
+  SWCL_TRACE_BEGIN("on_wl_kb_mod");
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+  if (app->on_keyboard_mod_key_cb)
+    app->on_keyboard_mod_key_cb(seat->keyboard_window, seat, mods_depressed,
+                                mods_latched, mods_locked, group);
+  SWCL_TRACE_END("on_wl_kb_mod");
+}
+
+static const struct wl_keyboard_listener wl_keyboard_listener = {
+    .keymap = on_wl_kb_keymap,
+    .enter = on_wl_kb_focus_enter_surface,
+    .leave = on_wl_kb_focus_leave_surface,
+    .key = on_wl_kb_key,
+    .modifiers = on_wl_kb_mod,
+};
+
+// -------- wl_touch events callbacks -------- //
+
+// Find slot of point that is down
+static inline SWCLTouchPoint *__swcl_touch_find(SWCLSeat *seat, int32_t id) {
+  for (uint32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++) {
+    SWCLTouchPoint *p = &seat->touch_points[i];
+    if (p->id == id && p->state != SWCL_TOUCH_NONE &&
+        p->state != SWCL_TOUCH_UP)
+      return p;
+  }
+  return NULL;
+}
+
+// Points that went up free their slots, others stay still until they change
+static inline void __swcl_touch_frame_done(SWCLSeat *seat) {
+  for (uint32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++) {
+    SWCLTouchPoint *p = &seat->touch_points[i];
+    if (p->state == SWCL_TOUCH_UP || p->state == SWCL_TOUCH_CANCEL)
+      *p = (SWCLTouchPoint){0};
+    else if (p->state != SWCL_TOUCH_NONE)
+      p->state = SWCL_TOUCH_STATIONARY;
+  }
+  if (!seat->touch_count)
+    seat->touch_window = NULL;
+}
+
+// Drop points of window that is destroyed without reporting them
+static inline void __swcl_touch_forget(SWCLSeat *seat, SWCLWindow *win) {
+  for (uint32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++) {
+    SWCLTouchPoint *p = &seat->touch_points[i];
+    if (p->window != win)
+      continue;
+    if (p->state != SWCL_TOUCH_UP)
+      seat->touch_count--;
+    *p = (SWCLTouchPoint){0};
+  }
+  if (seat->touch_window != win)
+    return;
+  seat->touch_window = NULL;
+  seat->gesture.active = false;
+  for (uint32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++)
+    if (seat->touch_points[i].window && !seat->touch_window)
+      seat->touch_window = seat->touch_points[i].window;
+}
+
+// Recognize gestures of points on the window at the end of touch frame. Only
+// state of the current gesture is kept, so each frame takes the same time
+// and nothing is allocated.
+static inline void __swcl_gesture_update(SWCLSeat *seat, SWCLWindow *win) {
+  SWCLApplication *app = seat->app;
+  SWCLGestureRecognizer *r = &seat->gesture;
+  SWCLGesture *g = &r->gesture;
+  uint32_t n = 0;
+  float x = 0, y = 0;
+  SWCLTouchPoint *a = NULL, *b = NULL, *up = NULL;
+  for (uint32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++) {
+    SWCLTouchPoint *p = &seat->touch_points[i];
+    if (p->state == SWCL_TOUCH_NONE || p->window != win)
+      continue;
+    if (!r->moved &&
+        hypotf(p->x - p->start_x, p->y - p->start_y) > SWCL_TOUCH_SLOP)
+      r->moved = true;
+    if (p->state == SWCL_TOUCH_UP || p->state == SWCL_TOUCH_CANCEL) {
+      up = p;
+      continue;
+    }
+    n++;
+    x += p->x;
+    y += p->y;
+    if (!a)
+      a = p;
+    else if (!b)
+      b = p;
+  }
+  // Gesture ends when number of its points changes, next one begins from the
+  // current position, so it doesn't jump
+  if (r->active && n != r->points) {
+    r->active = false;
+    g->phase = SWCL_GESTURE_END;
+    app->on_gesture_cb(win, seat, g);
+  }
+  if (!n) {
+    if (up && !r->moved && r->max_points == 1 &&
+        seat->touch_time - r->start_time <= SWCL_TAP_TIMEOUT) {
+      SWCLGesture tap = {SWCL_GESTURE_TAP, SWCL_GESTURE_END, up->x, up->y,
+                         0, 0, 1};
+      app->on_gesture_cb(win, seat, &tap);
+    }
+    return;
+  }
+  x /= n;
+  y /= n;
+  float distance = b ? hypotf(a->x - b->x, a->y - b->y) : 0;
+  if (!r->active) {
+    if (!r->moved)
+      return;
+    r->active = true;
+    r->points = n;
+    r->start_x = x;
+    r->start_y = y;
+    r->start_distance = distance;
+    *g = (SWCLGesture){n == 1 ? SWCL_GESTURE_PAN : SWCL_GESTURE_PINCH,
+                       SWCL_GESTURE_BEGIN, x, y, 0, 0, 1};
+  } else {
+    g->phase = SWCL_GESTURE_UPDATE;
+    g->x = x;
+    g->y = y;
+    g->dx = x - r->start_x;
+    g->dy = y - r->start_y;
+    g->scale = r->start_distance > 0 ? distance / r->start_distance : 1;
+  }
+  app->on_gesture_cb(win, seat, g);
+}
+
+static inline void on_wl_touch_down(void *data, struct wl_touch *touch,
+                                    uint32_t serial, uint32_t time,
+                                    struct wl_surface *surface, int32_t id,
+                                    wl_fixed_t x, wl_fixed_t y) {
+  SWCL_TRACE_BEGIN("on_wl_touch_down");
+  SWCLSeat *seat = (SWCLSeat *)data;
+  seat->app->current_seat = seat;
+  seat->wl_touch_serial = serial;
+  seat->touch_time = time;
+  SWCLWindow *win = __swcl_window_of_surface(seat->app, surface);
+  SWCLTouchPoint *p = NULL;
+  for (uint32_t i = 0; i < SWCL_MAX_TOUCH_POINTS && !p; i++)
+    if (seat->touch_points[i].state == SWCL_TOUCH_NONE)
+      p = &seat->touch_points[i];
+  // Decorations handle touch as soon as it goes down
+  if (!win || __swcl_csd_touch_down(seat, win, wl_fixed_to_int(x),
+                                    wl_fixed_to_int(y), serial)) {
+    SWCL_TRACE_END("on_wl_touch_down");
+    return;
+  }
+  if (!p) {
+    SWCL_LOG_DEBUG("No free slot for touch point %d", id);
+    SWCL_TRACE_END("on_wl_touch_down");
+    return;
+  }
+  // First point begins new touch sequence
+  if (!seat->touch_count) {
+    seat->touch_window = win;
+    seat->gesture.max_points = 0;
+    seat->gesture.moved = false;
+    seat->gesture.start_time = time;
+  }
+  if (++seat->touch_count > seat->gesture.max_points)
+    seat->gesture.max_points = seat->touch_count;
+  float fx = wl_fixed_to_double(x), fy = wl_fixed_to_double(y);
+  *p = (SWCLTouchPoint){SWCL_TOUCH_DOWN, id, win, fx, fy, fx, fy};
+  seat->touch_changed = true;
+  SWCL_TRACE_END("on_wl_touch_down");
+}
+
+static inline void on_wl_touch_up(void *data, struct wl_touch *touch,
+                                  uint32_t serial, uint32_t time, int32_t id) {
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLTouchPoint *p = __swcl_touch_find(seat, id);
+  if (!p)
+    return;
+  p->state = SWCL_TOUCH_UP;
+  seat->touch_count--;
+  seat->touch_time = time;
+  seat->touch_changed = true;
+}
+
+static inline void on_wl_touch_motion(void *data, struct wl_touch *touch,
+                                      uint32_t time, int32_t id, wl_fixed_t x,
+                                      wl_fixed_t y) {
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLTouchPoint *p = __swcl_touch_find(seat, id);
+  if (!p)
+    return;
+  p->x = wl_fixed_to_double(x);
+  p->y = wl_fixed_to_double(y);
+  if (p->state == SWCL_TOUCH_STATIONARY)
+    p->state = SWCL_TOUCH_MOTION;
+  seat->touch_time = time;
+  seat->touch_changed = true;
+}
+
+// Report all changes of the frame at once. Compositor sends frame right
+// after its events, so it doesn't delay them.
+static inline void on_wl_touch_frame(void *data, struct wl_touch *touch) {
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+  if (!seat->touch_changed)
+    return;
+  SWCL_TRACE_BEGIN("on_wl_touch_frame");
+  app->current_seat = seat;
+  seat->touch_changed = false;
+  SWCLWindow *win = seat->touch_window;
+  if (win && app->on_touch_cb)
+    app->on_touch_cb(win, seat, seat->touch_points, SWCL_MAX_TOUCH_POINTS);
+  if (win && app->on_gesture_cb)
+    __swcl_gesture_update(seat, win);
+  __swcl_touch_frame_done(seat);
+  SWCL_TRACE_END("on_wl_touch_frame");
+}
+
+// Compositor took the touch sequence, e. g. for its own gesture. Points are
+// reported as cancelled and gesture in progress ends without tap.
+static inline void on_wl_touch_cancel(void *data, struct wl_touch *touch) {
+  SWCLSeat *seat = (SWCLSeat *)data;
+  for (uint32_t i = 0; i < SWCL_MAX_TOUCH_POINTS; i++)
+    if (seat->touch_points[i].state != SWCL_TOUCH_NONE)
+      seat->touch_points[i].state = SWCL_TOUCH_CANCEL;
+  seat->touch_count = 0;
+  seat->touch_changed = true;
+  seat->gesture.moved = true;
+  on_wl_touch_frame(data, touch);
+}
+
+static const struct wl_touch_listener wl_touch_listener = {
+    .down = on_wl_touch_down,
+    .up = on_wl_touch_up,
+    .motion = on_wl_touch_motion,
+    .frame = on_wl_touch_frame,
+    .cancel = on_wl_touch_cancel,
+};
+
+// -------- wl_seat events callbacks -------- //
+
+// Window is destroyed, input of seats no longer goes to it
+static inline void __swcl_seats_forget(SWCLApplication *app, SWCLWindow *win) {
+  for (uint32_t i = 0; i < app->seats.length; i++) {
+    SWCLSeat *seat = (SWCLSeat *)app->seats.items[i];
+    if (seat->current_window == win)
+      seat->current_window = NULL;
+    if (seat->keyboard_window == win)
+      seat->keyboard_window = NULL;
+    __swcl_touch_forget(seat, win);
+  }
+}
+
+static inline void __swcl_seat_release_pointer(SWCLSeat *seat) {
+  if (!seat->wl_pointer)
+    return;
+  wl_pointer_destroy(seat->wl_pointer);
+  seat->wl_pointer = NULL;
+  seat->current_window = NULL;
+  seat->current_cursor_name = NULL;
+}
+
+static inline void __swcl_seat_release_keyboard(SWCLSeat *seat) {
+  if (!seat->wl_keyboard)
+    return;
+  wl_keyboard_destroy(seat->wl_keyboard);
+  seat->wl_keyboard = NULL;
+  seat->keyboard_window = NULL;
+}
+
+static inline void __swcl_seat_release_touch(SWCLSeat *seat) {
+  if (!seat->wl_touch)
+    return;
+  wl_touch_destroy(seat->wl_touch);
+  seat->wl_touch = NULL;
+  memset(seat->touch_points, 0, sizeof(seat->touch_points));
+  seat->touch_count = 0;
+  seat->touch_window = NULL;
+  seat->gesture.active = false;
+}
+
+// Release Wayland objects of the seat. Seat itself is freed by its owner.
+static inline void __swcl_seat_destroy(SWCLSeat *seat) {
+  if (seat->app->current_seat == seat)
+    seat->app->current_seat = NULL;
+  __swcl_seat_release_pointer(seat);
+  __swcl_seat_release_keyboard(seat);
+  __swcl_seat_release_touch(seat);
+  if (seat->wl_cursor_surface) {
+    wl_surface_destroy(seat->wl_cursor_surface);
+    SWCL_LIVE_DEC(wl_surfaces);
+  }
+  wl_seat_destroy(seat->wl_seat);
+  free(seat->name);
+}
+
+static inline void on_wl_seat_name(void *data, struct wl_seat *wl_seat,
+                                   const char *name) {
+  SWCLSeat *seat = (SWCLSeat *)data;
+  free(seat->name);
+  seat->name = strdup(name);
+}
+
+// Devices are taken when seat gets them and released when they are unplugged
+static inline void on_wl_seat_capabilities(void *data, struct wl_seat *wl_seat,
+                                           uint32_t capability) {
+  SWCLSeat *seat = (SWCLSeat *)data;
+  SWCLApplication *app = seat->app;
+
+  if ((capability & WL_SEAT_CAPABILITY_POINTER) && !seat->wl_pointer) {
+    seat->wl_pointer = wl_seat_get_pointer(wl_seat);
+    if (seat->wl_pointer) {
+      SWCL_LOG_DEBUG("Got pointer");
+      wl_pointer_add_listener(seat->wl_pointer, &wl_pointer_listener, seat);
+      SWCL_TRACE_BEGIN("wl_display_roundtrip");
+      wl_display_roundtrip(app->wl_display);
+      SWCL_TRACE_END("wl_display_roundtrip");
+    } else {
+      SWCL_LOG_DEBUG("No pointer found");
+    }
+  } else if (!(capability & WL_SEAT_CAPABILITY_POINTER))
+    __swcl_seat_release_pointer(seat);
+
+  if ((capability & WL_SEAT_CAPABILITY_KEYBOARD) && !seat->wl_keyboard) {
+    seat->wl_keyboard = wl_seat_get_keyboard(wl_seat);
+    if (seat->wl_keyboard) {
+      SWCL_LOG_DEBUG("Got keyboard");
+      wl_keyboard_add_listener(seat->wl_keyboard, &wl_keyboard_listener, seat);
+      SWCL_TRACE_BEGIN("wl_display_roundtrip");
+      wl_display_roundtrip(app->wl_display);
+      SWCL_TRACE_END("wl_display_roundtrip");
+    } else {
+      SWCL_LOG_DEBUG("No keyboard found");
+    }
+  } else if (!(capability & WL_SEAT_CAPABILITY_KEYBOARD))
+    __swcl_seat_release_keyboard(seat);
+
+  if ((capability & WL_SEAT_CAPABILITY_TOUCH) && !seat->wl_touch) {
+    seat->wl_touch = wl_seat_get_touch(wl_seat);
+    if (seat->wl_touch) {
+      SWCL_LOG_DEBUG("Got touch");
+      wl_touch_add_listener(seat->wl_touch, &wl_touch_listener, seat);
+    } else {
+      SWCL_LOG_DEBUG("No touch found");
+    }
+  } else if (!(capability & WL_SEAT_CAPABILITY_TOUCH))
+    __swcl_seat_release_touch(seat);
+}
+
+static const struct wl_seat_listener wl_seat_listener = {
+    .capabilities = on_wl_seat_capabilities,
+    .name = on_wl_seat_name,
+};
+
+// -------- zwp_linux_dmabuf_feedback_v1 events callbacks -------- //
+
+static inline void __swcl_dmabuf_feedback_push(SWCLDmabufFeedback *fb,
+                                               uint32_t format,
+                                               uint64_t modifier) {
+  if (fb->pending_length == fb->pending_capacity) {
+    fb->pending_capacity = fb->pending_capacity ? fb->pending_capacity * 2 : 64;
+    fb->pending = (SWCLDmabufFormat *)realloc(
+        fb->pending, fb->pending_capacity * sizeof(SWCLDmabufFormat));
+  }
+  fb->pending[fb->pending_length++] =
+      (SWCLDmabufFormat){format, modifier, false};
+}
+
+// Replace formats with pending ones
+static inline void __swcl_dmabuf_feedback_done(SWCLDmabufFeedback *fb) {
+  SWCLDmabufFormat *formats = fb->formats;
+  uint32_t capacity = fb->formats_capacity;
+  fb->formats = fb->pending;
+  fb->formats_length = fb->pending_length;
+  fb->formats_capacity = fb->pending_capacity;
+  fb->pending = formats;
+  fb->pending_length = 0;
+  fb->pending_capacity = capacity;
+  fb->tranche_start = 0;
+  fb->changed = true;
+}
+
+// Free formats and format table of feedback
+static inline void __swcl_dmabuf_feedback_free(SWCLDmabufFeedback *fb) {
+  free(fb->formats);
+  free(fb->pending);
+  if (fb->table)
+    munmap(fb->table, fb->table_size);
+  memset(fb, 0, sizeof(*fb));
+}
+
+static inline bool __swcl_dmabuf_feedback_has(const SWCLDmabufFeedback *fb,
+                                              uint32_t format,
+                                              uint64_t modifier) {
+  for (uint32_t i = 0; i < fb->formats_length; i++)
+    if (fb->formats[i].format == format && fb->formats[i].modifier == modifier)
+      return true;
+  return false;
+}
+
+static inline void on_dmabuf_feedback_done(
+    void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback) {
+  SWCLDmabufFeedback *fb = (SWCLDmabufFeedback *)data;
+  __swcl_dmabuf_feedback_done(fb);
+  SWCL_LOG_DEBUG("Received %d dmabuf formats", fb->formats_length);
+}
+
+static inline void on_dmabuf_feedback_format_table(
+    void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback, int32_t fd,
+    uint32_t size) {
+  SWCLDmabufFeedback *fb = (SWCLDmabufFeedback *)data;
+  if (fb->table)
+    munmap(fb->table, fb->table_size);
+  fb->table = (uint8_t *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  fb->table_size = size;
+  if (fb->table == MAP_FAILED) {
+    SWCL_LOG("Failed to map dmabuf format table");
+    fb->table = NULL;
+    fb->table_size = 0;
+  }
+  close(fd);
+}
+
+static inline void
+on_dmabuf_feedback_main_device(void *data,
+                               struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                               struct wl_array *device) {}
+
+static inline void on_dmabuf_feedback_tranche_done(
+    void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback) {
+  SWCLDmabufFeedback *fb = (SWCLDmabufFeedback *)data;
+  bool scanout =
+      fb->tranche_flags & ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_SCANOUT;
+  for (uint32_t i = fb->tranche_start; i < fb->pending_length; i++)
+    fb->pending[i].scanout = scanout;
+  fb->tranche_start = fb->pending_length;
+  fb->tranche_flags = 0;
+}
+
+static inline void on_dmabuf_feedback_tranche_target_device(
+    void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback,
+    struct wl_array *device) {}
+
+// Table entry is 32-bit format, 4 bytes of padding and 64-bit modifier
+static inline void on_dmabuf_feedback_tranche_formats(
+    void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback,
+    struct wl_array *indices) {
+  SWCLDmabufFeedback *fb = (SWCLDmabufFeedback *)data;
+  uint16_t *index = (uint16_t *)indices->data;
+  for (size_t i = 0; i < indices->size / sizeof(uint16_t); i++) {
+    if (((size_t)index[i] + 1) * 16 > fb->table_size)
+      continue;
+    const uint8_t *entry = fb->table + index[i] * 16;
+    uint32_t format;
+    uint64_t modifier;
+    memcpy(&format, entry, sizeof(format));
+    memcpy(&modifier, entry + 8, sizeof(modifier));
+    __swcl_dmabuf_feedback_push(fb, format, modifier);
+  }
+}
+
+static inline void
+on_dmabuf_feedback_tranche_flags(void *data,
+                                 struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                                 uint32_t flags) {
+  SWCLDmabufFeedback *fb = (SWCLDmabufFeedback *)data;
+  fb->tranche_flags = flags;
+}
+
+static const struct zwp_linux_dmabuf_feedback_v1_listener
+    zwp_linux_dmabuf_feedback_v1_listener = {
+        .done = on_dmabuf_feedback_done,
+        .format_table = on_dmabuf_feedback_format_table,
+        .main_device = on_dmabuf_feedback_main_device,
+        .tranche_done = on_dmabuf_feedback_tranche_done,
+        .tranche_target_device = on_dmabuf_feedback_tranche_target_device,
+        .tranche_formats = on_dmabuf_feedback_tranche_formats,
+        .tranche_flags = on_dmabuf_feedback_tranche_flags,
+};
+
+// -------- zwp_linux_dmabuf_v1 events callbacks -------- //
+
+// Compositors older than version 4 send formats once after bind instead of
+// feedback
+
+static inline void
+on_zwp_linux_dmabuf_format(void *data, struct zwp_linux_dmabuf_v1 *dmabuf,
+                           uint32_t format) {
   SWCLApplication *app = (SWCLApplication *)data;
-  app->wl_pointer_serial = serial;
-  app->cursor_pos.x = wl_fixed_to_int(x);
-  app->cursor_pos.y = wl_fixed_to_int(y);
-  for (int i = 0; i < app->windows.length; i++) {
-    SWCLWindow *win = (SWCLWindow *)app->windows.items[i];
-    if (win->wl_surface == surface) {
-      app->current_window = win;
-      if (app->on_pointer_enter_cb)
-        app->on_pointer_enter_cb(app->current_window, app->cursor_pos.x,
-                                 app->cursor_pos.y);
+  // Version 3 sends the same formats with modifiers
+  if (zwp_linux_dmabuf_v1_get_version(dmabuf) < 3)
+    __swcl_dmabuf_feedback_push(&app->dmabuf_formats, format,
+                                SWCL_DMABUF_MOD_INVALID);
+}
+
+static inline void on_zwp_linux_dmabuf_modifier(
+    void *data, struct zwp_linux_dmabuf_v1 *dmabuf, uint32_t format,
+    uint32_t modifier_hi, uint32_t modifier_lo) {
+  SWCLApplication *app = (SWCLApplication *)data;
+  __swcl_dmabuf_feedback_push(&app->dmabuf_formats, format,
+                              (uint64_t)modifier_hi << 32 | modifier_lo);
+}
+
+static const struct zwp_linux_dmabuf_v1_listener zwp_linux_dmabuf_v1_listener =
+    {
+        .format = on_zwp_linux_dmabuf_format,
+        .modifier = on_zwp_linux_dmabuf_modifier,
+};
+
+// -------- wl_output events callbacks -------- //
+
+static inline void on_wl_output_geometry(void *data, struct wl_output *output,
+                                         int32_t x, int32_t y,
+                                         int32_t physical_width,
+                                         int32_t physical_height,
+                                         int32_t subpixel, const char *make,
+                                         const char *model, int32_t transform) {
+}
+
+static inline void on_wl_output_mode(void *data, struct wl_output *output,
+                                     uint32_t flags, int32_t width,
+                                     int32_t height, int32_t refresh) {}
+
+// Output properties are applied at once on 'done' event
+static inline void on_wl_output_done(void *data, struct wl_output *output) {
+  SWCLApplication *app = ((SWCLOutput *)data)->app;
+  for (uint32_t i = 0; i < app->windows.length; i++)
+    __swcl_window_update_scale((SWCLWindow *)app->windows.items[i]);
+}
+
+static inline void on_wl_output_scale(void *data, struct wl_output *output,
+                                      int32_t factor) {
+  SWCLOutput *out = (SWCLOutput *)data;
+  out->scale = factor;
+}
+
+static const struct wl_output_listener wl_output_listener = {
+    .geometry = on_wl_output_geometry,
+    .mode = on_wl_output_mode,
+    .done = on_wl_output_done,
+    .scale = on_wl_output_scale,
+};
+
+// -------- wl_registry events callbacks -------- //
+
+static inline void on_wl_registry_global(void *data,
+                                         struct wl_registry *registry,
+                                         uint32_t id, const char *interface,
+                                         uint32_t version) {
+  SWCL_TRACE_BEGIN("on_wl_registry_global");
+  SWCLApplication *app = (SWCLApplication *)data;
+  if (strcmp(interface, wl_compositor_interface.name) == 0) {
+    // Version 6 sends preferred buffer scale of surfaces
+    uint32_t v = version < 6 ? version : 6;
+    app->wl_compositor = (struct wl_compositor *)wl_registry_bind(
+        registry, id, &wl_compositor_interface, v);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, v);
+  } else if (strcmp(interface, wl_subcompositor_interface.name) == 0) {
+    app->wl_subcompositor = (struct wl_subcompositor *)wl_registry_bind(
+        registry, id, &wl_subcompositor_interface, 1);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, 1);
+  } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+    app->xdg_wm_base = (struct xdg_wm_base *)wl_registry_bind(
+        registry, id, &xdg_wm_base_interface, 2);
+    xdg_wm_base_add_listener(app->xdg_wm_base, &xdg_wm_base_listener, NULL);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, 2);
+  } else if (strcmp(interface, wl_seat_interface.name) == 0) {
+    // Version 2 adds name of the seat
+    uint32_t v = version < 2 ? version : 2;
+    SWCLSeat *seat = SWCL_ALLOC(SWCLSeat);
+    seat->app = app;
+    seat->id = id;
+    seat->wl_seat = (struct wl_seat *)wl_registry_bind(registry, id,
+                                                       &wl_seat_interface, v);
+    swcl_array_append(&app->seats, seat);
+    wl_seat_add_listener(seat->wl_seat, &wl_seat_listener, seat);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, v);
+  } else if (strcmp(interface, wl_shm_interface.name) == 0) {
+    app->wl_shm =
+        (struct wl_shm *)wl_registry_bind(registry, id, &wl_shm_interface, 1);
+  } else if (strcmp(interface, zwp_linux_dmabuf_v1_interface.name) == 0) {
+    uint32_t v = version < 4 ? version : 4;
+    app->zwp_linux_dmabuf = (struct zwp_linux_dmabuf_v1 *)wl_registry_bind(
+        registry, id, &zwp_linux_dmabuf_v1_interface, v);
+    if (v >= 4) {
+      app->dmabuf_feedback =
+          zwp_linux_dmabuf_v1_get_default_feedback(app->zwp_linux_dmabuf);
+      SWCL_LIVE_INC(dmabuf_feedbacks);
+      zwp_linux_dmabuf_feedback_v1_add_listener(
+          app->dmabuf_feedback, &zwp_linux_dmabuf_feedback_v1_listener,
+          &app->dmabuf_formats);
+    } else
+      zwp_linux_dmabuf_v1_add_listener(app->zwp_linux_dmabuf,
+                                       &zwp_linux_dmabuf_v1_listener, app);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, v);
+  } else if (strcmp(interface, wp_viewporter_interface.name) == 0) {
+    app->wp_viewporter = (struct wp_viewporter *)wl_registry_bind(
+        registry, id, &wp_viewporter_interface, 1);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, 1);
+  } else if (strcmp(interface, wp_fractional_scale_manager_v1_interface.name) ==
+             0) {
+    app->wp_fractional_scale_manager =
+        (struct wp_fractional_scale_manager_v1 *)wl_registry_bind(
+            registry, id, &wp_fractional_scale_manager_v1_interface, 1);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, 1);
+  } else if (strcmp(interface, wl_output_interface.name) == 0) {
+    SWCLOutput *output = SWCL_ALLOC(SWCLOutput);
+    output->app = app;
+    output->id = id;
+    output->scale = 1;
+    output->wl_output = (struct wl_output *)wl_registry_bind(
+        registry, id, &wl_output_interface, version < 2 ? version : 2);
+    wl_output_add_listener(output->wl_output, &wl_output_listener, output);
+    swcl_array_append(&app->outputs, output);
+  } else if (strcmp(interface, zwlr_layer_shell_v1_interface.name) == 0) {
+    // Version 4 adds on demand keyboard interactivity
+    uint32_t v = version < 4 ? version : 4;
+    app->wlr_layer_shell = (struct zwlr_layer_shell_v1 *)wl_registry_bind(
+        registry, id, &zwlr_layer_shell_v1_interface, v);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, v);
+  } else if (strcmp(interface, zxdg_decoration_manager_v1_interface.name) ==
+             0) {
+    app->xdg_decoration_manager =
+        (struct zxdg_decoration_manager_v1 *)wl_registry_bind(
+            registry, id, &zxdg_decoration_manager_v1_interface, 1);
+    SWCL_LOG_DEBUG("Registered %s version %d", interface, 1);
+  }
+  SWCL_TRACE_END("on_wl_registry_global");
+}
+
+static inline void on_wl_registry_global_remove(void *data,
+                                                struct wl_registry *registry,
+                                                uint32_t id) {
+  SWCLApplication *app = (SWCLApplication *)data;
+  for (uint32_t i = 0; i < app->seats.length; i++) {
+    SWCLSeat *seat = (SWCLSeat *)app->seats.items[i];
+    if (seat->id != id)
+      continue;
+    if (app->on_seat_removed_cb)
+      app->on_seat_removed_cb(seat);
+    swcl_array_remove(&app->seats, seat);
+    __swcl_seat_destroy(seat);
+    free(seat);
+    return;
+  }
+  for (uint32_t i = 0; i < app->outputs.length; i++) {
+    SWCLOutput *output = (SWCLOutput *)app->outputs.items[i];
+    if (output->id != id)
+      continue;
+    // Windows that were on unplugged output change their scale
+    for (uint32_t j = 0; j < app->windows.length; j++) {
+      SWCLWindow *win = (SWCLWindow *)app->windows.items[j];
+      swcl_array_remove(&win->outputs, output);
+      __swcl_window_update_scale(win);
+    }
+    swcl_array_remove(&app->outputs, output);
+    wl_output_destroy(output->wl_output);
+    free(output);
+    return;
+  }
+}
+
+static const struct wl_registry_listener wl_registry_listener = {
+    .global = on_wl_registry_global,
+    .global_remove = on_wl_registry_global_remove,
+};
+
+// ---------- APPLICATION METHODS ---------- //
+
+// Create OpenGL context for chosen config. Core profile is requested if
+// configured.
+static inline EGLContext
+__swcl_application_create_egl_context(SWCLApplication *app) {
+  const EGLint compat_attrs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+  const EGLint core_attrs[] = {
+      EGL_CONTEXT_MAJOR_VERSION,
+      3,
+      EGL_CONTEXT_MINOR_VERSION,
+      3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK,
+      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE,
+  };
+  EGLContext ctx =
+      eglCreateContext(app->egl_display, app->egl_config, EGL_NO_CONTEXT,
+                       app->gl_core_profile ? core_attrs : compat_attrs);
+  if (ctx != EGL_NO_CONTEXT)
+    SWCL_LIVE_INC(egl_contexts);
+  return ctx;
+}
+
+// Initialize EGL on Wayland display. Returns false on failure.
+static inline bool __swcl_application_init_egl(SWCLApplication *app) {
+  // Get EGLDisplay
+  app->egl_display = eglGetDisplay(app->wl_display);
+  if (app->egl_display == EGL_NO_DISPLAY) {
+    SWCL_LOG("Failed to get EGLDisplay");
+    return false;
+  } else
+    SWCL_LOG_DEBUG("Got EGLDisplay");
+
+  // Init EGL
+  EGLint major, minor;
+  if (!eglInitialize(app->egl_display, &major, &minor)) {
+    SWCL_LOG("Failed to init EGL");
+    return false;
+  } else
+    SWCL_LOG_DEBUG("Initialized EGL");
+
+  // Bind OpenGL ES API to EGL
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    SWCL_LOG("Failed to bind OpenGL to EGL");
+    return false;
+  } else
+    SWCL_LOG_DEBUG("Binded OpenGL to EGL");
+
+  const EGLint config_attrs[] = {
+      EGL_SURFACE_TYPE,
+      EGL_WINDOW_BIT,
+      EGL_RED_SIZE,
+      8,
+      EGL_GREEN_SIZE,
+      8,
+      EGL_BLUE_SIZE,
+      8,
+      EGL_ALPHA_SIZE,
+      8,
+      EGL_RENDERABLE_TYPE,
+      EGL_OPENGL_BIT,
+      EGL_SAMPLE_BUFFERS,
+      1,
+      EGL_SAMPLES,
+      4,
+      EGL_NONE,
+  };
+
+  // Choose config
+  EGLint num;
+  if (eglChooseConfig(app->egl_display, config_attrs, &app->egl_config, 1,
+                      &num) == EGL_FALSE ||
+      num == 0) {
+    SWCL_LOG("Failed to choose EGL config");
+    return false;
+  } else
+    SWCL_LOG_DEBUG("Chosen EGL config");
+
+  // Create EGL context
+  app->egl_context = __swcl_application_create_egl_context(app);
+  if (!app->egl_context) {
+    SWCL_LOG("Failed to create EGL context");
+    return false;
+  } else
+    SWCL_LOG_DEBUG("Created EGL context");
+
+  return true;
+}
+
+// -------- OpenGL state cache -------- //
+
+// Count state change. Returns true if it must reach the driver.
+static inline bool __swcl_gl_changed(SWCLApplication *app, bool changed) {
+  if (changed)
+    app->stats.state_changes++;
+  else
+    app->stats.state_changes_skipped++;
+  return changed;
+}
+
+static inline void __swcl_gl_set_blend(SWCLApplication *app, bool blend) {
+  if (!__swcl_gl_changed(app, app->gl_state.blend != blend))
+    return;
+  app->gl_state.blend = blend;
+  if (blend)
+    glEnable(GL_BLEND);
+  else
+    glDisable(GL_BLEND);
+}
+
+static inline void __swcl_gl_set_viewport(SWCLApplication *app, GLint x,
+                                          GLint y, GLint w, GLint h) {
+  GLint *vp = app->gl_state.viewport;
+  if (!__swcl_gl_changed(app, vp[0] != x || vp[1] != y || vp[2] != w ||
+                                  vp[3] != h))
+    return;
+  vp[0] = x, vp[1] = y, vp[2] = w, vp[3] = h;
+  glViewport(x, y, w, h);
+}
+
+static inline void __swcl_gl_use_program(SWCLApplication *app,
+                                         GLuint program) {
+  if (!__swcl_gl_changed(app, app->gl_state.program != program))
+    return;
+  app->gl_state.program = program;
+  glUseProgram(program);
+}
+
+static inline void __swcl_gl_bind_vertex_array(SWCLApplication *app,
+                                               GLuint vertex_array) {
+  if (!__swcl_gl_changed(app, app->gl_state.vertex_array != vertex_array))
+    return;
+  app->gl_state.vertex_array = vertex_array;
+  glBindVertexArray(vertex_array);
+}
+
+static inline void __swcl_gl_bind_array_buffer(SWCLApplication *app,
+                                               GLuint buffer) {
+  if (!__swcl_gl_changed(app, app->gl_state.array_buffer != buffer))
+    return;
+  app->gl_state.array_buffer = buffer;
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+}
+
+static inline void __swcl_gl_bind_texture(SWCLApplication *app,
+                                          GLuint texture) {
+  if (!__swcl_gl_changed(app, app->gl_state.texture != texture))
+    return;
+  app->gl_state.texture = texture;
+  glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+static inline void __swcl_gl_bind_framebuffer(SWCLApplication *app,
+                                              GLuint framebuffer) {
+  if (!__swcl_gl_changed(app, app->gl_state.framebuffer != framebuffer))
+    return;
+  app->gl_state.framebuffer = framebuffer;
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+// Check if context supports extension. Extensions are listed one by one
+// since OpenGL 3.0, older contexts have only space separated string of them.
+static inline bool __swcl_gl_has_extension(const char *name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  // Older contexts raise error of unknown GL_NUM_EXTENSIONS, clear it
+  glGetError();
+  for (GLint i = 0; i < count; i++)
+    if (!strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name))
+      return true;
+  if (count > 0)
+    return false;
+  const char *exts = (const char *)glGetString(GL_EXTENSIONS);
+  size_t length = strlen(name);
+  for (const char *p = exts; p && (p = strstr(p, name)); p += length)
+    if ((p == exts || p[-1] == ' ') && (p[length] == ' ' || !p[length]))
+      return true;
+  return false;
+}
+
+// Shaders used for all OpenGL drawing. Version line is prepended depending on
+// context profile. Vertex colors are straight, fragment shader outputs them
+// premultiplied and multiplied by glyph atlas coverage, or by premultiplied
+// texel of image texture.
+static const char *__swcl_vertex_shader_source =
+    "#if __VERSION__ >= 130\n"
+    "#define attribute in\n"
+    "#define varying out\n"
+    "#endif\n"
+    "uniform mat4 u_projection;\n"
+    "uniform vec2 u_offset;\n"
+    "attribute vec2 a_position;\n"
+    "attribute vec4 a_color;\n"
+    "attribute vec2 a_uv;\n"
+    "varying vec4 v_color;\n"
+    "varying vec2 v_uv;\n"
+    "void main() {\n"
+    "  v_color = vec4(a_color.rgb * a_color.a, a_color.a);\n"
+    "  v_uv = a_uv;\n"
+    "  gl_Position = u_projection * vec4(a_position + u_offset, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *__swcl_fragment_shader_source =
+    "#if __VERSION__ >= 130\n"
+    "#define varying in\n"
+    "out vec4 frag_color;\n"
+    "#else\n"
+    "#define frag_color gl_FragColor\n"
+    "#define texture texture2D\n"
+    "#endif\n"
+    "uniform sampler2D u_texture;\n"
+    "uniform bool u_image;\n"
+    "varying vec4 v_color;\n"
+    "varying vec2 v_uv;\n"
+    "void main() {\n"
+    "  vec4 t = texture(u_texture, v_uv);\n"
+    "  frag_color = v_color * (u_image ? vec4(t.rgb * t.a, t.a) : vec4(t.r));\n"
+    "}\n";
+
+static inline GLuint __swcl_gl_compile_shader(SWCLApplication *app,
+                                              GLenum type, const char *src) {
+  const char *sources[] = {
+      app->gl_core_profile ? "#version 330 core\n" : "#version 120\n", src};
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 2, sources, NULL);
+  glCompileShader(shader);
+  GLint ok;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    SWCL_PANIC("Failed to compile shader: %s", log);
+  }
+  return shader;
+}
+
+// Create shader program, vertex array and streaming vertex buffer. Called
+// once, when context is current.
+static inline void __swcl_application_init_gl(SWCLApplication *app) {
+  GLuint vs = __swcl_gl_compile_shader(app, GL_VERTEX_SHADER,
+                                       __swcl_vertex_shader_source);
+  GLuint fs = __swcl_gl_compile_shader(app, GL_FRAGMENT_SHADER,
+                                       __swcl_fragment_shader_source);
+  app->gl_program = glCreateProgram();
+  glAttachShader(app->gl_program, vs);
+  glAttachShader(app->gl_program, fs);
+  glBindAttribLocation(app->gl_program, 0, "a_position");
+  glBindAttribLocation(app->gl_program, 1, "a_color");
+  glBindAttribLocation(app->gl_program, 2, "a_uv");
+  glLinkProgram(app->gl_program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  GLint ok;
+  glGetProgramiv(app->gl_program, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    char log[512];
+    glGetProgramInfoLog(app->gl_program, sizeof(log), NULL, log);
+    SWCL_PANIC("Failed to link shader program: %s", log);
+  }
+  app->gl_projection_location =
+      glGetUniformLocation(app->gl_program, "u_projection");
+  app->gl_offset_location = glGetUniformLocation(app->gl_program, "u_offset");
+  app->gl_image_location = glGetUniformLocation(app->gl_program, "u_image");
+  __swcl_gl_use_program(app, app->gl_program);
+
+  // Core profile requires vertex array object to be bound
+  glGenVertexArrays(1, &app->gl_vertex_array);
+  __swcl_gl_bind_vertex_array(app, app->gl_vertex_array);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+  glGenBuffers(1, &app->gl_stream_buffer);
+
+  // Glyph atlas starts as a single white texel used by shapes. It's sampled
+  // at exact texels, so filtering is not needed.
+  const uint8_t white = 255;
+  glGenTextures(1, &app->gl_atlas_texture);
+  __swcl_gl_bind_texture(app, app->gl_atlas_texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, 1, 1, 0, GL_RED, GL_UNSIGNED_BYTE,
+               &white);
+  app->gl_atlas_size = 1;
+  glEnable(GL_MULTISAMPLE);
+  // Colors are premultiplied, as compositors expect. Blend function never
+  // changes, only blending is toggled.
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  app->gl_persistent_upload =
+      __swcl_gl_has_extension("GL_ARB_buffer_storage");
+  // Timer queries are core since OpenGL 3.3
+  app->gl_timer_queries =
+      app->gl_core_profile || __swcl_gl_has_extension("GL_ARB_timer_query");
+  // Initial viewport is unknown, force setting it
+  memset(app->gl_state.viewport, -1, sizeof(app->gl_state.viewport));
+  SWCL_LOG_DEBUG("Initialized OpenGL program");
+}
+
+// Initialize EGL without Wayland display. Uses Mesa surfaceless platform if
+// available, otherwise default display with small pbuffer surface.
+static inline void
+__swcl_application_init_headless_egl(SWCLApplication *app) {
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  app->egl_display = EGL_NO_DISPLAY;
+  if (get_platform_display)
+    app->egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                            EGL_DEFAULT_DISPLAY, NULL);
+  if (app->egl_display == EGL_NO_DISPLAY)
+    app->egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (app->egl_display == EGL_NO_DISPLAY)
+    SWCL_PANIC("Failed to get headless EGLDisplay");
+
+  EGLint major, minor;
+  if (!eglInitialize(app->egl_display, &major, &minor))
+    SWCL_PANIC("Failed to init EGL");
+  if (!eglBindAPI(EGL_OPENGL_API))
+    SWCL_PANIC("Failed to bind OpenGL to EGL");
+
+  const EGLint config_attrs[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RED_SIZE,        8,
+      EGL_GREEN_SIZE,   8,               EGL_BLUE_SIZE,       8,
+      EGL_ALPHA_SIZE,   8,               EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE,
+  };
+  EGLint num;
+  if (eglChooseConfig(app->egl_display, config_attrs, &app->egl_config, 1,
+                      &num) == EGL_FALSE ||
+      num == 0)
+    SWCL_PANIC("Failed to choose headless EGL config");
+
+  app->egl_context = __swcl_application_create_egl_context(app);
+  if (!app->egl_context)
+    SWCL_PANIC("Failed to create EGL context");
+
+  // Windows render into framebuffers, so surface is needed only if
+  // surfaceless contexts are not supported.
+  const char *exts = eglQueryString(app->egl_display, EGL_EXTENSIONS);
+  if (!exts || !strstr(exts, "EGL_KHR_surfaceless_context")) {
+    const EGLint pbuffer_attrs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    app->egl_pbuffer = eglCreatePbufferSurface(
+        app->egl_display, app->egl_config, pbuffer_attrs);
+    if (app->egl_pbuffer == EGL_NO_SURFACE)
+      SWCL_PANIC("Failed to create EGL pbuffer surface");
+    SWCL_LIVE_INC(egl_surfaces);
+  } else
+    app->egl_pbuffer = EGL_NO_SURFACE;
+  if (eglMakeCurrent(app->egl_display, app->egl_pbuffer, app->egl_pbuffer,
+                     app->egl_context) == EGL_FALSE)
+    SWCL_PANIC("Failed to make headless EGL context current");
+  SWCL_LOG_DEBUG("Initialized headless EGL");
+}
+
+static inline SWCLApplication *swcl_application_new(SWCLConfig *cfg) {
+  SWCLApplication *app = SWCL_ALLOC(SWCLApplication);
+
+  app->app_id = cfg->app_id;
+  app->running = false;
+  app->headless = cfg->headless;
+  app->renderer = cfg->headless ? SWCL_RENDERER_OPENGL : cfg->renderer;
+  app->software_threads = cfg->software_threads;
+  app->gl_core_profile = cfg->gl_core_profile;
+  app->dynamic_resolution = cfg->dynamic_resolution;
+  app->gpu_frame_budget = cfg->gpu_frame_budget ? cfg->gpu_frame_budget : 12;
+  if (app->software_threads == 0)
+    app->software_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (app->software_threads > SWCL_MAX_RENDER_THREADS)
+    app->software_threads = SWCL_MAX_RENDER_THREADS;
+
+  // Set callbacks
+  app->on_popup_done_cb = cfg->on_popup_done_cb;
+  app->on_decoration_mode_cb = cfg->on_decoration_mode_cb;
+  app->on_layer_surface_closed_cb = cfg->on_layer_surface_closed_cb;
+  app->on_seat_removed_cb = cfg->on_seat_removed_cb;
+  app->on_pointer_enter_cb = cfg->on_pointer_enter_cb;
+  app->on_pointer_leave_cb = cfg->on_pointer_leave_cb;
+  app->on_pointer_motion_cb = cfg->on_pointer_motion_cb;
+  app->on_mouse_button_cb = cfg->on_mouse_button_cb;
+  app->on_mouse_scroll_cb = cfg->on_mouse_scroll_cb;
+  app->on_keyboard_key_cb = cfg->on_keyboard_key_cb;
+  app->on_keyboard_mod_key_cb = cfg->on_keyboard_mod_key_cb;
+  app->on_touch_cb = cfg->on_touch_cb;
+  app->on_gesture_cb = cfg->on_gesture_cb;
+  app->outputs = swcl_array_new(1);
+  app->seats = swcl_array_new(1);
+  app->popup_pool = swcl_array_new(cfg->popup_pool ? cfg->popup_pool : 1);
+
+  if (app->headless) {
+    __swcl_application_init_headless_egl(app);
+    app->windows = swcl_array_new(2);
+    __swcl_popup_pool_fill(app, cfg->popup_pool);
+    return app;
+  }
+
+  app->wl_display = wl_display_connect(NULL);
+  if (!app->wl_display)
+    SWCL_PANIC("Failed to connect to wl_display");
+  else
+    SWCL_LOG_DEBUG("Connected to wl_display");
+
+  app->wl_registry = wl_display_get_registry(app->wl_display);
+  if (!app->wl_registry)
+    SWCL_PANIC("Failed to connect to wl_registry");
+  else
+    SWCL_LOG_DEBUG("Connected to wl_registry");
+
+  wl_registry_add_listener(app->wl_registry, &wl_registry_listener, app);
+  SWCL_TRACE_BEGIN("wl_display_roundtrip");
+  wl_display_roundtrip(app->wl_display);
+  SWCL_TRACE_END("wl_display_roundtrip");
+
+  // Receive dmabuf formats, they are sent after bind
+  if (app->zwp_linux_dmabuf) {
+    wl_display_roundtrip(app->wl_display);
+    if (!app->dmabuf_feedback)
+      __swcl_dmabuf_feedback_done(&app->dmabuf_formats);
+  }
+
+  if (app->renderer != SWCL_RENDERER_SOFTWARE &&
+      !__swcl_application_init_egl(app)) {
+    if (app->renderer == SWCL_RENDERER_OPENGL)
+      SWCL_PANIC("Failed to initialize OpenGL renderer");
+    SWCL_LOG("Failed to initialize OpenGL, using software renderer");
+    app->renderer = SWCL_RENDERER_SOFTWARE;
+  }
+  if (app->renderer == SWCL_RENDERER_AUTO)
+    app->renderer = SWCL_RENDERER_OPENGL;
+  if (app->renderer == SWCL_RENDERER_SOFTWARE && !app->wl_shm)
+    SWCL_PANIC("Failed to get wl_shm for software renderer");
+  if (app->dynamic_resolution &&
+      (app->renderer == SWCL_RENDERER_SOFTWARE || !app->wp_viewporter))
+    SWCL_LOG("Dynamic resolution needs OpenGL renderer and wp_viewporter");
+
+  app->windows = swcl_array_new(2);
+  __swcl_popup_pool_fill(app, cfg->popup_pool);
+
+  return app;
+}
+
+static inline void swcl_application_run(SWCLApplication *app) {
+  app->running = true;
+  // Without compositor there are no frame callbacks, so render windows as
+  // fast as possible
+  while (app->headless && app->running) {
+    // Nothing can queue redraw without events, so stop instead of spinning
+    bool drawn = false;
+    for (uint32_t i = 0; i < app->windows.length && app->running; i++) {
+      SWCLWindow *win = (SWCLWindow *)app->windows.items[i];
+      if (win->redraw_on_demand && !win->redraw_queued)
+        continue;
+      drawn = true;
+      __swcl_window_make_current(win);
+      win->redraw_queued = false;
+      SWCL_TRACE_BEGIN("on_draw_cb");
+      win->on_draw_cb(win);
+      SWCL_TRACE_END("on_draw_cb");
+    }
+    if (!drawn)
+      app->running = false;
+  }
+  while (app->running) {
+    SWCL_TRACE_BEGIN("wl_display_dispatch");
+    wl_display_dispatch(app->wl_display);
+    SWCL_TRACE_END("wl_display_dispatch");
+  }
+}
+
+// Delete OpenGL objects shared by windows. Context is current without
+// surface after all windows are destroyed.
+static inline void __swcl_application_release_gl(SWCLApplication *app) {
+  glDeleteProgram(app->gl_program);
+  glDeleteVertexArrays(1, &app->gl_vertex_array);
+  glDeleteBuffers(1, &app->gl_stream_buffer);
+  glDeleteTextures(1, &app->gl_atlas_texture);
+  for (uint32_t i = 0; i < SWCL_UPLOAD_BUFFERS; i++) {
+    SWCLUploadBuffer *buf = &app->gl_uploads[i];
+    if (buf->fence)
+      glDeleteSync(buf->fence);
+    // Mapped buffer is unmapped when deleted
+    if (buf->pbo)
+      glDeleteBuffers(1, &buf->pbo);
+  }
+  app->gl_program = 0;
+}
+
+static inline void swcl_application_destroy(SWCLApplication *app) {
+  SWCL_TRACE_BEGIN("swcl_application_destroy");
+  while (app->windows.length)
+    swcl_window_destroy(
+        (SWCLWindow *)app->windows.items[app->windows.length - 1]);
+  free(app->windows.items);
+  for (uint32_t i = 0; i < app->popup_pool.length; i++)
+    swcl_window_destroy((SWCLWindow *)app->popup_pool.items[i]);
+  free(app->popup_pool.items);
+  if (app->gl_program)
+    __swcl_application_release_gl(app);
+  free(app->gl_pending.items);
+  if (app->render_pool)
+    __swcl_render_pool_destroy(app->render_pool);
+
+  // EGL
+  if (app->egl_display) {
+    eglMakeCurrent(app->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (app->egl_pbuffer) {
+      eglDestroySurface(app->egl_display, app->egl_pbuffer);
+      SWCL_LIVE_DEC(egl_surfaces);
+    }
+    if (app->egl_context) {
+      eglDestroyContext(app->egl_display, app->egl_context);
+      SWCL_LIVE_DEC(egl_contexts);
+    }
+    eglTerminate(app->egl_display);
+  }
+
+  // Seats and cursor
+  for (uint32_t i = 0; i < app->seats.length; i++)
+    __swcl_seat_destroy((SWCLSeat *)app->seats.items[i]);
+  swcl_array_free(app->seats);
+  if (app->wl_cursor_theme)
+    wl_cursor_theme_destroy(app->wl_cursor_theme);
+
+  // Outputs and globals
+  for (uint32_t i = 0; i < app->outputs.length; i++) {
+    SWCLOutput *output = (SWCLOutput *)app->outputs.items[i];
+    wl_output_destroy(output->wl_output);
+  }
+  swcl_array_free(app->outputs);
+  if (app->dmabuf_feedback) {
+    zwp_linux_dmabuf_feedback_v1_destroy(app->dmabuf_feedback);
+    SWCL_LIVE_DEC(dmabuf_feedbacks);
+  }
+  __swcl_dmabuf_feedback_free(&app->dmabuf_formats);
+  if (app->wp_fractional_scale_manager)
+    wp_fractional_scale_manager_v1_destroy(app->wp_fractional_scale_manager);
+  if (app->wp_viewporter)
+    wp_viewporter_destroy(app->wp_viewporter);
+  if (app->zwp_linux_dmabuf)
+    zwp_linux_dmabuf_v1_destroy(app->zwp_linux_dmabuf);
+  if (app->xdg_decoration_manager)
+    zxdg_decoration_manager_v1_destroy(app->xdg_decoration_manager);
+  if (app->xdg_wm_base)
+    xdg_wm_base_destroy(app->xdg_wm_base);
+  // Destroy request was added in version 3
+  if (app->wlr_layer_shell &&
+      zwlr_layer_shell_v1_get_version(app->wlr_layer_shell) >= 3)
+    zwlr_layer_shell_v1_destroy(app->wlr_layer_shell);
+  else if (app->wlr_layer_shell)
+    wl_proxy_destroy((struct wl_proxy *)app->wlr_layer_shell);
+  if (app->wl_shm)
+    wl_shm_destroy(app->wl_shm);
+  if (app->wl_subcompositor)
+    wl_subcompositor_destroy(app->wl_subcompositor);
+  if (app->wl_compositor)
+    wl_compositor_destroy(app->wl_compositor);
+  if (app->wl_registry)
+    wl_registry_destroy(app->wl_registry);
+  if (app->wl_display)
+    wl_display_disconnect(app->wl_display);
+  __swcl_live_objects_report();
+  SWCL_TRACE_END("swcl_application_destroy");
+  free(app);
+}
+
+static inline SWCLRenderStats
+swcl_application_render_stats(SWCLApplication *app) {
+  return app->last_stats;
+}
+
+static inline void swcl_application_quit(SWCLApplication *app) {
+  app->running = false;
+}
+
+static inline void swcl_seat_set_cursor(SWCLSeat *seat, const char *name,
+                                        uint8_t size) {
+  SWCLApplication *app = seat->app;
+  if (!seat->wl_pointer)
+    return;
+  // Image of the seat is freed once another seat loads theme of another size
+  bool same = seat->current_cursor_name &&
+              !strcmp(seat->current_cursor_name, name) &&
+              app->wl_cursor_size == size &&
+              seat->wl_cursor_theme_generation ==
+                  app->wl_cursor_theme_generation;
+  // Compositor resets cursor when pointer enters a surface, otherwise the
+  // one set before is still shown
+  if (same && seat->wl_cursor_serial == seat->wl_pointer_enter_serial)
+    return;
+
+  if (!same) {
+    // Surface is created once, theme is loaded again only for another size
+    if (!seat->wl_cursor_surface) {
+      seat->wl_cursor_surface =
+          wl_compositor_create_surface(app->wl_compositor);
+      SWCL_LIVE_INC(wl_surfaces);
+    }
+    if (!app->wl_cursor_theme || app->wl_cursor_size != size) {
+      if (app->wl_cursor_theme)
+        wl_cursor_theme_destroy(app->wl_cursor_theme);
+      app->wl_cursor_theme = wl_cursor_theme_load(NULL, size, app->wl_shm);
+      app->wl_cursor_size = size;
+      app->wl_cursor_theme_generation++;
+    }
+    struct wl_cursor *cursor =
+        wl_cursor_theme_get_cursor(app->wl_cursor_theme, name);
+    if (!cursor) {
+      SWCL_LOG("Cursor '%s' not found", name);
+      return;
+    }
+    seat->wl_cursor_image = cursor->images[0];
+    wl_surface_attach(seat->wl_cursor_surface,
+                      wl_cursor_image_get_buffer(seat->wl_cursor_image), 0, 0);
+    wl_surface_damage(seat->wl_cursor_surface, 0, 0,
+                      seat->wl_cursor_image->width,
+                      seat->wl_cursor_image->height);
+    wl_surface_commit(seat->wl_cursor_surface);
+    seat->current_cursor_name = name;
+    seat->wl_cursor_theme_generation = app->wl_cursor_theme_generation;
+  }
+  wl_pointer_set_cursor(seat->wl_pointer, seat->wl_pointer_enter_serial,
+                        seat->wl_cursor_surface,
+                        seat->wl_cursor_image->hotspot_x,
+                        seat->wl_cursor_image->hotspot_y);
+  seat->wl_cursor_serial = seat->wl_pointer_enter_serial;
+}
+
+static inline void swcl_application_set_cursor(SWCLApplication *app,
+                                               const char *name, uint8_t size) {
+  if (app->headless)
+    return;
+  for (uint32_t i = 0; i < app->seats.length; i++)
+    swcl_seat_set_cursor((SWCLSeat *)app->seats.items[i], name, size);
+}
+
+// ------------------------------------------------------------------------- //
+//                                                                           //
+//                      SOFTWARE RENDERER IMPLEMENTATION                     //
+//                                                                           //
+// ------------------------------------------------------------------------- //
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+// Current window if it uses software renderer, NULL for OpenGL
+static SWCLWindow *__swcl_sw_window;
+
+// Current window if it uses OpenGL renderer
+static SWCLWindow *__swcl_gl_window;
+
+#ifdef SWCL_ENABLE_TEXT
+static SWCLGlyphAtlas __swcl_glyph_atlas = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+#endif
+
+// Command list that is being recorded on this thread
+static __thread SWCLCommandList *__swcl_recording;
+
+static inline void __swcl_command_list_push(SWCLCommandList *list,
+                                            SWCLDrawCommand cmd);
+
+// -------- wl_buffer events callbacks -------- //
+
+static inline void on_wl_buffer_release(void *data, struct wl_buffer *buffer) {
+  SWCLShmBuffer *buf = (SWCLShmBuffer *)data;
+  buf->busy = false;
+}
+
+static const struct wl_buffer_listener wl_buffer_listener = {
+    .release = on_wl_buffer_release,
+};
+
+// -------- Shared memory buffers -------- //
+
+static inline void __swcl_shm_buffer_destroy(SWCLShmBuffer *buf) {
+  if (!buf->wl_buffer)
+    return;
+  wl_buffer_destroy(buf->wl_buffer);
+  SWCL_LIVE_DEC(wl_buffers);
+  munmap(buf->data, buf->size);
+  buf->wl_buffer = NULL;
+  buf->data = NULL;
+}
+
+// Allocate memfd-backed buffer of given size. Returns false on failure.
+static inline bool __swcl_shm_buffer_init(SWCLApplication *app,
+                                          SWCLShmBuffer *buf, uint32_t width,
+                                          uint32_t height) {
+  buf->width = width;
+  buf->height = height;
+  buf->size = (size_t)width * height * 4;
+  int fd = syscall(SYS_memfd_create, "swcl-shm", MFD_CLOEXEC);
+  if (fd < 0)
+    return false;
+  if (ftruncate(fd, buf->size) < 0) {
+    close(fd);
+    return false;
+  }
+  buf->data = (uint32_t *)mmap(NULL, buf->size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED, fd, 0);
+  if (buf->data == MAP_FAILED) {
+    buf->data = NULL;
+    close(fd);
+    return false;
+  }
+  struct wl_shm_pool *pool = wl_shm_create_pool(app->wl_shm, fd, buf->size);
+  buf->wl_buffer = wl_shm_pool_create_buffer(pool, 0, width, height, width * 4,
+                                             WL_SHM_FORMAT_ARGB8888);
+  wl_buffer_add_listener(buf->wl_buffer, &wl_buffer_listener, buf);
+  SWCL_LIVE_INC(wl_buffers);
+  wl_shm_pool_destroy(pool);
+  close(fd);
+  buf->busy = false;
+  return true;
+}
+
+// Get buffer that is not used by compositor, recreating it if window size
+// changed. Blocks until compositor releases one if all of them are busy.
+static inline SWCLShmBuffer *
+__swcl_window_acquire_shm_buffer(SWCLWindow *win) {
+  while (true) {
+    for (uint32_t i = 0; i < SWCL_SHM_BUFFERS; i++) {
+      SWCLShmBuffer *buf = &win->shm_buffers[i];
+      if (buf->busy)
+        continue;
+      if (buf->wl_buffer &&
+          (buf->width != win->width || buf->height != win->height))
+        __swcl_shm_buffer_destroy(buf);
+      if (!buf->wl_buffer &&
+          !__swcl_shm_buffer_init(win->app, buf, win->width, win->height))
+        SWCL_PANIC("Failed to create shm buffer");
+      return buf;
+    }
+    SWCL_TRACE_BEGIN("wait_shm_buffer_release");
+    wl_display_roundtrip(win->app->wl_display);
+    SWCL_TRACE_END("wait_shm_buffer_release");
+  }
+}
+
+// -------- Rasterizer -------- //
+
+// Divide by 255 with rounding
+static inline uint32_t __swcl_div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+// Convert color to premultiplied ARGB8888 pixel
+static inline uint32_t __swcl_sw_pixel(SWCLColor c) {
+  return (uint32_t)c.a << 24 | __swcl_div255(c.r * c.a) << 16 |
+         __swcl_div255(c.g * c.a) << 8 | __swcl_div255(c.b * c.a);
+}
+
+// Multiply all channels of the pixel by k / 255
+static inline uint32_t __swcl_sw_scale(uint32_t p, uint32_t k) {
+  uint32_t rb = (p & 0x00ff00ff) * k + 0x00800080;
+  rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+  uint32_t ag = ((p >> 8) & 0x00ff00ff) * k + 0x00800080;
+  ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+  return rb | ag;
+}
+
+// Source-over blending of premultiplied pixels
+static inline uint32_t __swcl_sw_over(uint32_t dst, uint32_t src) {
+  return src + __swcl_sw_scale(dst, 255 - (src >> 24));
+}
+
+// Fill 'n' pixels with opaque pixel
+static inline void __swcl_sw_span_fill(uint32_t *dst, uint32_t n,
+                                       uint32_t px) {
+  uint32_t i = 0;
+#if defined(__AVX2__)
+  __m256i v = _mm256_set1_epi32((int)px);
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_si256((__m256i *)(dst + i), v);
+#elif defined(__SSE2__)
+  __m128i v = _mm_set1_epi32((int)px);
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_si128((__m128i *)(dst + i), v);
+#elif defined(__ARM_NEON)
+  uint32x4_t v = vdupq_n_u32(px);
+  for (; i + 4 <= n; i += 4)
+    vst1q_u32(dst + i, v);
+#endif
+  for (; i < n; i++)
+    dst[i] = px;
+}
+
+// Blend translucent pixel over 'n' pixels
+static inline void __swcl_sw_span_blend(uint32_t *dst, uint32_t n,
+                                        uint32_t px) {
+  uint32_t inv = 255 - (px >> 24);
+  uint32_t i = 0;
+#if defined(__AVX2__)
+  __m256i src = _mm256_set1_epi32((int)px);
+  __m256i zero = _mm256_setzero_si256();
+  __m256i k = _mm256_set1_epi16((short)inv);
+  __m256i half = _mm256_set1_epi16(128);
+  for (; i + 8 <= n; i += 8) {
+    __m256i d = _mm256_loadu_si256((__m256i *)(dst + i));
+    __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), k);
+    __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), k);
+    lo = _mm256_add_epi16(lo, half);
+    hi = _mm256_add_epi16(hi, half);
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+    d = _mm256_add_epi8(_mm256_packus_epi16(lo, hi), src);
+    _mm256_storeu_si256((__m256i *)(dst + i), d);
+  }
+#elif defined(__SSE2__)
+  __m128i src = _mm_set1_epi32((int)px);
+  __m128i zero = _mm_setzero_si128();
+  __m128i k = _mm_set1_epi16((short)inv);
+  __m128i half = _mm_set1_epi16(128);
+  for (; i + 4 <= n; i += 4) {
+    __m128i d = _mm_loadu_si128((__m128i *)(dst + i));
+    __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), k);
+    __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), k);
+    lo = _mm_add_epi16(lo, half);
+    hi = _mm_add_epi16(hi, half);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    d = _mm_add_epi8(_mm_packus_epi16(lo, hi), src);
+    _mm_storeu_si128((__m128i *)(dst + i), d);
+  }
+#elif defined(__ARM_NEON)
+  uint8x16_t src = vreinterpretq_u8_u32(vdupq_n_u32(px));
+  uint8x8_t k = vdup_n_u8((uint8_t)inv);
+  uint16x8_t half = vdupq_n_u16(128);
+  for (; i + 4 <= n; i += 4) {
+    uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+    uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(d), k), half);
+    uint16x8_t hi = vaddq_u16(vmull_u8(vget_high_u8(d), k), half);
+    uint8x8_t l = vshrn_n_u16(vaddq_u16(lo, vshrq_n_u16(lo, 8)), 8);
+    uint8x8_t h = vshrn_n_u16(vaddq_u16(hi, vshrq_n_u16(hi, 8)), 8);
+    vst1q_u32(dst + i, vreinterpretq_u32_u8(vaddq_u8(vcombine_u8(l, h), src)));
+  }
+#endif
+  for (; i < n; i++)
+    dst[i] = px + __swcl_sw_scale(dst[i], inv);
+}
+
+// Fill or blend span [x0, x1) of row y clipped to canvas
+static inline void __swcl_sw_span(SWCLCanvas *c, int32_t y, int32_t x0,
+                                  int32_t x1, uint32_t px) {
+  if (y < c->clip_y0 || y >= c->clip_y1)
+    return;
+  if (x0 < c->clip_x0)
+    x0 = c->clip_x0;
+  if (x1 > c->clip_x1)
+    x1 = c->clip_x1;
+  if (x0 >= x1)
+    return;
+  uint32_t *row = c->pixels + (size_t)y * c->stride + x0;
+  if (px >> 24 == 255)
+    __swcl_sw_span_fill(row, x1 - x0, px);
+  else
+    __swcl_sw_span_blend(row, x1 - x0, px);
+}
+
+// Blend anti-aliased edge pixels [x0, x1) of row y. Coverage of each pixel is
+// computed from its distance to arc center (cx, cy) with radius r.
+static inline void __swcl_sw_arc_edge(SWCLCanvas *c, int32_t y, int32_t x0,
+                                      int32_t x1, float cx, float dy, float r,
+                                      uint32_t px) {
+  if (y < c->clip_y0 || y >= c->clip_y1)
+    return;
+  if (x0 < c->clip_x0)
+    x0 = c->clip_x0;
+  if (x1 > c->clip_x1)
+    x1 = c->clip_x1;
+  uint32_t *row = c->pixels + (size_t)y * c->stride;
+  for (int32_t x = x0; x < x1; x++) {
+    float dx = x + 0.5f - cx;
+    float cov = r + 0.5f - sqrtf(dx * dx + dy * dy);
+    if (cov <= 0)
+      continue;
+    if (cov >= 1)
+      row[x] = __swcl_sw_over(row[x], px);
+    else
+      row[x] = __swcl_sw_over(row[x], __swcl_sw_scale(px, cov * 255 + 0.5f));
+  }
+}
+
+// Rasterize one row of the shape that has arcs with radius r centered at 'cl'
+// on the left and 'cr' on the right. 'dy' is vertical distance from the row
+// center to the arcs centers.
+static inline void __swcl_sw_arc_row(SWCLCanvas *c, int32_t y, float cl,
+                                     float cr, float dy, float r,
+                                     uint32_t px) {
+  if (dy >= r + 0.5f)
+    return;
+  float outer = sqrtf((r + 0.5f) * (r + 0.5f) - dy * dy);
+  // Fully covered pixels
+  int32_t x0 = (int32_t)floorf(cl);
+  int32_t x1 = (int32_t)floorf(cr) + 1;
+  if (dy <= r - 0.5f) {
+    float inner = sqrtf((r - 0.5f) * (r - 0.5f) - dy * dy);
+    x0 = (int32_t)ceilf(cl - inner - 0.5f);
+    x1 = (int32_t)floorf(cr + inner - 0.5f) + 1;
+  }
+  if (x1 < x0)
+    x1 = x0;
+  __swcl_sw_arc_edge(c, y, (int32_t)floorf(cl - outer), x0, cl, dy, r, px);
+  __swcl_sw_span(c, y, x0, x1, px);
+  __swcl_sw_arc_edge(c, y, x1, (int32_t)ceilf(cr + outer), cr, dy, r, px);
+}
+
+static inline void __swcl_sw_clear(SWCLCanvas *c, SWCLColor color) {
+  uint32_t px = __swcl_sw_pixel(color);
+  for (int32_t y = c->clip_y0; y < c->clip_y1; y++)
+    __swcl_sw_span_fill(c->pixels + (size_t)y * c->stride + c->clip_x0,
+                        c->clip_x1 - c->clip_x0, px);
+}
+
+static inline void __swcl_sw_draw_rect(SWCLCanvas *c, SWCLColor color,
+                                       SWCLRect rect) {
+  if (color.a == 0)
+    return;
+  uint32_t px = __swcl_sw_pixel(color);
+  int32_t y0 = rect.y, y1 = rect.y + rect.h;
+  if (y0 < c->clip_y0)
+    y0 = c->clip_y0;
+  if (y1 > c->clip_y1)
+    y1 = c->clip_y1;
+  for (int32_t y = y0; y < y1; y++)
+    __swcl_sw_span(c, y, rect.x, rect.x + rect.w, px);
+}
+
+static inline void __swcl_sw_draw_rounded_rect(SWCLCanvas *c, SWCLColor color,
+                                               SWCLRect rect, int radius) {
+  if (color.a == 0)
+    return;
+  float r = radius;
+  if (r * 2 > rect.w)
+    r = rect.w / 2.0f;
+  if (r * 2 > rect.h)
+    r = rect.h / 2.0f;
+  uint32_t px = __swcl_sw_pixel(color);
+  float cl = rect.x + r, cr = rect.x + rect.w - r;
+  float top = rect.y + r, bottom = (float)rect.y + rect.h - r;
+  int32_t y0 = rect.y, y1 = rect.y + rect.h;
+  if (y0 < c->clip_y0)
+    y0 = c->clip_y0;
+  if (y1 > c->clip_y1)
+    y1 = c->clip_y1;
+  for (int32_t y = y0; y < y1; y++) {
+    float py = y + 0.5f;
+    if (py < top)
+      __swcl_sw_arc_row(c, y, cl, cr, top - py, r, px);
+    else if (py > bottom)
+      __swcl_sw_arc_row(c, y, cl, cr, py - bottom, r, px);
+    else
+      __swcl_sw_span(c, y, rect.x, rect.x + rect.w, px);
+  }
+}
+
+static inline void __swcl_sw_draw_circle(SWCLCanvas *c, SWCLColor color,
+                                         SWCLCircle circle) {
+  if (color.a == 0)
+    return;
+  uint32_t px = __swcl_sw_pixel(color);
+  float r = circle.r;
+  int32_t y0 = (int32_t)circle.cy - (int32_t)circle.r - 1;
+  int32_t y1 = circle.cy + circle.r + 1;
+  if (y0 < c->clip_y0)
+    y0 = c->clip_y0;
+  if (y1 > c->clip_y1)
+    y1 = c->clip_y1;
+  for (int32_t y = y0; y < y1; y++)
+    __swcl_sw_arc_row(c, y, circle.cx, circle.cx, fabsf(y + 0.5f - circle.cy),
+                      r, px);
+}
+
+#ifdef SWCL_ENABLE_TEXT
+// Blend color through glyph coverage from atlas
+static inline void __swcl_sw_draw_glyph(SWCLCanvas *c,
+                                        const SWCLDrawCommand *cmd) {
+  int32_t x0 = (int32_t)cmd->rect.x, y0 = (int32_t)cmd->rect.y;
+  int32_t x1 = x0 + cmd->rect.w, y1 = y0 + cmd->rect.h;
+  int32_t cx0 = x0 < c->clip_x0 ? c->clip_x0 : x0;
+  int32_t cy0 = y0 < c->clip_y0 ? c->clip_y0 : y0;
+  int32_t cx1 = x1 > c->clip_x1 ? c->clip_x1 : x1;
+  int32_t cy1 = y1 > c->clip_y1 ? c->clip_y1 : y1;
+  uint32_t px = __swcl_sw_pixel(cmd->color);
+  for (int32_t y = cy0; y < cy1; y++) {
+    const uint8_t *coverage =
+        __swcl_glyph_atlas.pixels +
+        (size_t)(cmd->glyph.atlas_y + y - y0) * SWCL_GLYPH_ATLAS_SIZE +
+        cmd->glyph.atlas_x - x0;
+    uint32_t *dst = c->pixels + (size_t)y * c->stride;
+    for (int32_t x = cx0; x < cx1; x++)
+      if (coverage[x])
+        dst[x] = __swcl_sw_over(dst[x], __swcl_sw_scale(px, coverage[x]));
+  }
+}
+#endif
+
+// Blend texture stretched to rectangle, sampling nearest texels
+static inline void __swcl_sw_draw_texture(SWCLCanvas *c,
+                                          const SWCLDrawCommand *cmd) {
+  const SWCLTexture *t = cmd->texture;
+  if (cmd->rect.w == 0 || cmd->rect.h == 0)
+    return;
+  int32_t x0 = (int32_t)cmd->rect.x, y0 = (int32_t)cmd->rect.y;
+  int32_t x1 = x0 + cmd->rect.w, y1 = y0 + cmd->rect.h;
+  int32_t cx0 = x0 < c->clip_x0 ? c->clip_x0 : x0;
+  int32_t cy0 = y0 < c->clip_y0 ? c->clip_y0 : y0;
+  int32_t cx1 = x1 > c->clip_x1 ? c->clip_x1 : x1;
+  int32_t cy1 = y1 > c->clip_y1 ? c->clip_y1 : y1;
+  // Texels per pixel in 16.16 fixed point. Pixel centers are sampled.
+  uint64_t sx = ((uint64_t)t->width << 16) / cmd->rect.w;
+  uint64_t sy = ((uint64_t)t->height << 16) / cmd->rect.h;
+  for (int32_t y = cy0; y < cy1; y++) {
+    const uint32_t *src =
+        t->pixels + (((uint64_t)(y - y0) * sy + sy / 2) >> 16) * t->width;
+    uint32_t *dst = c->pixels + (size_t)y * c->stride;
+    for (int32_t x = cx0; x < cx1; x++) {
+      uint32_t p = src[((uint64_t)(x - x0) * sx + sx / 2) >> 16];
+      if (p >> 24 == 255)
+        dst[x] = p;
+      else if (p)
+        dst[x] = __swcl_sw_over(dst[x], p);
+    }
+  }
+}
+
+// -------- Tiled rendering -------- //
+
+static inline void __swcl_sw_execute(SWCLCanvas *c,
+                                     const SWCLDrawCommand *cmd) {
+  switch (cmd->type) {
+  case SWCL_DRAW_CLEAR:
+    __swcl_sw_clear(c, cmd->color);
+    break;
+  case SWCL_DRAW_RECT:
+    __swcl_sw_draw_rect(c, cmd->color, cmd->rect);
+    break;
+  case SWCL_DRAW_ROUNDED_RECT:
+    __swcl_sw_draw_rounded_rect(c, cmd->color, cmd->rect, cmd->radius);
+    break;
+  case SWCL_DRAW_CIRCLE:
+    __swcl_sw_draw_circle(c, cmd->color, cmd->circle);
+    break;
+  case SWCL_DRAW_GLYPH:
+#ifdef SWCL_ENABLE_TEXT
+    __swcl_sw_draw_glyph(c, cmd);
+#endif
+    break;
+  case SWCL_DRAW_TEXTURE:
+    __swcl_sw_draw_texture(c, cmd);
+    break;
+  }
+}
+
+// Get range of tiles touched by command
+static inline void __swcl_sw_command_tiles(const SWCLDrawCommand *cmd,
+                                           uint32_t tiles_x, uint32_t tiles_y,
+                                           uint32_t *tx0, uint32_t *ty0,
+                                           uint32_t *tx1, uint32_t *ty1) {
+  int64_t x0 = 0, y0 = 0, x1 = INT32_MAX, y1 = INT32_MAX;
+  if (cmd->type == SWCL_DRAW_RECT || cmd->type == SWCL_DRAW_ROUNDED_RECT) {
+    x0 = cmd->rect.x;
+    y0 = cmd->rect.y;
+    x1 = (int64_t)cmd->rect.x + cmd->rect.w;
+    y1 = (int64_t)cmd->rect.y + cmd->rect.h;
+  } else if (cmd->type == SWCL_DRAW_CIRCLE) {
+    x0 = (int64_t)cmd->circle.cx - cmd->circle.r - 1;
+    y0 = (int64_t)cmd->circle.cy - cmd->circle.r - 1;
+    x1 = (int64_t)cmd->circle.cx + cmd->circle.r + 1;
+    y1 = (int64_t)cmd->circle.cy + cmd->circle.r + 1;
+  } else if (cmd->type == SWCL_DRAW_GLYPH ||
+             cmd->type == SWCL_DRAW_TEXTURE) {
+    x0 = (int32_t)cmd->rect.x;
+    y0 = (int32_t)cmd->rect.y;
+    x1 = x0 + cmd->rect.w;
+    y1 = y0 + cmd->rect.h;
+  }
+  *tx0 = x0 < 0 ? 0 : x0 / SWCL_TILE_SIZE;
+  *ty0 = y0 < 0 ? 0 : y0 / SWCL_TILE_SIZE;
+  *tx1 = x1 <= 0 ? 0 : (x1 + SWCL_TILE_SIZE - 1) / SWCL_TILE_SIZE;
+  *ty1 = y1 <= 0 ? 0 : (y1 + SWCL_TILE_SIZE - 1) / SWCL_TILE_SIZE;
+  if (*tx1 > tiles_x)
+    *tx1 = tiles_x;
+  if (*ty1 > tiles_y)
+    *ty1 = tiles_y;
+}
+
+// Sort recorded commands of the window into tiles. Commands keep recording
+// order inside of each tile.
+static inline void __swcl_sw_bin(SWCLWindow *win, uint32_t width,
+                                 uint32_t height) {
+  uint32_t tiles_x = (width + SWCL_TILE_SIZE - 1) / SWCL_TILE_SIZE;
+  uint32_t tiles_y = (height + SWCL_TILE_SIZE - 1) / SWCL_TILE_SIZE;
+  uint32_t tiles = tiles_x * tiles_y;
+  if (win->tile_offsets_capacity < tiles + 1) {
+    win->tile_offsets_capacity = tiles + 1;
+    win->tile_offsets = (uint32_t *)realloc(
+        win->tile_offsets, win->tile_offsets_capacity * sizeof(uint32_t));
+  }
+  uint32_t *offsets = win->tile_offsets;
+  memset(offsets, 0, (tiles + 1) * sizeof(uint32_t));
+  // Count commands per tile
+  uint32_t tx0, ty0, tx1, ty1;
+  for (uint32_t i = 0; i < win->commands_length; i++) {
+    __swcl_sw_command_tiles(&win->commands[i], tiles_x, tiles_y, &tx0, &ty0,
+                            &tx1, &ty1);
+    for (uint32_t ty = ty0; ty < ty1; ty++)
+      for (uint32_t tx = tx0; tx < tx1; tx++)
+        offsets[ty * tiles_x + tx + 1]++;
+  }
+  for (uint32_t i = 0; i < tiles; i++)
+    offsets[i + 1] += offsets[i];
+  if (win->tile_commands_capacity < offsets[tiles]) {
+    win->tile_commands_capacity = offsets[tiles];
+    win->tile_commands = (uint32_t *)realloc(
+        win->tile_commands, win->tile_commands_capacity * sizeof(uint32_t));
+  }
+  // Fill lists, using offsets as write cursors and shifting them back after
+  for (uint32_t i = 0; i < win->commands_length; i++) {
+    __swcl_sw_command_tiles(&win->commands[i], tiles_x, tiles_y, &tx0, &ty0,
+                            &tx1, &ty1);
+    for (uint32_t ty = ty0; ty < ty1; ty++)
+      for (uint32_t tx = tx0; tx < tx1; tx++)
+        win->tile_commands[offsets[ty * tiles_x + tx]++] = i;
+  }
+  memmove(offsets + 1, offsets, tiles * sizeof(uint32_t));
+  offsets[0] = 0;
+}
+
+// Rasterize commands of one tile
+static inline void __swcl_sw_render_tile(SWCLWindow *win,
+                                         const SWCLCanvas *target,
+                                         uint32_t tile) {
+  uint32_t tiles_x = (target->width + SWCL_TILE_SIZE - 1) / SWCL_TILE_SIZE;
+  SWCLCanvas c = *target;
+  c.clip_x0 = (tile % tiles_x) * SWCL_TILE_SIZE;
+  c.clip_y0 = (tile / tiles_x) * SWCL_TILE_SIZE;
+  c.clip_x1 = c.clip_x0 + SWCL_TILE_SIZE;
+  c.clip_y1 = c.clip_y0 + SWCL_TILE_SIZE;
+  if (c.clip_x1 > (int32_t)c.width)
+    c.clip_x1 = c.width;
+  if (c.clip_y1 > (int32_t)c.height)
+    c.clip_y1 = c.height;
+  for (uint32_t i = win->tile_offsets[tile]; i < win->tile_offsets[tile + 1];
+       i++)
+    __swcl_sw_execute(&c, &win->commands[win->tile_commands[i]]);
+}
+
+// Take tiles of frame 'generation' until all of them are taken. Tile is
+// claimed only while counter still belongs to that frame.
+static inline void __swcl_render_pool_work(SWCLRenderPool *pool,
+                                           uint64_t generation,
+                                           SWCLWindow *win,
+                                           const SWCLCanvas *canvas,
+                                           uint32_t tiles) {
+  uint64_t next = __atomic_load_n(&pool->next_tile, __ATOMIC_RELAXED);
+  while (true) {
+    uint32_t tile = (uint32_t)next;
+    if (next >> 32 != (uint32_t)generation || tile >= tiles)
+      return;
+    if (__atomic_compare_exchange_n(&pool->next_tile, &next, next + 1, true,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      __swcl_sw_render_tile(win, canvas, tile);
+      next = __atomic_load_n(&pool->next_tile, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+static inline void *__swcl_render_pool_thread(void *data) {
+  SWCLRenderPool *pool = (SWCLRenderPool *)data;
+  uint64_t generation = 0;
+  pthread_mutex_lock(&pool->mutex);
+  while (true) {
+    while (pool->generation == generation && !pool->quit)
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    if (pool->quit)
+      break;
+    generation = pool->generation;
+    pool->active++;
+    SWCLWindow *win = pool->win;
+    SWCLCanvas canvas = pool->canvas;
+    uint32_t tiles = pool->tiles_count;
+    pthread_mutex_unlock(&pool->mutex);
+    __swcl_render_pool_work(pool, generation, win, &canvas, tiles);
+    pthread_mutex_lock(&pool->mutex);
+    if (--pool->active == 0)
+      pthread_cond_signal(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return NULL;
+}
+
+// Start 'threads - 1' worker threads
+static inline SWCLRenderPool *__swcl_render_pool_new(uint32_t threads) {
+  SWCLRenderPool *pool = SWCL_ALLOC(SWCLRenderPool);
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+  for (uint32_t i = 0; i + 1 < threads; i++) {
+    if (pthread_create(&pool->threads[i], NULL, __swcl_render_pool_thread,
+                       pool) != 0)
+      break;
+    pool->threads_count++;
+  }
+  SWCL_LOG_DEBUG("Started %d software renderer threads", pool->threads_count);
+  return pool;
+}
+
+static inline void __swcl_render_pool_destroy(SWCLRenderPool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->quit = true;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  for (uint32_t i = 0; i < pool->threads_count; i++)
+    pthread_join(pool->threads[i], NULL);
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_cond_destroy(&pool->done_cond);
+  free(pool);
+}
+
+// Free old pixels of textures kept for rendered frame
+static inline void __swcl_sw_free_snapshots(SWCLWindow *win) {
+  for (uint32_t i = 0; i < win->texture_snapshots.length; i++) {
+    SWCLTexture *snapshot = (SWCLTexture *)win->texture_snapshots.items[i];
+    free(snapshot->pixels);
+    free(snapshot);
+  }
+  win->texture_snapshots.length = 0;
+}
+
+// Rasterize all commands recorded for the window into 'pixels' and clear the
+// commands. Output doesn't depend on number of threads.
+static inline void __swcl_sw_render(SWCLWindow *win, uint32_t *pixels,
+                                    uint32_t width, uint32_t height) {
+  SWCL_TRACE_BEGIN("__swcl_sw_render");
+  SWCLApplication *app = win->app;
+  SWCLCanvas canvas = {pixels, width, height, width, 0, 0,
+                       (int32_t)width, (int32_t)height};
+  __swcl_sw_bin(win, width, height);
+  uint32_t tiles = ((width + SWCL_TILE_SIZE - 1) / SWCL_TILE_SIZE) *
+                   ((height + SWCL_TILE_SIZE - 1) / SWCL_TILE_SIZE);
+  if (app->software_threads > 1 && !app->render_pool)
+    app->render_pool = __swcl_render_pool_new(app->software_threads);
+  SWCLRenderPool *pool = app->render_pool;
+  if (!pool || pool->threads_count == 0) {
+    for (uint32_t i = 0; i < tiles; i++)
+      __swcl_sw_render_tile(win, &canvas, i);
+  } else {
+    pthread_mutex_lock(&pool->mutex);
+    pool->win = win;
+    pool->canvas = canvas;
+    pool->tiles_count = tiles;
+    uint64_t generation = ++pool->generation;
+    __atomic_store_n(&pool->next_tile, (uint64_t)(uint32_t)generation << 32,
+                     __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    __swcl_render_pool_work(pool, generation, win, &canvas, tiles);
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->active > 0)
+      pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+  }
+  win->commands_length = 0;
+  __swcl_sw_free_snapshots(win);
+  SWCL_TRACE_END("__swcl_sw_render");
+}
+
+// Record drawing command for the current software rendered window
+static inline void __swcl_sw_record(SWCLDrawCommand cmd) {
+  SWCLWindow *win = __swcl_sw_window;
+  if (win->commands_length == win->commands_capacity) {
+    win->commands_capacity =
+        win->commands_capacity ? win->commands_capacity * 2 : 64;
+    win->commands = (SWCLDrawCommand *)realloc(
+        win->commands, win->commands_capacity * sizeof(SWCLDrawCommand));
+  }
+  win->commands[win->commands_length++] = cmd;
+}
+
+// ------------------------------------------------------------------------- //
+//                                                                           //
+//                            WINDOW IMPLEMENTATION                          //
+//                                                                           //
+// ------------------------------------------------------------------------- //
+
+// Send opaque region of the frame to compositor if it changed since last
+// frame and start collecting it again. Must be called before surface commit.
+// Headless windows only reset it.
+static inline void __swcl_window_commit_opaque_region(SWCLWindow *win) {
+  SWCLOpaqueRegion *r = &win->opaque;
+  SWCLOpaqueRegion *c = &win->opaque_committed;
+  bool changed =
+      r->full != c->full || r->length != c->length ||
+      memcmp(r->rects, c->rects, r->length * sizeof(SWCLRect)) != 0 ||
+      (r->full && (win->opaque_committed_width != win->width ||
+                   win->opaque_committed_height != win->height));
+  if (changed && win->wl_surface) {
+    struct wl_region *region =
+        wl_compositor_create_region(win->app->wl_compositor);
+    if (r->full)
+      wl_region_add(region, 0, 0, win->width, win->height);
+    else
+      for (uint32_t i = 0; i < r->length; i++)
+        wl_region_add(region, r->rects[i].x, r->rects[i].y, r->rects[i].w,
+                      r->rects[i].h);
+    wl_surface_set_opaque_region(win->wl_surface, region);
+    wl_region_destroy(region);
+    *c = *r;
+    win->opaque_committed_width = win->width;
+    win->opaque_committed_height = win->height;
+  }
+  r->cleared = false;
+  r->full = false;
+  r->length = 0;
+}
+
+// Build orthographic projection for current window size with top left
+// corner as 0
+static inline void __swcl_window_update_projection(SWCLWindow *win) {
+  float *m = win->projection;
+  memset(m, 0, sizeof(win->projection));
+  m[0] = 2.0f / win->width;
+  m[5] = -2.0f / win->height;
+  m[10] = -1.0f;
+  m[12] = -1.0f;
+  m[13] = 1.0f;
+  m[15] = 1.0f;
+}
+
+// Apply size of the latest configure and ack it. Called before drawing a
+// frame, so acked size is the one committed next. Software renderer buffers
+// are recreated on the next frame.
+static inline void __swcl_window_apply_configure(SWCLWindow *win) {
+  if (!win->configure_pending)
+    return;
+  win->configure_pending = false;
+  // Zero size is left to the client
+  uint32_t width = win->configure_width ? win->configure_width : win->width;
+  uint32_t height =
+      win->configure_height ? win->configure_height : win->height;
+  if (win->width != width || win->height != height) {
+    win->width = width;
+    win->height = height;
+    __swcl_window_update_projection(win);
+    __swcl_window_update_scale(win);
+  }
+  if (win->csd)
+    __swcl_csd_layout(win);
+  if (win->xdg_surface)
+    xdg_surface_ack_configure(win->xdg_surface, win->configure_serial);
+  else if (win->layer_surface)
+    zwlr_layer_surface_v1_ack_configure(win->layer_surface,
+                                        win->configure_serial);
+}
+
+// -------- xdg_toplevel events callbacks -------- //
+
+static inline void on_xdg_toplevel_configure(void *data,
+                                             struct xdg_toplevel *toplevel,
+                                             int32_t width, int32_t height,
+                                             struct wl_array *states) {
+  SWCL_LOG_DEBUG("xdg_toplevel configure. width=%d, height=%d", width, height);
+  SWCL_TRACE_BEGIN("on_xdg_toplevel_configure");
+  SWCLWindow *win = (SWCLWindow *)data;
+
+  // States array lists all states window has now
+  bool maximized = false, fullscreen = false, activated = false;
+  uint32_t *state;
+  for (state = (uint32_t *)(states)->data;
+       (const char *)state < ((const char *)(states)->data + (states)->size);
+       (state)++) {
+    if (*state == XDG_TOPLEVEL_STATE_MAXIMIZED)
+      maximized = true;
+    else if (*state == XDG_TOPLEVEL_STATE_FULLSCREEN)
+      fullscreen = true;
+    else if (*state == XDG_TOPLEVEL_STATE_ACTIVATED)
+      activated = true;
+  }
+  win->maximized = maximized;
+  win->fullscreen = fullscreen;
+  // Decorations show if window is focused
+  if (win->csd && win->activated != activated)
+    swcl_window_queue_redraw(win->csd);
+  win->activated = activated;
+
+  // Size is applied with the next frame, zero size is left to the client.
+  // Compositor sets size of window geometry, which includes title bar.
+  uint32_t top = __swcl_csd_top(win);
+  win->configure_width = width > 0 ? width : 0;
+  win->configure_height = height > (int32_t)top ? height - top : 0;
+  SWCL_TRACE_END("on_xdg_toplevel_configure");
+}
+
+static inline void on_xdg_toplevel_close(void *data,
+                                         struct xdg_toplevel *toplevel) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  win->app->running = false;
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+    .configure = on_xdg_toplevel_configure,
+    .close = on_xdg_toplevel_close,
+};
+
+// -------- zxdg_toplevel_decoration_v1 events callbacks -------- //
+
+// Mode is part of configure sequence, so it's applied with the frame that
+// acks it. Window drawn on demand is redrawn to add or remove its chrome.
+static inline void
+on_xdg_toplevel_decoration_configure(void *data,
+                                     struct zxdg_toplevel_decoration_v1 *deco,
+                                     uint32_t mode) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  SWCL_LOG_DEBUG("xdg_toplevel_decoration configure. mode=%d", mode);
+  if (win->decoration_mode == (SWCLDecorationMode)mode)
+    return;
+  win->decoration_mode = (SWCLDecorationMode)mode;
+  if (win->app->on_decoration_mode_cb)
+    win->app->on_decoration_mode_cb(win, win->decoration_mode);
+  swcl_window_queue_redraw(win);
+}
+
+static const struct zxdg_toplevel_decoration_v1_listener
+    xdg_toplevel_decoration_listener = {
+        .configure = on_xdg_toplevel_decoration_configure,
+};
+
+// -------- xdg_surface events callbacks -------- //
+
+// Configure sequence is finished. It's acked when next frame is drawn, newer
+// configure replaces it until then.
+static inline void on_xdg_surface_configure(void *data,
+                                            struct xdg_surface *surface,
+                                            uint32_t serial) {
+  SWCL_TRACE_INSTANT("on_xdg_surface_configure");
+  SWCLWindow *win = (SWCLWindow *)data;
+  win->configure_serial = serial;
+  win->configure_pending = true;
+  // Popup is shown right after its first configure
+  if (win->xdg_popup && !win->mapped)
+    __swcl_window_map(win);
+  else
+    swcl_window_queue_redraw(win);
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+    .configure = on_xdg_surface_configure,
+};
+
+// -------- wl_surface events callbacks -------- //
+
+static inline void on_wl_surface_enter(void *data, struct wl_surface *surface,
+                                       struct wl_output *output) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  SWCLApplication *app = win->app;
+  for (uint32_t i = 0; i < app->outputs.length; i++) {
+    SWCLOutput *out = (SWCLOutput *)app->outputs.items[i];
+    if (out->wl_output == output)
+      swcl_array_append(&win->outputs, out);
+  }
+  __swcl_window_update_scale(win);
+}
+
+static inline void on_wl_surface_leave(void *data, struct wl_surface *surface,
+                                       struct wl_output *output) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  for (uint32_t i = 0; i < win->outputs.length; i++) {
+    SWCLOutput *out = (SWCLOutput *)win->outputs.items[i];
+    if (out->wl_output == output) {
+      swcl_array_remove(&win->outputs, out);
+      break;
+    }
+  }
+  __swcl_window_update_scale(win);
+}
+
+static inline void on_wl_surface_preferred_buffer_scale(
+    void *data, struct wl_surface *surface, int32_t factor) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  win->preferred_scale = factor;
+  __swcl_window_update_scale(win);
+}
+
+static inline void on_wl_surface_preferred_buffer_transform(
+    void *data, struct wl_surface *surface, uint32_t transform) {}
+
+static const struct wl_surface_listener wl_surface_listener = {
+    .enter = on_wl_surface_enter,
+    .leave = on_wl_surface_leave,
+    .preferred_buffer_scale = on_wl_surface_preferred_buffer_scale,
+    .preferred_buffer_transform = on_wl_surface_preferred_buffer_transform,
+};
+
+// -------- wp_fractional_scale_v1 events callbacks -------- //
+
+// Scale is numerator of fraction with denominator of 120
+static inline void
+on_wp_fractional_scale_preferred_scale(void *data,
+                                       struct wp_fractional_scale_v1 *fs,
+                                       uint32_t scale) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  win->fractional_scale = scale;
+  __swcl_window_update_scale(win);
+}
+
+static const struct wp_fractional_scale_v1_listener
+    wp_fractional_scale_v1_listener = {
+        .preferred_scale = on_wp_fractional_scale_preferred_scale,
+};
+
+// -------- wl_callback events callback -------- //
+
+static void on_new_frame(void *data, struct wl_callback *cb, uint32_t cb_data);
+static const struct wl_callback_listener wl_callback_listener = {
+    .done = on_new_frame,
+};
+
+static inline void on_new_frame(void *data, struct wl_callback *cb,
+                                uint32_t cb_data) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  // Window drawn on demand stops requesting frames when nothing changed
+  if (win->redraw_on_demand && !win->redraw_queued) {
+    wl_callback_destroy(cb);
+    win->wl_callback = NULL;
+    SWCL_LIVE_DEC(wl_callbacks);
+    return;
+  }
+  SWCL_TRACE_BEGIN("on_new_frame");
+  if (win->csd)
+    __swcl_csd_update(win);
+  __swcl_window_make_current(win);
+  win->redraw_queued = false;
+  wl_callback_destroy(cb);
+  win->wl_callback = wl_surface_frame(win->wl_surface);
+  wl_callback_add_listener(win->wl_callback, &wl_callback_listener, win);
+  SWCL_TRACE_BEGIN("on_draw_cb");
+  win->on_draw_cb(win);
+  SWCL_TRACE_END("on_draw_cb");
+  SWCL_TRACE_END("on_new_frame");
+}
+
+// ---------- WINDOW METHODS ---------- //
+
+// Create offscreen framebuffer used instead of EGL surface in headless mode
+static inline void __swcl_window_init_framebuffer(SWCLWindow *win) {
+  glGenRenderbuffers(1, &win->gl_renderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, win->gl_renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, win->width, win->height);
+  glGenFramebuffers(1, &win->gl_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, win->gl_framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, win->gl_renderbuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    SWCL_PANIC("Failed to create framebuffer for headless window");
+  for (uint32_t i = 0; i < SWCL_READBACK_BUFFERS; i++)
+    glGenBuffers(1, &win->readbacks[i].pbo);
+  SWCL_LOG_DEBUG("Created headless framebuffer");
+}
+
+// Deliver oldest pending readback. If 'wait' is false and GPU has not
+// finished it yet - do nothing. Returns true if readback was delivered.
+static inline bool __swcl_window_deliver_readback(SWCLWindow *win,
+                                                  bool wait) {
+  if (win->readback_count == 0)
+    return false;
+  uint32_t idx = (win->readback_head + SWCL_READBACK_BUFFERS -
+                  win->readback_count) %
+                 SWCL_READBACK_BUFFERS;
+  SWCLReadback *rb = &win->readbacks[idx];
+  GLenum res = glClientWaitSync(rb->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                wait ? GL_TIMEOUT_IGNORED : 0);
+  if (res == GL_TIMEOUT_EXPIRED || res == GL_WAIT_FAILED)
+    return false;
+  glDeleteSync(rb->fence);
+  rb->fence = NULL;
+  win->readback_count--;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+  const uint8_t *pixels = (const uint8_t *)glMapBufferRange(
+      GL_PIXEL_PACK_BUFFER, 0, rb->width * rb->height * 4, GL_MAP_READ_BIT);
+  if (pixels)
+    rb->cb(win, pixels, rb->width, rb->height, rb->user_data);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return true;
+}
+
+// Pick scale of the window and size of its buffers in device pixels. Must be
+// called when window size or scale changes. OpenGL renders at buffer size,
+// so content is sharp on HiDPI outputs without rendering more pixels than
+// output has.
+static inline void __swcl_window_update_scale(SWCLWindow *win) {
+  SWCLApplication *app = win->app;
+  float scale = 1;
+  if (win->fractional_scale)
+    scale = win->fractional_scale / 120.0f;
+  else if (win->preferred_scale)
+    scale = win->preferred_scale;
+  else {
+    for (uint32_t i = 0; i < win->outputs.length; i++) {
+      SWCLOutput *output = (SWCLOutput *)win->outputs.items[i];
+      if (output->scale > scale)
+        scale = output->scale;
+    }
+  }
+  // Without viewporter buffer scale can be set since wl_surface version 3
+  if (app->headless || app->renderer == SWCL_RENDERER_SOFTWARE ||
+      win->video ||
+      (!win->wp_viewport && wl_surface_get_version(win->wl_surface) < 3))
+    scale = 1;
+  // Buffer scale is integer, fractional one is rounded up, so compositor
+  // scales frames down instead of blurring them
+  else if (!win->wp_viewport)
+    scale = ceilf(scale);
+  win->scale = scale;
+  // Lowered resolution is scaled up by viewport
+  if (!win->app->dynamic_resolution || win->video || !win->wp_viewport)
+    win->render_scale = 1;
+  else
+    scale *= win->render_scale;
+  // Rounded halfway away from zero, as fractional scale protocol requires
+  uint32_t width = (uint32_t)(win->width * scale + 0.5f);
+  uint32_t height = (uint32_t)(win->height * scale + 0.5f);
+  if (width == 0)
+    width = 1;
+  if (height == 0)
+    height = 1;
+  if (win->buffer_width == width && win->buffer_height == height)
+    return;
+  win->buffer_width = width;
+  win->buffer_height = height;
+  if (win->egl_window)
+    wl_egl_window_resize(win->egl_window, width, height, 0, 0);
+  else if (win->gl_renderbuffer) {
+    // Headless framebuffer is reallocated in place
+    glBindRenderbuffer(GL_RENDERBUFFER, win->gl_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  }
+  SWCL_LOG_DEBUG("Window with id=%d has scale %.3f, buffer size %dx%d",
+                 win->id, scale, width, height);
+  swcl_window_queue_redraw(win);
+}
+
+// Send surface size of the frame with viewport, or its integer scale if
+// there is no viewporter. Must be called before surface commit.
+static inline void __swcl_window_commit_scale(SWCLWindow *win) {
+  if (win->wp_viewport) {
+    if (win->viewport_width == win->width &&
+        win->viewport_height == win->height)
+      return;
+    wp_viewport_set_destination(win->wp_viewport, win->width, win->height);
+    win->viewport_width = win->width;
+    win->viewport_height = win->height;
+    return;
+  }
+  int32_t buffer_scale = (int32_t)ceilf(win->scale);
+  if (buffer_scale == win->buffer_scale)
+    return;
+  wl_surface_set_buffer_scale(win->wl_surface, buffer_scale);
+  win->buffer_scale = buffer_scale;
+}
+
+// Adjust render scale of the window to GPU time of its frame. Pixels to
+// render grow with square of scale, so scale changes with square root of
+// time ratio, aiming a bit below the budget to not oscillate around it.
+static inline void __swcl_window_update_render_scale(SWCLWindow *win,
+                                                     float ms) {
+  float budget = win->app->gpu_frame_budget;
+  win->gpu_time = win->gpu_time ? win->gpu_time * 0.8f + ms * 0.2f : ms;
+  if (win->render_scale_hold) {
+    win->render_scale_hold--;
+    return;
+  }
+  float scale = win->render_scale;
+  if (win->gpu_time > budget)
+    scale *= fmaxf(sqrtf(budget * 0.9f / win->gpu_time), 0.75f);
+  else if (win->gpu_time < budget * 0.7f)
+    scale *= fminf(sqrtf(budget * 0.9f / win->gpu_time), 1.1f);
+  // Quantized, so small changes in GPU time don't resize buffers
+  scale = fminf(fmaxf(roundf(scale * 20) / 20, SWCL_MIN_RENDER_SCALE), 1);
+  if (scale == win->render_scale)
+    return;
+  // Expected time of frames at new scale until they are measured
+  win->gpu_time *= (scale * scale) / (win->render_scale * win->render_scale);
+  win->render_scale = scale;
+  win->render_scale_hold = SWCL_GPU_TIMERS;
+  SWCL_LOG_DEBUG("Window with id=%d render scale is %.2f, GPU time %.2f ms",
+                 win->id, scale, ms);
+  __swcl_window_update_scale(win);
+}
+
+// Start measuring GPU time of window frame. Timer of the previous window is
+// dropped if it was not finished with swap.
+static inline void __swcl_window_begin_gpu_timer(SWCLWindow *win) {
+  SWCLApplication *app = win->app;
+  if (app->gl_timer_window) {
+    glEndQuery(GL_TIME_ELAPSED);
+    app->gl_timer_window = NULL;
+  }
+  if (!app->dynamic_resolution || !app->gl_timer_queries || !win->wp_viewport)
+    return;
+  // All queries are in flight, this frame is not measured
+  if (win->gl_timer_count == SWCL_GPU_TIMERS)
+    return;
+  if (!win->gl_timers[0])
+    glGenQueries(SWCL_GPU_TIMERS, win->gl_timers);
+  uint32_t idx = (win->gl_timer_head + win->gl_timer_count) % SWCL_GPU_TIMERS;
+  glBeginQuery(GL_TIME_ELAPSED, win->gl_timers[idx]);
+  app->gl_timer_window = win;
+}
+
+// Finish measuring frame and collect results of frames GPU has finished
+static inline void __swcl_window_end_gpu_timer(SWCLWindow *win) {
+  SWCLApplication *app = win->app;
+  if (app->gl_timer_window == win) {
+    glEndQuery(GL_TIME_ELAPSED);
+    app->gl_timer_window = NULL;
+    win->gl_timer_count++;
+  }
+  while (win->gl_timer_count) {
+    GLuint query = win->gl_timers[win->gl_timer_head];
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      break;
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    win->gl_timer_head = (win->gl_timer_head + 1) % SWCL_GPU_TIMERS;
+    win->gl_timer_count--;
+    __swcl_window_update_render_scale(win, ns / 1e6f);
+  }
+}
+
+// Listen for scale of the window surface. Fractional scale is used only with
+// viewporter, which sets surface size independently of buffer size.
+static inline void __swcl_window_init_scaling(SWCLWindow *win) {
+  SWCLApplication *app = win->app;
+  win->outputs = swcl_array_new(1);
+  win->buffer_scale = 1;
+  win->render_scale = 1;
+  wl_surface_add_listener(win->wl_surface, &wl_surface_listener, win);
+  if (app->renderer != SWCL_RENDERER_SOFTWARE && app->wp_viewporter) {
+    win->wp_viewport =
+        wp_viewporter_get_viewport(app->wp_viewporter, win->wl_surface);
+    SWCL_LIVE_INC(wp_viewports);
+    if (app->wp_fractional_scale_manager) {
+      win->wp_fractional_scale =
+          wp_fractional_scale_manager_v1_get_fractional_scale(
+              app->wp_fractional_scale_manager, win->wl_surface);
+      SWCL_LIVE_INC(wp_fractional_scales);
+      wp_fractional_scale_v1_add_listener(
+          win->wp_fractional_scale, &wp_fractional_scale_v1_listener, win);
+    }
+  }
+  __swcl_window_update_scale(win);
+}
+
+// Create EGL window and surface for wl_surface of the window. Software
+// rendered windows don't need them.
+static inline void __swcl_window_init_egl(SWCLWindow *win) {
+  SWCLApplication *app = win->app;
+  if (app->renderer == SWCL_RENDERER_SOFTWARE)
+    return;
+
+  // Create EGL window
+  win->egl_window = wl_egl_window_create(win->wl_surface, win->buffer_width,
+                                         win->buffer_height);
+  SWCL_LIVE_INC(wl_egl_windows);
+
+  // Create EGL surface
+  win->egl_surface =
+      eglCreateWindowSurface(app->egl_display, app->egl_config,
+                             (EGLNativeWindowType)win->egl_window, NULL);
+  if (win->egl_surface == EGL_NO_SURFACE)
+    SWCL_PANIC("Failed to create EGL surface");
+  else
+    SWCL_LOG_DEBUG("Created EGL surface");
+  SWCL_LIVE_INC(egl_surfaces);
+}
+
+static inline SWCLWindow *swcl_window_new(SWCLApplication *app, char *title,
+                                          uint16_t width, uint16_t height,
+                                          uint16_t min_width,
+                                          uint16_t min_height, bool maximized,
+                                          bool fullscreen,
+                                          void (*draw_func)(SWCLWindow *win)) {
+
+  SWCL_TRACE_BEGIN("swcl_window_new");
+  SWCLWindow *win = SWCL_ALLOC(SWCLWindow);
+  SWCL_LIVE_INC(windows);
+
+  win->id = swcl_generate_id();
+  win->width = width;
+  win->height = height;
+  win->min_width = min_width;
+  win->min_height = min_height;
+  win->maximized = maximized;
+  win->fullscreen = fullscreen;
+  win->title = title;
+  win->decoration_mode = SWCL_DECORATION_CLIENT_SIDE;
+  win->on_draw_cb = draw_func;
+  win->app = app;
+  __swcl_window_update_projection(win);
+
+  SWCL_LOG_DEBUG("Create new window with id: %d, width: %d, height: %d",
+                 win->id, win->width, win->height);
+
+  if (app->headless) {
+    __swcl_window_update_scale(win);
+    __swcl_window_init_framebuffer(win);
+    swcl_array_append(&app->windows, win);
+    SWCL_TRACE_END("swcl_window_new");
+    return win;
+  }
+
+  // Get wl_surface
+  if (!app->wl_compositor)
+    SWCL_PANIC("Failed to get wl_compositor");
+
+  win->wl_surface = wl_compositor_create_surface(app->wl_compositor);
+  if (!win->wl_surface)
+    SWCL_PANIC("Failed to get wl_surface");
+  else
+    SWCL_LOG_DEBUG("Got wl_surface");
+  SWCL_LIVE_INC(wl_surfaces);
+  __swcl_window_init_scaling(win);
+
+  // Get wl_callback for surface frame
+  win->wl_callback = wl_surface_frame(win->wl_surface);
+  if (!win->wl_callback)
+    SWCL_PANIC("Failed to get wl_callback");
+  else {
+    SWCL_LOG_DEBUG("Got wl_callback");
+    SWCL_LIVE_INC(wl_callbacks);
+    wl_callback_add_listener(win->wl_callback, &wl_callback_listener, win);
+    SWCL_TRACE_BEGIN("wl_display_roundtrip");
+    wl_display_roundtrip(app->wl_display);
+    SWCL_TRACE_END("wl_display_roundtrip");
+  }
+
+  // Get xdg_surface
+  win->xdg_surface =
+      xdg_wm_base_get_xdg_surface(app->xdg_wm_base, win->wl_surface);
+  if (!win->xdg_surface)
+    SWCL_PANIC("Failed to get xdg_surface");
+  else {
+    SWCL_LOG_DEBUG("Got xdg_surface");
+    SWCL_LIVE_INC(xdg_surfaces);
+    xdg_surface_add_listener(win->xdg_surface, &xdg_surface_listener, win);
+  }
+
+  // Get xdg_toplevel
+  win->xdg_toplevel = xdg_surface_get_toplevel(win->xdg_surface);
+  if (!win->xdg_toplevel)
+    SWCL_PANIC("Failed to get xdg_toplevel");
+  else {
+    SWCL_LOG_DEBUG("Got xdg_toplevel");
+    SWCL_LIVE_INC(xdg_toplevels);
+    xdg_toplevel_add_listener(win->xdg_toplevel, &xdg_toplevel_listener, win);
+    // Decoration object can't be created after the first buffer is attached,
+    // so it's created for every toplevel. No mode is requested, compositor
+    // configures the one it prefers and it's reported like requested ones.
+    if (app->xdg_decoration_manager) {
+      win->xdg_decoration =
+          zxdg_decoration_manager_v1_get_toplevel_decoration(
+              app->xdg_decoration_manager, win->xdg_toplevel);
+      SWCL_LIVE_INC(xdg_decorations);
+      zxdg_toplevel_decoration_v1_add_listener(
+          win->xdg_decoration, &xdg_toplevel_decoration_listener, win);
+    }
+    SWCL_TRACE_BEGIN("wl_display_roundtrip");
+    wl_display_roundtrip(app->wl_display);
+    SWCL_TRACE_END("wl_display_roundtrip");
+  }
+
+  __swcl_window_init_egl(win);
+
+  // Setup xdg_toplevel
+  xdg_toplevel_set_app_id(win->xdg_toplevel, app->app_id);
+  if (win->title)
+    xdg_toplevel_set_title(win->xdg_toplevel, win->title);
+  if (win->min_height && win->min_width)
+    xdg_toplevel_set_min_size(win->xdg_toplevel, win->min_width,
+                              win->min_height);
+  if (win->maximized)
+    xdg_toplevel_set_maximized(win->xdg_toplevel);
+  else
+    xdg_toplevel_unset_maximized(win->xdg_toplevel);
+
+  if (win->fullscreen)
+    xdg_toplevel_set_fullscreen(win->xdg_toplevel, NULL);
+  else
+    xdg_toplevel_unset_fullscreen(win->xdg_toplevel);
+
+  swcl_array_append(&app->windows, win);
+  SWCL_LOG_DEBUG("Created window with id=%d, at %p", win->id, win);
+  SWCL_TRACE_END("swcl_window_new");
+  return win;
+}
+
+static inline void swcl_window_show(SWCLWindow *win) {
+  win->mapped = true;
+  if (win->csd)
+    __swcl_csd_update(win);
+  __swcl_window_make_current(win);
+  // Changes applied before drawing are in this frame
+  win->redraw_queued = false;
+  SWCL_TRACE_BEGIN("on_draw_cb");
+  win->on_draw_cb(win);
+  SWCL_TRACE_END("on_draw_cb");
+}
+
+// Request frame callback and commit surface, so compositor sends it with its
+// next frame
+static inline void __swcl_window_request_frame(SWCLWindow *win) {
+  win->wl_callback = wl_surface_frame(win->wl_surface);
+  if (!win->wl_callback)
+    SWCL_PANIC("Failed to get wl_callback");
+  SWCL_LIVE_INC(wl_callbacks);
+  wl_callback_add_listener(win->wl_callback, &wl_callback_listener, win);
+  wl_surface_commit(win->wl_surface);
+}
+
+// Draw first frame of popup or layer surface that was configured for the
+// first time. Frame callback is requested before, so it's committed with the
+// frame.
+static inline void __swcl_window_map(SWCLWindow *win) {
+  SWCL_TRACE_BEGIN("__swcl_window_map");
+  if (!win->wl_callback) {
+    win->wl_callback = wl_surface_frame(win->wl_surface);
+    if (!win->wl_callback)
+      SWCL_PANIC("Failed to get wl_callback");
+    SWCL_LIVE_INC(wl_callbacks);
+    wl_callback_add_listener(win->wl_callback, &wl_callback_listener, win);
+  }
+  swcl_window_show(win);
+  SWCL_TRACE_END("__swcl_window_map");
+}
+
+static inline void swcl_window_queue_redraw(SWCLWindow *win) {
+  if (!win->redraw_on_demand || win->redraw_queued)
+    return;
+  win->redraw_queued = true;
+  // Frame is drawn when pending frame callback comes, or when window is
+  // mapped. Headless windows are drawn by application loop.
+  if (win->wl_callback || !win->mapped || !win->wl_surface)
+    return;
+  __swcl_window_request_frame(win);
+}
+
+static inline void swcl_window_set_redraw_on_demand(SWCLWindow *win,
+                                                    bool on_demand) {
+  win->redraw_on_demand = on_demand;
+  win->redraw_queued = false;
+  // Idle window starts drawing continuously again
+  if (!on_demand && !win->wl_callback && win->mapped && win->wl_surface)
+    __swcl_window_request_frame(win);
+}
+
+// Delete OpenGL objects of the window and its EGL surface. Context is left
+// current without surface if window was current.
+static inline void __swcl_window_release_gl(SWCLWindow *win) {
+  SWCLApplication *app = win->app;
+  if (__swcl_gl_window == win) {
+    __swcl_gl_flush(app);
+    __swcl_gl_window = NULL;
+  }
+  if (app->gl_timer_window == win) {
+    glEndQuery(GL_TIME_ELAPSED);
+    app->gl_timer_window = NULL;
+  }
+  if (win->gl_timers[0])
+    glDeleteQueries(SWCL_GPU_TIMERS, win->gl_timers);
+  if (win->gl_framebuffer) {
+    if (app->gl_state.framebuffer == win->gl_framebuffer)
+      __swcl_gl_bind_framebuffer(app, 0);
+    glDeleteFramebuffers(1, &win->gl_framebuffer);
+    glDeleteRenderbuffers(1, &win->gl_renderbuffer);
+    // Pending readbacks are dropped
+    for (uint32_t i = 0; i < SWCL_READBACK_BUFFERS; i++) {
+      if (win->readbacks[i].fence)
+        glDeleteSync(win->readbacks[i].fence);
+      glDeleteBuffers(1, &win->readbacks[i].pbo);
+    }
+  }
+  if (win->egl_surface) {
+    if (eglGetCurrentSurface(EGL_DRAW) == win->egl_surface)
+      eglMakeCurrent(app->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                     app->egl_context);
+    eglDestroySurface(app->egl_display, win->egl_surface);
+    SWCL_LIVE_DEC(egl_surfaces);
+  }
+  if (win->egl_window) {
+    wl_egl_window_destroy(win->egl_window);
+    SWCL_LIVE_DEC(wl_egl_windows);
+  }
+}
+
+static inline void swcl_window_destroy(SWCLWindow *win) {
+  SWCL_TRACE_BEGIN("swcl_window_destroy");
+  SWCLApplication *app = win->app;
+  // Subsurfaces and popups are destroyed before their parent
+  for (uint32_t i = 0; i < app->windows.length;) {
+    SWCLWindow *child = (SWCLWindow *)app->windows.items[i];
+    if (child->parent == win) {
+      swcl_window_destroy(child);
+      i = 0;
+    } else
+      i++;
+  }
+  __swcl_seats_forget(app, win);
+  if (__swcl_sw_window == win)
+    __swcl_sw_window = NULL;
+  if (app->renderer != SWCL_RENDERER_SOFTWARE)
+    __swcl_window_release_gl(win);
+  for (uint32_t i = 0; i < SWCL_SHM_BUFFERS; i++)
+    __swcl_shm_buffer_destroy(&win->shm_buffers[i]);
+
+  // Wayland objects, surface is destroyed last
+  if (win->dmabuf_feedback) {
+    zwp_linux_dmabuf_feedback_v1_destroy(win->dmabuf_feedback);
+    SWCL_LIVE_DEC(dmabuf_feedbacks);
+  }
+  __swcl_dmabuf_feedback_free(&win->feedback);
+  if (win->wp_fractional_scale) {
+    wp_fractional_scale_v1_destroy(win->wp_fractional_scale);
+    SWCL_LIVE_DEC(wp_fractional_scales);
+  }
+  if (win->wp_viewport) {
+    wp_viewport_destroy(win->wp_viewport);
+    SWCL_LIVE_DEC(wp_viewports);
+  }
+  if (win->wl_callback) {
+    wl_callback_destroy(win->wl_callback);
+    SWCL_LIVE_DEC(wl_callbacks);
+  }
+  // Decoration must be destroyed before its toplevel
+  if (win->xdg_decoration) {
+    zxdg_toplevel_decoration_v1_destroy(win->xdg_decoration);
+    SWCL_LIVE_DEC(xdg_decorations);
+  }
+  if (win->xdg_toplevel) {
+    xdg_toplevel_destroy(win->xdg_toplevel);
+    SWCL_LIVE_DEC(xdg_toplevels);
+  }
+  if (win->xdg_popup) {
+    xdg_popup_destroy(win->xdg_popup);
+    SWCL_LIVE_DEC(xdg_popups);
+  }
+  if (win->xdg_surface) {
+    xdg_surface_destroy(win->xdg_surface);
+    SWCL_LIVE_DEC(xdg_surfaces);
+  }
+  if (win->layer_surface) {
+    zwlr_layer_surface_v1_destroy(win->layer_surface);
+    SWCL_LIVE_DEC(layer_surfaces);
+  }
+  if (win->wl_subsurface) {
+    wl_subsurface_destroy(win->wl_subsurface);
+    SWCL_LIVE_DEC(wl_subsurfaces);
+  }
+  if (win->wl_surface) {
+    wl_surface_destroy(win->wl_surface);
+    SWCL_LIVE_DEC(wl_surfaces);
+  }
+
+  free(win->outputs.items);
+  free(win->commands);
+  __swcl_sw_free_snapshots(win);
+  free(win->texture_snapshots.items);
+  free(win->tile_offsets);
+  free(win->tile_commands);
+  swcl_array_remove(&app->windows, win);
+  // Window disappears right away, not with the next dispatch
+  if (app->wl_display)
+    wl_display_flush(app->wl_display);
+  SWCL_LOG_DEBUG("Destroyed window with id=%d", win->id);
+  free(win);
+  SWCL_LIVE_DEC(windows);
+  SWCL_TRACE_END("swcl_window_destroy");
+}
+
+static inline void __swcl_window_make_current(SWCLWindow *win) {
+  __swcl_window_apply_configure(win);
+  // Nothing is drawn on video surfaces
+  if (win->video)
+    return;
+  if (win->app->renderer == SWCL_RENDERER_SOFTWARE) {
+    __swcl_sw_window = win;
+    return;
+  }
+  __swcl_sw_window = NULL;
+  // Draws of previous window must reach its surface
+  __swcl_gl_flush(win->app);
+  __swcl_gl_window = win;
+  if (win->app->headless)
+    __swcl_gl_bind_framebuffer(win->app, win->gl_framebuffer);
+  else if (eglMakeCurrent(win->app->egl_display, win->egl_surface,
+                          win->egl_surface,
+                          win->app->egl_context) == EGL_FALSE)
+    SWCL_PANIC("Failed to make egl_surface current");
+  if (!win->app->gl_program)
+    __swcl_application_init_gl(win->app);
+  // Context is shared by windows, so their viewport and projection are set
+  // every time window becomes current
+  __swcl_gl_set_viewport(win->app, 0, 0, win->buffer_width,
+                         win->buffer_height);
+  glUniformMatrix4fv(win->app->gl_projection_location, 1, GL_FALSE,
+                     win->projection);
+  __swcl_window_begin_gpu_timer(win);
+}
+
+static inline void swcl_window_drag(SWCLWindow *win) {
+  SWCLSeat *seat = win->app->current_seat;
+  if (!win->app->headless && seat)
+    xdg_toplevel_move(win->xdg_toplevel, seat->wl_seat,
+                      seat->wl_pointer_serial);
+}
+
+static inline void swcl_window_resize(SWCLWindow *win, SWCLWindowEdge edge) {
+  SWCLSeat *seat = win->app->current_seat;
+  if (!win->app->headless && seat)
+    xdg_toplevel_resize(win->xdg_toplevel, seat->wl_seat,
+                        seat->wl_pointer_serial, edge);
+}
+
+static inline void swcl_window_swap_buffers(SWCLWindow *win) {
+  SWCLApplication *app = win->app;
+  if (win->video) {
+    SWCL_LOG("Video surfaces are shown with 'swcl_video_surface_present'");
+    return;
+  }
+  if (app->renderer == SWCL_RENDERER_SOFTWARE) {
+    win->shm_current = __swcl_window_acquire_shm_buffer(win);
+    __swcl_sw_render(win, win->shm_current->data, win->shm_current->width,
+                     win->shm_current->height);
+  } else
+    __swcl_gl_flush(app);
+#ifdef SWCL_ENABLE_TEXT
+  // Glyphs of this frame are drawn, so they can be evicted now
+  __swcl_glyph_atlas_next_frame();
+#endif
+  app->last_stats = app->stats;
+  memset(&app->stats, 0, sizeof(app->stats));
+  __swcl_window_commit_opaque_region(win);
+  if (win->app->headless) {
+    while (__swcl_window_deliver_readback(win, false))
+      ;
+    glFlush();
+    return;
+  }
+  __swcl_window_commit_scale(win);
+  if (win->app->renderer == SWCL_RENDERER_SOFTWARE) {
+    SWCL_TRACE_BEGIN("wl_surface_commit");
+    wl_surface_attach(win->wl_surface, win->shm_current->wl_buffer, 0, 0);
+    wl_surface_damage(win->wl_surface, 0, 0, win->width, win->height);
+    wl_surface_commit(win->wl_surface);
+    win->shm_current->busy = true;
+    SWCL_TRACE_END("wl_surface_commit");
+  } else {
+    __swcl_window_end_gpu_timer(win);
+    SWCL_TRACE_BEGIN("eglSwapBuffers");
+    eglSwapBuffers(win->app->egl_display, win->egl_surface);
+    SWCL_TRACE_END("eglSwapBuffers");
+  }
+  // Done here rather than after draw callback, which may destroy the window
+  if (win->csd)
+    __swcl_csd_update_done(win);
+}
+
+static inline void swcl_window_read_pixels_async(SWCLWindow *win,
+                                                 SWCLPixelsCallback cb,
+                                                 void *user_data) {
+  if (!win->app->headless) {
+    SWCL_LOG("Pixels readback is only supported in headless mode");
+    return;
+  }
+  __swcl_gl_flush(win->app);
+  // All buffers are in flight - wait for the oldest one
+  if (win->readback_count == SWCL_READBACK_BUFFERS)
+    __swcl_window_deliver_readback(win, true);
+  SWCLReadback *rb = &win->readbacks[win->readback_head];
+  rb->width = win->width;
+  rb->height = win->height;
+  rb->cb = cb;
+  rb->user_data = user_data;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+  glBufferData(GL_PIXEL_PACK_BUFFER, rb->width * rb->height * 4, NULL,
+               GL_STREAM_READ);
+  glReadPixels(0, 0, rb->width, rb->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  rb->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  win->readback_head = (win->readback_head + 1) % SWCL_READBACK_BUFFERS;
+  win->readback_count++;
+}
+
+static inline void swcl_window_flush_pixels(SWCLWindow *win) {
+  while (__swcl_window_deliver_readback(win, true))
+    ;
+}
+
+static inline void swcl_window_set_title(SWCLWindow *win, char *title) {
+  win->title = title;
+  if (win->app->headless)
+    return;
+  xdg_toplevel_set_title(win->xdg_toplevel, title);
+}
+
+static inline void swcl_window_set_maximized(SWCLWindow *win, bool maximized) {
+  win->maximized = maximized;
+  if (win->app->headless)
+    return;
+  if (maximized)
+    xdg_toplevel_set_maximized(win->xdg_toplevel);
+  else
+    xdg_toplevel_unset_maximized(win->xdg_toplevel);
+}
+
+static inline void swcl_window_minimize(SWCLWindow *win) {
+  if (win->app->headless)
+    return;
+  xdg_toplevel_set_minimized(win->xdg_toplevel);
+}
+
+static inline void swcl_window_set_min_size(SWCLWindow *win, int min_width,
+                                            int min_height) {
+  if (min_width <= 0 || min_height <= 0)
+    return;
+  win->min_width = min_width;
+  win->min_height = min_height;
+  if (win->app->headless)
+    return;
+  // Minimum size of window geometry includes title bar
+  xdg_toplevel_set_min_size(win->xdg_toplevel, min_width,
+                            min_height + __swcl_csd_top(win));
+}
+
+static inline void swcl_window_show_menu(SWCLWindow *win) {
+  SWCLSeat *seat = win->app->current_seat;
+  if (win->app->headless || !win->xdg_toplevel || !seat)
+    return;
+  // Position is relative to window geometry, which starts at title bar
+  int32_t x = seat->cursor_pos.x, y = seat->cursor_pos.y;
+  if (win->csd && seat->current_window == win->csd) {
+    x -= win->csd_shadow;
+    y -= win->csd_shadow;
+  } else
+    y += win->csd_top;
+  xdg_toplevel_show_window_menu(win->xdg_toplevel, seat->wl_seat,
+                                seat->wl_pointer_serial, x, y);
+}
+
+static inline bool swcl_window_request_ssr(SWCLWindow *win) {
+  if (!win->xdg_decoration) {
+    SWCL_LOG("Compositor is not supporting xdg_decoration");
+    return false;
+  }
+  zxdg_toplevel_decoration_v1_set_mode(
+      win->xdg_decoration, ZXDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE);
+  return true;
+}
+
+// ---------- SUBSURFACE METHODS ---------- //
+
+static inline SWCLWindow *swcl_subsurface_new(SWCLWindow *parent, int32_t x,
+                                              int32_t y, uint16_t width,
+                                              uint16_t height,
+                                              void (*draw_func)(SWCLWindow *)) {
+  SWCL_TRACE_BEGIN("swcl_subsurface_new");
+  SWCLApplication *app = parent->app;
+  SWCLWindow *win = SWCL_ALLOC(SWCLWindow);
+  SWCL_LIVE_INC(windows);
+  win->id = swcl_generate_id();
+  win->width = width;
+  win->height = height;
+  win->on_draw_cb = draw_func;
+  win->app = app;
+  win->parent = parent;
+  win->x = x;
+  win->y = y;
+  __swcl_window_update_projection(win);
+
+  SWCL_LOG_DEBUG("Create new subsurface with id: %d, width: %d, height: %d",
+                 win->id, win->width, win->height);
+
+  // Headless subsurfaces are offscreen windows, nothing composes them
+  if (app->headless) {
+    __swcl_window_update_scale(win);
+    __swcl_window_init_framebuffer(win);
+    swcl_array_append(&app->windows, win);
+    SWCL_TRACE_END("swcl_subsurface_new");
+    return win;
+  }
+
+  if (!app->wl_subcompositor)
+    SWCL_PANIC("Failed to get wl_subcompositor");
+
+  win->wl_surface = wl_compositor_create_surface(app->wl_compositor);
+  if (!win->wl_surface)
+    SWCL_PANIC("Failed to get wl_surface");
+  SWCL_LIVE_INC(wl_surfaces);
+  win->wl_subsurface = wl_subcompositor_get_subsurface(
+      app->wl_subcompositor, win->wl_surface, parent->wl_surface);
+  if (!win->wl_subsurface)
+    SWCL_PANIC("Failed to get wl_subsurface");
+  SWCL_LIVE_INC(wl_subsurfaces);
+  __swcl_window_init_scaling(win);
+  wl_subsurface_set_position(win->wl_subsurface, x, y);
+  wl_subsurface_set_desync(win->wl_subsurface);
+
+  // Empty input region passes all input to the surfaces below
+  struct wl_region *region = wl_compositor_create_region(app->wl_compositor);
+  wl_surface_set_input_region(win->wl_surface, region);
+  wl_region_destroy(region);
+
+  // Frame callbacks of subsurface drive its own drawing
+  win->wl_callback = wl_surface_frame(win->wl_surface);
+  if (!win->wl_callback)
+    SWCL_PANIC("Failed to get wl_callback");
+  SWCL_LIVE_INC(wl_callbacks);
+  wl_callback_add_listener(win->wl_callback, &wl_callback_listener, win);
+
+  __swcl_window_init_egl(win);
+  swcl_array_append(&app->windows, win);
+  SWCL_LOG_DEBUG("Created subsurface with id=%d, at %p", win->id, win);
+  SWCL_TRACE_END("swcl_subsurface_new");
+  return win;
+}
+
+static inline void swcl_subsurface_set_position(SWCLWindow *sub, int32_t x,
+                                                int32_t y) {
+  sub->x = x;
+  sub->y = y;
+  if (sub->wl_subsurface)
+    wl_subsurface_set_position(sub->wl_subsurface, x, y);
+}
+
+static inline void swcl_subsurface_place_above(SWCLWindow *sub,
+                                               SWCLWindow *sibling) {
+  if (sub->wl_subsurface)
+    wl_subsurface_place_above(sub->wl_subsurface, sibling->wl_surface);
+}
+
+static inline void swcl_subsurface_place_below(SWCLWindow *sub,
+                                               SWCLWindow *sibling) {
+  if (sub->wl_subsurface)
+    wl_subsurface_place_below(sub->wl_subsurface, sibling->wl_surface);
+}
+
+static inline void swcl_subsurface_set_sync(SWCLWindow *sub, bool sync) {
+  sub->sync = sync;
+  if (!sub->wl_subsurface)
+    return;
+  if (sync)
+    wl_subsurface_set_sync(sub->wl_subsurface);
+  else
+    wl_subsurface_set_desync(sub->wl_subsurface);
+}
+
+// ---------- CLIENT-SIDE DECORATIONS ---------- //
+
+// Window decorations belong to, if window is decorations subsurface
+static inline SWCLWindow *__swcl_csd_owner(SWCLWindow *win) {
+  return win && win->parent && win->parent->csd == win ? win->parent : NULL;
+}
+
+static inline uint32_t __swcl_csd_top(SWCLWindow *win) {
+  if (!win->csd || win->fullscreen ||
+      win->decoration_mode == SWCL_DECORATION_SERVER_SIDE)
+    return 0;
+  return SWCL_CSD_TITLE_BAR_HEIGHT;
+}
+
+// Part of decorations at the point of decorations surface. Used only to fill
+// decorations map.
+static inline uint8_t __swcl_csd_classify(SWCLWindow *win, int32_t x,
+                                          int32_t y) {
+  int32_t s = win->csd_shadow, t = win->csd_top;
+  int32_t w = win->csd->width, h = win->csd->height;
+  // Resize borders are in the shadow, corners reach further along the edges
+  bool top = y < s, bottom = !top && y >= h - s;
+  bool left = x < s, right = !left && x >= w - s;
+  if (top || bottom) {
+    left = x < s * 2;
+    right = !left && x >= w - s * 2;
+  }
+  if (left || right) {
+    top = y < s * 2;
+    bottom = !top && y >= h - s * 2;
+  }
+  if (top || bottom || left || right)
+    return top * SWCL_WINDOW_EDGE_TOP | bottom * SWCL_WINDOW_EDGE_BOTTOM |
+           left * SWCL_WINDOW_EDGE_LEFT | right * SWCL_WINDOW_EDGE_RIGHT;
+  if (y >= s + t)
+    return SWCL_CSD_REGION_NONE;
+  // Buttons are squares at the right end of title bar
+  switch ((w - s - 1 - x) / t) {
+  case 0:
+    return SWCL_CSD_REGION_CLOSE;
+  case 1:
+    return SWCL_CSD_REGION_MAXIMIZE;
+  case 2:
+    return SWCL_CSD_REGION_MINIMIZE;
+  default:
+    return SWCL_CSD_REGION_TITLE_BAR;
+  }
+}
+
+// Sort borders between parts of decorations into cell starts, dropping
+// duplicates and ones outside of [0, end)
+static inline uint8_t __swcl_csd_cuts(int32_t *cuts, const int32_t *points,
+                                      uint32_t length, int32_t end) {
+  uint8_t n = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    int32_t p = points[i];
+    bool found = p < 0 || p >= end;
+    for (uint8_t j = 0; j < n && !found; j++)
+      found = cuts[j] == p;
+    if (found)
+      continue;
+    uint8_t j = n++;
+    for (; j > 0 && cuts[j - 1] > p; j--)
+      cuts[j] = cuts[j - 1];
+    cuts[j] = p;
+  }
+  return n;
+}
+
+static inline void __swcl_csd_build_map(SWCLWindow *win) {
+  SWCLCSDMap *map = &win->csd_map;
+  int32_t s = win->csd_shadow, t = win->csd_top;
+  int32_t w = win->csd->width, h = win->csd->height;
+  const int32_t xs[] = {0,         s,         s * 2,     w - s - t * 3,
+                        w - s - t * 2, w - s - t, w - s * 2, w - s};
+  const int32_t ys[] = {0, s, s * 2, s + t, h - s * 2, h - s};
+  map->xs_length = __swcl_csd_cuts(map->xs, xs, 8, w);
+  map->ys_length = __swcl_csd_cuts(map->ys, ys, 6, h);
+  for (uint8_t j = 0; j < map->ys_length; j++)
+    for (uint8_t i = 0; i < map->xs_length; i++)
+      map->cells[j][i] = __swcl_csd_classify(win, map->xs[i], map->ys[j]);
+}
+
+// Part of decorations under the pointer
+static inline uint8_t __swcl_csd_hit(SWCLWindow *win, int32_t x, int32_t y) {
+  const SWCLCSDMap *map = &win->csd_map;
+  uint8_t i = 0, j = 0;
+  while (i + 1 < map->xs_length && x >= map->xs[i + 1])
+    i++;
+  while (j + 1 < map->ys_length && y >= map->ys[j + 1])
+    j++;
+  return map->cells[j][i];
+}
+
+static inline const char *__swcl_csd_cursor(uint8_t region) {
+  switch (region) {
+  case SWCL_WINDOW_EDGE_TOP:
+    return "top_side";
+  case SWCL_WINDOW_EDGE_BOTTOM:
+    return "bottom_side";
+  case SWCL_WINDOW_EDGE_LEFT:
+    return "left_side";
+  case SWCL_WINDOW_EDGE_RIGHT:
+    return "right_side";
+  case SWCL_WINDOW_EDGE_TOP_LEFT:
+    return "top_left_corner";
+  case SWCL_WINDOW_EDGE_TOP_RIGHT:
+    return "top_right_corner";
+  case SWCL_WINDOW_EDGE_BOTTOM_LEFT:
+    return "bottom_left_corner";
+  case SWCL_WINDOW_EDGE_BOTTOM_RIGHT:
+    return "bottom_right_corner";
+  default:
+    return "left_ptr";
+  }
+}
+
+// Place decorations around window content of its current size and state.
+// Called when configure is applied, does nothing if layout didn't change.
+static inline void __swcl_csd_layout(SWCLWindow *win) {
+  SWCLWindow *chrome = win->csd;
+  uint32_t t = __swcl_csd_top(win);
+  uint32_t s = t && !win->maximized ? SWCL_CSD_SHADOW : 0;
+  uint32_t width = win->width + s * 2;
+  uint32_t height = win->height + t + s * 2;
+  if (win->csd_map.xs_length && t == win->csd_top && s == win->csd_shadow &&
+      chrome->width == width && chrome->height == height)
+    return;
+  win->csd_top = t;
+  win->csd_shadow = s;
+  // Shadow is outside of window geometry, so compositor doesn't count it
+  // when placing, snapping or maximizing window
+  if (win->xdg_surface)
+    xdg_surface_set_window_geometry(win->xdg_surface, 0, -(int32_t)t,
+                                    win->width, win->height + t);
+  if (!t) {
+    win->csd_map.xs_length = 0;
+    chrome->redraw_queued = false;
+    if (chrome->mapped && chrome->wl_surface) {
+      wl_surface_attach(chrome->wl_surface, NULL, 0, 0);
+      wl_surface_commit(chrome->wl_surface);
     }
+    chrome->mapped = false;
+    return;
   }
-};
+  if (chrome->width != width || chrome->height != height) {
+    chrome->width = width;
+    chrome->height = height;
+    __swcl_window_update_projection(chrome);
+    __swcl_window_update_scale(chrome);
+  }
+  swcl_subsurface_set_position(chrome, -(int32_t)s, -(int32_t)(s + t));
+  __swcl_csd_build_map(win);
+  // Drawn right before the window, see '__swcl_csd_update'
+  chrome->redraw_queued = true;
+}
 
-static inline void on_wl_pointer_leave(void *data, struct wl_pointer *pointer,
-                                       uint32_t serial,
-                                       struct wl_surface *surface) {
-  SWCLApplication *app = (SWCLApplication *)data;
-  if (app->on_pointer_leave_cb)
-    app->on_pointer_leave_cb(app->current_window);
-  app->wl_pointer_serial = serial;
-};
+// Draw shadow and title bar with buttons. Window content covers the rest.
+static inline void __swcl_csd_draw(SWCLWindow *chrome) {
+  SWCLWindow *win = chrome->parent;
+  uint32_t s = win->csd_shadow, t = win->csd_top;
+  uint32_t radius = win->maximized ? 0 : 8;
+  swcl_clear_background((SWCLColor){0, 0, 0, 0});
+  // Shadow fades out in layers towards the edges
+  for (uint32_t i = 4; s && i > 0; i--) {
+    uint32_t d = s * i / 4;
+    swcl_draw_rounded_rect(
+        (SWCLColor){0, 0, 0, 12},
+        (SWCLRect){s - d, s - d, win->width + d * 2, win->height + t + d * 2},
+        radius + d);
+  }
+  // Bottom of title bar goes under content, so its bottom corners are hidden
+  SWCLColor bar = win->activated ? (SWCLColor){230, 230, 230, 255}
+                                 : (SWCLColor){245, 245, 245, 255};
+  if (radius)
+    swcl_draw_rounded_rect(bar, (SWCLRect){s, s, win->width, t + radius},
+                           radius);
+  else
+    swcl_draw_rect(bar, (SWCLRect){s, s, win->width, t});
+  // Close, maximize and minimize buttons from the right
+  const SWCLColor colors[] = {
+      {208, 114, 119, 255}, {210, 183, 126, 255}, {154, 184, 123, 255}};
+  for (uint32_t i = 0; i < 3; i++) {
+    SWCLCircle c = {s + win->width - t * i - t / 2, s + t / 2, t / 4};
+    if (win->csd_hovered == SWCL_CSD_REGION_CLOSE + i)
+      swcl_draw_circle((SWCLColor){0, 0, 0, 40},
+                       (SWCLCircle){c.cx, c.cy, c.r + 4});
+    swcl_draw_circle(win->activated ? colors[i]
+                                    : (SWCLColor){190, 190, 190, 255},
+                     c);
+  }
+  swcl_window_swap_buffers(chrome);
+}
 
-static inline void on_wl_pointer_motion(void *data, struct wl_pointer *pointer,
-                                        uint32_t time, wl_fixed_t x,
-                                        wl_fixed_t y) {
-  SWCLApplication *app = (SWCLApplication *)data;
-  app->cursor_pos.x = wl_fixed_to_int(x);
-  app->cursor_pos.y = wl_fixed_to_int(y);
-  if (app->on_pointer_motion_cb)
-    app->on_pointer_motion_cb(app->current_window, app->cursor_pos.x,
-                              app->cursor_pos.y);
-};
+// Apply configure of the window and redraw its decorations if needed before
+// window content. Decorations are synchronized with the window for this
+// frame, so new size of both is shown by its commit.
+static inline void __swcl_csd_update(SWCLWindow *win) {
+  __swcl_window_apply_configure(win);
+  if (!win->csd->redraw_queued)
+    return;
+  swcl_subsurface_set_sync(win->csd, true);
+  swcl_window_show(win->csd);
+}
 
-static inline void on_wl_pointer_axis(void *data, struct wl_pointer *wl_pointer,
-                                      uint32_t time, uint32_t axis,
-                                      wl_fixed_t value) {
-  SWCLApplication *app = (SWCLApplication *)data;
-  if (app->on_mouse_scroll_cb)
-    app->on_mouse_scroll_cb(app->current_window,
-                            (SWCLScrollDirection)(1 ? value > 0 : 0));
+// Window is committed, decorations are redrawn on their own again, e. g.
+// when hovered button changes while window content is idle
+static inline void __swcl_csd_update_done(SWCLWindow *win) {
+  if (win->csd->sync)
+    swcl_subsurface_set_sync(win->csd, false);
+}
+
+// Update part of decorations under the pointer. Decorations are redrawn only
+// when hovered button changes.
+static inline void __swcl_csd_hover(SWCLWindow *win, SWCLSeat *seat,
+                                    uint8_t region) {
+  swcl_seat_set_cursor(seat, __swcl_csd_cursor(region), SWCL_CSD_CURSOR_SIZE);
+  if (region == win->csd_hovered)
+    return;
+  bool redraw = region >= SWCL_CSD_REGION_CLOSE ||
+                win->csd_hovered >= SWCL_CSD_REGION_CLOSE;
+  win->csd_hovered = region;
+  if (redraw)
+    swcl_window_queue_redraw(win->csd);
+}
+
+static inline bool __swcl_csd_pointer_motion(SWCLSeat *seat) {
+  SWCLWindow *win = __swcl_csd_owner(seat->current_window);
+  if (!win)
+    return false;
+  __swcl_csd_hover(win, seat,
+                   __swcl_csd_hit(win, seat->cursor_pos.x, seat->cursor_pos.y));
+  return true;
+}
+
+static inline bool __swcl_csd_pointer_leave(SWCLSeat *seat) {
+  SWCLWindow *chrome = seat->current_window;
+  SWCLWindow *win = __swcl_csd_owner(chrome);
+  if (!win)
+    return false;
+  win->csd_pressed = SWCL_CSD_REGION_NONE;
+  if (win->csd_hovered >= SWCL_CSD_REGION_CLOSE)
+    swcl_window_queue_redraw(chrome);
+  win->csd_hovered = SWCL_CSD_REGION_NONE;
+  return true;
+}
+
+static inline void __swcl_csd_click(SWCLWindow *win, uint8_t region) {
+  if (region == SWCL_CSD_REGION_CLOSE)
+    win->app->running = false;
+  else if (region == SWCL_CSD_REGION_MAXIMIZE)
+    swcl_window_set_maximized(win, !win->maximized);
+  else if (region == SWCL_CSD_REGION_MINIMIZE)
+    swcl_window_minimize(win);
+}
+
+// Title bar moves window and shows window menu, borders resize it. Buttons
+// act when released over the button they were pressed on.
+static inline bool __swcl_csd_pointer_button(SWCLSeat *seat, uint32_t button,
+                                             uint32_t state) {
+  SWCLWindow *win = __swcl_csd_owner(seat->current_window);
+  if (!win)
+    return false;
+  uint8_t region = win->csd_hovered;
+  if (state == SWCL_BUTTON_RELEASED) {
+    bool clicked = button == SWCL_MOUSE_1 && win->csd_pressed == region;
+    win->csd_pressed = SWCL_CSD_REGION_NONE;
+    if (clicked)
+      __swcl_csd_click(win, region);
+    return true;
+  }
+  if (button == SWCL_MOUSE_2 && region == SWCL_CSD_REGION_TITLE_BAR)
+    swcl_window_show_menu(win);
+  if (button != SWCL_MOUSE_1 || region == SWCL_CSD_REGION_NONE)
+    return true;
+  if (region >= SWCL_CSD_REGION_CLOSE)
+    win->csd_pressed = region;
+  else if (region == SWCL_CSD_REGION_TITLE_BAR)
+    swcl_window_drag(win);
+  else
+    swcl_window_resize(win, (SWCLWindowEdge)region);
+  return true;
+}
+
+// Touch moves or resizes window with serial of touch down. Buttons act right
+// away, as there is no hover to show which one is touched.
+static inline bool __swcl_csd_touch_down(SWCLSeat *seat, SWCLWindow *chrome,
+                                         int32_t x, int32_t y,
+                                         uint32_t serial) {
+  SWCLWindow *win = __swcl_csd_owner(chrome);
+  if (!win)
+    return false;
+  uint8_t region = __swcl_csd_hit(win, x, y);
+  if (region >= SWCL_CSD_REGION_CLOSE)
+    __swcl_csd_click(win, region);
+  else if (region == SWCL_CSD_REGION_TITLE_BAR)
+    xdg_toplevel_move(win->xdg_toplevel, seat->wl_seat, serial);
+  else if (region != SWCL_CSD_REGION_NONE)
+    xdg_toplevel_resize(win->xdg_toplevel, seat->wl_seat, serial, region);
+  return true;
+}
+
+static inline void swcl_window_enable_csd(SWCLWindow *win) {
+  if (win->csd)
+    return;
+  if (win->parent || win->layer_surface) {
+    SWCL_LOG("Only toplevel windows can have decorations");
+    return;
+  }
+  win->csd = swcl_subsurface_new(win, 0, 0, win->width, win->height,
+                                 __swcl_csd_draw);
+  swcl_window_set_redraw_on_demand(win->csd, true);
+  if (win->csd->wl_surface) {
+    // Unlike other subsurfaces, decorations take input
+    wl_surface_set_input_region(win->csd->wl_surface, NULL);
+    swcl_subsurface_place_below(win->csd, win);
+  }
+  __swcl_csd_layout(win);
+  if (win->xdg_toplevel && win->min_width && win->min_height)
+    swcl_window_set_min_size(win, win->min_width, win->min_height);
+}
+
+// ---------- LAYER SURFACE METHODS ---------- //
+
+// -------- zwlr_layer_surface_v1 events callbacks -------- //
+
+// Zero width or height means size is chosen by client. Size is applied and
+// acked with the next frame, first frame is drawn right away.
+static inline void
+on_layer_surface_configure(void *data, struct zwlr_layer_surface_v1 *surface,
+                           uint32_t serial, uint32_t width, uint32_t height) {
+  SWCL_LOG_DEBUG("zwlr_layer_surface_v1 configure. width=%d, height=%d",
+                 width, height);
+  SWCLWindow *win = (SWCLWindow *)data;
+  win->configure_width = width;
+  win->configure_height = height;
+  win->configure_serial = serial;
+  win->configure_pending = true;
+  if (!win->mapped)
+    __swcl_window_map(win);
+  else
+    swcl_window_queue_redraw(win);
+}
+
+// Surface is not shown anymore, e. g. its output was removed. It can't be
+// shown again, so it's destroyed, while other windows keep running.
+static inline void
+on_layer_surface_closed(void *data, struct zwlr_layer_surface_v1 *surface) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  if (win->app->on_layer_surface_closed_cb)
+    win->app->on_layer_surface_closed_cb(win);
+  swcl_window_destroy(win);
+}
+
+static const struct zwlr_layer_surface_v1_listener layer_surface_listener = {
+    .configure = on_layer_surface_configure,
+    .closed = on_layer_surface_closed,
 };
 
-static const struct wl_pointer_listener wl_pointer_listener = {
-    .enter = on_wl_pointer_enter,
-    .leave = on_wl_pointer_leave,
-    .motion = on_wl_pointer_motion,
-    .button = on_wl_pointer_button,
-    .axis = on_wl_pointer_axis,
+static inline SWCLWindow *
+swcl_layer_surface_new(SWCLApplication *app, SWCLLayer layer, uint32_t ancor,
+                       uint16_t width, uint16_t height,
+                       void (*draw_func)(SWCLWindow *)) {
+  if (!app->headless && !app->wlr_layer_shell) {
+    SWCL_LOG("Compositor is not supporting wlr_layer_shell");
+    return NULL;
+  }
+  SWCL_TRACE_BEGIN("swcl_layer_surface_new");
+  SWCLWindow *win = SWCL_ALLOC(SWCLWindow);
+  SWCL_LIVE_INC(windows);
+  win->id = swcl_generate_id();
+  // Stretched sides get their size from the first configure
+  win->width = width ? width : 1;
+  win->height = height ? height : 1;
+  win->on_draw_cb = draw_func;
+  win->app = app;
+  win->redraw_on_demand = true;
+  __swcl_window_update_projection(win);
+
+  SWCL_LOG_DEBUG("Create new layer surface with id: %d, width: %d, height: %d",
+                 win->id, width, height);
+
+  // Headless layer surfaces are offscreen windows drawn once
+  if (app->headless) {
+    win->redraw_queued = true;
+    __swcl_window_update_scale(win);
+    __swcl_window_init_framebuffer(win);
+    swcl_array_append(&app->windows, win);
+    SWCL_TRACE_END("swcl_layer_surface_new");
+    return win;
+  }
+
+  win->wl_surface = wl_compositor_create_surface(app->wl_compositor);
+  if (!win->wl_surface)
+    SWCL_PANIC("Failed to get wl_surface");
+  SWCL_LIVE_INC(wl_surfaces);
+  __swcl_window_init_scaling(win);
+
+  // Output is chosen by compositor
+  win->layer_surface = zwlr_layer_shell_v1_get_layer_surface(
+      app->wlr_layer_shell, win->wl_surface, NULL, layer, app->app_id);
+  if (!win->layer_surface)
+    SWCL_PANIC("Failed to get zwlr_layer_surface_v1");
+  SWCL_LIVE_INC(layer_surfaces);
+  zwlr_layer_surface_v1_add_listener(win->layer_surface,
+                                     &layer_surface_listener, win);
+  zwlr_layer_surface_v1_set_size(win->layer_surface, width, height);
+  zwlr_layer_surface_v1_set_anchor(win->layer_surface, ancor);
+
+  __swcl_window_init_egl(win);
+
+  // Initial commit without buffer asks compositor for configure
+  wl_surface_commit(win->wl_surface);
+  swcl_array_append(&app->windows, win);
+  SWCL_LOG_DEBUG("Created layer surface with id=%d, at %p", win->id, win);
+  SWCL_TRACE_END("swcl_layer_surface_new");
+  return win;
+}
+
+// Layer surface state is double-buffered, so changes are committed with the
+// next frame
+static inline void swcl_window_ancor(SWCLWindow *win, uint32_t ancor) {
+  if (!win->layer_surface) {
+    SWCL_LOG("Only layer surfaces can be ancored");
+    return;
+  }
+  zwlr_layer_surface_v1_set_anchor(win->layer_surface, ancor);
+  swcl_window_queue_redraw(win);
+}
+
+static inline void swcl_layer_surface_set_exclusive_zone(SWCLWindow *win,
+                                                         int32_t zone) {
+  if (!win->layer_surface)
+    return;
+  zwlr_layer_surface_v1_set_exclusive_zone(win->layer_surface, zone);
+  swcl_window_queue_redraw(win);
+}
+
+static inline void swcl_layer_surface_set_margin(SWCLWindow *win, int32_t top,
+                                                 int32_t right, int32_t bottom,
+                                                 int32_t left) {
+  if (!win->layer_surface)
+    return;
+  zwlr_layer_surface_v1_set_margin(win->layer_surface, top, right, bottom,
+                                   left);
+  swcl_window_queue_redraw(win);
+}
+
+static inline void swcl_layer_surface_set_keyboard_interactivity(
+    SWCLWindow *win, SWCLKeyboardInteractivity interactivity) {
+  if (!win->layer_surface)
+    return;
+  // On demand focus needs version 4, exclusive is the closest before it
+  if (interactivity == SWCL_KEYBOARD_INTERACTIVITY_ON_DEMAND &&
+      zwlr_layer_surface_v1_get_version(win->layer_surface) < 4)
+    interactivity = SWCL_KEYBOARD_INTERACTIVITY_EXCLUSIVE;
+  zwlr_layer_surface_v1_set_keyboard_interactivity(win->layer_surface,
+                                                   interactivity);
+  swcl_window_queue_redraw(win);
+}
+
+static inline void swcl_layer_surface_set_layer(SWCLWindow *win,
+                                                SWCLLayer layer) {
+  if (!win->layer_surface)
+    return;
+  if (zwlr_layer_surface_v1_get_version(win->layer_surface) < 2) {
+    SWCL_LOG("Compositor can't change layer of layer surface");
+    return;
+  }
+  zwlr_layer_surface_v1_set_layer(win->layer_surface, layer);
+  swcl_window_queue_redraw(win);
+}
+
+// ---------- POPUP METHODS ---------- //
+
+// -------- xdg_popup events callbacks -------- //
+
+// Size can differ from requested one if compositor resized popup to fit on
+// output. It's applied with the first frame, like toplevel configure.
+static inline void on_xdg_popup_configure(void *data, struct xdg_popup *popup,
+                                          int32_t x, int32_t y, int32_t width,
+                                          int32_t height) {
+  SWCL_LOG_DEBUG("xdg_popup configure. x=%d, y=%d, width=%d, height=%d", x, y,
+                 width, height);
+  SWCLWindow *win = (SWCLWindow *)data;
+  win->x = x;
+  win->y = y;
+  if (width > 0 && height > 0) {
+    win->configure_width = width;
+    win->configure_height = height;
+  }
+}
+
+static inline void on_xdg_popup_done(void *data, struct xdg_popup *popup) {
+  SWCLWindow *win = (SWCLWindow *)data;
+  if (win->app->on_popup_done_cb)
+    win->app->on_popup_done_cb(win);
+  swcl_popup_close(win);
+}
+
+static inline void on_xdg_popup_repositioned(void *data,
+                                             struct xdg_popup *popup,
+                                             uint32_t token) {}
+
+static const struct xdg_popup_listener xdg_popup_listener = {
+    .configure = on_xdg_popup_configure,
+    .popup_done = on_xdg_popup_done,
+    .repositioned = on_xdg_popup_repositioned,
 };
 
-// -------- wl_keyboard events callbacks -------- //
+// Create hidden popup surface with its viewport and EGL surface. Role is
+// given to it when popup is opened. Surface can get popup role again after
+// popup is closed, so it's kept in pool and reused.
+static inline SWCLWindow *__swcl_popup_surface_new(SWCLApplication *app) {
+  SWCLWindow *win = SWCL_ALLOC(SWCLWindow);
+  SWCL_LIVE_INC(windows);
+  win->width = 1;
+  win->height = 1;
+  win->app = app;
+  if (app->headless) {
+    __swcl_window_update_scale(win);
+    __swcl_window_init_framebuffer(win);
+    return win;
+  }
+  win->wl_surface = wl_compositor_create_surface(app->wl_compositor);
+  if (!win->wl_surface)
+    SWCL_PANIC("Failed to get wl_surface");
+  SWCL_LIVE_INC(wl_surfaces);
+  __swcl_window_init_scaling(win);
+  __swcl_window_init_egl(win);
+  return win;
+}
 
-static inline void on_wl_kb_keymap(void *data, struct wl_keyboard *wl_keyboard,
-                                   uint32_t format, int32_t fd, uint32_t size) {
+// Create 'count' popup surfaces in advance
+static inline void __swcl_popup_pool_fill(SWCLApplication *app,
+                                          uint32_t count) {
+  if (!app->headless && !app->xdg_wm_base)
+    return;
+  for (uint32_t i = 0; i < count; i++)
+    swcl_array_append(&app->popup_pool, __swcl_popup_surface_new(app));
 }
 
-static inline void on_wl_kb_focus_enter_surface(void *data,
-                                                struct wl_keyboard *wl_keyboard,
-                                                uint32_t serial,
-                                                struct wl_surface *surface,
-                                                struct wl_array *key) {}
+// Send size and anchor rectangle of the next popup to positioner if they
+// differ from the previous popup
+static inline void __swcl_positioner_update(SWCLPositioner *pos,
+                                            SWCLRect anchor, uint32_t width,
+                                            uint32_t height) {
+  if (pos->width != width || pos->height != height) {
+    xdg_positioner_set_size(pos->xdg_positioner, width, height);
+    pos->width = width;
+    pos->height = height;
+  }
+  if (memcmp(&pos->anchor_rect, &anchor, sizeof(SWCLRect)) != 0) {
+    xdg_positioner_set_anchor_rect(pos->xdg_positioner, anchor.x, anchor.y,
+                                   anchor.w, anchor.h);
+    pos->anchor_rect = anchor;
+  }
+}
 
-static inline void on_wl_kb_focus_leave_surface(void *data,
-                                                struct wl_keyboard *wl_keyboard,
-                                                uint32_t serial,
-                                                struct wl_surface *surface) {}
+static inline SWCLPositioner *
+swcl_positioner_new(SWCLApplication *app, SWCLPopupEdge anchor,
+                    SWCLPopupEdge gravity, uint32_t adjust, int32_t offset_x,
+                    int32_t offset_y) {
+  SWCLPositioner *pos = SWCL_ALLOC(SWCLPositioner);
+  pos->anchor = anchor;
+  pos->gravity = gravity;
+  pos->adjust = adjust;
+  pos->offset_x = offset_x;
+  pos->offset_y = offset_y;
+  pos->app = app;
+  if (!app->xdg_wm_base)
+    return pos;
+  pos->xdg_positioner = xdg_wm_base_create_positioner(app->xdg_wm_base);
+  if (!pos->xdg_positioner)
+    SWCL_PANIC("Failed to get xdg_positioner");
+  SWCL_LIVE_INC(xdg_positioners);
+  xdg_positioner_set_anchor(pos->xdg_positioner, anchor);
+  xdg_positioner_set_gravity(pos->xdg_positioner, gravity);
+  xdg_positioner_set_constraint_adjustment(pos->xdg_positioner, adjust);
+  if (offset_x || offset_y)
+    xdg_positioner_set_offset(pos->xdg_positioner, offset_x, offset_y);
+  // Anchor rectangle is always set with the first popup
+  pos->anchor_rect.w = UINT32_MAX;
+  return pos;
+}
 
-static inline void on_wl_kb_key(void *data, struct wl_keyboard *wl_keyboard,
-                                uint32_t serial, uint32_t time, uint32_t key,
-                                uint32_t state) {
-  SWCLApplication *app = (SWCLApplication *)data;
-  if (app->on_keyboard_key_cb)
-    app->on_keyboard_key_cb(app->current_window, key, (SWCLButtonState)state);
+static inline void swcl_positioner_free(SWCLPositioner *pos) {
+  if (pos->xdg_positioner) {
+    xdg_positioner_destroy(pos->xdg_positioner);
+    SWCL_LIVE_DEC(xdg_positioners);
+  }
+  free(pos);
 }
 
-static inline void on_wl_kb_mod(void *data, struct wl_keyboard *wl_keyboard,
-                                uint32_t serial, uint32_t mods_depressed,
-                                uint32_t mods_latched, uint32_t mods_locked,
-                                uint32_t group) {
-  SWCLApplication *app = (SWCLApplication *)data;
-  if (app->on_keyboard_mod_key_cb)
-    app->on_keyboard_mod_key_cb(app->current_window, mods_depressed,
-                                mods_latched, mods_locked, group);
+static inline SWCLWindow *swcl_popup_open(SWCLWindow *parent,
+                                          SWCLPositioner *pos, SWCLRect anchor,
+                                          uint16_t width, uint16_t height,
+                                          bool grab,
+                                          void (*draw_func)(SWCLWindow *)) {
+  SWCL_TRACE_BEGIN("swcl_popup_open");
+  SWCLApplication *app = parent->app;
+  SWCLWindow *win;
+  if (app->popup_pool.length)
+    win = (SWCLWindow *)app->popup_pool.items[--app->popup_pool.length];
+  else
+    win = __swcl_popup_surface_new(app);
+  win->id = swcl_generate_id();
+  win->width = width;
+  win->height = height;
+  win->on_draw_cb = draw_func;
+  win->popup = true;
+  win->parent = parent;
+  win->x = anchor.x;
+  win->y = anchor.y;
+  __swcl_window_update_projection(win);
+  __swcl_window_update_scale(win);
+  swcl_array_append(&app->windows, win);
+
+  SWCL_LOG_DEBUG("Open popup with id: %d, width: %d, height: %d", win->id,
+                 win->width, win->height);
+
+  // Headless popups are offscreen windows, nothing places them
+  if (app->headless) {
+    SWCL_TRACE_END("swcl_popup_open");
+    return win;
+  }
+
+  // Popups of subsurfaces belong to their toplevel or popup, anchor is moved
+  // into its coordinates
+  int32_t x = anchor.x, y = anchor.y;
+  while (!parent->xdg_surface && parent->parent) {
+    x += parent->x;
+    y += parent->y;
+    parent = parent->parent;
+  }
+  // Window geometry of toplevel with decorations starts at its title bar
+  y += parent->csd_top;
+  anchor.x = x > 0 ? x : 0;
+  anchor.y = y > 0 ? y : 0;
+  __swcl_positioner_update(pos, anchor, width, height);
+
+  win->xdg_surface =
+      xdg_wm_base_get_xdg_surface(app->xdg_wm_base, win->wl_surface);
+  if (!win->xdg_surface)
+    SWCL_PANIC("Failed to get xdg_surface");
+  SWCL_LIVE_INC(xdg_surfaces);
+  xdg_surface_add_listener(win->xdg_surface, &xdg_surface_listener, win);
+  win->xdg_popup = xdg_surface_get_popup(win->xdg_surface, parent->xdg_surface,
+                                         pos->xdg_positioner);
+  if (!win->xdg_popup)
+    SWCL_PANIC("Failed to get xdg_popup");
+  SWCL_LIVE_INC(xdg_popups);
+  xdg_popup_add_listener(win->xdg_popup, &xdg_popup_listener, win);
+  if (grab && app->current_seat)
+    xdg_popup_grab(win->xdg_popup, app->current_seat->wl_seat,
+                   app->current_seat->wl_pointer_serial);
+
+  // Initial commit without buffer asks compositor for configure. Nothing
+  // waits for it here, first frame is drawn from configure event.
+  wl_surface_commit(win->wl_surface);
+  wl_display_flush(app->wl_display);
+  SWCL_LOG_DEBUG("Opened popup with id=%d, at %p", win->id, win);
+  SWCL_TRACE_END("swcl_popup_open");
+  return win;
 }
 
-static const struct wl_keyboard_listener wl_keyboard_listener = {
-    .keymap = on_wl_kb_keymap,
-    .enter = on_wl_kb_focus_enter_surface,
-    .leave = on_wl_kb_focus_leave_surface,
-    .key = on_wl_kb_key,
-    .modifiers = on_wl_kb_mod,
+static inline void swcl_popup_close(SWCLWindow *win) {
+  if (!win->popup)
+    return;
+  SWCL_TRACE_BEGIN("swcl_popup_close");
+  SWCLApplication *app = win->app;
+  // Only topmost popup can be destroyed, so popups opened from this one are
+  // closed first
+  for (uint32_t i = 0; i < app->windows.length;) {
+    SWCLWindow *child = (SWCLWindow *)app->windows.items[i];
+    if (child->parent == win) {
+      if (child->popup)
+        swcl_popup_close(child);
+      else
+        swcl_window_destroy(child);
+      i = 0;
+    } else
+      i++;
+  }
+  __swcl_seats_forget(app, win);
+  if (__swcl_sw_window == win)
+    __swcl_sw_window = NULL;
+  if (__swcl_gl_window == win) {
+    __swcl_gl_flush(app);
+    __swcl_gl_window = NULL;
+  }
+  if (app->gl_timer_window == win) {
+    glEndQuery(GL_TIME_ELAPSED);
+    app->gl_timer_window = NULL;
+  }
+
+  if (win->wl_callback) {
+    wl_callback_destroy(win->wl_callback);
+    SWCL_LIVE_DEC(wl_callbacks);
+    win->wl_callback = NULL;
+  }
+  if (win->xdg_popup) {
+    xdg_popup_destroy(win->xdg_popup);
+    SWCL_LIVE_DEC(xdg_popups);
+    win->xdg_popup = NULL;
+  }
+  if (win->xdg_surface) {
+    xdg_surface_destroy(win->xdg_surface);
+    SWCL_LIVE_DEC(xdg_surfaces);
+    win->xdg_surface = NULL;
+  }
+  // Surface without role must have no buffer to get popup role again
+  if (win->wl_surface) {
+    wl_surface_attach(win->wl_surface, NULL, 0, 0);
+    wl_surface_commit(win->wl_surface);
+    wl_display_flush(app->wl_display);
+  }
+
+  win->mapped = false;
+  win->redraw_on_demand = false;
+  win->redraw_queued = false;
+  win->configure_pending = false;
+  win->configure_width = 0;
+  win->configure_height = 0;
+  win->on_draw_cb = NULL;
+  win->popup = false;
+  win->parent = NULL;
+  swcl_array_remove(&app->windows, win);
+  swcl_array_append(&app->popup_pool, win);
+  SWCL_LOG_DEBUG("Closed popup with id=%d", win->id);
+  SWCL_TRACE_END("swcl_popup_close");
+}
+
+// ---------- VIDEO SURFACE METHODS ---------- //
+
+static inline void on_video_buffer_release(void *data,
+                                           struct wl_buffer *buffer) {
+  SWCLVideoBuffer *buf = (SWCLVideoBuffer *)data;
+  buf->busy = false;
+}
+
+static const struct wl_buffer_listener video_buffer_listener = {
+    .release = on_video_buffer_release,
 };
 
-// -------- wl_seat events callbacks -------- //
+static inline void
+on_buffer_params_created(void *data, struct zwp_linux_buffer_params_v1 *params,
+                         struct wl_buffer *buffer) {
+  SWCLVideoBuffer *buf = (SWCLVideoBuffer *)data;
+  buf->wl_buffer = buffer;
+}
+
+static inline void
+on_buffer_params_failed(void *data,
+                        struct zwp_linux_buffer_params_v1 *params) {}
 
-static inline void on_wl_seat_capabilities(void *data, struct wl_seat *seat,
-                                           uint32_t capability) {
-  SWCLApplication *app = (SWCLApplication *)data;
+static const struct zwp_linux_buffer_params_v1_listener
+    zwp_linux_buffer_params_v1_listener = {
+        .created = on_buffer_params_created,
+        .failed = on_buffer_params_failed,
+};
 
-  if ((capability & WL_SEAT_CAPABILITY_POINTER) && !app->wl_pointer) {
-    app->wl_pointer = wl_seat_get_pointer(seat);
-    if (app->wl_pointer) {
-      SWCL_LOG_DEBUG("Got pointer");
-      wl_pointer_add_listener(app->wl_pointer, &wl_pointer_listener, app);
-      wl_display_roundtrip(app->wl_display);
-    } else {
-      SWCL_LOG_DEBUG("No pointer found");
-    }
+static inline bool swcl_video_surface_init(SWCLWindow *win) {
+  SWCLApplication *app = win->app;
+  if (win->video)
+    return true;
+  if (!app->zwp_linux_dmabuf) {
+    SWCL_LOG("Compositor doesn't support zwp_linux_dmabuf_v1");
+    return false;
   }
-
-  if ((capability & WL_SEAT_CAPABILITY_KEYBOARD) && !app->wl_keyboard) {
-    app->wl_keyboard = wl_seat_get_keyboard(seat);
-    if (app->wl_keyboard) {
-      SWCL_LOG_DEBUG("Got keyboard");
-      wl_keyboard_add_listener(app->wl_keyboard, &wl_keyboard_listener, app);
-      wl_display_roundtrip(app->wl_display);
-    } else {
-      SWCL_LOG_DEBUG("No keyboard found");
+  // Buffers are attached to wl_surface directly, so renderer surfaces are
+  // not needed
+  if (app->renderer == SWCL_RENDERER_SOFTWARE) {
+    if (__swcl_sw_window == win)
+      __swcl_sw_window = NULL;
+    for (uint32_t i = 0; i < SWCL_SHM_BUFFERS; i++)
+      __swcl_shm_buffer_destroy(&win->shm_buffers[i]);
+    win->shm_current = NULL;
+  } else if (win->egl_surface) {
+    if (__swcl_gl_window == win) {
+      __swcl_gl_flush(app);
+      __swcl_gl_window = NULL;
     }
+    eglDestroySurface(app->egl_display, win->egl_surface);
+    wl_egl_window_destroy(win->egl_window);
+    SWCL_LIVE_DEC(egl_surfaces);
+    SWCL_LIVE_DEC(wl_egl_windows);
+    win->egl_surface = EGL_NO_SURFACE;
+    win->egl_window = NULL;
   }
+  win->video = true;
+  // Software rendered windows don't have viewport yet
+  if (app->wp_viewporter && !win->wp_viewport) {
+    win->wp_viewport =
+        wp_viewporter_get_viewport(app->wp_viewporter, win->wl_surface);
+    SWCL_LIVE_INC(wp_viewports);
+  } else if (!app->wp_viewporter)
+    SWCL_LOG("Compositor doesn't support wp_viewporter, video is not scaled");
+  // Buffers are scaled by compositor, so surface itself is not scaled
+  __swcl_window_update_scale(win);
+  // Surface feedback tells which formats can be scanned out where the surface
+  // is shown
+  if (app->dmabuf_feedback) {
+    win->dmabuf_feedback = zwp_linux_dmabuf_v1_get_surface_feedback(
+        app->zwp_linux_dmabuf, win->wl_surface);
+    SWCL_LIVE_INC(dmabuf_feedbacks);
+    zwp_linux_dmabuf_feedback_v1_add_listener(
+        win->dmabuf_feedback, &zwp_linux_dmabuf_feedback_v1_listener,
+        &win->feedback);
+  }
+  SWCL_LOG_DEBUG("Window with id=%d is video surface now", win->id);
+  return true;
 }
 
-static const struct wl_seat_listener wl_seat_listener = {
-    .capabilities = on_wl_seat_capabilities,
-    .name = on_wl_seat_name,
-};
+static inline const SWCLDmabufFormat *
+swcl_video_surface_formats(SWCLWindow *win, uint32_t *length) {
+  // Until surface feedback arrives, default one is used
+  SWCLDmabufFeedback *fb = win->feedback.formats_length
+                               ? &win->feedback
+                               : &win->app->dmabuf_formats;
+  *length = fb->formats_length;
+  return fb->formats;
+}
 
-// -------- wl_registry events callbacks -------- //
+static inline bool swcl_video_surface_formats_changed(SWCLWindow *win) {
+  bool changed = win->feedback.changed;
+  win->feedback.changed = false;
+  return changed;
+}
 
-static inline void on_wl_registry_global(void *data,
-                                         struct wl_registry *registry,
-                                         uint32_t id, const char *interface,
-                                         uint32_t version) {
-  SWCLApplication *app = (SWCLApplication *)data;
-  if (strcmp(interface, wl_compositor_interface.name) == 0) {
-    app->wl_compositor = (struct wl_compositor *)wl_registry_bind(
-        registry, id, &wl_compositor_interface, 1);
-    SWCL_LOG_DEBUG("Registered %s version %d", interface, 1);
-  } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
-    app->xdg_wm_base = (struct xdg_wm_base *)wl_registry_bind(
-        registry, id, &xdg_wm_base_interface, 2);
-    xdg_wm_base_add_listener(app->xdg_wm_base, &xdg_wm_base_listener, NULL);
-    SWCL_LOG_DEBUG("Registered %s version %d", interface, 2);
-  } else if (strcmp(interface, wl_seat_interface.name) == 0) {
-    app->wl_seat =
-        (struct wl_seat *)wl_registry_bind(registry, id, &wl_seat_interface, 1);
-    wl_seat_add_listener(app->wl_seat, &wl_seat_listener, app);
-    SWCL_LOG_DEBUG("Registered %s version %d", interface, 1);
-  } else if (strcmp(interface, wl_shm_interface.name) == 0) {
-    app->wl_cursor_shm =
-        (struct wl_shm *)wl_registry_bind(registry, id, &wl_shm_interface, 1);
+static inline void swcl_video_surface_set_source(SWCLWindow *win,
+                                                 SWCLRect src) {
+  win->video_source = src;
+  if (!win->wp_viewport)
+    return;
+  if (src.w == 0 || src.h == 0)
+    wp_viewport_set_source(win->wp_viewport, wl_fixed_from_int(-1),
+                           wl_fixed_from_int(-1), wl_fixed_from_int(-1),
+                           wl_fixed_from_int(-1));
+  else
+    wp_viewport_set_source(win->wp_viewport, wl_fixed_from_int(src.x),
+                           wl_fixed_from_int(src.y), wl_fixed_from_int(src.w),
+                           wl_fixed_from_int(src.h));
+}
+
+static inline void swcl_video_surface_present(SWCLWindow *win,
+                                              SWCLVideoBuffer *buf) {
+  if (!win->video) {
+    SWCL_LOG("Window with id=%d is not a video surface", win->id);
+    return;
   }
-  // else if (strcmp(interface, zwlr_layer_shell_v1_interface.name) == 0) {
-  //   app->wlr_layer_shell =
-  //       wl_registry_bind(registry, id, &zwlr_layer_shell_v1_interface, 1);
-  //   SWCL_LOG_DEBUG("Registered %s version %d", interface, 1);
-  // }
+  SWCL_TRACE_BEGIN("swcl_video_surface_present");
+  wl_surface_attach(win->wl_surface, buf->wl_buffer, 0, 0);
+  // Compositor scales buffer to window size, it's sent only when it changes
+  __swcl_window_commit_scale(win);
+  win->opaque.full = buf->opaque;
+  __swcl_window_commit_opaque_region(win);
+  wl_surface_damage(win->wl_surface, 0, 0, win->width, win->height);
+  wl_surface_commit(win->wl_surface);
+  buf->busy = true;
+  SWCL_TRACE_END("swcl_video_surface_present");
 }
 
-static inline void on_wl_registry_global_remove(void *data,
-                                                struct wl_registry *registry,
-                                                uint32_t id) {}
+static inline SWCLVideoBuffer *
+swcl_video_buffer_new(SWCLApplication *app, const SWCLDmabuf *dmabuf) {
+  if (!app->zwp_linux_dmabuf) {
+    SWCL_LOG("Compositor doesn't support zwp_linux_dmabuf_v1");
+    return NULL;
+  }
+  if (dmabuf->planes_length == 0 ||
+      dmabuf->planes_length > SWCL_DMABUF_MAX_PLANES) {
+    SWCL_LOG("Invalid number of dmabuf planes: %d", dmabuf->planes_length);
+    return NULL;
+  }
+  // Unsupported format is protocol error, so it's checked before
+  if (!__swcl_dmabuf_feedback_has(&app->dmabuf_formats, dmabuf->format,
+                                  dmabuf->modifier)) {
+    SWCL_LOG("Compositor doesn't support dmabuf format 0x%08x with modifier "
+             "0x%016llx",
+             dmabuf->format, (unsigned long long)dmabuf->modifier);
+    return NULL;
+  }
+  SWCLVideoBuffer *buf = SWCL_ALLOC(SWCLVideoBuffer);
+  buf->app = app;
+  buf->width = dmabuf->width;
+  buf->height = dmabuf->height;
+  // Formats with alpha have 'A' in the first two characters of fourcc code,
+  // e. g. AR24 or BA24
+  buf->opaque = (dmabuf->format & 0xff) != 'A' &&
+                (dmabuf->format >> 8 & 0xff) != 'A';
+  struct zwp_linux_buffer_params_v1 *params =
+      zwp_linux_dmabuf_v1_create_params(app->zwp_linux_dmabuf);
+  for (uint32_t i = 0; i < dmabuf->planes_length; i++)
+    zwp_linux_buffer_params_v1_add(params, dmabuf->planes[i].fd, i,
+                                   dmabuf->planes[i].offset,
+                                   dmabuf->planes[i].stride,
+                                   dmabuf->modifier >> 32,
+                                   dmabuf->modifier & 0xffffffff);
+  // Import failure is reported with event instead of protocol error, so
+  // wait for the result
+  zwp_linux_buffer_params_v1_add_listener(
+      params, &zwp_linux_buffer_params_v1_listener, buf);
+  zwp_linux_buffer_params_v1_create(params, dmabuf->width, dmabuf->height,
+                                    dmabuf->format, 0);
+  wl_display_roundtrip(app->wl_display);
+  zwp_linux_buffer_params_v1_destroy(params);
+  if (!buf->wl_buffer) {
+    SWCL_LOG("Compositor failed to import dmabuf");
+    free(buf);
+    return NULL;
+  }
+  wl_buffer_add_listener(buf->wl_buffer, &video_buffer_listener, buf);
+  SWCL_LIVE_INC(wl_buffers);
+  return buf;
+}
 
-static const struct wl_registry_listener wl_registry_listener = {
-    .global = on_wl_registry_global,
-    .global_remove = on_wl_registry_global_remove,
-};
+static inline void swcl_video_buffer_free(SWCLVideoBuffer *buf) {
+  wl_buffer_destroy(buf->wl_buffer);
+  SWCL_LIVE_DEC(wl_buffers);
+  free(buf);
+}
 
-// ---------- APPLICATION METHODS ---------- //
+// ------------------------------------------------------------------------- //
+//                                                                           //
+//                           DRAWING IMPLEMENTATION                          //
+//                                                                           //
+// ------------------------------------------------------------------------- //
 
-static inline SWCLApplication *swcl_application_new(SWCLConfig *cfg) {
-  SWCLApplication *app = SWCL_ALLOC(SWCLApplication);
+// Add opaque rectangle to region if it's big enough and there is room for it
+static inline void __swcl_opaque_region_add_rect(SWCLOpaqueRegion *region,
+                                                 SWCLRect rect) {
+  if (region->full || region->length == SWCL_OPAQUE_RECTS ||
+      (uint64_t)rect.w * rect.h < SWCL_OPAQUE_MIN_AREA)
+    return;
+  region->rects[region->length++] = rect;
+}
 
-  app->app_id = cfg->app_id;
-  app->running = false;
+// Update region with command drawn at offset x, y. Drawing over opaque pixels
+// leaves them opaque, so only clears can make region smaller.
+static inline void __swcl_opaque_region_add(SWCLOpaqueRegion *region,
+                                            const SWCLDrawCommand *cmd,
+                                            int32_t x, int32_t y) {
+  if (cmd->type == SWCL_DRAW_CLEAR) {
+    region->cleared = true;
+    region->full = cmd->color.a == 255;
+    region->length = 0;
+    return;
+  }
+  if (cmd->color.a < 255 ||
+      (cmd->type != SWCL_DRAW_RECT && cmd->type != SWCL_DRAW_ROUNDED_RECT))
+    return;
+  SWCLRect r = cmd->rect;
+  r.x += x;
+  r.y += y;
+  if (cmd->type == SWCL_DRAW_RECT) {
+    __swcl_opaque_region_add_rect(region, r);
+    return;
+  }
+  // Rounded rect without its corners
+  uint32_t radius = cmd->radius;
+  if (radius * 2 > r.w || radius * 2 > r.h)
+    return;
+  __swcl_opaque_region_add_rect(
+      region, (SWCLRect){r.x, r.y + radius, r.w, r.h - radius * 2});
+  __swcl_opaque_region_add_rect(region, (SWCLRect){r.x + radius, r.y,
+                                                   r.w - radius * 2, radius});
+  __swcl_opaque_region_add_rect(
+      region,
+      (SWCLRect){r.x + radius, r.y + r.h - radius, r.w - radius * 2, radius});
+}
 
-  // Set callbacks
-  app->on_pointer_enter_cb = cfg->on_pointer_enter_cb;
-  app->on_pointer_leave_cb = cfg->on_pointer_leave_cb;
-  app->on_pointer_motion_cb = cfg->on_pointer_motion_cb;
-  app->on_mouse_button_cb = cfg->on_mouse_button_cb;
-  app->on_mouse_scroll_cb = cfg->on_mouse_scroll_cb;
-  app->on_keyboard_key_cb = cfg->on_keyboard_key_cb;
-  app->on_keyboard_mod_key_cb = cfg->on_keyboard_mod_key_cb;
+// Add region of command list drawn at offset x, y
+static inline void __swcl_opaque_region_merge(SWCLOpaqueRegion *region,
+                                              const SWCLOpaqueRegion *other,
+                                              int32_t x, int32_t y) {
+  if (other->cleared) {
+    region->cleared = true;
+    region->full = other->full;
+    region->length = 0;
+  }
+  for (uint32_t i = 0; i < other->length; i++) {
+    SWCLRect r = other->rects[i];
+    r.x += x;
+    r.y += y;
+    __swcl_opaque_region_add_rect(region, r);
+  }
+}
 
-  app->wl_display = wl_display_connect(NULL);
-  if (!app->wl_display)
-    SWCL_PANIC("Failed to connect to wl_display");
-  else
-    SWCL_LOG_DEBUG("Connected to wl_display");
+// Record drawing command into command list or software renderer frame.
+// Returns false if command should be drawn with OpenGL right away.
+static inline bool __swcl_defer(SWCLDrawCommand cmd) {
+  if (__swcl_recording) {
+    __swcl_command_list_push(__swcl_recording, cmd);
+    return true;
+  }
+  SWCLWindow *win = __swcl_sw_window ? __swcl_sw_window : __swcl_gl_window;
+  if (win)
+    __swcl_opaque_region_add(&win->opaque, &cmd, 0, 0);
+  if (__swcl_sw_window) {
+    __swcl_sw_record(cmd);
+    return true;
+  }
+  return false;
+}
 
-  app->wl_registry = wl_display_get_registry(app->wl_display);
-  if (!app->wl_registry)
-    SWCL_PANIC("Failed to connect to wl_registry");
-  else
-    SWCL_LOG_DEBUG("Connected to wl_registry");
+// True if command needs blending. Glyph edges are always translucent and
+// textures can have transparent pixels.
+static inline bool __swcl_command_blends(const SWCLDrawCommand *cmd) {
+  return cmd->color.a < 255 || cmd->type == SWCL_DRAW_GLYPH ||
+         cmd->type == SWCL_DRAW_TEXTURE;
+}
 
-  wl_registry_add_listener(app->wl_registry, &wl_registry_listener, app);
-  wl_display_roundtrip(app->wl_display);
+// Texture the command is drawn with, NULL for glyph atlas
+static inline SWCLTexture *__swcl_command_texture(const SWCLDrawCommand *cmd) {
+  return cmd->type == SWCL_DRAW_TEXTURE ? cmd->texture : NULL;
+}
 
-  // Get EGLDisplay
-  app->egl_display = eglGetDisplay(app->wl_display);
-  if (app->egl_display == EGL_NO_DISPLAY)
-    SWCL_PANIC("Failed to get EGLDisplay");
-  else
-    SWCL_LOG_DEBUG("Got EGLDisplay");
+// Number of segments in full circle when tessellating
+#define SWCL_CIRCLE_SEGMENTS 100
 
-  // Init EGL
-  EGLint major, minor;
-  if (!eglInitialize(app->egl_display, &major, &minor))
-    SWCL_PANIC("Failed to init EGL");
-  else
-    SWCL_LOG_DEBUG("Initialized EGL");
+static inline void __swcl_vertex_push_uv(SWCLVertexArray *a, float x,
+                                         float y, float u, float v,
+                                         SWCLColor color) {
+  if (a->length == a->capacity) {
+    a->capacity = a->capacity ? a->capacity * 2 : 256;
+    a->items =
+        (SWCLVertex *)realloc(a->items, a->capacity * sizeof(SWCLVertex));
+  }
+  a->items[a->length++] = (SWCLVertex){x, y, u, v, color};
+}
 
-  // Bind OpenGL ES API to EGL
-  if (!eglBindAPI(EGL_OPENGL_API))
-    SWCL_PANIC("Failed to bind OpenGL to EGL");
-  else
-    SWCL_LOG_DEBUG("Binded OpenGL to EGL");
+static inline void __swcl_vertex_push(SWCLVertexArray *a, float x, float y,
+                                      SWCLColor color) {
+  __swcl_vertex_push_uv(a, x, y, 0, 0, color);
+}
 
-  const EGLint config_attrs[] = {
-      EGL_SURFACE_TYPE,
-      EGL_WINDOW_BIT,
-      EGL_RED_SIZE,
-      8,
-      EGL_GREEN_SIZE,
-      8,
-      EGL_BLUE_SIZE,
-      8,
-      EGL_ALPHA_SIZE,
-      8,
-      EGL_RENDERABLE_TYPE,
-      EGL_OPENGL_BIT,
-      EGL_SAMPLE_BUFFERS,
-      1,
-      EGL_SAMPLES,
-      4,
-      EGL_NONE,
-  };
+static inline void __swcl_tessellate_quad(SWCLVertexArray *a, float x0,
+                                          float y0, float x1, float y1,
+                                          SWCLColor color) {
+  __swcl_vertex_push(a, x0, y0, color);
+  __swcl_vertex_push(a, x1, y0, color);
+  __swcl_vertex_push(a, x1, y1, color);
+  __swcl_vertex_push(a, x0, y0, color);
+  __swcl_vertex_push(a, x1, y1, color);
+  __swcl_vertex_push(a, x0, y1, color);
+}
 
-  // Choose config
-  EGLint num;
-  if (eglChooseConfig(app->egl_display, config_attrs, &app->egl_config, 1,
-                      &num) == EGL_FALSE ||
-      num == 0) {
-    SWCL_PANIC("Failed to choose EGL config");
-  } else
-    SWCL_LOG_DEBUG("Chosen EGL config");
+// Triangle fan from the center of arc from angle a0 to a1
+static inline void __swcl_tessellate_arc(SWCLVertexArray *a, float cx,
+                                         float cy, float r, float a0, float a1,
+                                         uint32_t segments, SWCLColor color) {
+  for (uint32_t i = 0; i < segments; i++) {
+    float t0 = a0 + (a1 - a0) * i / segments;
+    float t1 = a0 + (a1 - a0) * (i + 1) / segments;
+    __swcl_vertex_push(a, cx, cy, color);
+    __swcl_vertex_push(a, cx + cosf(t0) * r, cy + sinf(t0) * r, color);
+    __swcl_vertex_push(a, cx + cosf(t1) * r, cy + sinf(t1) * r, color);
+  }
+}
 
-  // Create EGL context
-  const EGLint context_attrs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
-  app->egl_context = eglCreateContext(app->egl_display, app->egl_config,
-                                      EGL_NO_CONTEXT, context_attrs);
-  if (!app->egl_context) {
-    SWCL_PANIC("Failed to create EGL context");
-  } else
-    SWCL_LOG_DEBUG("Created EGL context");
+// Textured quad of the command with signed 'rect' and texture coordinates
+// from u0, v0 to u1, v1
+static inline void __swcl_tessellate_textured_quad(SWCLVertexArray *a,
+                                                   const SWCLDrawCommand *cmd,
+                                                   float u0, float v0,
+                                                   float u1, float v1) {
+  float x0 = (int32_t)cmd->rect.x, y0 = (int32_t)cmd->rect.y;
+  float x1 = x0 + cmd->rect.w, y1 = y0 + cmd->rect.h;
+  __swcl_vertex_push_uv(a, x0, y0, u0, v0, cmd->color);
+  __swcl_vertex_push_uv(a, x1, y0, u1, v0, cmd->color);
+  __swcl_vertex_push_uv(a, x1, y1, u1, v1, cmd->color);
+  __swcl_vertex_push_uv(a, x0, y0, u0, v0, cmd->color);
+  __swcl_vertex_push_uv(a, x1, y1, u1, v1, cmd->color);
+  __swcl_vertex_push_uv(a, x0, y1, u0, v1, cmd->color);
+}
 
-  glEnable(GL_MULTISAMPLE);
+#ifdef SWCL_ENABLE_TEXT
+// Quad of the glyph textured with its atlas slot
+static inline void __swcl_tessellate_glyph(SWCLVertexArray *a,
+                                           const SWCLDrawCommand *cmd) {
+  float k = 1.0f / SWCL_GLYPH_ATLAS_SIZE;
+  float u0 = cmd->glyph.atlas_x * k, v0 = cmd->glyph.atlas_y * k;
+  __swcl_tessellate_textured_quad(a, cmd, u0, v0, u0 + cmd->rect.w * k,
+                                  v0 + cmd->rect.h * k);
+}
+#endif
 
-  app->windows = swcl_array_new(2);
+// Convert drawing command into triangles
+static inline void __swcl_tessellate(SWCLVertexArray *a,
+                                     const SWCLDrawCommand *cmd) {
+  SWCLRect rect = cmd->rect;
+  switch (cmd->type) {
+  case SWCL_DRAW_CLEAR:
+    break;
+  case SWCL_DRAW_RECT:
+    __swcl_tessellate_quad(a, rect.x, rect.y, rect.x + rect.w, rect.y + rect.h,
+                           cmd->color);
+    break;
+  case SWCL_DRAW_ROUNDED_RECT: {
+    float r = cmd->radius;
+    if (r * 2 > rect.w)
+      r = rect.w / 2.0f;
+    if (r * 2 > rect.h)
+      r = rect.h / 2.0f;
+    float x0 = rect.x, y0 = rect.y;
+    float x1 = rect.x + rect.w, y1 = rect.y + rect.h;
+    uint32_t seg = SWCL_CIRCLE_SEGMENTS / 4;
+    // Middle column, side strips and quarter circle corners without overlaps
+    __swcl_tessellate_quad(a, x0 + r, y0, x1 - r, y1, cmd->color);
+    __swcl_tessellate_quad(a, x0, y0 + r, x0 + r, y1 - r, cmd->color);
+    __swcl_tessellate_quad(a, x1 - r, y0 + r, x1, y1 - r, cmd->color);
+    __swcl_tessellate_arc(a, x1 - r, y0 + r, r, -M_PI / 2, 0, seg, cmd->color);
+    __swcl_tessellate_arc(a, x1 - r, y1 - r, r, 0, M_PI / 2, seg, cmd->color);
+    __swcl_tessellate_arc(a, x0 + r, y1 - r, r, M_PI / 2, M_PI, seg,
+                          cmd->color);
+    __swcl_tessellate_arc(a, x0 + r, y0 + r, r, M_PI, M_PI * 1.5f, seg,
+                          cmd->color);
+    break;
+  }
+  case SWCL_DRAW_CIRCLE:
+    __swcl_tessellate_arc(a, cmd->circle.cx, cmd->circle.cy, cmd->circle.r, 0,
+                          2 * M_PI, SWCL_CIRCLE_SEGMENTS, cmd->color);
+    break;
+  case SWCL_DRAW_GLYPH:
+#ifdef SWCL_ENABLE_TEXT
+    __swcl_tessellate_glyph(a, cmd);
+#endif
+    break;
+  case SWCL_DRAW_TEXTURE:
+    __swcl_tessellate_textured_quad(a, cmd, 0, 0, 1, 1);
+    break;
+  }
+}
 
-  return app;
+// Draw batches of vertices from currently bound array buffer
+static inline void __swcl_draw_batches(SWCLApplication *app,
+                                       SWCLCommandBatch *batches,
+                                       uint32_t count, bool translucent) {
+  __swcl_gl_set_blend(app, translucent);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SWCLVertex),
+                        (void *)0);
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SWCLVertex),
+                        (void *)offsetof(SWCLVertex, color));
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SWCLVertex),
+                        (void *)offsetof(SWCLVertex, u));
+  for (uint32_t i = 0; i < count; i++) {
+    if (batches[i].clear)
+      swcl_clear_background(batches[i].clear_color);
+    if (batches[i].count > 0) {
+      __swcl_gl_use_texture(app, batches[i].texture);
+      glDrawArrays(GL_TRIANGLES, batches[i].first, batches[i].count);
+      app->stats.draw_calls++;
+    }
+  }
 }
 
-static inline void swcl_application_run(SWCLApplication *app) {
-  app->running = true;
-  while (app->running) {
-    wl_display_dispatch(app->wl_display);
+// Draw pending immediate draws as one batch
+static inline void __swcl_gl_flush(SWCLApplication *app) {
+  if (app->gl_pending.length == 0)
+    return;
+#ifdef SWCL_ENABLE_TEXT
+  __swcl_glyph_atlas_upload(app);
+#endif
+  SWCLCommandBatch batch = {.count = app->gl_pending.length,
+                            .texture = app->gl_pending_texture};
+  __swcl_gl_bind_array_buffer(app, app->gl_stream_buffer);
+  glBufferData(GL_ARRAY_BUFFER, app->gl_pending.length * sizeof(SWCLVertex),
+               app->gl_pending.items, GL_STREAM_DRAW);
+  __swcl_draw_batches(app, &batch, 1, app->gl_pending_translucent);
+  app->gl_pending.length = 0;
+  app->gl_pending_translucent = false;
+}
+
+// Add command to pending batch. Opaque shapes are drawn the same way with
+// blending enabled, so consecutive draws share one draw call unless they use
+// different textures.
+static inline void __swcl_gl_draw(SWCLDrawCommand cmd) {
+  SWCLApplication *app = __swcl_gl_window->app;
+  SWCLTexture *texture = __swcl_command_texture(&cmd);
+  if (app->gl_pending_texture != texture) {
+    __swcl_gl_flush(app);
+    app->gl_pending_texture = texture;
   }
-  // Cleanup
-  swcl_array_free(app->windows);
-  wl_display_disconnect(app->wl_display);
-  free(app);
+  if (app->gl_pending.length > 0)
+    app->stats.draws_merged++;
+  __swcl_tessellate(&app->gl_pending, &cmd);
+  if (__swcl_command_blends(&cmd))
+    app->gl_pending_translucent = true;
 }
 
-static inline void swcl_application_quit(SWCLApplication *app) {
-  app->running = false;
+static inline void swcl_clear_background(SWCLColor color) {
+  if (__swcl_defer((SWCLDrawCommand){.type = SWCL_DRAW_CLEAR, .color = color}))
+    return;
+  // Pending draws would be cleared anyway
+  __swcl_gl_window->app->gl_pending.length = 0;
+  // Framebuffer holds premultiplied colors
+  float a = color.a / 255.0f;
+  glClearColor(color.r / 255.0f * a, color.g / 255.0f * a,
+               color.b / 255.0f * a, a);
+  glClear(GL_COLOR_BUFFER_BIT);
 }
 
-static inline void swcl_application_set_cursor(SWCLApplication *app,
-                                               const char *name, uint8_t size) {
-  if (!app->current_cursor_name)
-    goto create;
-  if (!strcmp(app->current_cursor_name, name))
-    goto update;
-
-create:
-  app->wl_cursor_surface = wl_compositor_create_surface(app->wl_compositor);
-  app->wl_cursor_theme = wl_cursor_theme_load(NULL, size, app->wl_cursor_shm);
-  goto update;
-
-update:
-  app->wl_cursor = wl_cursor_theme_get_cursor(app->wl_cursor_theme, name);
-  app->wl_cursor_image = app->wl_cursor->images[0];
-  app->wl_cursor_buffer = wl_cursor_image_get_buffer(app->wl_cursor_image);
-  wl_surface_attach(app->wl_cursor_surface, app->wl_cursor_buffer, 0, 0);
-  goto finish;
-
-finish:
-  wl_surface_damage(app->wl_cursor_surface, 0, 0, app->wl_cursor_image->width,
-                    app->wl_cursor_image->height);
-  wl_surface_commit(app->wl_cursor_surface);
-  wl_pointer_set_cursor(app->wl_pointer, app->wl_pointer_serial,
-                        app->wl_cursor_surface, app->wl_cursor_image->hotspot_x,
-                        app->wl_cursor_image->hotspot_y);
-  app->current_cursor_name = (char *)name;
+// Draw rectangle with given color and dimentions.
+static inline void swcl_draw_rect(SWCLColor color, SWCLRect rect) {
+  SWCLDrawCommand cmd = {.type = SWCL_DRAW_RECT, .color = color, .rect = rect};
+  if (!__swcl_defer(cmd))
+    __swcl_gl_draw(cmd);
+}
+
+static inline void swcl_draw_rounded_rect(SWCLColor color, SWCLRect rect,
+                                          int radius) {
+  SWCLDrawCommand cmd = {.type = SWCL_DRAW_ROUNDED_RECT,
+                         .color = color,
+                         .rect = rect,
+                         .radius = radius};
+  if (!__swcl_defer(cmd))
+    __swcl_gl_draw(cmd);
+}
+
+static inline void swcl_draw_circle(SWCLColor color, SWCLCircle circle) {
+  SWCLDrawCommand cmd = {
+      .type = SWCL_DRAW_CIRCLE, .color = color, .circle = circle};
+  if (!__swcl_defer(cmd))
+    __swcl_gl_draw(cmd);
 }
 
 // ------------------------------------------------------------------------- //
 //                                                                           //
-//                            WINDOW IMPLEMENTATION                          //
+//                          TEXTURES IMPLEMENTATION                          //
 //                                                                           //
 // ------------------------------------------------------------------------- //
 
-static void __swcl_window_make_current(SWCLWindow *win);
-
-// -------- xdg_toplevel events callbacks -------- //
+// Copy RGBA rows into rectangle of software texture as premultiplied ARGB
+static inline void __swcl_texture_convert(SWCLTexture *t, uint32_t x,
+                                          uint32_t y, uint32_t w, uint32_t h,
+                                          const uint8_t *pixels,
+                                          uint32_t stride) {
+  for (uint32_t row = 0; row < h; row++) {
+    const uint8_t *src = pixels + (size_t)row * stride;
+    uint32_t *dst = t->pixels + (size_t)(y + row) * t->width + x;
+    for (uint32_t i = 0; i < w; i++, src += 4)
+      dst[i] = __swcl_sw_pixel((SWCLColor){src[0], src[1], src[2], src[3]});
+  }
+}
 
-static inline void on_xdg_toplevel_configure(void *data,
-                                             struct xdg_toplevel *toplevel,
-                                             int32_t width, int32_t height,
-                                             struct wl_array *states) {
-  if (width == 0 || height == 0)
+// Software frame is rendered at swap, so draws of the texture recorded in it
+// are given copy of its current pixels before they change, like OpenGL draws
+// made before the update. Texture gets its own copy of pixels if 'keep' is
+// set, otherwise it's being freed and the buffer is owned by the snapshot.
+static inline void __swcl_texture_snapshot(SWCLTexture *t, bool keep) {
+  SWCLWindow *win = __swcl_sw_window;
+  if (!win)
     return;
-  SWCL_LOG_DEBUG("xdg_toplevel configure. width=%d, height=%d", width, height);
-  SWCLWindow *win = (SWCLWindow *)data;
-
-  // Loop over the states array
-  uint32_t *state;
-  for (state = (uint32_t *)(states)->data;
-       (const char *)state < ((const char *)(states)->data + (states)->size);
-       (state)++) {
-    switch (*state) {
-    // Set maximized state
-    case XDG_TOPLEVEL_STATE_MAXIMIZED:
-      win->maximized = true;
-    // Set unmaximized state
-    case XDG_TOPLEVEL_STATE_ACTIVATED:
-      if (win->maximized && (win->width > width || win->height > height)) {
-        win->maximized = false;
+  SWCLTexture *snapshot = NULL;
+  for (uint32_t i = 0; i < win->commands_length; i++) {
+    SWCLDrawCommand *cmd = &win->commands[i];
+    if (cmd->type != SWCL_DRAW_TEXTURE || cmd->texture != t)
+      continue;
+    if (!snapshot) {
+      size_t size = (size_t)t->width * t->height * sizeof(uint32_t);
+      snapshot = SWCL_ALLOC(SWCLTexture);
+      *snapshot = *t;
+      // Old buffer goes to the snapshot, texture is updated in the copy
+      t->pixels = NULL;
+      if (keep) {
+        t->pixels = (uint32_t *)malloc(size);
+        memcpy(t->pixels, snapshot->pixels, size);
       }
+      swcl_array_append(&win->texture_snapshots, snapshot);
     }
+    cmd->texture = snapshot;
   }
+}
 
-  // Resize window if needed
-  if (win->egl_window && win->width != width || win->height != height) {
-    win->width = width;
-    win->height = height;
-    glViewport(0, 0, width, height);
-    wl_egl_window_resize(win->egl_window, width, height, 0, 0);
+// Create OpenGL texture from staging pixels or imported image. Context must
+// be current.
+static inline void __swcl_texture_realize(SWCLTexture *t) {
+  if (t->gl_texture)
+    return;
+  glGenTextures(1, &t->gl_texture);
+  __swcl_gl_bind_texture(t->app, t->gl_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  if (t->egl_image) {
+    t->app->gl_image_target_texture(GL_TEXTURE_2D, t->egl_image);
+    return;
+  }
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, t->width, t->height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, t->staging);
+  free(t->staging);
+  t->staging = NULL;
+}
+
+// Get next buffer of upload ring with room for 'size' bytes, bound as pixel
+// unpack buffer. Waits only if GPU hasn't finished upload made
+// SWCL_UPLOAD_BUFFERS uploads ago. Returns NULL if buffer can't be mapped.
+static inline SWCLUploadBuffer *__swcl_upload_buffer_get(SWCLApplication *app,
+                                                         size_t size) {
+  SWCLUploadBuffer *buf = &app->gl_uploads[app->gl_upload_index];
+  app->gl_upload_index = (app->gl_upload_index + 1) % SWCL_UPLOAD_BUFFERS;
+  if (buf->fence) {
+    glClientWaitSync(buf->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                     GL_TIMEOUT_IGNORED);
+    glDeleteSync(buf->fence);
+    buf->fence = NULL;
+  }
+  if (buf->size >= size) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf->pbo);
+    return buf;
+  }
+  // Storage of persistent buffer is immutable, so it's created again
+  if (buf->pbo)
+    glDeleteBuffers(1, &buf->pbo);
+  const GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &buf->pbo);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf->pbo);
+  glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+  buf->data =
+      (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+  buf->size = buf->data ? size : 0;
+  if (!buf->data) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return NULL;
+  }
+  SWCL_LOG_DEBUG("Created %zu bytes upload buffer", size);
+  return buf;
+}
+
+// Update rectangle of OpenGL texture. Pixels are copied into upload buffer
+// and GPU reads them from there after the call returns.
+static inline void __swcl_texture_upload(SWCLTexture *t, uint32_t x,
+                                         uint32_t y, uint32_t w, uint32_t h,
+                                         const uint8_t *pixels,
+                                         uint32_t stride) {
+  SWCLApplication *app = t->app;
+  __swcl_gl_bind_texture(app, t->gl_texture);
+  SWCLUploadBuffer *buf = NULL;
+  if (app->gl_persistent_upload &&
+      !(buf = __swcl_upload_buffer_get(app, (size_t)w * h * 4))) {
+    SWCL_LOG("Failed to map upload buffer, uploading textures directly");
+    app->gl_persistent_upload = false;
+  }
+  if (!buf) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride / 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE,
+                    pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    return;
+  }
+  if (stride == w * 4)
+    memcpy(buf->data, pixels, (size_t)w * h * 4);
+  else
+    for (uint32_t row = 0; row < h; row++)
+      memcpy(buf->data + (size_t)row * w * 4, pixels + (size_t)row * stride,
+             w * 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  buf->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Bind texture for drawing, glyph atlas if 'texture' is NULL
+static inline void __swcl_gl_use_texture(SWCLApplication *app,
+                                         SWCLTexture *texture) {
+  bool image = texture != NULL;
+  if (image) {
+    __swcl_texture_realize(texture);
+    __swcl_gl_bind_texture(app, texture->gl_texture);
+  } else
+    __swcl_gl_bind_texture(app, app->gl_atlas_texture);
+  if (!__swcl_gl_changed(app, app->gl_state.image != image))
+    return;
+  app->gl_state.image = image;
+  glUniform1i(app->gl_image_location, image);
+}
+
+static inline SWCLTexture *swcl_texture_create(SWCLApplication *app,
+                                               uint32_t width, uint32_t height,
+                                               const uint8_t *pixels) {
+  SWCLTexture *t = SWCL_ALLOC(SWCLTexture);
+  SWCL_LIVE_INC(textures);
+  t->app = app;
+  t->width = width;
+  t->height = height;
+  if (app->renderer == SWCL_RENDERER_SOFTWARE) {
+    t->pixels = (uint32_t *)calloc((size_t)width * height, sizeof(uint32_t));
+    if (pixels)
+      __swcl_texture_convert(t, 0, 0, width, height, pixels, width * 4);
+    return t;
+  }
+  t->staging = (uint8_t *)calloc((size_t)width * height, 4);
+  if (pixels)
+    memcpy(t->staging, pixels, (size_t)width * height * 4);
+  // Without current context texture is created when it's drawn first time
+  if (app->gl_program)
+    __swcl_texture_realize(t);
+  return t;
+}
+
+static inline void swcl_texture_update(SWCLTexture *texture, uint32_t x,
+                                       uint32_t y, uint32_t width,
+                                       uint32_t height, const uint8_t *pixels,
+                                       uint32_t stride) {
+  if (texture->egl_image) {
+    SWCL_LOG("Imported textures are updated by their producer");
+    return;
+  }
+  if (x + width > texture->width || y + height > texture->height) {
+    SWCL_LOG("Texture update is out of texture bounds");
+    return;
+  }
+  if (stride == 0)
+    stride = width * 4;
+  if (texture->pixels) {
+    __swcl_texture_snapshot(texture, true);
+    __swcl_texture_convert(texture, x, y, width, height, pixels, stride);
+    return;
+  }
+  SWCLApplication *app = texture->app;
+  if (!app->gl_program) {
+    for (uint32_t row = 0; row < height; row++)
+      memcpy(texture->staging + ((size_t)(y + row) * texture->width + x) * 4,
+             pixels + (size_t)row * stride, width * 4);
+    return;
+  }
+  // Draws made before the update must see old pixels
+  if (app->gl_pending_texture == texture)
+    __swcl_gl_flush(app);
+  __swcl_texture_realize(texture);
+  __swcl_texture_upload(texture, x, y, width, height, pixels, stride);
+}
+
+// Load dmabuf import entry points. Returns false if EGL can't import dmabufs.
+static inline bool __swcl_application_init_dmabuf_import(SWCLApplication *app) {
+  if (app->egl_create_image)
+    return true;
+  const char *exts = eglQueryString(app->egl_display, EGL_EXTENSIONS);
+  if (!exts || !strstr(exts, "EGL_EXT_image_dma_buf_import")) {
+    SWCL_LOG("EGL doesn't support dmabuf import");
+    return false;
+  }
+  app->egl_dmabuf_modifiers =
+      strstr(exts, "EGL_EXT_image_dma_buf_import_modifiers") != NULL;
+  app->gl_image_target_texture = (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)
+      eglGetProcAddress("glEGLImageTargetTexture2DOES");
+  app->egl_destroy_image =
+      (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
+  app->egl_create_image =
+      (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
+  if (!app->gl_image_target_texture || !app->egl_destroy_image) {
+    app->egl_create_image = NULL;
+    SWCL_LOG("Failed to load EGLImage functions");
+  }
+  return app->egl_create_image != NULL;
+}
+
+static inline SWCLTexture *
+swcl_texture_import_dmabuf(SWCLApplication *app, const SWCLDmabuf *dmabuf) {
+  if (app->renderer == SWCL_RENDERER_SOFTWARE) {
+    SWCL_LOG("Dmabuf import requires OpenGL renderer");
+    return NULL;
+  }
+  if (!__swcl_application_init_dmabuf_import(app))
+    return NULL;
+  if (dmabuf->planes_length == 0 ||
+      dmabuf->planes_length > SWCL_DMABUF_MAX_PLANES) {
+    SWCL_LOG("Invalid number of dmabuf planes: %d", dmabuf->planes_length);
+    return NULL;
+  }
+  bool modifier = dmabuf->modifier != SWCL_DMABUF_MOD_INVALID;
+  if (modifier && !app->egl_dmabuf_modifiers) {
+    SWCL_LOG("EGL doesn't support dmabuf modifiers");
+    return NULL;
+  }
+  static const EGLint plane_attrs[SWCL_DMABUF_MAX_PLANES][5] = {
+      {EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT,
+       EGL_DMA_BUF_PLANE0_PITCH_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT,
+       EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT},
+      {EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT,
+       EGL_DMA_BUF_PLANE1_PITCH_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT,
+       EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT},
+      {EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT,
+       EGL_DMA_BUF_PLANE2_PITCH_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT,
+       EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT},
+      {EGL_DMA_BUF_PLANE3_FD_EXT, EGL_DMA_BUF_PLANE3_OFFSET_EXT,
+       EGL_DMA_BUF_PLANE3_PITCH_EXT, EGL_DMA_BUF_PLANE3_MODIFIER_LO_EXT,
+       EGL_DMA_BUF_PLANE3_MODIFIER_HI_EXT},
+  };
+  EGLint attrs[7 + SWCL_DMABUF_MAX_PLANES * 10];
+  uint32_t n = 0;
+  attrs[n++] = EGL_WIDTH;
+  attrs[n++] = dmabuf->width;
+  attrs[n++] = EGL_HEIGHT;
+  attrs[n++] = dmabuf->height;
+  attrs[n++] = EGL_LINUX_DRM_FOURCC_EXT;
+  attrs[n++] = dmabuf->format;
+  for (uint32_t i = 0; i < dmabuf->planes_length; i++) {
+    attrs[n++] = plane_attrs[i][0];
+    attrs[n++] = dmabuf->planes[i].fd;
+    attrs[n++] = plane_attrs[i][1];
+    attrs[n++] = dmabuf->planes[i].offset;
+    attrs[n++] = plane_attrs[i][2];
+    attrs[n++] = dmabuf->planes[i].stride;
+    if (modifier) {
+      attrs[n++] = plane_attrs[i][3];
+      attrs[n++] = dmabuf->modifier & 0xffffffff;
+      attrs[n++] = plane_attrs[i][4];
+      attrs[n++] = dmabuf->modifier >> 32;
+    }
+  }
+  attrs[n++] = EGL_NONE;
+  EGLImageKHR image = app->egl_create_image(
+      app->egl_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, attrs);
+  if (image == EGL_NO_IMAGE_KHR) {
+    SWCL_LOG("Failed to import dmabuf: 0x%x", eglGetError());
+    return NULL;
   }
+  SWCLTexture *t = SWCL_ALLOC(SWCLTexture);
+  SWCL_LIVE_INC(textures);
+  t->app = app;
+  t->width = dmabuf->width;
+  t->height = dmabuf->height;
+  t->egl_image = image;
+  // Without current context texture is created when it's drawn first time
+  if (app->gl_program)
+    __swcl_texture_realize(t);
+  return t;
 }
 
-static inline void on_xdg_toplevel_close(void *data,
-                                         struct xdg_toplevel *toplevel) {
-  SWCLWindow *win = (SWCLWindow *)data;
-  win->app->running = false;
+static inline void swcl_texture_free(SWCLTexture *texture) {
+  SWCLApplication *app = texture->app;
+  if (app->gl_pending_texture == texture) {
+    __swcl_gl_flush(app);
+    app->gl_pending_texture = NULL;
+  }
+  if (texture->gl_texture) {
+    // Deleted texture is unbound by OpenGL
+    if (app->gl_state.texture == texture->gl_texture)
+      app->gl_state.texture = 0;
+    glDeleteTextures(1, &texture->gl_texture);
+  }
+  if (texture->egl_image)
+    app->egl_destroy_image(app->egl_display, texture->egl_image);
+  // Pending software draws keep the pixels until the frame is rendered
+  if (texture->pixels)
+    __swcl_texture_snapshot(texture, false);
+  free(texture->pixels);
+  free(texture->staging);
+  free(texture);
+  SWCL_LIVE_DEC(textures);
 }
 
-static const struct xdg_toplevel_listener xdg_toplevel_listener = {
-    .configure = on_xdg_toplevel_configure,
-    .close = on_xdg_toplevel_close,
-};
-
-// -------- xdg_surface events callbacks -------- //
-
-static inline void on_xdg_surface_configure(void *data,
-                                            struct xdg_surface *surface,
-                                            uint32_t serial) {
-  xdg_surface_ack_configure(surface, serial);
+static inline void swcl_draw_texture(SWCLTexture *texture, SWCLRect rect) {
+  SWCLDrawCommand cmd = {.type = SWCL_DRAW_TEXTURE,
+                         .color = {255, 255, 255, 255},
+                         .rect = rect,
+                         .texture = texture};
+  if (!__swcl_defer(cmd))
+    __swcl_gl_draw(cmd);
 }
 
-static const struct xdg_surface_listener xdg_surface_listener = {
-    .configure = on_xdg_surface_configure,
-};
+// ------------------------------------------------------------------------- //
+//                                                                           //
+//                            TEXT IMPLEMENTATION                            //
+//                                                                           //
+// ------------------------------------------------------------------------- //
 
-// -------- wl_callback events callback -------- //
+#ifdef SWCL_ENABLE_TEXT
 
-static void on_new_frame(void *data, struct wl_callback *cb, uint32_t cb_data);
-static const struct wl_callback_listener wl_callback_listener = {
-    .done = on_new_frame,
-};
+// -------- LRU lists -------- //
 
-static inline void on_new_frame(void *data, struct wl_callback *cb,
-                                uint32_t cb_data) {
-  SWCLWindow *win = (SWCLWindow *)data;
-  __swcl_window_make_current(win);
-  wl_callback_destroy(cb);
-  cb = wl_surface_frame(win->wl_surface);
-  wl_callback_add_listener(cb, &wl_callback_listener, win);
-  win->on_draw_cb(win);
+static inline void __swcl_lru_remove(SWCLLru *lru, SWCLLruLink *links,
+                                     uint32_t id) {
+  SWCLLruLink *l = &links[id - 1];
+  if (l->prev)
+    links[l->prev - 1].next = l->next;
+  else
+    lru->head = l->next;
+  if (l->next)
+    links[l->next - 1].prev = l->prev;
+  else
+    lru->tail = l->prev;
+  l->prev = l->next = 0;
 }
 
-// ---------- WINDOW METHODS ---------- //
-
-static inline SWCLWindow *swcl_window_new(SWCLApplication *app, char *title,
-                                          uint16_t width, uint16_t height,
-                                          uint16_t min_width,
-                                          uint16_t min_height, bool maximized,
-                                          bool fullscreen,
-                                          void (*draw_func)(SWCLWindow *win)) {
+static inline void __swcl_lru_push(SWCLLru *lru, SWCLLruLink *links,
+                                   uint32_t id) {
+  links[id - 1] = (SWCLLruLink){0, lru->head};
+  if (lru->head)
+    links[lru->head - 1].prev = id;
+  else
+    lru->tail = id;
+  lru->head = id;
+}
 
-  SWCLWindow *win = SWCL_ALLOC(SWCLWindow);
+// -------- Glyph atlas -------- //
 
-  win->id = swcl_generate_id();
-  win->width = width;
-  win->height = height;
-  win->min_width = min_width;
-  win->min_height = min_height;
-  win->maximized = maximized;
-  win->fullscreen = fullscreen;
-  win->title = title;
-  win->on_draw_cb = draw_func;
-  win->app = app;
+static inline void __swcl_font_set_size(SWCLFont *font, uint32_t size) {
+  if (font->size == size)
+    return;
+  FT_Set_Pixel_Sizes(font->face, 0, size);
+  font->size = size;
+}
 
-  SWCL_LOG_DEBUG("Create new window with id: %d, width: %d, height: %d",
-                 win->id, win->width, win->height);
+// Allocate CPU copy of atlas. Texel at 0, 0 is white.
+static inline void __swcl_glyph_atlas_init() {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  if (at->pixels)
+    return;
+  at->pixels =
+      (uint8_t *)calloc(SWCL_GLYPH_ATLAS_SIZE, SWCL_GLYPH_ATLAS_SIZE);
+  at->pixels[0] = 255;
+  at->shelves_y = 1;
+  at->dirty_y0 = 0;
+  at->dirty_y1 = SWCL_GLYPH_ATLAS_SIZE;
+}
 
-  // Get wl_surface
-  if (!app->wl_compositor)
-    SWCL_PANIC("Failed to get wl_compositor");
+static inline uint32_t __swcl_glyph_hash(const SWCLGlyphRef *ref) {
+  uint64_t h = (uintptr_t)ref->font * 0x9E3779B97F4A7C15ull;
+  h ^= ref->index * 0x85EBCA6Bull + ((uint32_t)ref->size << 8 | ref->bucket);
+  h *= 0xC2B2AE3D27D4EB4Full;
+  return (h >> 32) & (SWCL_GLYPH_CACHE_SIZE - 1);
+}
 
-  win->wl_surface = wl_compositor_create_surface(app->wl_compositor);
-  if (!win->wl_surface)
-    SWCL_PANIC("Failed to get wl_surface");
-  else
-    SWCL_LOG_DEBUG("Got wl_surface");
+static inline bool __swcl_glyph_equal(const SWCLGlyphRef *a,
+                                      const SWCLGlyphRef *b) {
+  return a->font == b->font && a->index == b->index && a->size == b->size &&
+         a->bucket == b->bucket;
+}
 
-  // Get wl_callback for surface frame
-  win->wl_callback = wl_surface_frame(win->wl_surface);
-  if (!win->wl_callback)
-    SWCL_PANIC("Failed to get wl_callback");
-  else {
-    SWCL_LOG_DEBUG("Got wl_callback");
-    wl_callback_add_listener(win->wl_callback, &wl_callback_listener, win);
-    wl_display_roundtrip(app->wl_display);
+// Remove glyph from atlas, its slot and cache entry become free
+static inline void __swcl_glyph_evict(uint32_t id) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  SWCLGlyph *g = &at->glyphs[id - 1];
+  uint32_t *link = &at->glyphs_table[__swcl_glyph_hash(&g->ref)];
+  while (*link != id)
+    link = &at->glyphs[*link - 1].hash_next;
+  *link = g->hash_next;
+  __swcl_lru_remove(&at->glyphs_lru, at->glyphs_links, id);
+  if (g->w && g->h) {
+    uint8_t cls = g->slot_class;
+    if (at->free_slots_length[cls] == at->free_slots_capacity[cls]) {
+      at->free_slots_capacity[cls] =
+          at->free_slots_capacity[cls] ? at->free_slots_capacity[cls] * 2 : 16;
+      at->free_slots[cls] = (SWCLAtlasSlot *)realloc(
+          at->free_slots[cls],
+          at->free_slots_capacity[cls] * sizeof(SWCLAtlasSlot));
+    }
+    at->free_slots[cls][at->free_slots_length[cls]++] =
+        (SWCLAtlasSlot){g->ref.atlas_x, g->ref.atlas_y};
   }
+  at->glyphs_free[at->glyphs_free_length++] = id;
+  at->generation++;
+}
 
-  // Get xdg_surface
-  win->xdg_surface =
-      xdg_wm_base_get_xdg_surface(app->xdg_wm_base, win->wl_surface);
-  if (!win->xdg_surface)
-    SWCL_PANIC("Failed to get xdg_surface");
-  else {
-    SWCL_LOG_DEBUG("Got xdg_surface");
-    xdg_surface_add_listener(win->xdg_surface, &xdg_surface_listener, NULL);
+// Find free slot of the size class. Reuses slots of least recently used
+// glyphs that were not used in current frame.
+static inline bool __swcl_glyph_atlas_alloc(uint8_t cls, SWCLAtlasSlot *slot) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  uint32_t size = (cls + 1) * SWCL_GLYPH_SLOT_STEP;
+  if (at->free_slots_length[cls] > 0) {
+    *slot = at->free_slots[cls][--at->free_slots_length[cls]];
+    return true;
   }
-
-  // Get xdg_toplevel
-  win->xdg_toplevel = xdg_surface_get_toplevel(win->xdg_surface);
-  if (!win->xdg_toplevel)
-    SWCL_PANIC("Failed to get xdg_toplevel");
-  else {
-    SWCL_LOG_DEBUG("Got xdg_toplevel");
-    xdg_toplevel_add_listener(win->xdg_toplevel, &xdg_toplevel_listener, win);
-    wl_display_roundtrip(app->wl_display);
+  for (uint32_t i = 0; i < at->shelves_length; i++) {
+    SWCLAtlasShelf *shelf = &at->shelves[i];
+    if (shelf->slot_class == cls &&
+        shelf->next_x + size <= SWCL_GLYPH_ATLAS_SIZE) {
+      *slot = (SWCLAtlasSlot){shelf->next_x, shelf->y};
+      shelf->next_x += size;
+      return true;
+    }
   }
+  if (at->shelves_y + size <= SWCL_GLYPH_ATLAS_SIZE) {
+    at->shelves[at->shelves_length++] =
+        (SWCLAtlasShelf){at->shelves_y, cls, size};
+    *slot = (SWCLAtlasSlot){0, at->shelves_y};
+    at->shelves_y += size;
+    return true;
+  }
+  // Glyphs after the first one used in this frame are used in it too
+  for (uint32_t id = at->glyphs_lru.tail; id;
+       id = at->glyphs_links[id - 1].prev) {
+    SWCLGlyph *g = &at->glyphs[id - 1];
+    if (g->last_used == at->frame)
+      break;
+    if (g->w && g->h && g->slot_class == cls) {
+      __swcl_glyph_evict(id);
+      *slot = at->free_slots[cls][--at->free_slots_length[cls]];
+      return true;
+    }
+  }
+  return false;
+}
 
-  // Create EGL window
-  win->egl_window =
-      wl_egl_window_create(win->wl_surface, win->width, win->height);
-
-  // Create EGL surface
-  win->egl_surface =
-      eglCreateWindowSurface(app->egl_display, app->egl_config,
-                             (EGLNativeWindowType)win->egl_window, NULL);
-  if (win->egl_surface == EGL_NO_SURFACE)
-    SWCL_PANIC("Failed to create EGL surface");
-  else
-    SWCL_LOG_DEBUG("Created EGL surface");
-
-  // Setup xdg_toplevel
-  xdg_toplevel_set_app_id(win->xdg_toplevel, app->app_id);
-  if (win->title)
-    xdg_toplevel_set_title(win->xdg_toplevel, win->title);
-  if (win->min_height && win->min_width)
-    xdg_toplevel_set_min_size(win->xdg_toplevel, win->min_width,
-                              win->min_height);
-  if (win->maximized)
-    xdg_toplevel_set_maximized(win->xdg_toplevel);
-  else
-    xdg_toplevel_unset_maximized(win->xdg_toplevel);
-
-  if (win->fullscreen)
-    xdg_toplevel_set_fullscreen(win->xdg_toplevel, NULL);
-  else
-    xdg_toplevel_unset_fullscreen(win->xdg_toplevel);
-
-  swcl_array_append(&app->windows, win);
-  SWCL_LOG_DEBUG("Created window with id=%d, at %p", win->id, win);
-  return win;
+// Mark glyph as used in current frame, so it isn't evicted until next one.
+// Must be called with atlas mutex locked.
+static inline void __swcl_glyph_touch(uint32_t id) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  SWCLGlyph *g = &at->glyphs[id - 1];
+  if (g->last_used == at->frame)
+    return;
+  g->last_used = at->frame;
+  __swcl_lru_remove(&at->glyphs_lru, at->glyphs_links, id);
+  __swcl_lru_push(&at->glyphs_lru, at->glyphs_links, id);
 }
 
-static inline void swcl_window_show(SWCLWindow *win) {
-  __swcl_window_make_current(win);
-  win->on_draw_cb(win);
+// Find glyph in atlas or rasterize it. Returns NULL if glyph can't be loaded
+// or there is no room for it. Must be called with atlas mutex locked.
+static inline SWCLGlyph *__swcl_glyph_get(SWCLGlyphRef ref) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  uint32_t hash = __swcl_glyph_hash(&ref);
+  for (uint32_t id = at->glyphs_table[hash]; id;) {
+    SWCLGlyph *g = &at->glyphs[id - 1];
+    if (__swcl_glyph_equal(&g->ref, &ref)) {
+      __swcl_glyph_touch(id);
+      return g;
+    }
+    id = g->hash_next;
+  }
+  if (at->reset)
+    return NULL;
+
+  // Rasterize glyph shifted by subpixel offset
+  SWCL_TRACE_BEGIN("__swcl_glyph_rasterize");
+  __swcl_font_set_size(ref.font, ref.size);
+  FT_GlyphSlot ft_glyph = ref.font->face->glyph;
+  if (FT_Load_Glyph(ref.font->face, ref.index,
+                    FT_LOAD_TARGET_LIGHT | FT_LOAD_NO_BITMAP)) {
+    SWCL_TRACE_END("__swcl_glyph_rasterize");
+    return NULL;
+  }
+  if (ft_glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+    FT_Outline_Translate(&ft_glyph->outline,
+                         ref.bucket * 64 / SWCL_SUBPIXEL_BUCKETS, 0);
+  if (FT_Render_Glyph(ft_glyph, FT_RENDER_MODE_NORMAL)) {
+    SWCL_TRACE_END("__swcl_glyph_rasterize");
+    return NULL;
+  }
+  SWCL_TRACE_END("__swcl_glyph_rasterize");
+  at->rasterized++;
+  FT_Bitmap *bitmap = &ft_glyph->bitmap;
+  uint32_t size =
+      bitmap->width > bitmap->rows ? bitmap->width : bitmap->rows;
+  uint8_t cls = size ? (size - 1) / SWCL_GLYPH_SLOT_STEP : 0;
+  if (cls >= SWCL_GLYPH_SLOT_CLASSES)
+    return NULL;
+
+  // Get free cache entry
+  uint32_t id;
+  if (at->glyphs_free_length > 0)
+    id = at->glyphs_free[--at->glyphs_free_length];
+  else if (at->glyphs_length < SWCL_GLYPH_CACHE_SIZE)
+    id = ++at->glyphs_length;
+  else if (at->glyphs[at->glyphs_lru.tail - 1].last_used != at->frame) {
+    __swcl_glyph_evict(at->glyphs_lru.tail);
+    id = at->glyphs_free[--at->glyphs_free_length];
+  } else
+    return NULL;
+
+  SWCLAtlasSlot slot = {0, 0};
+  if (size && !__swcl_glyph_atlas_alloc(cls, &slot)) {
+    at->glyphs_free[at->glyphs_free_length++] = id;
+    at->reset = true;
+    SWCL_LOG_DEBUG("Glyph atlas is full, it will be cleared on next frame");
+    return NULL;
+  }
+  SWCLGlyph *g = &at->glyphs[id - 1];
+  ref.atlas_x = slot.x;
+  ref.atlas_y = slot.y;
+  *g = (SWCLGlyph){
+      .ref = ref,
+      .w = bitmap->width,
+      .h = bitmap->rows,
+      .left = ft_glyph->bitmap_left,
+      .top = ft_glyph->bitmap_top,
+      .slot_class = cls,
+      .last_used = at->frame,
+      .hash_next = at->glyphs_table[hash],
+  };
+  at->glyphs_table[hash] = id;
+  __swcl_lru_push(&at->glyphs_lru, at->glyphs_links, id);
+  for (uint32_t row = 0; row < bitmap->rows; row++)
+    memcpy(at->pixels + (size_t)(slot.y + row) * SWCL_GLYPH_ATLAS_SIZE +
+               slot.x,
+           bitmap->buffer + (size_t)row * bitmap->pitch, bitmap->width);
+  if (size) {
+    if (slot.y < at->dirty_y0)
+      at->dirty_y0 = slot.y;
+    if (slot.y + bitmap->rows > at->dirty_y1)
+      at->dirty_y1 = slot.y + bitmap->rows;
+  }
+  return g;
 }
 
-static inline void __swcl_window_make_current(SWCLWindow *win) {
-  if (eglMakeCurrent(win->app->egl_display, win->egl_surface, win->egl_surface,
-                     win->app->egl_context) == EGL_FALSE)
-    SWCL_PANIC("Failed to make egl_surface current");
+// Start new frame of the atlas. If atlas overflowed in previous frame - clear
+// it, so glyphs can be placed from scratch.
+static inline void __swcl_glyph_atlas_next_frame() {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  pthread_mutex_lock(&at->mutex);
+  at->frame++;
+  if (at->reset) {
+    memset(at->glyphs_table, 0, sizeof(at->glyphs_table));
+    memset(at->free_slots_length, 0, sizeof(at->free_slots_length));
+    at->glyphs_length = 0;
+    at->glyphs_free_length = 0;
+    at->glyphs_lru = (SWCLLru){0};
+    at->shelves_length = 0;
+    at->shelves_y = 1;
+    at->generation++;
+    at->reset = false;
+  }
+  pthread_mutex_unlock(&at->mutex);
 }
 
-static inline void swcl_window_drag(SWCLWindow *win) {
-  xdg_toplevel_move(win->xdg_toplevel, win->app->wl_seat,
-                    win->app->wl_pointer_serial);
+// Upload changed rows of atlas to OpenGL texture
+static inline void __swcl_glyph_atlas_upload(SWCLApplication *app) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  pthread_mutex_lock(&at->mutex);
+  if (at->pixels && at->dirty_y0 < at->dirty_y1) {
+    SWCL_TRACE_BEGIN("__swcl_glyph_atlas_upload");
+    __swcl_gl_bind_texture(app, app->gl_atlas_texture);
+    if (app->gl_atlas_size != SWCL_GLYPH_ATLAS_SIZE) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, SWCL_GLYPH_ATLAS_SIZE,
+                   SWCL_GLYPH_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE,
+                   at->pixels);
+      app->gl_atlas_size = SWCL_GLYPH_ATLAS_SIZE;
+    } else
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, at->dirty_y0, SWCL_GLYPH_ATLAS_SIZE,
+                      at->dirty_y1 - at->dirty_y0, GL_RED, GL_UNSIGNED_BYTE,
+                      at->pixels +
+                          (size_t)at->dirty_y0 * SWCL_GLYPH_ATLAS_SIZE);
+    at->dirty_y0 = SWCL_GLYPH_ATLAS_SIZE;
+    at->dirty_y1 = 0;
+    SWCL_TRACE_END("__swcl_glyph_atlas_upload");
+  }
+  pthread_mutex_unlock(&at->mutex);
 }
 
-static inline void swcl_window_resize(SWCLWindow *win, SWCLWindowEdge edge) {
-  xdg_toplevel_resize(win->xdg_toplevel, win->app->wl_seat,
-                      win->app->wl_pointer_serial, edge);
+// -------- Shaping -------- //
+
+// Decode next UTF-8 code point. Invalid bytes are decoded as U+FFFD.
+static inline uint32_t __swcl_utf8_next(const char **text) {
+  const uint8_t *s = (const uint8_t *)*text;
+  uint32_t cp, len;
+  if (s[0] < 0x80)
+    cp = s[0], len = 1;
+  else if ((s[0] & 0xe0) == 0xc0)
+    cp = s[0] & 0x1f, len = 2;
+  else if ((s[0] & 0xf0) == 0xe0)
+    cp = s[0] & 0x0f, len = 3;
+  else if ((s[0] & 0xf8) == 0xf0)
+    cp = s[0] & 0x07, len = 4;
+  else {
+    *text += 1;
+    return 0xfffd;
+  }
+  for (uint32_t i = 1; i < len; i++) {
+    if ((s[i] & 0xc0) != 0x80) {
+      *text += i;
+      return 0xfffd;
+    }
+    cp = cp << 6 | (s[i] & 0x3f);
+  }
+  *text += len;
+  return cp;
 }
 
-static inline void swcl_window_swap_buffers(SWCLWindow *win) {
-  eglSwapBuffers(win->app->egl_display, win->egl_surface);
+static inline uint64_t __swcl_text_hash(SWCLFont *font, uint32_t size,
+                                        const char *text) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (const char *c = text; *c; c++)
+    h = (h ^ (uint8_t)*c) * 0x100000001b3ull;
+  h ^= (uintptr_t)font * 0x9E3779B97F4A7C15ull + size;
+  return h * 0x100000001b3ull;
 }
 
-static inline void swcl_window_set_title(SWCLWindow *win, char *title) {
-  win->title = title;
-  xdg_toplevel_set_title(win->xdg_toplevel, title);
+static inline void __swcl_text_run_evict(uint32_t id) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  SWCLTextRun *run = &at->runs[id - 1];
+  uint32_t *link =
+      &at->runs_table[run->hash & (SWCL_TEXT_RUN_CACHE_SIZE - 1)];
+  while (*link != id)
+    link = &at->runs[*link - 1].hash_next;
+  *link = run->hash_next;
+  __swcl_lru_remove(&at->runs_lru, at->runs_links, id);
+  free(run->text);
+  free(run->glyphs);
+  run->text = NULL;
+  run->glyphs = NULL;
+  at->runs_free[at->runs_free_length++] = id;
 }
 
-static inline void swcl_window_set_maximized(SWCLWindow *win, bool maximized) {
-  win->maximized = maximized;
-  if (maximized)
-    xdg_toplevel_set_maximized(win->xdg_toplevel);
+// Get cached shaped string or shape it. Text is laid out with font advances
+// and kerning. Must be called with atlas mutex locked.
+static inline SWCLTextRun *__swcl_text_shape(SWCLFont *font, uint32_t size,
+                                             const char *text) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  uint64_t hash = __swcl_text_hash(font, size, text);
+  uint32_t *head = &at->runs_table[hash & (SWCL_TEXT_RUN_CACHE_SIZE - 1)];
+  for (uint32_t id = *head; id;) {
+    SWCLTextRun *run = &at->runs[id - 1];
+    if (run->hash == hash && run->font == font && run->size == size &&
+        strcmp(run->text, text) == 0) {
+      __swcl_lru_remove(&at->runs_lru, at->runs_links, id);
+      __swcl_lru_push(&at->runs_lru, at->runs_links, id);
+      return run;
+    }
+    id = run->hash_next;
+  }
+
+  SWCL_TRACE_BEGIN("__swcl_text_shape");
+  uint32_t id;
+  if (at->runs_free_length == 0 && at->runs_length == SWCL_TEXT_RUN_CACHE_SIZE)
+    __swcl_text_run_evict(at->runs_lru.tail);
+  if (at->runs_free_length > 0)
+    id = at->runs_free[--at->runs_free_length];
   else
-    xdg_toplevel_unset_maximized(win->xdg_toplevel);
+    id = ++at->runs_length;
+  SWCLTextRun *run = &at->runs[id - 1];
+  size_t len = strlen(text);
+  *run = (SWCLTextRun){
+      .text = strdup(text),
+      .hash = hash,
+      .font = font,
+      .size = size,
+      .glyphs = (SWCLShapedGlyph *)malloc(len * sizeof(SWCLShapedGlyph)),
+      .hash_next = *head,
+  };
+  *head = id;
+  __swcl_lru_push(&at->runs_lru, at->runs_links, id);
+
+  __swcl_font_set_size(font, size);
+  FT_Face face = font->face;
+  bool kerning = FT_HAS_KERNING(face);
+  int32_t pen = 0;
+  uint32_t prev = 0;
+  const char *c = text;
+  while (*c) {
+    uint32_t index = FT_Get_Char_Index(face, __swcl_utf8_next(&c));
+    if (kerning && prev && index) {
+      FT_Vector delta;
+      if (!FT_Get_Kerning(face, prev, index, FT_KERNING_UNFITTED, &delta))
+        pen += delta.x;
+    }
+    run->glyphs[run->length++] = (SWCLShapedGlyph){index, pen};
+    // Unhinted advance is in 16.16
+    FT_Fixed advance;
+    if (!FT_Get_Advance(face, index, FT_LOAD_NO_HINTING, &advance))
+      pen += advance >> 10;
+    prev = index;
+  }
+  run->advance = pen;
+  run->ascender = face->size->metrics.ascender;
+  SWCL_TRACE_END("__swcl_text_shape");
+  return run;
 }
 
-static inline void swcl_window_minimize(SWCLWindow *win) {
-  xdg_toplevel_set_minimized(win->xdg_toplevel);
+// -------- Public API -------- //
+
+static inline SWCLFont *swcl_font_new(const char *path) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  SWCLFont *font = NULL;
+  pthread_mutex_lock(&at->mutex);
+  if (!at->ft && FT_Init_FreeType(&at->ft)) {
+    SWCL_LOG("Failed to init FreeType");
+    goto unlock;
+  }
+  font = SWCL_ALLOC(SWCLFont);
+  if (FT_New_Face(at->ft, path, 0, &font->face)) {
+    SWCL_LOG("Failed to load font %s", path);
+    free(font);
+    font = NULL;
+  } else
+    SWCL_LOG_DEBUG("Loaded font %s", path);
+unlock:
+  pthread_mutex_unlock(&at->mutex);
+  return font;
 }
 
-static inline void swcl_window_set_min_size(SWCLWindow *win, int min_width,
-                                            int min_height) {
-  if (min_width <= 0 || min_height <= 0)
+static inline void swcl_font_free(SWCLFont *font) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  pthread_mutex_lock(&at->mutex);
+  for (uint32_t id = at->glyphs_lru.head; id;) {
+    uint32_t next = at->glyphs_links[id - 1].next;
+    if (at->glyphs[id - 1].ref.font == font)
+      __swcl_glyph_evict(id);
+    id = next;
+  }
+  for (uint32_t id = at->runs_lru.head; id;) {
+    uint32_t next = at->runs_links[id - 1].next;
+    if (at->runs[id - 1].font == font)
+      __swcl_text_run_evict(id);
+    id = next;
+  }
+  FT_Done_Face(font->face);
+  free(font);
+  pthread_mutex_unlock(&at->mutex);
+}
+
+static inline void swcl_draw_text(SWCLColor color, SWCLFont *font,
+                                  uint32_t size, float x, float y,
+                                  const char *text) {
+  if (!font || !text || !*text)
     return;
-  win->min_width = min_width;
-  win->min_height = min_height;
-  xdg_toplevel_set_min_size(win->xdg_toplevel, min_width, min_height);
+  // Lines outside of the window are not even shaped. Recorded lists can be
+  // drawn with any offset, so they get all lines.
+  SWCLWindow *win = __swcl_sw_window ? __swcl_sw_window : __swcl_gl_window;
+  if (!__swcl_recording && win &&
+      (y >= (float)win->height || y + size * 2.0f < 0))
+    return;
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  pthread_mutex_lock(&at->mutex);
+  __swcl_glyph_atlas_init();
+  SWCLTextRun *run = __swcl_text_shape(font, size, text);
+  int32_t baseline = (int32_t)floorf(y + run->ascender / 64.0f + 0.5f);
+  for (uint32_t i = 0; i < run->length; i++) {
+    float pen = x + run->glyphs[i].x / 64.0f;
+    float px = floorf(pen);
+    uint32_t bucket = (pen - px) * SWCL_SUBPIXEL_BUCKETS;
+    if (bucket >= SWCL_SUBPIXEL_BUCKETS)
+      bucket = SWCL_SUBPIXEL_BUCKETS - 1;
+    SWCLGlyph *g = __swcl_glyph_get((SWCLGlyphRef){
+        .font = font,
+        .index = run->glyphs[i].index,
+        .size = size,
+        .bucket = bucket,
+    });
+    if (!g || !g->w || !g->h)
+      continue;
+    SWCLDrawCommand cmd = {
+        .type = SWCL_DRAW_GLYPH,
+        .color = color,
+        .rect = {(uint32_t)((int32_t)px + g->left),
+                 (uint32_t)(baseline - g->top), g->w, g->h},
+        .glyph = g->ref,
+    };
+    if (!__swcl_defer(cmd))
+      __swcl_gl_draw(cmd);
+  }
+  pthread_mutex_unlock(&at->mutex);
 }
 
-// inline void swcl_window_ancor(SWCLWindow *win, SWCLAncor ancor) {
-//   SWCL_NOT_IMPLEMENTED("swcl_window_ancor");
-//   return;
-//   if (!win->app->zwlr_layer_shell) {
-//     SWCL_LOG("Compositor is not supporting wlr_layer_shell");
-//     return;
-//   }
-// }
+static inline float swcl_text_width(SWCLFont *font, uint32_t size,
+                                    const char *text) {
+  if (!font || !text)
+    return 0;
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  pthread_mutex_lock(&at->mutex);
+  float width = __swcl_text_shape(font, size, text)->advance / 64.0f;
+  pthread_mutex_unlock(&at->mutex);
+  return width;
+}
 
-// inline void swcl_window_request_ssr(SWCLWindow *win) {
-//   SWCL_NOT_IMPLEMENTED("swcl_window_request_ssr");
-//   return;
-// }
+#endif // SWCL_ENABLE_TEXT
 
 // ------------------------------------------------------------------------- //
 //                                                                           //
-//                           DRAWING IMPLEMENTATION                          //
+//                        COMMAND LISTS IMPLEMENTATION                       //
 //                                                                           //
 // ------------------------------------------------------------------------- //
 
-// Setup coordinates system with top left corner as 0. If window size is not
-// changed - do nothing.
-static inline void __swcl_set_orthographic_projection() {
-  uint32_t width;
-  uint32_t height;
-  GLint viewport[4];
+// Iterate over blocks of the list that hold recorded commands
+#define __swcl_command_list_foreach_block(list, block)                         \
+  for (SWCLCommandBlock *block = (list)->current ? (list)->first : NULL;       \
+       block; block = block == (list)->current ? NULL : block->next)
+
+// Append command to the list, reusing blocks from previous recordings
+static inline void __swcl_command_list_push(SWCLCommandList *list,
+                                            SWCLDrawCommand cmd) {
+  SWCLCommandBlock *block = list->current;
+  if (!block || block->length == SWCL_COMMAND_BLOCK_SIZE) {
+    SWCLCommandBlock *next = block ? block->next : list->first;
+    if (!next) {
+      next = SWCL_ALLOC(SWCLCommandBlock);
+      if (block)
+        block->next = next;
+      else
+        list->first = next;
+    }
+    next->length = 0;
+    block = list->current = next;
+  }
+  block->commands[block->length++] = cmd;
+  list->length++;
+}
+
+static inline SWCLCommandBatch *
+__swcl_command_list_add_batch(SWCLCommandList *list) {
+  if (list->batches_length == list->batches_capacity) {
+    list->batches_capacity =
+        list->batches_capacity ? list->batches_capacity * 2 : 4;
+    list->batches = (SWCLCommandBatch *)realloc(
+        list->batches, list->batches_capacity * sizeof(SWCLCommandBatch));
+  }
+  SWCLCommandBatch *batch = &list->batches[list->batches_length++];
+  *batch = (SWCLCommandBatch){.first = list->vertices.length};
+  return batch;
+}
+
+// Convert recorded commands into vertices. Clear commands and texture
+// changes split vertices into batches.
+static inline void __swcl_command_list_tessellate(SWCLCommandList *list) {
+  list->vertices.length = 0;
+  list->batches_length = 0;
+  list->translucent = false;
+  list->has_glyphs = false;
+  list->opaque = (SWCLOpaqueRegion){0};
+  SWCLCommandBatch *batch = __swcl_command_list_add_batch(list);
+  __swcl_command_list_foreach_block(list, block) {
+    for (uint32_t i = 0; i < block->length; i++) {
+      SWCLDrawCommand *cmd = &block->commands[i];
+      __swcl_opaque_region_add(&list->opaque, cmd, 0, 0);
+      if (cmd->type == SWCL_DRAW_CLEAR) {
+        if (batch->count > 0)
+          batch = __swcl_command_list_add_batch(list);
+        batch->clear = true;
+        batch->clear_color = cmd->color;
+        continue;
+      }
+      if (__swcl_command_blends(cmd))
+        list->translucent = true;
+      if (cmd->type == SWCL_DRAW_GLYPH)
+        list->has_glyphs = true;
+      SWCLTexture *texture = __swcl_command_texture(cmd);
+      if (batch->texture != texture) {
+        if (batch->count > 0)
+          batch = __swcl_command_list_add_batch(list);
+        batch->texture = texture;
+      }
+      __swcl_tessellate(&list->vertices, cmd);
+      batch->count = list->vertices.length - batch->first;
+    }
+  }
+}
+
+// Append commands of the list translated by x and y to the current recording
+// or software renderer frame
+static inline void __swcl_command_list_defer(SWCLCommandList *list, int32_t x,
+                                             int32_t y) {
+  __swcl_command_list_foreach_block(list, block) {
+    for (uint32_t i = 0; i < block->length; i++) {
+      SWCLDrawCommand cmd = block->commands[i];
+      if (cmd.type == SWCL_DRAW_CIRCLE) {
+        cmd.circle.cx += x;
+        cmd.circle.cy += y;
+      } else if (cmd.type != SWCL_DRAW_CLEAR) {
+        cmd.rect.x += x;
+        cmd.rect.y += y;
+      }
+      __swcl_defer(cmd);
+    }
+  }
+}
+
+#ifdef SWCL_ENABLE_TEXT
+// Look up glyphs of the list in atlas with their current positions and
+// collect distinct ones, so they can be kept in atlas while list is drawn
+static inline void __swcl_command_list_place_glyphs(SWCLCommandList *list) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  uint64_t seen[(SWCL_GLYPH_CACHE_SIZE + 63) / 64] = {0};
+  list->glyphs_length = 0;
+  pthread_mutex_lock(&at->mutex);
+  __swcl_command_list_foreach_block(list, block) {
+    for (uint32_t i = 0; i < block->length; i++) {
+      SWCLDrawCommand *cmd = &block->commands[i];
+      if (cmd->type != SWCL_DRAW_GLYPH)
+        continue;
+      SWCLGlyph *g = __swcl_glyph_get(cmd->glyph);
+      if (!g) {
+        cmd->rect.w = cmd->rect.h = 0;
+        continue;
+      }
+      cmd->glyph = g->ref;
+      cmd->rect.w = g->w;
+      cmd->rect.h = g->h;
+      uint32_t id = g - at->glyphs;
+      if (seen[id / 64] & (1ull << id % 64))
+        continue;
+      seen[id / 64] |= 1ull << id % 64;
+      if (list->glyphs_length == list->glyphs_capacity) {
+        list->glyphs_capacity =
+            list->glyphs_capacity ? list->glyphs_capacity * 2 : 64;
+        list->glyphs = (uint32_t *)realloc(
+            list->glyphs, list->glyphs_capacity * sizeof(uint32_t));
+      }
+      list->glyphs[list->glyphs_length++] = id + 1;
+    }
+  }
+  // All glyphs of the list are used in this frame, so lookups above couldn't
+  // evict any of them
+  list->glyph_generation = at->generation;
+  pthread_mutex_unlock(&at->mutex);
+}
 
-  glGetIntegerv(GL_VIEWPORT, viewport);
-  if (width && height && viewport[2] == width && viewport[3] == height)
+// Keep glyphs of the list in atlas until the frame it's drawn in ends. If
+// atlas evicted some glyphs since they were placed, look them up again and
+// tessellate the list with their new positions.
+static inline void __swcl_command_list_update_glyphs(SWCLCommandList *list) {
+  SWCLGlyphAtlas *at = &__swcl_glyph_atlas;
+  if (!list->has_glyphs)
     return;
+  pthread_mutex_lock(&at->mutex);
+  if (list->glyph_generation == at->generation) {
+    for (uint32_t i = 0; i < list->glyphs_length; i++)
+      __swcl_glyph_touch(list->glyphs[i]);
+    pthread_mutex_unlock(&at->mutex);
+    return;
+  }
+  pthread_mutex_unlock(&at->mutex);
+  __swcl_command_list_place_glyphs(list);
+  __swcl_command_list_tessellate(list);
+  list->uploaded = false;
+}
+#endif
 
-  width = viewport[2];
-  height = viewport[3];
+static inline SWCLCommandList *swcl_command_list_new() {
+  SWCLCommandList *list = SWCL_ALLOC(SWCLCommandList);
+  list->dirty = true;
+  return list;
+}
 
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glOrtho(0, width, height, 0, -1, 1);
-  glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
+static inline void swcl_command_list_begin(SWCLCommandList *list) {
+  list->current = NULL;
+  list->length = 0;
+  list->uploaded = false;
+  __swcl_recording = list;
 }
 
-static inline void swcl_clear_background(SWCLColor color) {
-  glClearColor(color.r, color.g, color.b, color.a);
-  glClear(GL_COLOR_BUFFER_BIT);
+static inline void swcl_command_list_end(SWCLCommandList *list) {
+  if (__swcl_recording == list)
+    __swcl_recording = NULL;
+#ifdef SWCL_ENABLE_TEXT
+  // Remember glyphs of the list, so they stay in atlas when it's drawn
+  __swcl_command_list_place_glyphs(list);
+#endif
+  __swcl_command_list_tessellate(list);
+  list->dirty = false;
 }
 
-// Draw rectangle with given color and dimentions.
-static inline void swcl_draw_rect(SWCLColor color, SWCLRect rect) {
-  if (color.a < 255) {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  }
-  __swcl_set_orthographic_projection();
-  glColor4ub(color.r, color.g, color.b, color.a);
-  glBegin(GL_QUADS);
-  glVertex2i(rect.x, rect.y);
-  glVertex2i(rect.x + rect.w, rect.y);
-  glVertex2i(rect.x + rect.w, rect.y + rect.h);
-  glVertex2i(rect.x, rect.y + rect.h);
-  glEnd();
-  if (color.a < 255)
-    glDisable(GL_BLEND);
+static inline void swcl_command_list_invalidate(SWCLCommandList *list) {
+  list->dirty = true;
 }
 
-static inline void swcl_draw_rounded_rect(SWCLColor color, SWCLRect rect,
-                                          int radius) {
-  if (radius == 0) {
-    swcl_draw_rect(color, rect);
-    return;
-  }
-  // Draw corner circles
-  swcl_draw_circle(
-      color, (SWCLCircle){rect.x + radius, rect.y + radius, (uint32_t)radius});
-  swcl_draw_circle(color, (SWCLCircle){rect.x + rect.w - radius,
-                                       rect.y + radius, (uint32_t)radius});
-  swcl_draw_circle(color,
-                   (SWCLCircle){rect.x + radius, rect.y + rect.h - radius,
-                                (uint32_t)radius});
-  swcl_draw_circle(color,
-                   (SWCLCircle){rect.x + rect.w - radius,
-                                rect.y + rect.h - radius, (uint32_t)radius});
-  // Draw rects
-  swcl_draw_rect(
-      color, (SWCLRect){rect.x + radius, rect.y, rect.w - radius * 2, rect.h});
-  swcl_draw_rect(
-      color, (SWCLRect){rect.x, rect.y + radius, rect.w, rect.h - radius * 2});
+static inline void swcl_command_list_draw(SWCLCommandList *list, int32_t x,
+                                          int32_t y) {
+#ifdef SWCL_ENABLE_TEXT
+  __swcl_command_list_update_glyphs(list);
+#endif
+  // Software renderer and nested recording get translated commands
+  if (__swcl_recording || __swcl_sw_window) {
+    __swcl_command_list_defer(list, x, y);
+    return;
+  }
+  SWCL_TRACE_BEGIN("swcl_command_list_draw");
+  SWCLApplication *app = __swcl_gl_window->app;
+  __swcl_gl_flush(app);
+#ifdef SWCL_ENABLE_TEXT
+  __swcl_glyph_atlas_upload(app);
+#endif
+  if (!list->gl_buffer) {
+    glGenBuffers(1, &list->gl_buffer);
+    list->gl_app = app;
+  }
+  __swcl_gl_bind_array_buffer(app, list->gl_buffer);
+  if (!list->uploaded) {
+    glBufferData(GL_ARRAY_BUFFER, list->vertices.length * sizeof(SWCLVertex),
+                 list->vertices.items, GL_STATIC_DRAW);
+    list->uploaded = true;
+  }
+  glUniform2f(app->gl_offset_location, x, y);
+  __swcl_draw_batches(app, list->batches, list->batches_length,
+                      list->translucent);
+  glUniform2f(app->gl_offset_location, 0, 0);
+  __swcl_opaque_region_merge(&__swcl_gl_window->opaque, &list->opaque, x, y);
+  SWCL_TRACE_END("swcl_command_list_draw");
 }
 
-static inline void swcl_draw_circle(SWCLColor color, SWCLCircle circle) {
-  if (color.a < 255) {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  }
-  __swcl_set_orthographic_projection();
-  glColor4ub(color.r, color.g, color.b, color.a);
-  glBegin(GL_POLYGON);
-  for (int i = 0; i <= 100; i++) {
-    double angle = 2 * M_PI * i / 100;
-    double x = cos(angle) * circle.r;
-    double y = sin(angle) * circle.r;
-    glVertex2d(circle.cx + x, circle.cy + y);
-  }
-  glEnd();
-  if (color.a < 255)
-    glDisable(GL_BLEND);
+// Batches of lists merged by 'swcl_command_lists_submit'
+static SWCLCommandBatch *__swcl_stream_batches;
+static uint32_t __swcl_stream_batches_capacity;
+
+static inline void swcl_command_lists_submit(SWCLCommandList **lists,
+                                             uint32_t count) {
+#ifdef SWCL_ENABLE_TEXT
+  for (uint32_t i = 0; i < count; i++)
+    __swcl_command_list_update_glyphs(lists[i]);
+#endif
+  if (__swcl_recording || __swcl_sw_window) {
+    for (uint32_t i = 0; i < count; i++)
+      __swcl_command_list_defer(lists[i], 0, 0);
+    return;
+  }
+  SWCL_TRACE_BEGIN("swcl_command_lists_submit");
+  SWCLApplication *app = __swcl_gl_window->app;
+  __swcl_gl_flush(app);
+#ifdef SWCL_ENABLE_TEXT
+  __swcl_glyph_atlas_upload(app);
+#endif
+  // Merge batches of all lists, joining neighbours that are not split by clear
+  // and use the same texture
+  uint32_t vertices = 0, batches = 0;
+  bool translucent = false;
+  for (uint32_t i = 0; i < count; i++)
+    batches += lists[i]->batches_length;
+  if (batches > __swcl_stream_batches_capacity) {
+    __swcl_stream_batches_capacity = batches;
+    __swcl_stream_batches = (SWCLCommandBatch *)realloc(
+        __swcl_stream_batches, batches * sizeof(SWCLCommandBatch));
+  }
+  batches = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    SWCLCommandList *list = lists[i];
+    translucent |= list->translucent;
+    for (uint32_t j = 0; j < list->batches_length; j++) {
+      SWCLCommandBatch b = list->batches[j];
+      b.first += vertices;
+      if (batches > 0 && !b.clear &&
+          __swcl_stream_batches[batches - 1].texture == b.texture)
+        __swcl_stream_batches[batches - 1].count += b.count;
+      else
+        __swcl_stream_batches[batches++] = b;
+    }
+    vertices += list->vertices.length;
+  }
+  // Upload all vertices into one orphaned buffer
+  __swcl_gl_bind_array_buffer(app, app->gl_stream_buffer);
+  glBufferData(GL_ARRAY_BUFFER, vertices * sizeof(SWCLVertex), NULL,
+               GL_STREAM_DRAW);
+  vertices = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    SWCLVertexArray *v = &lists[i]->vertices;
+    glBufferSubData(GL_ARRAY_BUFFER, vertices * sizeof(SWCLVertex),
+                    v->length * sizeof(SWCLVertex), v->items);
+    vertices += v->length;
+  }
+  __swcl_draw_batches(app, __swcl_stream_batches, batches, translucent);
+  for (uint32_t i = 0; i < count; i++)
+    __swcl_opaque_region_merge(&__swcl_gl_window->opaque, &lists[i]->opaque, 0,
+                               0);
+  SWCL_TRACE_END("swcl_command_lists_submit");
+}
+
+static inline void swcl_command_list_free(SWCLCommandList *list) {
+  if (__swcl_recording == list)
+    __swcl_recording = NULL;
+  if (list->gl_buffer) {
+    // Deleted buffer is unbound by OpenGL
+    SWCLGLState *state = &list->gl_app->gl_state;
+    if (state->array_buffer == list->gl_buffer)
+      state->array_buffer = 0;
+    glDeleteBuffers(1, &list->gl_buffer);
+  }
+  SWCLCommandBlock *block = list->first;
+  while (block) {
+    SWCLCommandBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  free(list->vertices.items);
+  free(list->batches);
+  free(list->glyphs);
+  free(list);
 }
 
 #endif // SWCL_IMPLEMENTATION